@@ -33,6 +33,7 @@
 #include <common/config.h>
 #include <common/array.h>
 #include <act/path.h>
+#include <act/profile.h>
 #include "fexpr.h"
 
 #ifdef DEBUG_PERFORMANCE
@@ -52,6 +53,9 @@ struct command_line_defs {
 
 int Act::max_recurse_depth;
 int Act::max_loop_iterations;
+int Act::parse_threads;
+int Act::func_bytecode;
+char *Act::ast_cache;
 int Act::emit_depend;
 char *Act::_getopt_string;
 
@@ -253,6 +257,9 @@ int Act::_process_act_arg (const char *argvp, int *tech_specified, char **conf)
       if (strcmp (tmp, "config") == 0) {
 	Log::UpdateLogLevel("A");
       }
+      else if (strcmp (tmp, "parse") == 0) {
+	Log::UpdateLogLevel("P");
+      }
       else {
 	fatal_error ("-V option `%s' is unknown", tmp);
       }
@@ -293,6 +300,13 @@ int Act::_process_act_arg (const char *argvp, int *tech_specified, char **conf)
   else if (strncmp (argvp, "-lev=", 5) == 0) {
     Log::UpdateLogLevel(argvp+5);
   }
+  else if (strcmp (argvp, "-prof") == 0 ||
+	   strncmp (argvp, "-prof=", 6) == 0) {
+    /* -prof=text|json[:file] */
+    if (!act_prof_setup (argvp[5] ? argvp+6 : NULL)) {
+      fatal_error ("-prof option `%s' must be text or json, optionally followed by :file", argvp);
+    }
+  }
   else {
     return 0;
   }
@@ -334,6 +348,9 @@ void Act::Init (int *iargc, char ***iargv, list_t *multi_conf)
 
   config_set_default_int ("act.max_recurse_depth", 1000);
   config_set_default_int ("act.max_loop_iterations", 1000);
+  config_set_default_int ("act.parse_threads", 1);
+  config_set_default_int ("act.func_bytecode", 1);
+  config_set_default_string ("act.ast_cache", "");
   
 #define WARNING_FLAG(x,y) \
   config_set_default_int ("act.warn." #x, y);
@@ -456,6 +473,12 @@ void Act::Init (int *iargc, char ***iargv, list_t *multi_conf)
   
   Act::max_recurse_depth = config_get_int ("act.max_recurse_depth");
   Act::max_loop_iterations = config_get_int ("act.max_loop_iterations");
+  Act::parse_threads = config_get_int ("act.parse_threads");
+  Act::func_bytecode = config_get_int ("act.func_bytecode");
+  {
+    char *s = config_get_string ("act.ast_cache");
+    Act::ast_cache = (s && *s) ? Strdup (s) : NULL;
+  }
   Act::cmdline_args = NULL;
   
   return;
@@ -620,6 +643,8 @@ Act::Act (const char *s)
   FREE (argv[0]);
   FREE (argv);
 
+  act_prof_begin ("Act::Act");
+
   /* load in standard config parameters */
   refine_steps = config_get_int ("act.refine_steps");
   
@@ -682,6 +707,8 @@ Act::Act (const char *s)
 
   /* read in file, if specified */
   Merge (s);
+
+  act_prof_end ();
 }
 
 void Act::Merge (const char *s)
@@ -708,7 +735,14 @@ void Act::Merge (const char *s)
     return;
   }
 
-  a = act_parse (s);
+  act_prof_begin ("Merge");
+
+  act_prof_begin ("parse");
+  a = act_cached_parse (s);
+
+  /* parse the imports ahead of the walk */
+  act_import_prefetch (a, Act::parse_threads);
+  act_prof_end ();
 
 #ifdef DEBUG_PERFORMANCE
   printf ("Parser time: %g\n", (realtime_msec()/1000.0));
@@ -781,7 +815,11 @@ void Act::Merge (const char *s)
     }
   }
 
+  act_prof_begin ("walk");
   act_walk_X (&tr, a);
+  act_import_drain ();
+  act_prof_end ();
+  act_parse_cache_report ();
   
   act_parse_free (a);
 
@@ -790,6 +828,8 @@ void Act::Merge (const char *s)
 #endif
   _free_tr (&tr);
   _finished_init = true;
+
+  act_prof_end ();
 }
 
 
@@ -800,11 +840,15 @@ void Act::Expand ()
   /* update refine steps to the latest value */
   refine_steps = config_get_int ("act.refine_steps");
 
+  act_prof_begin ("Expand");
+
   /* expand each namespace! */
   gns->Expand ();
 
   /* mark all user-enum data types as int */
   gns->enum2Int ();
+
+  act_prof_end ();
 }
 
 
@@ -400,6 +400,23 @@ class Act {
    */
   static int max_loop_iterations;
 
+  /**
+   * Number of threads used to parse imported files (0 = one per
+   * processor, 1 = parse imports sequentially)
+   */
+  static int parse_threads;
+
+  /**
+   * 1 if parameter function bodies are compiled to bytecode, 0 to
+   * always use the tree interpreter
+   */
+  static int func_bytecode;
+
+  /**
+   * Directory used to cache parse trees (NULL = no cache)
+   */
+  static char *ast_cache;
+
 #define WARNING_FLAG(x,y) \
   static int x ;
 #include "warn.def"
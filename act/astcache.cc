@@ -0,0 +1,421 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <act/act.h>
+#include <act/expr_extra.h>
+#include <common/misc.h>
+#include <common/list.h>
+#include <common/mstring.h>
+#include <common/int.h>
+#include <common/log.h>
+#include "act_parse.h"
+#include "act_parse_int.h"
+#include "path.h"
+
+/*------------------------------------------------------------------------
+ *
+ *  Parse tree cache
+ *
+ *   Parse trees are saved in the directory named by act.ast_cache,
+ *  one file per source file. The cache file name is a hash of the
+ *  contents and the name of the source file, so an edited file simply
+ *  misses; there is no need to check time stamps. The cache file
+ *  starts with a header that identifies the grammar and the source,
+ *  and a checksum of the saved tree.
+ *
+ *   Files that contain something that cannot be saved (external
+ *  language bodies) are parsed every time.
+ *
+ *------------------------------------------------------------------------
+ */
+
+/* bump this when the act-specific parts of the saved format change */
+#define AST_CACHE_VERSION 1
+
+struct ast_header {
+  char magic[8];
+  unsigned long sig;		/* grammar signature */
+  unsigned long key;		/* source hash */
+  unsigned long srclen;		/* source length */
+  unsigned long len;		/* saved tree length */
+  unsigned long sum;		/* saved tree checksum */
+};
+
+static const char _ast_magic[8] = "ACTAST";
+
+static int _hits = 0;
+static int _misses = 0;
+static int _uncached = 0;
+
+static pthread_mutex_t _miss_lock = PTHREAD_MUTEX_INITIALIZER;
+static list_t *_miss_list = NULL;
+
+static Log *_cache_log = NULL;
+
+static unsigned long _hash (unsigned long h, const char *s, size_t len)
+{
+  while (len > 0) {
+    h = (h ^ (unsigned char)*s) * 0x100000001b3UL;
+    s++;
+    len--;
+  }
+  return h;
+}
+
+static unsigned long _signature (void)
+{
+  return act_parse_signature () ^ (unsigned long) AST_CACHE_VERSION;
+}
+
+
+/*-- act-specific expressions --*/
+
+static int _save_expr_special (FILE *fp, Expr *e)
+{
+  BigInt *b;
+
+  switch (e->type) {
+  case E_INT:
+    expr_save_uint (fp, e->u.ival.v);
+    b = (BigInt *) e->u.ival.v_extra;
+    if (!b) {
+      expr_save_uint (fp, 0);
+      return 1;
+    }
+    if (b->getLen() != (b->getWidth() + BIGINT_BITS_ONE - 1)/BIGINT_BITS_ONE) {
+      return -1;
+    }
+    expr_save_uint (fp, 1);
+    expr_save_uint (fp, b->getWidth());
+    expr_save_uint (fp, (b->isSigned() ? 1 : 0) | (b->isDynamic() ? 2 : 0));
+    for (unsigned int i=0; i < b->getLen(); i++) {
+      expr_save_uint (fp, b->getVal (i));
+    }
+    return 1;
+
+  case E_ENUM_CONST:
+    expr_save_string (fp, e->u.fn.s);
+    expr_save_string (fp, (char *)e->u.fn.r);
+    return 1;
+
+  case E_USERMACRO2:
+    expr_save_string (fp, e->u.fn.s);
+    return expr_save (fp, e->u.fn.r) ? 1 : -1;
+
+  case E_TYPE:
+  case E_ARRAY:
+  case E_SUBRANGE:
+  case E_PSTRUCT:
+  case E_PSTRUCT_FN:
+  case E_BITSLICE:
+    /* these only appear after expansion */
+    return -1;
+
+  default:
+    break;
+  }
+  return 0;
+}
+
+static int _load_expr_special (FILE *fp, Expr *e)
+{
+  const char *s;
+  BigInt *b;
+  unsigned int w, flags;
+
+  switch (e->type) {
+  case E_INT:
+    e->u.ival.v = expr_load_uint (fp);
+    e->u.ival.v_extra = NULL;
+    if (expr_load_uint (fp)) {
+      w = expr_load_uint (fp);
+      flags = expr_load_uint (fp);
+      b = new BigInt (w, flags & 1, (flags >> 1) & 1);
+      for (unsigned int i=0; i < b->getLen(); i++) {
+	b->setVal (i, expr_load_uint (fp));
+      }
+      e->u.ival.v_extra = b;
+    }
+    return 1;
+
+  case E_ENUM_CONST:
+    s = expr_load_string (fp);
+    e->u.fn.s = s ? Strdup (s) : NULL;
+    s = expr_load_string (fp);
+    e->u.fn.r = s ? (Expr *) string_cache (s) : NULL;
+    return 1;
+
+  case E_USERMACRO2:
+    s = expr_load_string (fp);
+    e->u.fn.s = s ? Strdup (s) : NULL;
+    e->u.fn.r = expr_load (fp);
+    return 1;
+
+  default:
+    break;
+  }
+  return 0;
+}
+
+
+/*-- cache files --*/
+
+static char *_cache_name (unsigned long key)
+{
+  char *s;
+  int len = strlen (Act::ast_cache) + 24;
+
+  MALLOC (s, char, len);
+  snprintf (s, len, "%s/%016lx.ast", Act::ast_cache, key);
+  return s;
+}
+
+/* create the cache directory (and any missing parents) */
+static int _cache_mkdir (void)
+{
+  struct stat st;
+  char *s, *t;
+
+  if (stat (Act::ast_cache, &st) == 0) {
+    return S_ISDIR (st.st_mode);
+  }
+  s = Strdup (Act::ast_cache);
+  for (t = s + 1; *t; t++) {
+    if (*t == '/') {
+      *t = '\0';
+      mkdir (s, 0777);
+      *t = '/';
+    }
+  }
+  mkdir (s, 0777);
+  FREE (s);
+  return (stat (Act::ast_cache, &st) == 0 && S_ISDIR (st.st_mode));
+}
+
+static act_Token *_cache_load (const char *name, unsigned long key,
+			       unsigned long srclen)
+{
+  struct ast_header h;
+  FILE *fp, *mfp;
+  char *buf;
+  act_Token *t;
+
+  fp = fopen (name, "r");
+  if (!fp) {
+    return NULL;
+  }
+  if (fread (&h, sizeof (h), 1, fp) != 1 ||
+      memcmp (h.magic, _ast_magic, sizeof (_ast_magic)) != 0 ||
+      h.sig != _signature() || h.key != key || h.srclen != srclen ||
+      h.len == 0) {
+    fclose (fp);
+    return NULL;
+  }
+  MALLOC (buf, char, h.len);
+  if (fread (buf, 1, h.len, fp) != h.len ||
+      _hash (0xcbf29ce484222325UL, buf, h.len) != h.sum) {
+    FREE (buf);
+    fclose (fp);
+    return NULL;
+  }
+  fclose (fp);
+
+  mfp = fmemopen (buf, h.len, "r");
+  if (!mfp) {
+    FREE (buf);
+    return NULL;
+  }
+  t = act_parse_load (mfp);
+  fclose (mfp);
+  FREE (buf);
+  return t;
+}
+
+/* returns 0 if the tree cannot be saved */
+static int _cache_save (const char *name, unsigned long key,
+			unsigned long srclen, act_Token *t)
+{
+  struct ast_header h;
+  FILE *mfp, *fp;
+  char *buf, *tmp;
+  size_t len;
+  int fd, ok;
+
+  buf = NULL;
+  len = 0;
+  mfp = open_memstream (&buf, &len);
+  if (!mfp) {
+    return 1;
+  }
+  ok = act_parse_save (mfp, t);
+  fclose (mfp);
+  if (!ok || len == 0 || !_cache_mkdir ()) {
+    free (buf);
+    return ok;
+  }
+
+  memcpy (h.magic, _ast_magic, sizeof (_ast_magic));
+  h.sig = _signature ();
+  h.key = key;
+  h.srclen = srclen;
+  h.len = len;
+  h.sum = _hash (0xcbf29ce484222325UL, buf, len);
+
+  /* write to a temporary and rename, so that readers (and other
+     threads or tools writing the same entry) never see a partial
+     file */
+  MALLOC (tmp, char, strlen (name) + 8);
+  sprintf (tmp, "%s.XXXXXX", name);
+  fd = mkstemp (tmp);
+  if (fd >= 0) {
+    fp = fdopen (fd, "w");
+    if (fp) {
+      if (fwrite (&h, sizeof (h), 1, fp) == 1 &&
+	  fwrite (buf, 1, len, fp) == len &&
+	  fclose (fp) == 0) {
+	chmod (tmp, 0644);
+	if (rename (tmp, name) != 0) {
+	  unlink (tmp);
+	}
+      }
+      else {
+	unlink (tmp);
+      }
+    }
+    else {
+      close (fd);
+      unlink (tmp);
+    }
+  }
+  FREE (tmp);
+  free (buf);
+  return 1;
+}
+
+static void _record_miss (const char *file, int uncached)
+{
+  char *s;
+
+  MALLOC (s, char, strlen (file) + 20);
+  sprintf (s, "%s: %s", uncached ? "skip" : "miss", file);
+  pthread_mutex_lock (&_miss_lock);
+  if (!_miss_list) {
+    _miss_list = list_new ();
+  }
+  list_append (_miss_list, s);
+  pthread_mutex_unlock (&_miss_lock);
+}
+
+act_Token *act_cached_parse (const char *file)
+{
+  FILE *fp;
+  char *src, *name;
+  unsigned long key, srclen;
+  long sz;
+  act_Token *t;
+
+  if (!Act::ast_cache) {
+    return act_parse (file);
+  }
+
+  /* hash the source; errors are left to the parser */
+  fp = fopen (file, "r");
+  if (!fp) {
+    return act_parse (file);
+  }
+  if (fseek (fp, 0, SEEK_END) != 0 || (sz = ftell (fp)) <= 0) {
+    fclose (fp);
+    return act_parse (file);
+  }
+  rewind (fp);
+  MALLOC (src, char, sz);
+  if (fread (src, 1, sz, fp) != (size_t)sz) {
+    FREE (src);
+    fclose (fp);
+    return act_parse (file);
+  }
+  fclose (fp);
+  srclen = sz;
+  key = _hash (0xcbf29ce484222325UL, src, srclen);
+  FREE (src);
+  key = _hash (key, file, strlen (file) + 1);
+
+  if (expr_save_special_default != _save_expr_special) {
+    expr_save_special_default = _save_expr_special;
+  }
+  if (expr_load_special_default != _load_expr_special) {
+    expr_load_special_default = _load_expr_special;
+  }
+
+  name = _cache_name (key);
+  t = _cache_load (name, key, srclen);
+  if (t) {
+    __sync_fetch_and_add (&_hits, 1);
+    FREE (name);
+    return t;
+  }
+
+  t = act_parse (file);
+  if (_cache_save (name, key, srclen, t)) {
+    __sync_fetch_and_add (&_misses, 1);
+    _record_miss (file, 0);
+  }
+  else {
+    __sync_fetch_and_add (&_uncached, 1);
+    _record_miss (file, 1);
+  }
+  FREE (name);
+  return t;
+}
+
+void act_parse_cache_report (void)
+{
+  listitem_t *li;
+
+  if (!Act::ast_cache) {
+    return;
+  }
+  if (!_cache_log) {
+    _cache_log = new Log ("actparse", 'P');
+  }
+  pthread_mutex_lock (&_miss_lock);
+  if (_miss_list) {
+    for (li = list_first (_miss_list); li; li = list_next (li)) {
+      (*_cache_log) << "parse cache " << (char *) list_value (li) << "\n";
+      FREE ((char *) list_value (li));
+    }
+    list_free (_miss_list);
+    _miss_list = NULL;
+  }
+  (*_cache_log) << "parse cache: " << _hits << " hit(s), " << _misses
+		<< " miss(es), " << _uncached << " skipped\n";
+  _hits = 0;
+  _misses = 0;
+  _uncached = 0;
+  pthread_mutex_unlock (&_miss_lock);
+}
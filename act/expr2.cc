@@ -1534,13 +1534,13 @@ static Expr *_expr_expand (int *width, Expr *e,
 	    *l -= *r;
 	  }
 	  else if (e->type == E_MULT) {
-	    *l = (*l) * (*r);
+	    *l *= (*r);
 	  }
 	  else if (e->type == E_DIV) {
-	    *l = (*l) / (*r);
+	    *l /= (*r);
 	  }
 	  else if (e->type == E_MOD) {
-	    *l = (*l) % (*r);
+	    *l %= (*r);
 	  }
 	  else if (e->type == E_LSL) {
 	    *l <<= (*r);
@@ -1564,6 +1564,15 @@ static Expr *_expr_expand (int *width, Expr *e,
 	else {
 	  signed long v;
 
+	  if ((e->type == E_DIV || e->type == E_MOD) &&
+	      ret->u.e.r->u.ival.v == 0) {
+	    act_error_ctxt (stderr);
+	    fprintf (stderr, "\texpanding expr: ");
+	    print_expr (stderr, e);
+	    fprintf (stderr, "\n");
+	    fatal_error ("Division by zero");
+	  }
+
 	  v = ret->u.e.l->u.ival.v;
 	  if (e->type == E_PLUS) {
 	    v = v + ((signed long)ret->u.e.r->u.ival.v);
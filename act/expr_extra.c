@@ -28,17 +28,17 @@
 
 void *act_parse_a_fexpr (LFILE *);
 
-static int tokand, tokor, lpar, rpar, ddot, colon;
-static int tokxor, tokplus, tokmult;
-static int double_colon, comma;
-static int inttok, booltok;
-static int langle, rangle;
-static int dot, lbrack;
-static int probe;
+static __thread int tokand, tokor, lpar, rpar, ddot, colon;
+static __thread int tokxor, tokplus, tokmult;
+static __thread int double_colon, comma;
+static __thread int inttok, booltok;
+static __thread int langle, rangle;
+static __thread int dot, lbrack;
+static __thread int probe;
 
 static void do_init (LFILE *l)
 {
-  static int init = 0;
+  static __thread int init = 0;
   if (!init) {
     probe = expr_gettoken (E_PROBE);
     tokand = expr_gettoken (E_AND);
@@ -31,6 +31,10 @@ static struct ExtLibs *_ext_lang = NULL;
 
 extern "C" void act_init_extern_lang (LFILE *l)
 {
+  if (act_import_worker ()) {
+    // the library table is owned by the main thread
+    return;
+  }
   // look for libraries in support of external languages
   _ext_lang = act_read_extern_table ("act.extern_lang");
 }
@@ -38,6 +42,12 @@ extern "C" void act_init_extern_lang (LFILE *l)
 extern "C" int act_is_a_extern_lang (LFILE *l)
 {
   list_t *t = act_parse_id_stack ();
+
+  if (act_import_worker ()) {
+    // external language parsers are not thread-safe; abandon the
+    // prefetch so that the file is parsed by the main thread
+    THROW (EXC_NULL_EXCEPTION);
+  }
   
   if (!_ext_lang || list_length (t) == 0) {
     if (list_length (t) > 0) {
@@ -162,6 +172,19 @@ extern "C" void act_free_a_extern_lang (void *v)
 }
 
 
+/* external language bodies are opaque, so files that contain them
+   are not saved in the parse cache */
+extern "C" int act_save_a_extern_lang (FILE *fp, void *v)
+{
+  return 0;
+}
+
+extern "C" void *act_load_a_extern_lang (FILE *fp)
+{
+  return NULL;
+}
+
+
 void lang_extern_print (FILE *fp, const char *nm, void *v)
 {
   char buf[1024];
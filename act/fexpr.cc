@@ -30,8 +30,8 @@
 #include "act_parse_int.h"
 #include "act_walk.extra.h"
 
-static int T[E_NUMBER];
-static int _prec_table[E_NUMBER];
+static __thread int T[E_NUMBER];
+static __thread int _prec_table[E_NUMBER];
 
 Expr *(*expr_parse_basecase_extra)(LFILE *l) = NULL;
 
@@ -40,7 +40,7 @@ Expr *(*expr_parse_basecase_extra)(LFILE *l) = NULL;
 #define SET(x)  file_set_position(x)
 #define INFO(x)
 
-static LFILE *Tl;
+static __thread LFILE *Tl;
 
 static void fexpr_settoken (int x, int v);
 
@@ -1017,6 +1017,16 @@ void act_free_a_fexpr (void *v)
   expr_free ((Expr *)v);
 }
 
+int act_save_a_fexpr (FILE *fp, void *v)
+{
+  return expr_save (fp, (Expr *)v);
+}
+
+void *act_load_a_fexpr (FILE *fp)
+{
+  return expr_load (fp);
+}
+
 void *act_walk_X_fexpr (ActTree *t, void *v)
 {
   bool tmp;
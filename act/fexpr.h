@@ -52,6 +52,18 @@ void *act_parse_a_fexpr (LFILE *);
   */
 void *act_walk_X_fexpr (ActTree *, void *);
 
+  /**
+     External parser for fast expression parsing: write out the parsed
+     expression for the parse cache; returns 0 if it cannot be saved
+  */
+int act_save_a_fexpr (FILE *, void *);
+
+  /**
+     External parser for fast expression parsing: read back an
+     expression written by act_save_a_fexpr()
+  */
+void *act_load_a_fexpr (FILE *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,7 @@
 #include <act/iter.h>
 #include <act/inline.h>
 #include <string.h>
+#include <limits.h>
 #include <common/misc.h>
 #include <common/hash.h>
 
@@ -564,10 +565,883 @@ static void _run_chp (Scope *s, act_chp_lang_t *c)
   }
 }
 
+
+/*------------------------------------------------------------------------
+ *
+ *  Register bytecode for parameter function bodies
+ *
+ *  The chp body is compiled once into a flat instruction list over a
+ *  register file. Scalar pint/pbool variables in the function scope
+ *  (parameters, self, locals) and syntactic loop variables live in
+ *  registers; they are loaded from the scope before the body is run,
+ *  and assigned variables are written back afterwards.
+ *
+ *  Anything the compiler does not handle (arrays, pstructs, preals,
+ *  function calls, integer constants wider than 64 bits) leaves the
+ *  function with _run_chp(). The same is true at run-time: on any
+ *  error (uninitialized value, all guards false, division by zero,
+ *  loop limit) the interpreter gives up without having modified the
+ *  scope, and the tree walker re-runs the body to report the error.
+ *  Setting act.func_bytecode to 0 always uses the tree walker.
+ *
+ *------------------------------------------------------------------------
+ */
+enum fbc_op {
+  FBC_HALT,
+  FBC_CHK,			/* fail if R[a] is not set */
+  FBC_MOV,			/* R[a] = R[b] */
+  FBC_ADD, FBC_SUB, FBC_MUL, FBC_DIV, FBC_MOD,
+  FBC_LSL, FBC_LSR, FBC_ASR,
+  FBC_AND, FBC_OR, FBC_XOR,
+  FBC_LT, FBC_GT, FBC_LE, FBC_GE, FBC_EQ, FBC_NE,
+  FBC_NOT,			/* R[a] = !R[b] */
+  FBC_COMPL,			/* R[a] = ~R[b] */
+  FBC_NEG,			/* R[a] = -R[b] */
+  FBC_JMP,			/* goto c */
+  FBC_JZ,			/* if (!R[b]) goto c */
+  FBC_JNZ,			/* if (R[b]) goto c */
+  FBC_LOOPINIT,			/* R[a],R[a+1] = loop range from R[b],R[c] */
+  FBC_JGT,			/* if (R[a] > R[b]) goto c */
+  FBC_INC,			/* R[a]++ */
+  FBC_LIMIT,			/* fail if R[a] exceeds the loop limit */
+  FBC_FAIL			/* give up */
+};
+
+struct fbc_insn {
+  int op;
+  int a, b, c;
+};
+
+struct fbc_var {
+  const char *name;		/* variable name */
+  int reg;			/* register holding the value */
+  unsigned int isbool:1;	/* pbool v/s pint */
+  unsigned int written:1;	/* assigned in the body */
+};
+
+struct act_func_bc {
+  A_DECL (fbc_insn, code);
+  A_DECL (fbc_var, vars);	/* scope variables */
+  A_DECL (long, rinit);		/* initial register values */
+  A_DECL (unsigned char, rbool); /* 1 if the register holds a pbool */
+  A_DECL (int, consts);		/* constant registers */
+
+  long *R;			/* register file */
+  unsigned char *S;		/* set flags */
+  ValueIdx **vx;		/* scope storage for vars */
+};
+
+struct fbc_ctxt {
+  act_func_bc *bc;
+  Scope *s;
+  A_DECL (fbc_var, loopvars);	/* syntactic loop variables in scope */
+  int fail;
+};
+
+static void _fbc_free (act_func_bc *bc)
+{
+  A_FREE (bc->code);
+  A_FREE (bc->vars);
+  A_FREE (bc->rinit);
+  A_FREE (bc->rbool);
+  A_FREE (bc->consts);
+  if (bc->R) {
+    FREE (bc->R);
+    FREE (bc->S);
+  }
+  if (bc->vx) {
+    FREE (bc->vx);
+  }
+  FREE (bc);
+}
+
+static int _fbc_emit (fbc_ctxt *x, int op, int a, int b = -1, int c = -1)
+{
+  act_func_bc *bc = x->bc;
+  A_NEW (bc->code, fbc_insn);
+  A_NEXT (bc->code).op = op;
+  A_NEXT (bc->code).a = a;
+  A_NEXT (bc->code).b = b;
+  A_NEXT (bc->code).c = c;
+  A_INC (bc->code);
+  return A_LEN (bc->code) - 1;
+}
+
+/* jump at pc goes to the next instruction to be emitted */
+static void _fbc_patch (fbc_ctxt *x, int pc)
+{
+  x->bc->code[pc].c = A_LEN (x->bc->code);
+}
+
+static int _fbc_newreg (fbc_ctxt *x, int isbool, long v = 0)
+{
+  act_func_bc *bc = x->bc;
+  A_NEW (bc->rinit, long);
+  A_NEXT (bc->rinit) = v;
+  A_INC (bc->rinit);
+  A_NEW (bc->rbool, unsigned char);
+  A_NEXT (bc->rbool) = isbool;
+  A_INC (bc->rbool);
+  return A_LEN (bc->rinit) - 1;
+}
+
+static int _fbc_const (fbc_ctxt *x, long v, int isbool)
+{
+  act_func_bc *bc = x->bc;
+  int r;
+  
+  for (int i=0; i < A_LEN (bc->consts); i++) {
+    r = bc->consts[i];
+    if (bc->rinit[r] == v && bc->rbool[r] == isbool) {
+      return r;
+    }
+  }
+  r = _fbc_newreg (x, isbool, v);
+  A_NEW (bc->consts, int);
+  A_NEXT (bc->consts) = r;
+  A_INC (bc->consts);
+  return r;
+}
+
+/*
+ * Map a variable name to a register. Returns -1 if it is not a scalar
+ * pint/pbool in the function scope. *isloop is set for syntactic
+ * loop variables.
+ */
+static int _fbc_name (fbc_ctxt *x, const char *nm, int *isloop)
+{
+  act_func_bc *bc = x->bc;
+  ValueIdx *vx;
+  int isbool;
+
+  *isloop = 0;
+  for (int i=A_LEN (x->loopvars)-1; i >= 0; i--) {
+    if (strcmp (x->loopvars[i].name, nm) == 0) {
+      *isloop = 1;
+      return x->loopvars[i].reg;
+    }
+  }
+  for (int i=0; i < A_LEN (bc->vars); i++) {
+    if (strcmp (bc->vars[i].name, nm) == 0) {
+      return bc->vars[i].reg;
+    }
+  }
+  vx = x->s->LookupVal (nm);
+  if (!vx || vx->t->arrayInfo()) {
+    return -1;
+  }
+  if (TypeFactory::isPIntType (vx->t)) {
+    isbool = 0;
+  }
+  else if (TypeFactory::isPBoolType (vx->t)) {
+    isbool = 1;
+  }
+  else {
+    return -1;
+  }
+  A_NEW (bc->vars, fbc_var);
+  A_NEXT (bc->vars).name = nm;
+  A_NEXT (bc->vars).isbool = isbool;
+  A_NEXT (bc->vars).written = 0;
+  A_NEXT (bc->vars).reg = _fbc_newreg (x, isbool);
+  A_INC (bc->vars);
+  return bc->vars[A_LEN (bc->vars)-1].reg;
+}
+
+/* same, for an identifier */
+static int _fbc_var (fbc_ctxt *x, ActId *id, int *isloop)
+{
+  *isloop = 0;
+  if (id->Rest() || id->arrayInfo() || id->isNamespace()) {
+    return -1;
+  }
+  return _fbc_name (x, id->getName(), isloop);
+}
+
+static void _fbc_loopvar_push (fbc_ctxt *x, const char *nm, int reg)
+{
+  A_NEW (x->loopvars, fbc_var);
+  A_NEXT (x->loopvars).name = nm;
+  A_NEXT (x->loopvars).reg = reg;
+  A_NEXT (x->loopvars).isbool = 0;
+  A_NEXT (x->loopvars).written = 0;
+  A_INC (x->loopvars);
+}
+
+static void _fbc_loopvar_pop (fbc_ctxt *x)
+{
+  A_LEN_RAW (x->loopvars)--;
+}
+
+/*
+ * Compile an expression, leaving the result in register dst (a new
+ * register if dst is -1). Returns the result register, or -1 if the
+ * expression cannot be compiled.
+ */
+static int _fbc_expr (fbc_ctxt *x, Expr *e, int dst = -1)
+{
+  int l, r, isbool, isloop;
+  int op;
+
+  if (x->fail || !e) {
+    x->fail = 1;
+    return -1;
+  }
+
+#define FBC_FAIL_IF(cond)			\
+  do {						\
+    if (cond) {					\
+      x->fail = 1;				\
+      return -1;				\
+    }						\
+  } while (0)
+
+#define FBC_DST(isb)				\
+  do {						\
+    if (dst == -1) {				\
+      dst = _fbc_newreg (x, (isb));		\
+    }						\
+    FBC_FAIL_IF (x->bc->rbool[dst] != (isb));	\
+  } while (0)
+
+  switch (e->type) {
+  case E_INT:
+    FBC_FAIL_IF (e->u.ival.v_extra);
+    r = _fbc_const (x, e->u.ival.v, 0);
+    if (dst != -1) {
+      FBC_FAIL_IF (x->bc->rbool[dst]);
+      _fbc_emit (x, FBC_MOV, dst, r);
+      return dst;
+    }
+    return r;
+    break;
+
+  case E_TRUE:
+  case E_FALSE:
+    r = _fbc_const (x, e->type == E_TRUE ? 1 : 0, 1);
+    if (dst != -1) {
+      FBC_FAIL_IF (!x->bc->rbool[dst]);
+      _fbc_emit (x, FBC_MOV, dst, r);
+      return dst;
+    }
+    return r;
+    break;
+
+  case E_VAR:
+  case E_SELF:
+    if (e->type == E_SELF) {
+      r = _fbc_name (x, "self", &isloop);
+    }
+    else {
+      r = _fbc_var (x, (ActId *)e->u.e.l, &isloop);
+    }
+    FBC_FAIL_IF (r == -1);
+    if (!isloop) {
+      _fbc_emit (x, FBC_CHK, r);
+    }
+    if (dst != -1) {
+      FBC_FAIL_IF (x->bc->rbool[dst] != x->bc->rbool[r]);
+      _fbc_emit (x, FBC_MOV, dst, r);
+      return dst;
+    }
+    return r;
+    break;
+
+  case E_PLUS: op = FBC_ADD; goto arith;
+  case E_MINUS: op = FBC_SUB; goto arith;
+  case E_MULT: op = FBC_MUL; goto arith;
+  case E_DIV: op = FBC_DIV; goto arith;
+  case E_MOD: op = FBC_MOD; goto arith;
+  case E_LSL: op = FBC_LSL; goto arith;
+  case E_LSR: op = FBC_LSR; goto arith;
+  case E_ASR: op = FBC_ASR; goto arith;
+  arith:
+    l = _fbc_expr (x, e->u.e.l);
+    r = _fbc_expr (x, e->u.e.r);
+    FBC_FAIL_IF (l == -1 || r == -1);
+    FBC_FAIL_IF (x->bc->rbool[l] || x->bc->rbool[r]);
+    FBC_DST (0);
+    _fbc_emit (x, op, dst, l, r);
+    return dst;
+    break;
+
+  case E_AND: op = FBC_AND; goto logic;
+  case E_OR: op = FBC_OR; goto logic;
+  case E_XOR: op = FBC_XOR; goto logic;
+  logic:
+    /* bools are 0/1, so bitwise operators work for both types */
+    l = _fbc_expr (x, e->u.e.l);
+    r = _fbc_expr (x, e->u.e.r);
+    FBC_FAIL_IF (l == -1 || r == -1);
+    isbool = x->bc->rbool[l];
+    FBC_FAIL_IF (x->bc->rbool[r] != isbool);
+    FBC_DST (isbool);
+    _fbc_emit (x, op, dst, l, r);
+    return dst;
+    break;
+
+  case E_LT: op = FBC_LT; goto cmp;
+  case E_GT: op = FBC_GT; goto cmp;
+  case E_LE: op = FBC_LE; goto cmp;
+  case E_GE: op = FBC_GE; goto cmp;
+  case E_EQ: op = FBC_EQ; goto cmp;
+  case E_NE: op = FBC_NE; goto cmp;
+  cmp:
+    l = _fbc_expr (x, e->u.e.l);
+    r = _fbc_expr (x, e->u.e.r);
+    FBC_FAIL_IF (l == -1 || r == -1);
+    FBC_FAIL_IF (x->bc->rbool[l] != x->bc->rbool[r]);
+    FBC_FAIL_IF (x->bc->rbool[l] && op != FBC_EQ && op != FBC_NE);
+    FBC_DST (1);
+    _fbc_emit (x, op, dst, l, r);
+    return dst;
+    break;
+
+  case E_NOT:
+  case E_COMPLEMENT:
+  case E_UMINUS:
+    l = _fbc_expr (x, e->u.e.l);
+    FBC_FAIL_IF (l == -1);
+    isbool = x->bc->rbool[l];
+    if (e->type == E_NOT) {
+      FBC_FAIL_IF (!isbool);
+      op = FBC_NOT;
+    }
+    else if (e->type == E_COMPLEMENT) {
+      op = isbool ? FBC_NOT : FBC_COMPL;
+    }
+    else {
+      FBC_FAIL_IF (isbool);
+      op = FBC_NEG;
+    }
+    FBC_DST (isbool);
+    _fbc_emit (x, op, dst, l);
+    return dst;
+    break;
+
+  case E_QUERY:
+    {
+      int jf, jend;
+      /* both branches are evaluated, like expr_expand() */
+      l = _fbc_expr (x, e->u.e.l);
+      FBC_FAIL_IF (l == -1 || !x->bc->rbool[l]);
+      FBC_FAIL_IF (!e->u.e.r || e->u.e.r->type != E_COLON);
+      r = _fbc_expr (x, e->u.e.r->u.e.l);
+      int r2 = _fbc_expr (x, e->u.e.r->u.e.r);
+      FBC_FAIL_IF (r == -1 || r2 == -1);
+      isbool = x->bc->rbool[r];
+      FBC_FAIL_IF (x->bc->rbool[r2] != isbool);
+      FBC_DST (isbool);
+      jf = _fbc_emit (x, FBC_JZ, -1, l);
+      _fbc_emit (x, FBC_MOV, dst, r);
+      jend = _fbc_emit (x, FBC_JMP, -1);
+      _fbc_patch (x, jf);
+      _fbc_emit (x, FBC_MOV, dst, r2);
+      _fbc_patch (x, jend);
+      return dst;
+    }
+    break;
+
+  default:
+    break;
+  }
+  x->fail = 1;
+  return -1;
+
+#undef FBC_DST
+#undef FBC_FAIL_IF
+}
+
+/*
+ * Compile a guarded command list. Each guard that is true runs its
+ * command and then jumps to a location recorded in jl, to be patched
+ * by the caller. If all guards are false, control falls through.
+ */
+static void _fbc_stmt (fbc_ctxt *x, act_chp_lang_t *c);
+
+static void _fbc_gc (fbc_ctxt *x, act_chp_gc_t *gc, list_t *jl)
+{
+  int g, jz;
+  
+  for (; gc && !x->fail; gc = gc->next) {
+    if (!gc->g) {
+      /* else clause */
+      _fbc_stmt (x, gc->s);
+      list_iappend (jl, _fbc_emit (x, FBC_JMP, -1));
+    }
+    else if (gc->id) {
+      int lo, hi, v, top;
+      lo = _fbc_expr (x, gc->lo);
+      hi = gc->hi ? _fbc_expr (x, gc->hi) : -1;
+      if (x->fail) return;
+      v = _fbc_newreg (x, 0);
+      _fbc_newreg (x, 0);
+      _fbc_emit (x, FBC_LOOPINIT, v, lo, hi);
+      top = _fbc_emit (x, FBC_JGT, v, v+1);
+      _fbc_loopvar_push (x, gc->id, v);
+      g = _fbc_expr (x, gc->g);
+      if (g == -1 || !x->bc->rbool[g]) {
+	x->fail = 1;
+	return;
+      }
+      jz = _fbc_emit (x, FBC_JZ, -1, g);
+      _fbc_stmt (x, gc->s);
+      _fbc_loopvar_pop (x);
+      list_iappend (jl, _fbc_emit (x, FBC_JMP, -1));
+      _fbc_patch (x, jz);
+      _fbc_emit (x, FBC_INC, v);
+      _fbc_emit (x, FBC_JMP, -1, -1, top);
+      _fbc_patch (x, top);
+    }
+    else {
+      g = _fbc_expr (x, gc->g);
+      if (g == -1 || !x->bc->rbool[g]) {
+	x->fail = 1;
+	return;
+      }
+      jz = _fbc_emit (x, FBC_JZ, -1, g);
+      _fbc_stmt (x, gc->s);
+      list_iappend (jl, _fbc_emit (x, FBC_JMP, -1));
+      _fbc_patch (x, jz);
+    }
+  }
+}
+
+static void _fbc_patch_list (fbc_ctxt *x, list_t *jl)
+{
+  for (listitem_t *li = list_first (jl); li; li = list_next (li)) {
+    _fbc_patch (x, list_ivalue (li));
+  }
+  list_free (jl);
+}
+
+static void _fbc_stmt (fbc_ctxt *x, act_chp_lang_t *c)
+{
+  list_t *jl;
+  int r, isloop;
+  
+  if (!c || x->fail) return;
+  
+  switch (c->type) {
+  case ACT_CHP_COMMA:
+  case ACT_CHP_SEMI:
+    for (listitem_t *li = list_first (c->u.semi_comma.cmd);
+	 li; li = list_next (li)) {
+      _fbc_stmt (x, (act_chp_lang_t *) list_value (li));
+    }
+    break;
+
+  case ACT_CHP_COMMALOOP:
+  case ACT_CHP_SEMILOOP:
+    {
+      int lo, hi, v, top;
+      lo = _fbc_expr (x, c->u.loop.lo);
+      hi = c->u.loop.hi ? _fbc_expr (x, c->u.loop.hi) : -1;
+      if (x->fail) return;
+      v = _fbc_newreg (x, 0);
+      _fbc_newreg (x, 0);
+      _fbc_emit (x, FBC_LOOPINIT, v, lo, hi);
+      top = _fbc_emit (x, FBC_JGT, v, v+1);
+      _fbc_loopvar_push (x, c->u.loop.id, v);
+      _fbc_stmt (x, c->u.loop.body);
+      _fbc_loopvar_pop (x);
+      _fbc_emit (x, FBC_INC, v);
+      _fbc_emit (x, FBC_JMP, -1, -1, top);
+      _fbc_patch (x, top);
+    }
+    break;
+
+  case ACT_CHP_SELECT:
+  case ACT_CHP_SELECT_NONDET:
+    jl = list_new ();
+    _fbc_gc (x, c->u.gc, jl);
+    /* all guards false */
+    _fbc_emit (x, FBC_FAIL, -1);
+    _fbc_patch_list (x, jl);
+    break;
+
+  case ACT_CHP_LOOP:
+    {
+      int cnt, top, jend;
+      cnt = _fbc_newreg (x, 0);
+      _fbc_emit (x, FBC_MOV, cnt, _fbc_const (x, 0, 0));
+      top = _fbc_emit (x, FBC_INC, cnt);
+      jl = list_new ();
+      _fbc_gc (x, c->u.gc, jl);
+      /* all guards false */
+      jend = _fbc_emit (x, FBC_JMP, -1);
+      _fbc_patch_list (x, jl);
+      _fbc_emit (x, FBC_LIMIT, cnt);
+      _fbc_emit (x, FBC_JMP, -1, -1, top);
+      _fbc_patch (x, jend);
+    }
+    break;
+
+  case ACT_CHP_DOLOOP:
+    {
+      int top = A_LEN (x->bc->code);
+      Assert (c->u.gc->next == NULL, "What?");
+      _fbc_stmt (x, c->u.gc->s);
+      if (!c->u.gc->g) {
+	x->fail = 1;
+	return;
+      }
+      r = _fbc_expr (x, c->u.gc->g);
+      if (r == -1 || !x->bc->rbool[r]) {
+	x->fail = 1;
+	return;
+      }
+      _fbc_emit (x, FBC_JNZ, -1, r, top);
+    }
+    break;
+
+  case ACT_CHP_SKIP:
+  case ACT_CHP_FUNC:
+    break;
+
+  case ACT_CHP_ASSIGN:
+    r = _fbc_var (x, c->u.assign.id, &isloop);
+    if (r == -1 || isloop) {
+      x->fail = 1;
+      return;
+    }
+    for (int i=0; i < A_LEN (x->bc->vars); i++) {
+      if (x->bc->vars[i].reg == r) {
+	x->bc->vars[i].written = 1;
+	break;
+      }
+    }
+    _fbc_expr (x, c->u.assign.e, r);
+    break;
+
+  default:
+    x->fail = 1;
+    break;
+  }
+}
+
+/*
+ * Compile the chp body. Returns NULL if the body has to be run by the
+ * tree walker.
+ */
+static act_func_bc *_fbc_compile (Scope *s, act_chp_lang_t *c)
+{
+  fbc_ctxt x;
+  act_func_bc *bc;
+
+  NEW (bc, act_func_bc);
+  A_INIT (bc->code);
+  A_INIT (bc->vars);
+  A_INIT (bc->rinit);
+  A_INIT (bc->rbool);
+  A_INIT (bc->consts);
+  bc->R = NULL;
+  bc->S = NULL;
+  bc->vx = NULL;
+
+  x.bc = bc;
+  x.s = s;
+  x.fail = 0;
+  A_INIT (x.loopvars);
+
+  _fbc_stmt (&x, c);
+  _fbc_emit (&x, FBC_HALT, -1);
+  A_FREE (x.loopvars);
+
+  if (x.fail) {
+    _fbc_free (bc);
+    return NULL;
+  }
+
+  MALLOC (bc->R, long, A_LEN (bc->rinit));
+  MALLOC (bc->S, unsigned char, A_LEN (bc->rinit));
+  if (A_LEN (bc->vars) > 0) {
+    MALLOC (bc->vx, ValueIdx *, A_LEN (bc->vars));
+  }
+  return bc;
+}
+
+/*
+ * Run the compiled body in scope s. Returns 1 on success, 0 if the
+ * tree walker has to be used instead; in that case the scope has not
+ * been modified.
+ */
+static int _fbc_run (act_func_bc *bc, Scope *s)
+{
+  long *R = bc->R;
+  unsigned char *S = bc->S;
+  fbc_insn *code = bc->code;
+  int pc;
+
+  /*-- load variables --*/
+  memcpy (R, bc->rinit, sizeof (long)*A_LEN (bc->rinit));
+  memset (S, 1, A_LEN (bc->rinit));
+  for (int i=0; i < A_LEN (bc->vars); i++) {
+    fbc_var *v = &bc->vars[i];
+    ValueIdx *vx = s->LookupVal (v->name);
+    if (!vx || vx->t->arrayInfo()) {
+      return 0;
+    }
+    if (v->isbool) {
+      if (!TypeFactory::isPBoolType (vx->t)) {
+	return 0;
+      }
+      S[v->reg] = vx->init && s->issetPBool (vx->u.idx);
+      if (S[v->reg]) {
+	R[v->reg] = s->getPBool (vx->u.idx) ? 1 : 0;
+      }
+    }
+    else {
+      if (!TypeFactory::isPIntType (vx->t)) {
+	return 0;
+      }
+      S[v->reg] = vx->init && s->issetPInt (vx->u.idx);
+      if (S[v->reg]) {
+	R[v->reg] = s->getPInt (vx->u.idx);
+      }
+    }
+    bc->vx[i] = vx;
+  }
+
+  /*-- run --*/
+  pc = 0;
+  while (1) {
+    fbc_insn *i = &code[pc++];
+    switch (i->op) {
+    case FBC_HALT:
+      goto done;
+
+    case FBC_CHK:
+      if (!S[i->a]) return 0;
+      break;
+
+    case FBC_MOV:
+      R[i->a] = R[i->b];
+      S[i->a] = 1;
+      break;
+
+#define FBC_BINOP(opc,expr)				\
+    case opc:						\
+      R[i->a] = (expr);					\
+      S[i->a] = 1;					\
+      break
+      
+    FBC_BINOP (FBC_ADD, R[i->b] + R[i->c]);
+    FBC_BINOP (FBC_SUB, R[i->b] - R[i->c]);
+    FBC_BINOP (FBC_MUL, R[i->b] * R[i->c]);
+    FBC_BINOP (FBC_LSL, R[i->b] << ((unsigned long)R[i->c]));
+    FBC_BINOP (FBC_LSR,
+	       ((unsigned long)R[i->b]) >> ((unsigned long)R[i->c]));
+    FBC_BINOP (FBC_ASR, R[i->b] >> ((unsigned long)R[i->c]));
+    FBC_BINOP (FBC_AND, R[i->b] & R[i->c]);
+    FBC_BINOP (FBC_OR, R[i->b] | R[i->c]);
+    FBC_BINOP (FBC_XOR, R[i->b] ^ R[i->c]);
+    FBC_BINOP (FBC_LT, R[i->b] < R[i->c]);
+    FBC_BINOP (FBC_GT, R[i->b] > R[i->c]);
+    FBC_BINOP (FBC_LE, R[i->b] <= R[i->c]);
+    FBC_BINOP (FBC_GE, R[i->b] >= R[i->c]);
+    FBC_BINOP (FBC_EQ, R[i->b] == R[i->c]);
+    FBC_BINOP (FBC_NE, R[i->b] != R[i->c]);
+    FBC_BINOP (FBC_NOT, !R[i->b]);
+    FBC_BINOP (FBC_COMPL, ~R[i->b]);
+    FBC_BINOP (FBC_NEG, -R[i->b]);
+#undef FBC_BINOP
+
+    case FBC_DIV:
+    case FBC_MOD:
+      if (R[i->c] == 0 || (R[i->c] == -1 && R[i->b] == LONG_MIN)) {
+	return 0;
+      }
+      R[i->a] = (i->op == FBC_DIV) ? R[i->b] / R[i->c] : R[i->b] % R[i->c];
+      S[i->a] = 1;
+      break;
+
+    case FBC_JMP:
+      pc = i->c;
+      break;
+
+    case FBC_JZ:
+      if (!R[i->b]) pc = i->c;
+      break;
+
+    case FBC_JNZ:
+      if (R[i->b]) pc = i->c;
+      break;
+
+    case FBC_LOOPINIT:
+      {
+	/* same as act_syn_loop_setup() */
+	int ilo, ihi;
+	ilo = R[i->b];
+	if (i->c != -1) {
+	  ihi = R[i->c];
+	}
+	else {
+	  ihi = ilo - 1;
+	  ilo = 0;
+	}
+	R[i->a] = ilo;
+	R[i->a+1] = ihi;
+      }
+      break;
+
+    case FBC_JGT:
+      if (R[i->a] > R[i->b]) pc = i->c;
+      break;
+
+    case FBC_INC:
+      R[i->a]++;
+      break;
+
+    case FBC_LIMIT:
+      if (R[i->a] > Act::max_loop_iterations) return 0;
+      break;
+
+    case FBC_FAIL:
+    default:
+      return 0;
+    }
+  }
+
+ done:
+  /*-- write back assigned variables --*/
+  for (int i=0; i < A_LEN (bc->vars); i++) {
+    fbc_var *v = &bc->vars[i];
+    ValueIdx *vx = bc->vx[i];
+    if (!v->written || !S[v->reg]) continue;
+    if (v->isbool) {
+      if (!vx->init) {
+	vx->init = 1;
+	vx->u.idx = s->AllocPBool ();
+      }
+      s->setPBool (vx->u.idx, R[v->reg]);
+    }
+    else {
+      if (!vx->init) {
+	vx->init = 1;
+	vx->u.idx = s->AllocPInt ();
+      }
+      s->setPInt (vx->u.idx, R[v->reg]);
+    }
+  }
+  return 1;
+}
+
+
 typedef long (*EXT_ACT_FUNC)(int nargs, long *args);
 
 static struct ExtLibs *_act_ext_libs = NULL;
 
+
+/*------------------------------------------------------------------------
+ *
+ *  Memoization of parameter function evaluation. Only scalar
+ *  arguments and results are memoized: array and structure values
+ *  refer to the function scope, which is flushed on every call.
+ *
+ *  A function's body cannot change once it has been defined, and the
+ *  caller's namespace is part of the key, so entries never go stale.
+ *  The table is dropped when it reaches ACT_FUNC_MEMO_MAX entries
+ *  so that sweeping a function over many distinct arguments does not
+ *  grow it without bound.
+ *
+ *------------------------------------------------------------------------
+ */
+#define ACT_FUNC_MEMO_MAX 4096
+
+void Function::_memo_init ()
+{
+  _memo = NULL;
+  _memo_ns = NULL;
+  _memo_pt = NULL;
+  _memo_hits = 0;
+  _memo_misses = 0;
+}
+
+void Function::_memo_drop ()
+{
+  if (_memo) {
+    hash_bucket_t *b;
+    hash_iter_t it;
+    hash_iter_init (_memo, &it);
+    while ((b = hash_iter_next (_memo, &it))) {
+      Expr *e = (Expr *) b->v;
+      if (e->type == E_REAL) {
+	/* the only result that is not shared */
+	FREE (e);
+      }
+    }
+    hash_free (_memo);
+    _memo = NULL;
+  }
+}
+
+void Function::_memo_clear ()
+{
+  _memo_drop ();
+  if (_memo_pt) {
+    FREE (_memo_pt);
+    _memo_pt = NULL;
+  }
+  _memo_ns = NULL;
+}
+
+void Function::_bc_clear ()
+{
+  if (_bc) {
+    _fbc_free (_bc);
+    _bc = NULL;
+  }
+  _bc_tried = 0;
+}
+
+/*
+ * Build the memo key for the argument tuple. Returns 0 if the call
+ * cannot be memoized.
+ */
+int Function::_memo_key (ActNamespace *ns, int nargs, Expr **args,
+			 char *buf, int sz)
+{
+  int k;
+
+  if (getRetType()->arrayInfo() ||
+      TypeFactory::isPStructType (getRetType())) {
+    return 0;
+  }
+
+  /* the body is expanded in the caller's namespace */
+  snprintf (buf, sz, "%p", (void *)ns);
+  k = strlen (buf);
+  
+  for (int i=0; i < nargs; i++) {
+    switch (args[i]->type) {
+    case E_TRUE:
+      snprintf (buf + k, sz - k, ",t");
+      break;
+    case E_FALSE:
+      snprintf (buf + k, sz - k, ",f");
+      break;
+    case E_INT:
+      if (args[i]->u.ival.v_extra) {
+	return 0;
+      }
+      snprintf (buf + k, sz - k, ",i%ld", args[i]->u.ival.v);
+      break;
+    case E_REAL:
+      snprintf (buf + k, sz - k, ",r%a", args[i]->u.f);
+      break;
+    default:
+      return 0;
+    }
+    k += strlen (buf + k);
+    if (k >= sz - 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
 Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
 {
   Assert (nargs == getNumParams(), "What?");
@@ -577,6 +1451,24 @@ Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
 	    expr_is_a_const (args[i]), "Argument is not a constant?");
   }
 
+  /*-- check if we have seen these arguments before --*/
+  char memo_buf[1024];
+  int memo_ok;
+
+  memo_ok = _memo_key (ns, nargs, args, memo_buf, 1024);
+  if (memo_ok && _memo) {
+    hash_bucket_t *mb = hash_lookup (_memo, memo_buf);
+    if (mb) {
+      Expr *e = (Expr *) mb->v;
+      _memo_hits++;
+      if (e->type == E_REAL) {
+	return const_expr_real (e->u.f);
+      }
+      return e;
+    }
+  }
+  _memo_misses++;
+
   /* 
      now we allocate all the parameters within the function scope
      and bind them to the specified values.
@@ -591,8 +1483,6 @@ Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
 		 getName());
   }
 
-  /* XXX we could cache the allocated state, maybe later...*/
-  
   I->FlushExpand ();
   pending = 1;
   expanded = 1;
@@ -626,8 +1516,23 @@ Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
       I->Add (name, it);
     }
     else {
-      InstType *xit = it->Expand (ns, ns->CurScope());
-      xit->MkCached ();
+      /* parameter types only depend on the namespace, so keep the
+	 expanded types around */
+      if (!_memo_pt || _memo_ns != ns) {
+	if (!_memo_pt) {
+	  MALLOC (_memo_pt, InstType *, getNumParams());
+	}
+	for (int j=0; j < getNumParams(); j++) {
+	  _memo_pt[j] = NULL;
+	}
+	_memo_ns = ns;
+      }
+      InstType *xit = _memo_pt[i];
+      if (!xit) {
+	xit = it->Expand (ns, ns->CurScope());
+	xit->MkCached ();
+	_memo_pt[i] = xit;
+      }
       I->Add (name, xit);
     }
     vx = I->LookupVal (name);
@@ -740,7 +1645,15 @@ Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
   else {
     /* run the chp */
     Assert (c, "Isn't this required?!");
-    _run_chp (I, c->c);
+    if (!_bc_tried) {
+      if (Act::func_bytecode) {
+	_bc = _fbc_compile (I, c->c);
+      }
+      _bc_tried = 1;
+    }
+    if (!_bc || !_fbc_run (_bc, I)) {
+      _run_chp (I, c->c);
+    }
   }
 
   pending = 0;
@@ -765,6 +1678,26 @@ Expr *Function::eval (ActNamespace *ns, int nargs, Expr **args)
     ActId *res = new ActId (string_cache ("self"));
     ret = res->Eval (ns, I);
   }
+
+  /*-- record the result; external functions might not be pure --*/
+  if (memo_ok && !ext_found && ret &&
+      ((ret->type == E_INT && !ret->u.ival.v_extra) ||
+       ret->type == E_TRUE || ret->type == E_FALSE ||
+       ret->type == E_REAL)) {
+    if (_memo && _memo->n >= ACT_FUNC_MEMO_MAX) {
+      _memo_drop ();
+    }
+    if (!_memo) {
+      _memo = hash_new (4);
+    }
+    hash_bucket_t *mb = hash_add (_memo, memo_buf);
+    if (ret->type == E_REAL) {
+      mb->v = const_expr_real (ret->u.f);
+    }
+    else {
+      mb->v = ret;
+    }
+  }
   return ret;
 }
 
@@ -0,0 +1,443 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <common/misc.h>
+#include <common/list.h>
+#include <common/hash.h>
+#include <common/except.h>
+#include "act_parse.h"
+#include "act_parse_int.h"
+#include "path.h"
+
+/*------------------------------------------------------------------------
+ *
+ *  Concurrent import parsing
+ *
+ *   Parsing a file does not depend on the semantic walk, so the files
+ *  named by import statements can be parsed before the walk gets to
+ *  them. Each parse tree is scanned for its own imports, and any file
+ *  not seen before is queued for the pool of parser threads. The walk
+ *  still processes imports in program order: it finds the tree ready,
+ *  waits for a parse in progress, or parses the file itself if no
+ *  thread has started on it.
+ *
+ *   The queue is kept in walk order (the imports of a file are placed
+ *  ahead of everything queued earlier), so the threads work on what
+ *  the walk will need next.
+ *
+ *   A parser thread that fails retires, since the parser state is not
+ *  reset when a parse is abandoned; the walk re-parses the file so that
+ *  the usual error messages are reported.
+ *
+ *------------------------------------------------------------------------
+ */
+
+enum import_state {
+  IMPORT_QUEUED,		/* waiting for a parser thread */
+  IMPORT_BUSY,			/* being parsed */
+  IMPORT_DONE,			/* parse tree available */
+  IMPORT_FAILED,		/* the walk has to parse the file */
+  IMPORT_TAKEN			/* handed over to the walk */
+};
+
+struct import_job {
+  const char *file;		/* expanded path name (hash key) */
+  enum import_state state;
+  act_Token *t;			/* parse tree */
+  struct import_job *next;	/* queue */
+};
+
+struct import_pool {
+  struct Hashtable *H;		/* file name -> struct import_job */
+  struct import_job *jobs;	/* files waiting to be parsed */
+  int live;			/* # of parser threads running */
+  int stop;			/* set when the pool is drained */
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* new jobs, or stop */
+  pthread_cond_t done;		/* a parse or a thread finished */
+};
+
+static struct import_pool *P = NULL;
+
+static __thread int _in_worker = 0;
+
+int act_import_worker (void)
+{
+  return _in_worker;
+}
+
+/*
+ * Resolve an import to its expanded path name, following the
+ * import_item rules in namespaces.m4. Imports only appear at the top
+ * of a file, so namespace imports are relative to the global
+ * namespace. Returns NULL if there is nothing to prefetch.
+ */
+static char *_import_resolve (Node_import_item *n)
+{
+  char *tmp, *s;
+  FILE *fp;
+  listitem_t *li;
+  int len;
+
+  if (n->type == 0) {
+    const char *q = n->u.Option_import_item0.f1;
+    len = strlen (q);
+    MALLOC (tmp, char, len-1);
+    strncpy (tmp, q+1, len-2);
+    tmp[len-2] = '\0';
+  }
+  else if (n->type == 1) {
+    len = 14;
+    for (li = list_first (n->u.Option_import_item1.f2); li;
+	 li = list_next (li)) {
+      len += strlen (((act_Token *)list_value (li))->u.Tok_ID.n0) + 1;
+    }
+    MALLOC (tmp, char, len);
+    tmp[0] = '\0';
+    for (li = list_first (n->u.Option_import_item1.f2); li;
+	 li = list_next (li)) {
+      strcat (tmp, ((act_Token *)list_value (li))->u.Tok_ID.n0);
+      if (list_next (li)) {
+	strcat (tmp, "/");
+      }
+    }
+    s = tmp + strlen (tmp);
+    strcpy (s, "/_all_.act");
+    char *t = act_path_open (tmp);
+    fp = fopen (t, "r");
+    FREE (t);
+    if (fp) {
+      fclose (fp);
+    }
+    else {
+      strcpy (s, ".act");
+    }
+  }
+  else {
+    return NULL;
+  }
+
+  s = act_path_open (tmp);
+  FREE (tmp);
+
+  /* missing files are reported by the walk */
+  fp = fopen (s, "r");
+  if (!fp) {
+    FREE (s);
+    return NULL;
+  }
+  fclose (fp);
+  return s;
+}
+
+/*
+ * Return the list of files imported by a parse tree. Files that have
+ * already been imported are skipped if "main" is set; the import list
+ * can only be read by the walk.
+ */
+static list_t *_import_scan (act_Token *t, int main)
+{
+  list_t *ret = list_new ();
+  listitem_t *li;
+  Node_toplevel *top;
+  Node_imports_opens *io;
+  Node_import_open_item *it;
+  char *s;
+
+  top = t->u.Tok_toplevel.n0;
+  if (!top) {
+    return ret;
+  }
+  for (li = list_first (top->u.Option_toplevel0.f0); li;
+       li = list_next (li)) {
+    io = ((act_Token *)list_value (li))->u.Tok_imports_opens.n0;
+    while (io) {
+      if (io->type == 0) {
+	it = io->u.Option_imports_opens0.f0;
+	io = io->u.Option_imports_opens0.f1;
+      }
+      else {
+	it = io->u.Option_imports_opens1.f0;
+	io = NULL;
+      }
+      if (it->type != 0) {
+	continue;
+      }
+      s = _import_resolve (it->u.Option_import_open_item0.f0);
+      if (s && main && act_isimported (s)) {
+	FREE (s);
+	s = NULL;
+      }
+      if (s) {
+	list_append (ret, s);
+      }
+    }
+  }
+  return ret;
+}
+
+/*
+ * Queue the files in "l" that have not been seen before, ahead of any
+ * queued files. Frees the names. Called with the pool lock held.
+ */
+static void _import_queue (list_t *l)
+{
+  struct import_job *hd, *tl, *j;
+  hash_bucket_t *b;
+  listitem_t *li;
+  char *s;
+
+  hd = NULL;
+  tl = NULL;
+  for (li = list_first (l); li; li = list_next (li)) {
+    s = (char *) list_value (li);
+    if (!hash_lookup (P->H, s)) {
+      b = hash_add (P->H, s);
+      NEW (j, struct import_job);
+      j->file = b->key;
+      j->state = IMPORT_QUEUED;
+      j->t = NULL;
+      j->next = NULL;
+      b->v = j;
+      if (!hd) {
+	hd = j;
+      }
+      else {
+	tl->next = j;
+      }
+      tl = j;
+    }
+    FREE (s);
+  }
+  list_free (l);
+  if (hd) {
+    tl->next = P->jobs;
+    P->jobs = hd;
+    pthread_cond_broadcast (&P->work);
+  }
+}
+
+static void _import_fatal (void)
+{
+  THROW (EXC_NULL_EXCEPTION);
+}
+
+static int _import_spawn (void);
+
+static void *_import_worker (void *arg)
+{
+  struct import_job *j;
+  act_Token *t;
+  list_t *l;
+  int failed = 0;
+
+  _in_worker = 1;
+  act_parse_quiet (1);
+
+  pthread_mutex_lock (&P->lock);
+  while (!failed) {
+    while (!P->stop && !P->jobs) {
+      pthread_cond_wait (&P->work, &P->lock);
+    }
+    if (P->stop) {
+      break;
+    }
+    j = P->jobs;
+    P->jobs = j->next;
+    if (j->state != IMPORT_QUEUED) {
+      /* the walk got there first */
+      continue;
+    }
+    j->state = IMPORT_BUSY;
+    pthread_mutex_unlock (&P->lock);
+
+    t = NULL;
+    l = NULL;
+    fatal_error_hook (_import_fatal);
+    TRY {
+      t = act_cached_parse (j->file);
+      l = _import_scan (t, 0);
+    } CATCH {
+      EXCEPT_SWITCH {
+      default:
+	failed = 1;
+	break;
+      }
+    }
+    fatal_error_hook (NULL);
+
+    pthread_mutex_lock (&P->lock);
+    if (failed) {
+      j->state = IMPORT_FAILED;
+    }
+    else {
+      j->t = t;
+      j->state = IMPORT_DONE;
+      _import_queue (l);
+    }
+    pthread_cond_broadcast (&P->done);
+  }
+  P->live--;
+  if (failed && !P->stop) {
+    _import_spawn ();
+  }
+  pthread_cond_broadcast (&P->done);
+  pthread_mutex_unlock (&P->lock);
+
+  list_cleanup ();
+  return NULL;
+}
+
+/* called with the pool lock held */
+static int _import_spawn (void)
+{
+  pthread_t tid;
+
+  if (pthread_create (&tid, NULL, _import_worker, NULL) != 0) {
+    return 0;
+  }
+  pthread_detach (tid);
+  P->live++;
+  return 1;
+}
+
+void act_import_prefetch (act_Token *t, int nthreads)
+{
+  list_t *l;
+  int i;
+
+  if (nthreads == 0) {
+    nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+  }
+  if (nthreads <= 1 || P || !t) {
+    return;
+  }
+
+  l = _import_scan (t, 1);
+  if (list_isempty (l)) {
+    list_free (l);
+    return;
+  }
+
+  NEW (P, struct import_pool);
+  P->H = hash_new (32);
+  P->jobs = NULL;
+  P->live = 0;
+  P->stop = 0;
+  pthread_mutex_init (&P->lock, NULL);
+  pthread_cond_init (&P->work, NULL);
+  pthread_cond_init (&P->done, NULL);
+
+  pthread_mutex_lock (&P->lock);
+  _import_queue (l);
+  for (i=0; i < nthreads; i++) {
+    if (!_import_spawn ()) {
+      break;
+    }
+  }
+  pthread_mutex_unlock (&P->lock);
+}
+
+act_Token *act_import_parse (char *file)
+{
+  hash_bucket_t *b;
+  struct import_job *j;
+  act_Token *t;
+  list_t *l;
+
+  if (!P) {
+    return act_cached_parse (file);
+  }
+
+  pthread_mutex_lock (&P->lock);
+  b = hash_lookup (P->H, file);
+  if (b) {
+    j = (struct import_job *) b->v;
+    while (j->state == IMPORT_BUSY) {
+      pthread_cond_wait (&P->done, &P->lock);
+    }
+    if (j->state == IMPORT_DONE) {
+      t = j->t;
+      j->t = NULL;
+      j->state = IMPORT_TAKEN;
+      pthread_mutex_unlock (&P->lock);
+      return t;
+    }
+  }
+  else {
+    b = hash_add (P->H, file);
+    NEW (j, struct import_job);
+    j->file = b->key;
+    j->t = NULL;
+    j->next = NULL;
+    b->v = j;
+  }
+  j->state = IMPORT_TAKEN;
+  pthread_mutex_unlock (&P->lock);
+
+  /* not prefetched, or the parse failed: parse it here */
+  t = act_cached_parse (file);
+
+  l = _import_scan (t, 1);
+  pthread_mutex_lock (&P->lock);
+  _import_queue (l);
+  pthread_mutex_unlock (&P->lock);
+
+  return t;
+}
+
+void act_import_drain (void)
+{
+  hash_iter_t it;
+  hash_bucket_t *b;
+  struct import_job *j;
+
+  if (!P) {
+    return;
+  }
+
+  pthread_mutex_lock (&P->lock);
+  P->stop = 1;
+  pthread_cond_broadcast (&P->work);
+  while (P->live > 0) {
+    pthread_cond_wait (&P->done, &P->lock);
+  }
+  pthread_mutex_unlock (&P->lock);
+
+  hash_iter_init (P->H, &it);
+  while ((b = hash_iter_next (P->H, &it))) {
+    j = (struct import_job *) b->v;
+    if (j->t) {
+      act_parse_free (j->t);
+    }
+    FREE (j);
+  }
+  hash_free (P->H);
+  pthread_cond_destroy (&P->done);
+  pthread_cond_destroy (&P->work);
+  pthread_mutex_destroy (&P->lock);
+  FREE (P);
+  P = NULL;
+}
@@ -70,7 +70,7 @@ import_item: "import" STRING ";"
     
     /* Process the new file */
     TRY {
-      t = act_parse (s);
+      t = act_import_parse (s);
       act_walk_X ($0, t);
       act_parse_free (t);
     } CATCH {
@@ -22,6 +22,7 @@
 #include <act/act.h>
 #include <act/iter.h>
 #include <act/tech.h>
+#include <act/profile.h>
 #include <string.h>
 #include <dlfcn.h>
 #include <common/config.h>
@@ -127,14 +128,28 @@ const char *ActPass::getName ()
   return name;
 }
 
+/* a profiler phase for the work done by a pass */
+static void _prof_pass_begin (const char *name)
+{
+  char buf[1024];
+
+  if (act_prof_enabled) {
+    snprintf (buf, 1024, "pass:%s", name);
+    act_prof_begin (buf);
+  }
+}
+
 /* defaults */
 int ActPass::run (Process *p)
 {
+  _prof_pass_begin (name);
+
   init();
 
   _root = p;
 
   if (!rundeps (p)) {
+    act_prof_end ();
     return 0;
   }
 
@@ -155,6 +170,8 @@ int ActPass::run (Process *p)
 
   _finished = 2;
 
+  act_prof_end ();
+
   return 1;
 }
 
@@ -164,6 +181,8 @@ void ActPass::run_recursive (Process *p, int mode)
     return;
   }
 
+  _prof_pass_begin (name);
+
   if (!visited_flag) {
     visited_flag = new std::unordered_set<UserDef *> ();
   }
@@ -181,6 +200,8 @@ void ActPass::run_recursive (Process *p, int mode)
     delete visited_flag;
     visited_flag = NULL;
   }
+
+  act_prof_end ();
 }
 
 int ActPass::init ()
@@ -323,6 +344,10 @@ void ActPass::recursive_op (UserDef *p, int mode)
   }
 
   if (mode >= 0) {
+    double t = 0;
+    if (act_prof_enabled) {
+      t = act_prof_now ();
+    }
     if (TypeFactory::isProcessType (p) || (p == NULL)) {
       (*pmap)[p] = local_op (dynamic_cast<Process *>(p), mode);
     }
@@ -334,6 +359,10 @@ void ActPass::recursive_op (UserDef *p, int mode)
 	      "What?");
       (*pmap)[p] = local_op (dynamic_cast<Data *>(p), mode);
     }
+    if (act_prof_enabled) {
+      /* local_op time per type */
+      act_prof_item (p ? p->getName() : "-toplevel-", act_prof_now () - t);
+    }
   }
   else {
     void *v = (*pmap)[p];
@@ -701,6 +730,8 @@ void ActPass::_actual_update (Process *p)
   if (_root_dirty) {
     p = _root;
   }
+
+  _prof_pass_begin (name);
   
   if (p) {
     act_error_push (p->getName(), p->getFile(), p->getLine());
@@ -722,6 +753,8 @@ void ActPass::_actual_update (Process *p)
   act_error_pop ();
   
   visited_flag = NULL;
+
+  act_prof_end ();
 }
 
 struct pass_edges {
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <pwd.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <common/misc.h>
 #include <common/path.h>
 #include "path.h"
@@ -32,6 +33,9 @@
 static int first = 1;
 static path_info_t *act_path = NULL;
 
+/* imports are resolved by the parser threads as well */
+static pthread_mutex_t path_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Initialize the search path
  */
@@ -74,8 +78,13 @@ static void _path_init (void)
  */
 char *act_path_open (char *name)
 {
+  char *s;
+  
+  pthread_mutex_lock (&path_lock);
   _path_init ();
-  return path_open (act_path, name, ".act");
+  s = path_open (act_path, name, ".act");
+  pthread_mutex_unlock (&path_lock);
+  return s;
 }
 
 
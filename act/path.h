@@ -80,6 +80,64 @@ void act_push_import (char *file);
  */
 int act_isimported (const char *file);
 
+
+/*--- concurrent import parsing ---*/
+
+struct act_DefToken;
+
+/**
+ *  Start parsing the files imported by a parse tree ahead of the
+ *  walk. Imports are discovered transitively and parsed by a pool of
+ *  threads; the walk picks up the trees with act_import_parse().
+ *
+ *  @param t is the parse tree of the top-level file
+ *  @param nthreads is the number of parser threads (0 = one per
+ *  processor, 1 = no prefetching)
+ */
+void act_import_prefetch (struct act_DefToken *t, int nthreads);
+
+/**
+ *  Return the parse tree for an import. If the file was parsed ahead
+ *  of time, the prefetched tree is returned (waiting for it if it is
+ *  still being parsed); otherwise the file is parsed now.
+ *
+ *  @param file is the expanded path name of the import
+ *  @return the parse tree, to be released with act_parse_free()
+ */
+struct act_DefToken *act_import_parse (char *file);
+
+/**
+ *  Stop the parser threads and release any trees that were never
+ *  used.
+ */
+void act_import_drain (void);
+
+/**
+ *  @return 1 if the caller is one of the import parser threads, 0
+ *  otherwise
+ */
+int act_import_worker (void);
+
+
+/*--- parse tree cache ---*/
+
+/**
+ *  Parse a file, using the parse tree cache in the act.ast_cache
+ *  directory if there is one. A cached tree is used if the file
+ *  contents are unchanged; otherwise the file is parsed and its tree
+ *  is saved.
+ *
+ *  @param file is the name of the file to be parsed
+ *  @return the parse tree, to be released with act_parse_free()
+ */
+struct act_DefToken *act_cached_parse (const char *file);
+
+/**
+ *  Report cache hits and misses since the last report (shown with
+ *  -V parse)
+ */
+void act_parse_cache_report (void);
+
 #ifdef __cplusplus
 }
 #endif
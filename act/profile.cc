@@ -0,0 +1,505 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <act/profile.h>
+#include <common/misc.h>
+#include <common/list.h>
+#include <common/hash.h>
+
+/*------------------------------------------------------------------------
+ *
+ *  Phase profiler
+ *
+ *   Allocations are the ones made through the MALLOC/NEW/REALLOC
+ *  macros; heap growth comes from the C library allocator, and so
+ *  includes C++ new. Both cover all threads. CPU time is for the whole
+ *  process.
+ *
+ *   The resident set size is sampled when a phase begins and ends,
+ *  and each phase reports the largest sample. getrusage() only has
+ *  the peak for the life of the process, so that is reported once,
+ *  for the whole run. The kernel updates that peak lazily, so it is
+ *  never reported below the largest sample.
+ *
+ *------------------------------------------------------------------------
+ */
+
+int act_prof_enabled = 0;
+
+/* items shown per phase in the text report */
+#define PROF_TEXT_ITEMS 10
+
+struct prof_sample {
+  double wall;			/* msec */
+  double cpu;			/* msec */
+  unsigned long allocs;
+  long heap;			/* bytes */
+  long rss;			/* KB */
+};
+
+struct prof_item {
+  const char *name;
+  unsigned long calls;
+  double wall;			/* msec */
+};
+
+struct prof_phase {
+  char *name;
+  struct prof_phase *parent;
+  list_t *kids;			/* sub-phases, in order of first use */
+
+  unsigned long calls;
+  double wall, cpu;		/* msec */
+  unsigned long allocs;
+  long heap;			/* bytes */
+  long rss;			/* largest sampled RSS in KB */
+
+  struct prof_sample start;	/* sample at act_prof_begin() */
+
+  struct Hashtable *items;	/* name -> struct prof_item */
+};
+
+static struct prof_phase *_root = NULL;
+static struct prof_phase *_cur = NULL;
+
+/* largest RSS sample so far, in KB */
+static long _rss_peak = 0;
+
+static int _prof_json = 0;
+static char *_prof_file = NULL;
+
+double act_prof_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000.0 + ts.tv_nsec/1.0e6;
+}
+
+static long _heap_inuse (void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2 ();
+  return (long) (mi.uordblks + mi.hblkhd);
+#elif defined(__GLIBC__)
+  struct mallinfo mi = mallinfo ();
+  return (long) (unsigned int) mi.uordblks + (long) (unsigned int) mi.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static long _maxrss (void)
+{
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+#if defined(__APPLE__)
+  return ru.ru_maxrss/1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+/* current RSS in KB, or the peak so far if that isn't available */
+static long _rss (void)
+{
+#if defined(__linux__)
+  char buf[128];
+  long sz, res;
+  int fd, n;
+
+  /* read(), not stdio, so that sampling doesn't change the heap */
+  fd = open ("/proc/self/statm", O_RDONLY);
+  if (fd >= 0) {
+    n = read (fd, buf, sizeof (buf) - 1);
+    close (fd);
+    if (n > 0) {
+      buf[n] = '\0';
+      if (sscanf (buf, "%ld %ld", &sz, &res) == 2) {
+	return res * (sysconf (_SC_PAGESIZE)/1024);
+      }
+    }
+  }
+#endif
+  return _maxrss ();
+}
+
+static void _sample (struct prof_sample *s)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  s->cpu = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000.0 +
+    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)/1000.0;
+  s->wall = act_prof_now ();
+  s->allocs = mem_alloc_count;
+  s->heap = _heap_inuse ();
+  s->rss = _rss ();
+  if (s->rss > _rss_peak) {
+    _rss_peak = s->rss;
+  }
+}
+
+/* peak RSS for the process in KB */
+static long _peak_rss (void)
+{
+  long rss = _maxrss ();
+  return rss > _rss_peak ? rss : _rss_peak;
+}
+
+static struct prof_phase *_new_phase (const char *name,
+				      struct prof_phase *parent)
+{
+  struct prof_phase *ph;
+
+  NEW (ph, struct prof_phase);
+  ph->name = Strdup (name);
+  ph->parent = parent;
+  ph->kids = list_new ();
+  ph->calls = 0;
+  ph->wall = 0;
+  ph->cpu = 0;
+  ph->allocs = 0;
+  ph->heap = 0;
+  ph->rss = 0;
+  ph->items = NULL;
+  if (parent) {
+    list_append (parent->kids, ph);
+  }
+  return ph;
+}
+
+static void _enter (struct prof_phase *ph)
+{
+  ph->calls++;
+  _sample (&ph->start);
+  if (ph->start.rss > ph->rss) {
+    ph->rss = ph->start.rss;
+  }
+  _cur = ph;
+}
+
+static void _leave (struct prof_phase *ph)
+{
+  struct prof_sample s;
+
+  _sample (&s);
+  ph->wall += s.wall - ph->start.wall;
+  ph->cpu += s.cpu - ph->start.cpu;
+  ph->allocs += s.allocs - ph->start.allocs;
+  ph->heap += s.heap - ph->start.heap;
+  if (s.rss > ph->rss) {
+    ph->rss = s.rss;
+  }
+  _cur = ph->parent;
+}
+
+void act_prof_begin (const char *name)
+{
+  listitem_t *li;
+  struct prof_phase *ph;
+
+  if (!act_prof_enabled) {
+    return;
+  }
+  ph = NULL;
+  for (li = list_first (_cur->kids); li; li = list_next (li)) {
+    if (strcmp (((struct prof_phase *)list_value (li))->name, name) == 0) {
+      ph = (struct prof_phase *) list_value (li);
+      break;
+    }
+  }
+  if (!ph) {
+    ph = _new_phase (name, _cur);
+  }
+  _enter (ph);
+}
+
+void act_prof_end (void)
+{
+  if (!act_prof_enabled) {
+    return;
+  }
+  Assert (_cur != _root, "act_prof_end() without act_prof_begin()");
+  _leave (_cur);
+}
+
+void act_prof_item (const char *name, double msec)
+{
+  hash_bucket_t *b;
+  struct prof_item *it;
+
+  if (!act_prof_enabled) {
+    return;
+  }
+  if (!_cur->items) {
+    _cur->items = hash_new (16);
+  }
+  b = hash_lookup (_cur->items, name);
+  if (!b) {
+    b = hash_add (_cur->items, name);
+    NEW (it, struct prof_item);
+    it->name = b->key;
+    it->calls = 0;
+    it->wall = 0;
+    b->v = it;
+  }
+  it = (struct prof_item *) b->v;
+  it->calls++;
+  it->wall += msec;
+}
+
+
+/*-- reports --*/
+
+static int _itemcmp (const void *a, const void *b)
+{
+  const struct prof_item *x = *(const struct prof_item **)a;
+  const struct prof_item *y = *(const struct prof_item **)b;
+
+  if (x->wall > y->wall) return -1;
+  if (x->wall < y->wall) return 1;
+  return strcmp (x->name, y->name);
+}
+
+/* items sorted by decreasing time */
+static struct prof_item **_items (struct prof_phase *ph, int *num)
+{
+  struct prof_item **ret;
+  hash_iter_t it;
+  hash_bucket_t *b;
+  int i;
+
+  *num = 0;
+  if (!ph->items || ph->items->n == 0) {
+    return NULL;
+  }
+  MALLOC (ret, struct prof_item *, ph->items->n);
+  i = 0;
+  hash_iter_init (ph->items, &it);
+  while ((b = hash_iter_next (ph->items, &it))) {
+    ret[i++] = (struct prof_item *) b->v;
+  }
+  qsort (ret, i, sizeof (struct prof_item *), _itemcmp);
+  *num = i;
+  return ret;
+}
+
+static void _text_report (FILE *fp, struct prof_phase *ph, int depth)
+{
+  struct prof_item **items;
+  listitem_t *li;
+  int i, num;
+
+  fprintf (fp, "%*s%-*s %6lu %10.3f %10.3f %12lu %10.2f %10.2f\n",
+	   2*depth, "", 32-2*depth, ph->name, ph->calls,
+	   ph->wall/1000.0, ph->cpu/1000.0, ph->allocs,
+	   ph->heap/(1024.0*1024.0), ph->rss/1024.0);
+
+  items = _items (ph, &num);
+  if (items) {
+    for (i=0; i < num && i < PROF_TEXT_ITEMS; i++) {
+      fprintf (fp, "%*s. %-*s %6lu %10.3f\n",
+	       2*depth+2, "", 28-2*depth, items[i]->name, items[i]->calls,
+	       items[i]->wall/1000.0);
+    }
+    if (num > PROF_TEXT_ITEMS) {
+      fprintf (fp, "%*s. (%d more)\n", 2*depth+2, "", num - PROF_TEXT_ITEMS);
+    }
+    FREE (items);
+  }
+
+  for (li = list_first (ph->kids); li; li = list_next (li)) {
+    _text_report (fp, (struct prof_phase *) list_value (li), depth+1);
+  }
+}
+
+static void _json_string (FILE *fp, const char *s)
+{
+  fputc ('"', fp);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      fprintf (fp, "\\%c", *s);
+    }
+    else if ((unsigned char)*s < 0x20) {
+      fprintf (fp, "\\u%04x", (unsigned char)*s);
+    }
+    else {
+      fputc (*s, fp);
+    }
+  }
+  fputc ('"', fp);
+}
+
+static void _json_report (FILE *fp, struct prof_phase *ph, int depth)
+{
+  struct prof_item **items;
+  listitem_t *li;
+  int i, num;
+
+  fprintf (fp, "%*s{ \"name\": ", 2*depth, "");
+  _json_string (fp, ph->name);
+  fprintf (fp, ", \"calls\": %lu, \"wall_ms\": %.3f, \"cpu_ms\": %.3f,"
+	   " \"allocs\": %lu, \"heap_bytes\": %ld, \"rss_kb\": %ld",
+	   ph->calls, ph->wall, ph->cpu, ph->allocs, ph->heap, ph->rss);
+  if (!ph->parent) {
+    fprintf (fp, ", \"peak_rss_kb\": %ld", _peak_rss ());
+  }
+
+  items = _items (ph, &num);
+  if (items) {
+    fprintf (fp, ",\n%*s\"items\": [\n", 2*depth+2, "");
+    for (i=0; i < num; i++) {
+      fprintf (fp, "%*s{ \"name\": ", 2*depth+4, "");
+      _json_string (fp, items[i]->name);
+      fprintf (fp, ", \"calls\": %lu, \"wall_ms\": %.3f }%s\n",
+	       items[i]->calls, items[i]->wall, i == num-1 ? "" : ",");
+    }
+    fprintf (fp, "%*s]", 2*depth+2, "");
+    FREE (items);
+  }
+
+  if (!list_isempty (ph->kids)) {
+    fprintf (fp, ",\n%*s\"phases\": [\n", 2*depth+2, "");
+    for (li = list_first (ph->kids); li; li = list_next (li)) {
+      _json_report (fp, (struct prof_phase *) list_value (li), depth+2);
+      fprintf (fp, "%s\n", list_next (li) ? "," : "");
+    }
+    fprintf (fp, "%*s]", 2*depth+2, "");
+  }
+  fprintf (fp, " }");
+}
+
+/* re-open a phase (and its parents) closed for a report */
+static void _reenter (struct prof_phase *ph)
+{
+  if (ph->parent) {
+    _reenter (ph->parent);
+  }
+  _enter (ph);
+  ph->calls--;
+}
+
+void act_prof_report (FILE *fp, int json)
+{
+  struct prof_phase *ph, *top;
+
+  if (!act_prof_enabled) {
+    return;
+  }
+
+  /* close any open phases, including the root */
+  top = _cur;
+  for (ph = top; ph; ph = ph->parent) {
+    _leave (ph);
+  }
+
+  if (json) {
+    _json_report (fp, _root, 0);
+    fprintf (fp, "\n");
+  }
+  else {
+    fprintf (fp, "%-32s %6s %10s %10s %12s %10s %10s\n",
+	     "phase", "calls", "wall(s)", "cpu(s)", "allocs",
+	     "heap(MB)", "rss(MB)");
+    _text_report (fp, _root, 0);
+    fprintf (fp, "peak rss for the process: %.2f MB\n", _peak_rss ()/1024.0);
+  }
+
+  _reenter (top);
+  fflush (fp);
+}
+
+static void _prof_exit (void)
+{
+  FILE *fp;
+
+  if (_prof_file) {
+    fp = fopen (_prof_file, "w");
+    if (!fp) {
+      warning ("Could not open profile output file `%s'", _prof_file);
+      return;
+    }
+  }
+  else {
+    fp = stderr;
+  }
+  act_prof_report (fp, _prof_json);
+  if (fp != stderr) {
+    fclose (fp);
+  }
+}
+
+int act_prof_setup (const char *opt)
+{
+  const char *file = NULL;
+  int len;
+
+  if (!opt) {
+    opt = "text";
+  }
+  len = strlen (opt);
+  for (int i=0; opt[i]; i++) {
+    if (opt[i] == ':') {
+      len = i;
+      file = opt + i + 1;
+      break;
+    }
+  }
+  if (len == 4 && strncmp (opt, "text", 4) == 0) {
+    _prof_json = 0;
+  }
+  else if (len == 4 && strncmp (opt, "json", 4) == 0) {
+    _prof_json = 1;
+  }
+  else {
+    return 0;
+  }
+  if (file && !*file) {
+    return 0;
+  }
+  if (_prof_file) {
+    FREE (_prof_file);
+    _prof_file = NULL;
+  }
+  if (file) {
+    _prof_file = Strdup (file);
+  }
+
+  if (!act_prof_enabled) {
+    act_prof_enabled = 1;
+    mem_alloc_counting = 1;
+    _root = _new_phase ("total", NULL);
+    _enter (_root);
+    atexit (_prof_exit);
+  }
+  return 1;
+}
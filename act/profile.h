@@ -0,0 +1,60 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACT_PROFILE_H__
+#define __ACT_PROFILE_H__
+
+#include <stdio.h>
+
+/*
+ *  Phase profiler, enabled by the -prof option to Act::Init().
+ *
+ *   A phase records wall and CPU time, allocations and heap growth
+ *  between act_prof_begin() and act_prof_end(), and the largest RSS
+ *  sampled when it begins and ends. Phases nest, and a phase entered
+ *  more than once from the same parent phase is accumulated. Counters
+ *  (for example, local_op time per process) are added to the current
+ *  phase with act_prof_item(). The report also gives the peak RSS for
+ *  the whole process.
+ *
+ *   The report is written when the program exits.
+ */
+
+/* non-zero if profiling is enabled */
+extern int act_prof_enabled;
+
+/*
+ * Process the argument to -prof: "text" or "json", optionally
+ * followed by ":file"; NULL is the same as "text". Returns 0 on error.
+ */
+int act_prof_setup (const char *opt);
+
+void act_prof_begin (const char *name);
+void act_prof_end (void);
+
+/* wall-clock time in msec, for act_prof_item() */
+double act_prof_now (void);
+
+void act_prof_item (const char *name, double msec);
+
+void act_prof_report (FILE *fp, int json);
+
+#endif /* __ACT_PROFILE_H__ */
@@ -75,9 +75,9 @@
 #define STD_ERRMSG "Error parsing production rule"
 
 /*
-  Token list 
+  Token list (per-thread, like the rest of the parser state)
 */
-static int LANGLE, RANGLE, TWIDDLE, LBRACE, RBRACE, AND, OR, COLON, COMMA,
+static __thread int LANGLE, RANGLE, TWIDDLE, LBRACE, RBRACE, AND, OR, COLON, COMMA,
   AT, DDOT, LPAR, RPAR, PLUS, MINUS, SEMI;
 
 static act_prs_expr_t *_act_parse_prs_expr (LFILE *l);
@@ -387,7 +387,7 @@ static act_prs_expr_t *atom (LFILE *l)
 static act_prs_expr_t *term (LFILE *l)
 {
   act_prs_expr_t *e, *f;
-  static int in_pchg = 0;
+  static __thread int in_pchg = 0;
 
   f = e = atom (l);
   if (!e) return NULL;
@@ -685,6 +685,120 @@ void act_free_a_prs_expr (void *v)
   _freeexpr ((act_prs_expr_t *)v);
 }
 
+/*------------------------------------------------------------------------
+ *
+ * Save/restore parsed expressions (see pgen -s)
+ *
+ *------------------------------------------------------------------------
+ */
+static int _saveexpr (FILE *fp, act_prs_expr_t *e)
+{
+  if (!e) {
+    expr_save_uint (fp, 0);
+    return 1;
+  }
+  expr_save_uint (fp, e->type + 1);
+  switch (e->type) {
+  case ACT_PRS_EXPR_AND:
+  case ACT_PRS_EXPR_OR:
+  case ACT_PRS_EXPR_NOT:
+    expr_save_int (fp, e->u.e.pchg_type);
+    return _saveexpr (fp, e->u.e.l) && _saveexpr (fp, e->u.e.r) &&
+      _saveexpr (fp, e->u.e.pchg);
+
+  case ACT_PRS_EXPR_VAR:
+    if (!(*expr_save_id) (fp, e->u.v.id)) {
+      return 0;
+    }
+    if (!e->u.v.sz) {
+      expr_save_uint (fp, 0);
+      return 1;
+    }
+    expr_save_uint (fp, 1);
+    expr_save_int (fp, e->u.v.sz->flavor);
+    return expr_save (fp, e->u.v.sz->w) && expr_save (fp, e->u.v.sz->l) &&
+      expr_save (fp, e->u.v.sz->folds);
+
+  case ACT_PRS_EXPR_LABEL:
+    expr_save_string (fp, e->u.l.label);
+    return 1;
+
+  case ACT_PRS_EXPR_ANDLOOP:
+  case ACT_PRS_EXPR_ORLOOP:
+    expr_save_string (fp, e->u.loop.id);
+    return expr_save (fp, e->u.loop.lo) && expr_save (fp, e->u.loop.hi) &&
+      _saveexpr (fp, e->u.loop.e);
+
+  default:
+    /* true/false only appear after expansion */
+    return 0;
+  }
+}
+
+static act_prs_expr_t *_loadexpr (FILE *fp)
+{
+  act_prs_expr_t *e;
+  unsigned long type = expr_load_uint (fp);
+  const char *s;
+
+  if (type == 0) {
+    return NULL;
+  }
+  NEW (e, act_prs_expr_t);
+  e->type = type - 1;
+  switch (e->type) {
+  case ACT_PRS_EXPR_AND:
+  case ACT_PRS_EXPR_OR:
+  case ACT_PRS_EXPR_NOT:
+    e->u.e.pchg_type = expr_load_int (fp);
+    e->u.e.l = _loadexpr (fp);
+    e->u.e.r = _loadexpr (fp);
+    e->u.e.pchg = _loadexpr (fp);
+    break;
+
+  case ACT_PRS_EXPR_VAR:
+    e->u.v.id = (ActId *) (*expr_load_id) (fp);
+    e->u.v.sz = NULL;
+    if (expr_load_uint (fp)) {
+      NEW (e->u.v.sz, act_size_spec_t);
+      e->u.v.sz->flavor = expr_load_int (fp);
+      e->u.v.sz->w = expr_load (fp);
+      e->u.v.sz->l = expr_load (fp);
+      e->u.v.sz->folds = expr_load (fp);
+    }
+    break;
+
+  case ACT_PRS_EXPR_LABEL:
+    s = expr_load_string (fp);
+    e->u.l.label = s ? Strdup (s) : NULL;
+    break;
+
+  case ACT_PRS_EXPR_ANDLOOP:
+  case ACT_PRS_EXPR_ORLOOP:
+    s = expr_load_string (fp);
+    e->u.loop.id = s ? Strdup (s) : NULL;
+    e->u.loop.lo = expr_load (fp);
+    e->u.loop.hi = expr_load (fp);
+    e->u.loop.e = _loadexpr (fp);
+    break;
+
+  default:
+    fatal_error ("what?");
+    break;
+  }
+  return e;
+}
+
+int act_save_a_prs_expr (FILE *fp, void *v)
+{
+  return _saveexpr (fp, (act_prs_expr_t *)v);
+}
+
+void *act_load_a_prs_expr (FILE *fp)
+{
+  return _loadexpr (fp);
+}
+
 
 static void _free_ex_expr (act_prs_expr_t *e)
 {
@@ -46,6 +46,8 @@ int act_is_a_prs_expr (LFILE *);
 void act_free_a_prs_expr (void *);
 void *act_parse_a_prs_expr (LFILE *);
 void *act_walk_X_prs_expr (ActTree *, void *);
+int act_save_a_prs_expr (FILE *, void *);
+void *act_load_a_prs_expr (FILE *);
 
 /**
  * This is used to free an expanded Expr pointer. It is here since the
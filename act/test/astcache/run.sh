@@ -0,0 +1,151 @@
+#!/bin/sh
+
+#
+# Parse tree cache (act.ast_cache). The inputs of the other test
+# directories are run without the cache, then twice with it: the
+# first run fills the cache and the second must read every file from
+# it. All three runs must produce the same output. The local test
+# checks the hit and miss counts as files are edited and touched.
+#
+
+ARCH=`$VLSI_TOOLS_SRC/scripts/getarch`
+OS=`$VLSI_TOOLS_SRC/scripts/getos`
+EXT=${ARCH}_${OS}
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../act-test.$EXT ]; then
+  ACT=$ACT_HOME/bin/act-test
+  echo "testing installation"
+echo
+else
+  ACT=`pwd`/../act-test.$EXT
+fi
+
+check_echo=0
+myecho()
+{
+  if [ $check_echo -eq 0 ]
+  then
+	check_echo=1
+	count=`echo -n "" | wc -c | awk '{print $1}'`
+	if [ $count -gt 0 ]
+	then
+		check_echo=2
+	fi
+  fi
+  if [ $check_echo -eq 1 ]
+  then
+	echo -n "$@"
+  else
+	echo "$@\c"
+  fi
+}
+
+
+fail=0
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+top=`pwd`
+rm -rf runs/cache runs/edit
+echo "begin act" > runs/cache.conf
+echo "string ast_cache \"$top/runs/cache\"" >> runs/cache.conf
+echo "end" >> runs/cache.conf
+CACHE="-cnf=$top/runs/cache.conf -log=$top/runs/parse.t.log -Vparse"
+
+#
+# cached <label>: run runs/edit/0.act with the cache, and append the
+# sorted parse cache report to runs/cache.t.log
+#
+cached()
+{
+	(cd runs/edit; $ACT $CACHE -ep 0.act > $top/runs/0.act.t.stdout 2> $top/runs/0.act.t.stderr)
+	echo "--- $1" >> runs/cache.t.log
+	sort runs/parse.t.log >> runs/cache.t.log
+	if ! cmp runs/0.act.t.stdout runs/0.act.stdout >/dev/null 2>/dev/null || [ -s runs/0.act.t.stderr ]
+	then
+		echo
+		myecho "** FAILED TEST $1: output **"
+		fail=`expr $fail + 1`
+	fi
+}
+
+myecho " .[cache]"
+mkdir runs/edit
+cp 0.act defs.act runs/edit
+rm -f runs/cache.t.log
+cached cold
+cached warm
+echo "// edited" >> runs/edit/defs.act
+cached "import edited"
+cached "edited warm"
+touch runs/edit/0.act
+cached touched
+rm -rf runs/edit
+if ! cmp runs/cache.t.log runs/cache.log >/dev/null 2>/dev/null
+then
+	echo
+	myecho "** FAILED TEST cache: counts **"
+	fail=`expr $fail + 1`
+	if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            diff runs/cache.t.log runs/cache.log
+        fi
+fi
+echo
+
+#
+# every other test input: cold and warm runs must match the run
+# without the cache, and the warm run must not miss
+#
+for d in ../*
+do
+	if [ ! -f $d/0.act -o $d = ../astcache ]; then
+		continue
+	fi
+	dname=`basename $d`
+	myecho " .[$dname]"
+	ok=1
+	count=0
+	while [ -f $d/${count}.act ]
+	do
+		i=${count}.act
+		count=`expr $count + 1`
+		(cd $d; $ACT -e $i > $top/runs/ref.t.stdout 2> $top/runs/ref.t.stderr)
+		for pass in cold warm
+		do
+			rm -f runs/parse.t.log
+			(cd $d; $ACT $CACHE -e $i > $top/runs/$pass.t.stdout 2> $top/runs/$pass.t.stderr)
+			if ! cmp runs/$pass.t.stdout runs/ref.t.stdout >/dev/null 2>/dev/null || ! cmp runs/$pass.t.stderr runs/ref.t.stderr >/dev/null 2>/dev/null
+			then
+				echo
+				myecho "** FAILED TEST $dname/$i: $pass output **"
+				fail=`expr $fail + 1`
+				ok=0
+			fi
+		done
+		if [ -f runs/parse.t.log ] && grep "parse cache miss" runs/parse.t.log >/dev/null
+		then
+			echo
+			myecho "** FAILED TEST $dname/$i: warm run missed **"
+			fail=`expr $fail + 1`
+			ok=0
+		fi
+	done
+	if [ $ok -eq 0 ]
+	then
+		echo
+	fi
+done
+echo
+
+if [ $fail -ne 0 ]
+then
+	if [ $fail -eq 1 ]
+	then
+		echo "--- Summary: 1 test failed ---"
+	else
+		echo "--- Summary: $fail tests failed ---"
+	fi
+	exit 1
+fi
@@ -0,0 +1,22 @@
+#!/bin/sh
+
+#
+# Run the tests twice: once with parameter function bodies compiled to
+# bytecode (the default), and once with the tree interpreter. Both
+# must match the saved output.
+#
+if ../run_subdir.sh
+then
+	fail=0
+else
+	fail=1
+fi
+
+echo " tree interpreter:"
+if ACT_TEST_FLAGS=-cnf=nobc.conf ../run_subdir.sh
+then
+	:
+else
+	fail=1
+fi
+exit $fail
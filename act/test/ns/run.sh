@@ -0,0 +1,22 @@
+#!/bin/sh
+
+#
+# Run the tests twice: once parsing imported files serially (the
+# default), and once with several parser threads. Both must match the
+# saved output.
+#
+if ../run_subdir.sh
+then
+	fail=0
+else
+	fail=1
+fi
+
+echo " parser threads:"
+if ACT_TEST_FLAGS=-cnf=threads.conf ../run_subdir.sh
+then
+	:
+else
+	fail=1
+fi
+exit $fail
@@ -0,0 +1,127 @@
+#!/bin/sh
+
+#
+# Phase profiler (-prof). The reports go to a file, and the numbers
+# other than call counts are masked before they are compared with
+# runs/<test>.text and runs/<test>.json. The sampled RSS of each phase
+# must be non-zero and at most the peak for the process.
+#
+
+ARCH=`$VLSI_TOOLS_SRC/scripts/getarch`
+OS=`$VLSI_TOOLS_SRC/scripts/getos`
+EXT=${ARCH}_${OS}
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../act-test.$EXT ]; then
+  ACT=$ACT_HOME/bin/act-test
+  echo "testing installation"
+echo
+else
+  ACT=../act-test.$EXT
+fi
+
+check_echo=0
+myecho()
+{
+  if [ $check_echo -eq 0 ]
+  then
+	check_echo=1
+	count=`echo -n "" | wc -c | awk '{print $1}'`
+	if [ $count -gt 0 ]
+	then
+		check_echo=2
+	fi
+  fi
+  if [ $check_echo -eq 1 ]
+  then
+	echo -n "$@"
+  else
+	echo "$@\c"
+  fi
+}
+
+
+fail=0
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+#
+# mask_text/mask_json <file>: replace the measurements with #
+#
+mask_text()
+{
+	sed -E -e 's/^( *[^ ]+ +[0-9]+)( +-?[0-9.]+){5}$/\1 # # # # #/' \
+	       -e 's/^(peak rss[^:]*: )[0-9.]+/\1#/' $1
+}
+
+mask_json()
+{
+	sed -E 's/"(wall_ms|cpu_ms|allocs|heap_bytes|rss_kb|peak_rss_kb)": -?[0-9.]+/"\1": #/g' $1
+}
+
+#
+# check_rss <file>: every rss_kb is positive and at most peak_rss_kb
+#
+check_rss()
+{
+	tr ',' '\n' < $1 | awk '/"peak_rss_kb"/ { peak = $2 }
+	  /"rss_kb"/ { n++; if ($2 <= 0) bad++; if ($2 > max) max = $2 }
+	  END { if (n == 0 || bad > 0 || peak <= 0 || max > peak) exit 1 }'
+}
+
+myecho " "
+count=0
+while [ -f ${count}.act ]
+do
+	i=${count}.act
+	count=`expr $count + 1`
+	myecho ".[$i]"
+	ok=1
+	for fmt in text json
+	do
+		$ACT -prof=$fmt:runs/$i.t.prof -e $i > runs/$i.t.stdout 2> runs/$i.t.stderr
+		if [ -s runs/$i.t.stdout -o -s runs/$i.t.stderr ]
+		then
+			echo
+			myecho "** FAILED TEST $i: $fmt output not in file"
+			fail=`expr $fail + 1`
+			ok=0
+		fi
+		mask_$fmt runs/$i.t.prof > runs/$i.t.$fmt
+		if ! cmp runs/$i.t.$fmt runs/$i.$fmt >/dev/null 2>/dev/null
+		then
+			echo
+			myecho "** FAILED TEST $i: $fmt"
+			fail=`expr $fail + 1`
+			ok=0
+			if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            		diff runs/$i.t.$fmt runs/$i.$fmt
+        		fi
+		fi
+		if [ $fmt = json ] && ! check_rss runs/$i.t.prof
+		then
+			echo
+			myecho "** FAILED TEST $i: rss"
+			fail=`expr $fail + 1`
+			ok=0
+		fi
+	done
+	if [ $ok -eq 0 ]
+	then
+		echo " **"
+		myecho " "
+	fi
+done
+echo
+
+if [ $fail -ne 0 ]
+then
+	if [ $fail -eq 1 ]
+	then
+		echo "--- Summary: 1 test failed ---"
+	else
+		echo "--- Summary: $fail tests failed ---"
+	fi
+	exit 1
+fi
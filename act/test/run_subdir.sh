@@ -59,7 +59,7 @@ do
              lim=8
           fi
         fi
-	$ACT -e $i > runs/$i.t.stdout 2> runs/$i.t.stderr
+	$ACT $ACT_TEST_FLAGS -e $i > runs/$i.t.stdout 2> runs/$i.t.stderr
 	ok=1
 	if ! cmp runs/$i.t.stdout runs/$i.stdout >/dev/null 2>/dev/null
 	then
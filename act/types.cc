@@ -534,6 +534,9 @@ Function::Function (UserDef *u) : UserDef (u)
   b = NULL;
   ret_type = NULL;
   is_simple_inline = 0;
+  _memo_init ();
+  _bc = NULL;
+  _bc_tried = 0;
 }
 
 Function::~Function ()
@@ -541,6 +544,8 @@ Function::~Function ()
   if (b) {
     delete b;
   }
+  _memo_clear ();
+  _bc_clear ();
 }
 
 
@@ -3284,6 +3289,9 @@ Function::Function (ActNamespace *ns) : UserDef (ns)
 {
   ret_type = NULL;
   is_simple_inline = 1;
+  _memo_init ();
+  _bc = NULL;
+  _bc_tried = 0;
 }
 
 Function *Function::Clone (ActNamespace *root, ActNamespace *cur)
@@ -1317,11 +1317,38 @@ class Function : public UserDef {
    * template list.
    */
   void convPortsToParams ();
+
+  /**
+   * @return the number of eval() calls answered from the memo table
+   */
+  unsigned long memoHits () { return _memo_hits; }
+
+  /**
+   * @return the number of eval() calls that ran the function body
+   */
+  unsigned long memoMisses () { return _memo_misses; }
   
  private:
   InstType *ret_type;		///< holds return type
   int is_simple_inline;		///< holds the simple inline flag
 
+  struct Hashtable *_memo;	///< argument tuple -> result of eval()
+  ActNamespace *_memo_ns;	///< namespace for _memo_pt
+  InstType **_memo_pt;		///< expanded parameter types
+  unsigned long _memo_hits;	///< memo statistics
+  unsigned long _memo_misses;
+
+  struct act_func_bc *_bc;	///< compiled chp body, if any
+  int _bc_tried;		///< 1 if the body was compiled (or
+				///could not be compiled)
+
+  void _memo_init ();		///< initialize memo state
+  void _memo_clear ();		///< discard memo state
+  void _memo_drop ();		///< discard the memo table
+  int _memo_key (ActNamespace *ns, int nargs, Expr **args,
+		 char *buf, int sz); ///< canonical key for arguments
+  void _bc_clear ();		///< discard the compiled body
+
   void _chk_inline (Expr *e);	///< used to check simple inline
   void _chk_inline (struct act_chp_lang *c); ///< used to check simple inline
 };
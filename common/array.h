@@ -35,7 +35,8 @@
  *      ...
  *  } f;
  *
- *  (use L_A_DECL if you want the vars to be static)
+ *  (use L_A_DECL if you want the vars to be static, T_A_DECL if you
+ *   want them to be static and thread-local)
  *
  *  Initialize:
  *
@@ -63,6 +64,7 @@
 
 #define A_DECL(type,name)  unsigned int name##_num; unsigned int name##_max; type *name
 #define L_A_DECL(type,name)  static unsigned int name##_num = 0; static unsigned int name##_max = 0; static type *name = NULL
+#define T_A_DECL(type,name)  static __thread unsigned int name##_num = 0; static __thread unsigned int name##_max = 0; static __thread type *name = NULL
 #define E_A_DECL(type,name)  extern unsigned int name##_num; extern unsigned int name##_max; extern type *name
 
 #define A_LEN_RAW(name)  name##_num
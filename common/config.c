@@ -22,8 +22,14 @@
  **************************************************************************
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "config.h"
 #include "hash.h"
 #include "misc.h"
@@ -85,6 +91,7 @@ static path_info_t *Path = NULL;
 L_A_DECL (char *, files_read);
 L_A_DECL (char, global_prefix);
 
+static void config_rec_env (const char *var, const char *val);
 
 /*--- expand any environment variables ---*/
 static char *create_string (const char *s)
@@ -117,6 +124,7 @@ static char *create_string (const char *s)
       }
       *tmp = '\0';
       char *env = getenv (var);
+      config_rec_env (var, env);
       if (env) {
         int i, lv, delta;
 
@@ -297,7 +305,710 @@ static config_t *newconfig(void)
   c->type = CONFIG_INT;
   return c;
 }
-  
+
+static void config_free (config_t *c)
+{
+  int i;
+
+  if (c->type == CONFIG_STR) {
+    FREE (c->u.s);
+  }
+  else if (c->type == CONFIG_TABLE_STR) {
+    for (i=0; i < c->u.t.sz; i++) {
+      FREE (c->u.t.u.s[i]);
+    }
+  }
+  if (c->type >= CONFIG_TABLE_INT && c->u.t.sz > 0) {
+    FREE (c->u.t.u.i);
+  }
+  FREE (c);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Compiled configuration cache
+ *
+ *   When a cache directory is set (config_set_cache(), or the
+ *  ACT_CONFIG_CACHE environment variable), the result of each
+ *  top-level config_read() is saved as an image with two sections:
+ *  the inputs (files read, with their size and contents hash, and the
+ *  environment variables used), followed by the list of assignments.
+ *  The next time the same file is read with the same prefix, the image
+ *  is mapped in, the inputs are checked, and the assignments are
+ *  replayed; nothing is lexed or parsed. The assignments go through
+ *  config_assign(), so values set by the program and the _tablex
+ *  extensions behave exactly as they do when the files are read.
+ *
+ *------------------------------------------------------------------------
+ */
+
+/* bump this when the image format changes */
+#define CONFIG_CACHE_VERSION 1
+
+struct config_cache_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int pad;
+  unsigned long deps;		/* length of the input section */
+  unsigned long len;		/* total payload length */
+  unsigned long sum;		/* payload checksum */
+};
+
+static const char config_cache_magic[8] = "ACTCFG";
+
+enum {
+  CREC_KEY = 'K',		/* file name, prefix */
+  CREC_FILE = 'F',		/* name, path, mtime, inode, size, hash */
+  CREC_ENV = 'E',		/* variable, value */
+  CREC_ASSIGN = 'A',		/* extend, type, name, value */
+  CREC_END = 'Z'
+};
+
+static int cache_init = 0;
+static char *cache_dir = NULL;
+
+static FILE *cache_deps = NULL;	/* inputs being recorded */
+static FILE *cache_rec = NULL;	/* assignments being recorded */
+static int cache_skip = 0;	/* recording can't be used */
+
+static unsigned long config_hash (unsigned long h, const char *s, size_t len)
+{
+  while (len > 0) {
+    h = (h ^ (unsigned char)*s) * 0x100000001b3UL;
+    s++;
+    len--;
+  }
+  return h;
+}
+
+#define CONFIG_HASH_INIT 0xcbf29ce484222325UL
+
+/* image checksum; a word at a time, since it covers the whole image */
+static unsigned long config_sum (unsigned long h, const char *s, size_t len)
+{
+  unsigned long w;
+
+  while (len >= sizeof (w)) {
+    memcpy (&w, s, sizeof (w));
+    h = (h ^ w) * 0x100000001b3UL;
+    h ^= h >> 29;
+    s += sizeof (w);
+    len -= sizeof (w);
+  }
+  return config_hash (h, s, len);
+}
+
+void config_set_cache (const char *dir)
+{
+  cache_init = 1;
+  if (cache_dir) {
+    FREE (cache_dir);
+  }
+  cache_dir = (dir && *dir) ? Strdup (dir) : NULL;
+}
+
+static char *config_get_cache (void)
+{
+  if (!cache_init) {
+    config_set_cache (getenv ("ACT_CONFIG_CACHE"));
+  }
+  return cache_dir;
+}
+
+/*-- image writer --*/
+
+static void crec_str (FILE *fp, const char *s)
+{
+  unsigned int n = s ? strlen (s) + 1 : 0;
+  fwrite (&n, sizeof (n), 1, fp);
+  if (n > 0) {
+    fwrite (s, 1, n, fp);
+  }
+}
+
+static void crec_word (FILE *fp, unsigned long v)
+{
+  fwrite (&v, sizeof (v), 1, fp);
+}
+
+static void config_rec_env (const char *var, const char *val)
+{
+  if (!cache_deps) {
+    return;
+  }
+  fputc (CREC_ENV, cache_deps);
+  crec_str (cache_deps, var);
+  crec_str (cache_deps, val);
+}
+
+static void config_rec_assign (const char *nm, config_t *c, int extend)
+{
+  int i;
+
+  if (!cache_rec) {
+    return;
+  }
+  fputc (CREC_ASSIGN, cache_rec);
+  fputc (extend, cache_rec);
+  fputc (c->type, cache_rec);
+  crec_str (cache_rec, nm);
+  switch (c->type) {
+  case CONFIG_INT:
+    fwrite (&c->u.i, sizeof (int), 1, cache_rec);
+    break;
+  case CONFIG_REAL:
+    fwrite (&c->u.r, sizeof (double), 1, cache_rec);
+    break;
+  case CONFIG_STR:
+    crec_str (cache_rec, c->u.s);
+    break;
+  default:
+    fwrite (&c->u.t.sz, sizeof (int), 1, cache_rec);
+    if (c->type == CONFIG_TABLE_INT && c->u.t.sz > 0) {
+      fwrite (c->u.t.u.i, sizeof (int), c->u.t.sz, cache_rec);
+    }
+    else if (c->type == CONFIG_TABLE_REAL && c->u.t.sz > 0) {
+      fwrite (c->u.t.u.r, sizeof (double), c->u.t.sz, cache_rec);
+    }
+    else {
+      for (i=0; i < c->u.t.sz; i++) {
+	crec_str (cache_rec, c->u.t.u.s[i]);
+      }
+    }
+    break;
+  }
+}
+
+/* hash of the contents of a file; returns 0 if it can't be read */
+static int config_hash_file (const char *path, unsigned long *sz,
+			     unsigned long *h)
+{
+  FILE *fp;
+  char buf[8192];
+  size_t n;
+
+  fp = fopen (path, "r");
+  if (!fp) {
+    return 0;
+  }
+  *sz = 0;
+  *h = CONFIG_HASH_INIT;
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0) {
+    *h = config_hash (*h, buf, n);
+    *sz += n;
+  }
+  fclose (fp);
+  return 1;
+}
+
+static char *config_resolve (const char *name)
+{
+  if (*name == '/') {
+    /* absolute path name */
+    return Strdup (name);
+  }
+  return path_open (Path, name, NULL);
+}
+
+/* canonical name of the file config_read() would open, or NULL */
+static char *config_abspath (const char *name)
+{
+  char *path, *ret;
+
+  path = config_resolve (name);
+  if (!path) {
+    return NULL;
+  }
+  ret = realpath (path, NULL);
+  FREE (path);
+  return ret;
+}
+
+static void config_rec_file (const char *name)
+{
+  unsigned long sz, h;
+  struct stat st;
+  char *path;
+
+  if (!cache_deps) {
+    return;
+  }
+  path = config_abspath (name);
+  if (!path || stat (path, &st) != 0 || !config_hash_file (path, &sz, &h)) {
+    if (path) {
+      FREE (path);
+    }
+    /* can't be checked later, so don't save the image */
+    cache_skip = 1;
+    return;
+  }
+  fputc (CREC_FILE, cache_deps);
+  crec_str (cache_deps, name);
+  crec_str (cache_deps, path);
+  /* the modification time is only trusted if it is not too recent */
+  crec_word (cache_deps,
+	     st.st_mtime + 2 > time (NULL) ? 0 : (unsigned long)st.st_mtime);
+  crec_word (cache_deps, (unsigned long)st.st_ino);
+  crec_word (cache_deps, sz);
+  crec_word (cache_deps, h);
+  FREE (path);
+}
+
+/*-- image reader --*/
+
+typedef struct {
+  const char *p, *end;
+  int err;
+} config_cursor_t;
+
+static const char *ccur_bytes (config_cursor_t *r, size_t n)
+{
+  const char *s = r->p;
+  if (r->err || (size_t)(r->end - r->p) < n) {
+    r->err = 1;
+    return NULL;
+  }
+  r->p += n;
+  return s;
+}
+
+static int ccur_tag (config_cursor_t *r)
+{
+  const char *s = ccur_bytes (r, 1);
+  return s ? *s : CREC_END;
+}
+
+static const char *ccur_str (config_cursor_t *r)
+{
+  unsigned int n;
+  const char *s;
+
+  s = ccur_bytes (r, sizeof (n));
+  if (!s) {
+    return NULL;
+  }
+  memcpy (&n, s, sizeof (n));
+  if (n == 0) {
+    return NULL;
+  }
+  s = ccur_bytes (r, n);
+  if (s && s[n-1] != '\0') {
+    r->err = 1;
+    return NULL;
+  }
+  return s;
+}
+
+static void ccur_copy (config_cursor_t *r, void *v, size_t n)
+{
+  const char *s = ccur_bytes (r, n);
+  if (s) {
+    memcpy (v, s, n);
+  }
+}
+
+static int streq (const char *a, const char *b)
+{
+  if (!a || !b) {
+    return a == b;
+  }
+  return strcmp (a, b) == 0;
+}
+
+/* read one assignment; NULL on a corrupt record */
+static config_t *ccur_assign (config_cursor_t *r, const char **nm,
+			      int *extend)
+{
+  config_t *c;
+  const char *s;
+  int i, type;
+
+  s = ccur_bytes (r, 2);
+  if (!s) {
+    return NULL;
+  }
+  *extend = s[0];
+  type = s[1];
+  *nm = ccur_str (r);
+  if (!*nm || type < CONFIG_INT || type > CONFIG_TABLE_REAL) {
+    r->err = 1;
+    return NULL;
+  }
+  c = newconfig ();
+  c->type = type;
+  switch (type) {
+  case CONFIG_INT:
+    ccur_copy (r, &c->u.i, sizeof (int));
+    break;
+  case CONFIG_REAL:
+    ccur_copy (r, &c->u.r, sizeof (double));
+    break;
+  case CONFIG_STR:
+    s = ccur_str (r);
+    c->u.s = Strdup (s ? s : "");
+    break;
+  default:
+    c->u.t.sz = 0;
+    ccur_copy (r, &c->u.t.sz, sizeof (int));
+    if (r->err || c->u.t.sz <= 0) {
+      c->u.t.sz = 0;
+      c->u.t.u.i = NULL;
+      break;
+    }
+    if (type == CONFIG_TABLE_INT) {
+      MALLOC (c->u.t.u.i, int, c->u.t.sz);
+      ccur_copy (r, c->u.t.u.i, sizeof (int)*c->u.t.sz);
+    }
+    else if (type == CONFIG_TABLE_REAL) {
+      MALLOC (c->u.t.u.r, double, c->u.t.sz);
+      ccur_copy (r, c->u.t.u.r, sizeof (double)*c->u.t.sz);
+    }
+    else {
+      MALLOC (c->u.t.u.s, char *, c->u.t.sz);
+      for (i=0; i < c->u.t.sz; i++) {
+	s = ccur_str (r);
+	c->u.t.u.s[i] = Strdup (s ? s : "");
+      }
+    }
+    break;
+  }
+  if (r->err) {
+    config_free (c);
+    return NULL;
+  }
+  return c;
+}
+
+static const char *config_prefix (void)
+{
+  return A_LEN (global_prefix) > 0 ? global_prefix : "";
+}
+
+static char *config_cache_name (const char *path)
+{
+  unsigned long key;
+  char *s;
+  int len;
+
+  key = config_hash (CONFIG_HASH_INIT, path, strlen (path) + 1);
+  key = config_hash (key, config_prefix (), strlen (config_prefix ()) + 1);
+  len = strlen (cache_dir) + 24;
+  MALLOC (s, char, len);
+  snprintf (s, len, "%s/%016lx.cfg", cache_dir, key);
+  return s;
+}
+
+static void config_assign (const char *nm, config_t *c, int extend);
+
+/*
+ * Check that the input section is for this file and prefix, and that
+ * none of the inputs have changed. "top" is the resolved file name.
+ */
+static int config_cache_check (config_cursor_t r, const char *name,
+			       const char *top)
+{
+  const char *s, *t;
+  char *path;
+  unsigned long sz, h;
+  unsigned long rtm = 0, rino = 0, rsz = 0, rh = 0;
+  struct stat st;
+  int ok;
+
+  if (ccur_tag (&r) != CREC_KEY) {
+    return 0;
+  }
+  s = ccur_str (&r);
+  t = ccur_str (&r);
+  if (r.err || !streq (s, name) || !streq (t ? t : "", config_prefix ())) {
+    return 0;
+  }
+  while (!r.err) {
+    switch (ccur_tag (&r)) {
+    case CREC_FILE:
+      s = ccur_str (&r);
+      t = ccur_str (&r);
+      ccur_copy (&r, &rtm, sizeof (rtm));
+      ccur_copy (&r, &rino, sizeof (rino));
+      ccur_copy (&r, &rsz, sizeof (rsz));
+      ccur_copy (&r, &rh, sizeof (rh));
+      if (r.err || !s || !t) {
+	return 0;
+      }
+      path = (strcmp (s, name) == 0) ? Strdup (top) : config_abspath (s);
+      if (!path || strcmp (path, t) != 0 || stat (path, &st) != 0 ||
+	  (unsigned long) st.st_size != rsz) {
+	ok = 0;
+      }
+      else if (rtm != 0 && (unsigned long) st.st_mtime == rtm &&
+	       (unsigned long) st.st_ino == rino) {
+	ok = 1;
+      }
+      else {
+	/* touched, or recorded too soon after it was written */
+	ok = (config_hash_file (path, &sz, &h) && sz == rsz && h == rh);
+      }
+      if (path) {
+	FREE (path);
+      }
+      if (!ok) {
+	return 0;
+      }
+      break;
+
+    case CREC_ENV:
+      s = ccur_str (&r);
+      t = ccur_str (&r);
+      if (r.err || !s || !streq (getenv (s), t)) {
+	return 0;
+      }
+      break;
+
+    case CREC_END:
+      return !r.err;
+
+    default:
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Replay a checked image. Returns 0 if the assignments are corrupt;
+ * since each one is checked before it is applied, that can only
+ * happen before the first assignment.
+ */
+static int config_cache_apply (config_cursor_t deps, config_cursor_t r)
+{
+  const char *s, *t;
+  int extend;
+  config_t *c;
+
+  while (!r.err) {
+    switch (ccur_tag (&r)) {
+    case CREC_ASSIGN:
+      c = ccur_assign (&r, &s, &extend);
+      if (!c) {
+	return 0;
+      }
+      config_assign (s, c, extend);
+      break;
+
+    case CREC_END:
+      /* repeat any warnings from reading the file */
+      while (!deps.err) {
+	switch (ccur_tag (&deps)) {
+	case CREC_KEY:
+	  ccur_str (&deps);
+	  ccur_str (&deps);
+	  break;
+	case CREC_FILE:
+	  ccur_str (&deps);
+	  ccur_str (&deps);
+	  ccur_bytes (&deps, 4*sizeof (unsigned long));
+	  break;
+	case CREC_ENV:
+	  s = ccur_str (&deps);
+	  t = ccur_str (&deps);
+	  if (!t) {
+	    warning ("Undefined environment variable `%s'", s);
+	  }
+	  break;
+	default:
+	  return 1;
+	}
+      }
+      return 1;
+
+    default:
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/* returns 1 if the configuration was loaded from the cache */
+static int config_cache_load (const char *name)
+{
+  struct config_cache_header h;
+  struct stat st;
+  config_cursor_t deps, r;
+  char *path, *cname;
+  const char *start;
+  void *img;
+  int fd, ok;
+
+  path = config_abspath (name);
+  if (!path) {
+    return 0;
+  }
+  cname = config_cache_name (path);
+  fd = open (cname, O_RDONLY);
+  FREE (cname);
+  if (fd < 0) {
+    FREE (path);
+    return 0;
+  }
+  if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (h)) {
+    close (fd);
+    FREE (path);
+    return 0;
+  }
+  img = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (img == MAP_FAILED) {
+    FREE (path);
+    return 0;
+  }
+
+  memcpy (&h, img, sizeof (h));
+  start = (const char *)img + sizeof (h);
+  ok = (memcmp (h.magic, config_cache_magic, sizeof (h.magic)) == 0 &&
+	h.version == CONFIG_CACHE_VERSION &&
+	h.len == (unsigned long)(st.st_size - sizeof (h)) &&
+	h.deps <= h.len &&
+	config_sum (CONFIG_HASH_INIT, start, h.len) == h.sum);
+  if (ok) {
+    deps.p = start;
+    deps.end = start + h.deps;
+    deps.err = 0;
+    r.p = deps.end;
+    r.end = start + h.len;
+    r.err = 0;
+    ok = config_cache_check (deps, name, path);
+  }
+  if (ok) {
+    if (!H) {
+      H = hash_new (8);
+    }
+    ok = config_cache_apply (deps, r);
+  }
+  munmap (img, st.st_size);
+  FREE (path);
+  return ok;
+}
+
+/* buf holds the input section (deps bytes), then the assignments */
+static void config_cache_save (const char *name, char *buf, size_t deps,
+			       size_t len)
+{
+  struct config_cache_header h;
+  char *path, *cname, *tmp;
+  FILE *fp;
+  int fd;
+
+  path = config_abspath (name);
+  if (!path) {
+    return;
+  }
+  cname = config_cache_name (path);
+  FREE (path);
+
+  mkdir (cache_dir, 0777);
+
+  memset (&h, 0, sizeof (h));
+  memcpy (h.magic, config_cache_magic, sizeof (h.magic));
+  h.version = CONFIG_CACHE_VERSION;
+  h.deps = deps;
+  h.len = len;
+  h.sum = config_sum (CONFIG_HASH_INIT, buf, len);
+
+  /* write to a temporary and rename, so readers never see a partial
+     image */
+  MALLOC (tmp, char, strlen (cname) + 8);
+  sprintf (tmp, "%s.XXXXXX", cname);
+  fd = mkstemp (tmp);
+  if (fd >= 0) {
+    fp = fdopen (fd, "w");
+    if (fp && fwrite (&h, sizeof (h), 1, fp) == 1 &&
+	fwrite (buf, 1, len, fp) == len && fclose (fp) == 0) {
+      chmod (tmp, 0644);
+      if (rename (tmp, cname) != 0) {
+	unlink (tmp);
+      }
+    }
+    else {
+      if (fp) {
+	fclose (fp);
+      }
+      else {
+	close (fd);
+      }
+      unlink (tmp);
+    }
+  }
+  FREE (tmp);
+  FREE (cname);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  config_assign --
+ *
+ *   Assign a value read from a configuration file. Scalars set by the
+ *   program are not overridden; tables are replaced, or extended if
+ *   "extend" is set. Takes ownership of "c".
+ *
+ *------------------------------------------------------------------------
+ */
+static void config_assign (const char *nm, config_t *c, int extend)
+{
+  hash_bucket_t *b;
+  config_t *old;
+  int sz;
+
+  config_rec_assign (nm, c, extend);
+
+  b = hash_lookup (H, nm);
+  if (!b) {
+    b = hash_add (H, nm);
+    b->v = c;
+    return;
+  }
+  old = (config_t *) b->v;
+  Assert (old->type == c->type, "Switching types!?");
+
+  if (c->type < CONFIG_TABLE_INT) {
+    if (old->set) {
+      config_free (c);
+    }
+    else {
+      config_free (old);
+      b->v = c;
+    }
+  }
+  else if (!extend || old->u.t.sz == 0) {
+    config_free (old);
+    b->v = c;
+  }
+  else {
+    if (c->u.t.sz > 0) {
+      sz = old->u.t.sz + c->u.t.sz;
+      if (c->type == CONFIG_TABLE_INT) {
+	REALLOC (old->u.t.u.i, int, sz);
+	memcpy (old->u.t.u.i + old->u.t.sz, c->u.t.u.i,
+		sizeof (int)*c->u.t.sz);
+      }
+      else if (c->type == CONFIG_TABLE_REAL) {
+	REALLOC (old->u.t.u.r, double, sz);
+	memcpy (old->u.t.u.r + old->u.t.sz, c->u.t.u.r,
+		sizeof (double)*c->u.t.sz);
+      }
+      else {
+	REALLOC (old->u.t.u.s, char *, sz);
+	memcpy (old->u.t.u.s + old->u.t.sz, c->u.t.u.s,
+		sizeof (char *)*c->u.t.sz);
+      }
+      old->u.t.sz = sz;
+      /* the strings now belong to old */
+      FREE (c->u.t.u.i);
+    }
+    FREE (c);
+  }
+}
+
 
 /*------------------------------------------------------------------------
  *
@@ -307,24 +1018,124 @@ static config_t *newconfig(void)
  *
  *------------------------------------------------------------------------
  */
+static int read_level = 0;
+
+static void _config_read (const char *name);
+
 void config_read (const char *name)
+{
+  char *dbuf, *buf;
+  size_t dlen, len;
+  long deps;
+
+  if (read_level > 0 || !config_get_cache ()) {
+    _config_read (name);
+    return;
+  }
+  if (!Path) {
+    Path = path_init ();
+    path_add (Path, ".");
+  }
+  if (config_cache_load (name)) {
+    return;
+  }
+
+  dbuf = buf = NULL;
+  dlen = len = 0;
+  cache_deps = open_memstream (&dbuf, &dlen);
+  cache_rec = open_memstream (&buf, &len);
+  cache_skip = 0;
+  if (cache_deps && cache_rec) {
+    fputc (CREC_KEY, cache_deps);
+    crec_str (cache_deps, name);
+    crec_str (cache_deps, config_prefix ());
+    _config_read (name);
+    fputc (CREC_END, cache_deps);
+    fputc (CREC_END, cache_rec);
+    fclose (cache_rec);
+    deps = ftell (cache_deps);
+    fwrite (buf, 1, len, cache_deps);
+    fclose (cache_deps);
+    cache_deps = cache_rec = NULL;
+    if (!cache_skip) {
+      config_cache_save (name, dbuf, deps, dlen);
+    }
+  }
+  else {
+    if (cache_deps) {
+      fclose (cache_deps);
+    }
+    if (cache_rec) {
+      fclose (cache_rec);
+    }
+    cache_deps = cache_rec = NULL;
+    _config_read (name);
+  }
+  free (dbuf);
+  free (buf);
+}
+
+/* a string table, from the rest of the line */
+static void config_read_strings (config_t *c, const char *name, int line,
+				 char *buf2)
+{
+  char *s;
+  A_DECL (char *, x);
+
+  A_INIT (x);
+  x = NULL;
+
+  s = strtok (NULL, " \t\r");
+  if (!s) fatal_error ("Invalid format [%s:%d]", name, line);
+
+  do {
+    if (s[0] != '"') {
+      fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
+    }
+    strcpy (buf2, s);
+
+    while (s && buf2[strlen(buf2)-1] != '"') {
+      s = strtok (NULL, " \t\r");
+      if (s) {
+	strcat (buf2, " ");
+	strcat (buf2, s);
+      }
+    }
+    if (!s) {
+      fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
+    }
+
+    buf2[strlen(buf2)-1] = '\0';
+
+    A_APPEND (x, char *, create_string (buf2+1));
+
+    s = strtok (NULL, " \t\r");
+
+    if (s && s[0] == '#') break;  /* comment */
+
+  } while (s);
+
+  c->u.t.sz = A_LEN (x);
+  c->u.t.u.s = x;
+}
+
+static void _config_read (const char *name)
 {
   FILE *fp;
   char *buf;
   char buf2[10240];
   char buf3[10240];
   char *s;
-  hash_bucket_t *b;
   config_t *c;
   int line = 0;
-  static int level = 0;
   int i;
   char *prefix = NULL;
   int prefix_len = 0;
   int initial_phase = 1;
   int buf_sz = 10240;
+  char *tmpname;
 
-  if (level == 0) {
+  if (read_level == 0) {
     A_INIT (files_read);
   }
 
@@ -338,27 +1149,20 @@ void config_read (const char *name)
   A_NEXT (files_read) = Strdup (name);
   A_INC (files_read);
 
-  level++;
+  read_level++;
 
   if (!Path) {
     Path = path_init ();
     path_add (Path, ".");
   }
 
-  fp = NULL;
-  if (*name == '/') {
-    /* absolute path name */
-    fp = fopen (name, "r");
-  }
-  else {
-    char *tmpname;
-    tmpname = path_open (Path, name, NULL);
-    fp = fopen (tmpname, "r");
-    FREE (tmpname);
-  }
+  tmpname = config_resolve (name);
+  fp = fopen (tmpname, "r");
   if (!fp) {
     fatal_error ("Could not open configuration file `%s' for reading.", name);
   }
+  config_rec_file (name);
+  FREE (tmpname);
 
   if (!H) {
     H = hash_new (8);
@@ -422,7 +1226,7 @@ void config_read (const char *name)
       }
       goto extend_buf;
     }
-    
+
     if (buf[0] == '#' || buf[0] == '\0') continue;
     s = strtok (buf, " \t\r");
     if (!s || !*s || s[0] == '#') continue;
@@ -438,41 +1242,20 @@ void config_read (const char *name)
       }
       s[strlen(s)-1] = '\0';
       tmps = create_string (s+1);
-      config_read (tmps);
+      _config_read (tmps);
       FREE (tmps);
     }
     else if (strcmp (s, "int") == 0) {
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	config_t *tmp;
-	Assert (((config_t*)b->v)->type == CONFIG_INT, "Switching types!?");
-	tmp = (config_t *)b->v;
-	if (tmp->set) continue;
-	FREE (b->v);
-      }
       c = newconfig ();
       c->type = CONFIG_INT;
       s = strtok (NULL, " \t\r");
       if (!s) fatal_error ("Invalid format [%s:%d]", name, line);
       sscanf (s, "%d", &c->u.i);
-      b->v = c;
+      config_assign (buf3, c, 0);
     }
     else if (strcmp (s, "string") == 0) {
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	config_t *tmp;
-	Assert (((config_t*)b->v)->type == CONFIG_STR, "Switching types!?");
-	tmp = (config_t *)b->v;
-	if (tmp->set) continue;
-	FREE (((config_t*)b->v)->u.s);
-	FREE (b->v);
-      }
       c = newconfig ();
       c->type = CONFIG_STR;
 
@@ -497,92 +1280,28 @@ void config_read (const char *name)
       }
       buf2[strlen(buf2)-1] = '\0';
       c->u.s = create_string (buf2+1);
-      b->v = c;
+      config_assign (buf3, c, 0);
     }
     else if  (strcmp (s, "real") == 0) {
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	config_t *tmp;
-	Assert (((config_t*)b->v)->type == CONFIG_REAL, "Switching types!?");
-	tmp = (config_t *)b->v;
-	if (tmp->set) continue;
-	FREE (b->v);
-      }
       c = newconfig ();
       c->type = CONFIG_REAL;
       s = strtok (NULL, " \t\r");
       if (!s) fatal_error ("Invalid format [%s:%d]", name, line);
       sscanf (s, "%lg", &c->u.r);
-      b->v = c;
+      config_assign (buf3, c, 0);
     }
-    else if (strcmp (s, "int_table") == 0) {
+    else if (strcmp (s, "int_table") == 0 ||
+	     strcmp (s, "int_tablex") == 0) {
+      int extend = (s[9] == 'x');
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_INT, "Switching types!?");
-	c = (config_t *)b->v;
-	if (c->u.t.sz > 0) {
-	  FREE (c->u.t.u.i);
-	}
-	FREE (b->v);
-      }
       c = newconfig ();
-      b->v = c;
       c->type = CONFIG_TABLE_INT;
-      {
-	A_DECL (int, x);
-	A_INIT (x);
-	
-	/* read in a space-separated list of integers */
-	s = strtok (NULL, " \t\r");
-	while (s && s[0] != '#') {
-	  /* accumulate s in the table */
-	  A_NEWM (x,int);
-	  sscanf (s, "%d", &A_NEXT (x));
-	  A_INC (x);
-	  s = strtok (NULL, " \t\r");
-	}
-	c->u.t.sz = A_LEN (x);
-	c->u.t.u.i = x;
-      }
-    }
-    else if (strcmp (s, "int_tablex") == 0) {
-      GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-	b->v = NULL;
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_INT, "Switching types!?");
-      }
-      if (b->v) {
-	c = (config_t *) b->v;
-      }
-      else {
-	c = newconfig ();
-	b->v = c;
-	c->type = CONFIG_TABLE_INT;
-	c->u.t.sz = 0;
-	c->u.t.u.i = NULL;
-      }
       {
 	A_DECL (int, x);
 	A_INIT (x);
 	x = NULL;
-	if (c->u.t.sz > 0) {
-	  int i;
-	  A_NEWP (x, int, c->u.t.sz);
-	  for (i=0; i < c->u.t.sz; i++) {
-	    A_NEWM (x, int);
-	    A_NEXT (x) = c->u.t.u.i[i];
-	    A_INC (x);
-	  }
-	}
+
 	/* read in a space-separated list of integers */
 	s = strtok (NULL, " \t\r");
 	while (s && s[0] != '#') {
@@ -592,80 +1311,23 @@ void config_read (const char *name)
 	  A_INC (x);
 	  s = strtok (NULL, " \t\r");
 	}
-	if (c->u.t.sz > 0) {
-	  FREE (c->u.t.u.i);
-	}
 	c->u.t.sz = A_LEN (x);
 	c->u.t.u.i = x;
       }
+      config_assign (buf3, c, extend);
     }
-    else if (strcmp (s, "real_table") == 0) {
+    else if (strcmp (s, "real_table") == 0 ||
+	     strcmp (s, "real_tablex") == 0) {
+      int extend = (s[10] == 'x');
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_REAL, "Switching types!?");
-	c = (config_t *)b->v;
-	if (c->u.t.sz > 0) {
-	  FREE (c->u.t.u.r);
-	}
-	FREE (b->v);
-      }
       c = newconfig ();
-      b->v = c;
       c->type = CONFIG_TABLE_REAL;
-      {
-	A_DECL (double, x);
-	A_INIT (x);
-	
-      /* read in a space-separated list of integers */
-	s = strtok (NULL, " \t\r");
-	while (s && s[0] != '#') {
-	  /* accumulate s in the table */
-	  A_NEWM (x,double);
-	  sscanf (s, "%lg", &A_NEXT (x));
-	  A_INC (x);
-	  s = strtok (NULL, " \t\r");
-	}
-	c->u.t.sz = A_LEN (x);
-	c->u.t.u.r = x;
-      }
-    }
-    else if (strcmp (s, "real_tablex") == 0) {
-      GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-	b->v = NULL;
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_REAL, "Switching types!?");
-      }
-      if (b->v) {
-	c = (config_t *)b->v;
-      }
-      else {
-	c = newconfig ();
-	b->v = c;
-	c->type = CONFIG_TABLE_REAL;
-	c->u.t.sz = 0;
-	c->u.t.u.r = NULL;
-      }
       {
 	A_DECL (double, x);
 	A_INIT (x);
 	x = NULL;
-	
-	if (c->u.t.sz > 0) {
-	  int i;
-	  A_NEWP (x, double, c->u.t.sz);
-	  for (i=0; i < c->u.t.sz; i++) {
-	    A_NEWM (x, double);
-	    A_NEXT (x) = c->u.t.u.r[i];
-	    A_INC (x);
-	  }
-	}
-	/* read in a space-separated list of integers */
+
+	/* read in a space-separated list of reals */
 	s = strtok (NULL, " \t\r");
 	while (s && s[0] != '#') {
 	  /* accumulate s in the table */
@@ -674,141 +1336,19 @@ void config_read (const char *name)
 	  A_INC (x);
 	  s = strtok (NULL, " \t\r");
 	}
-	if (c->u.t.sz > 0) {
-	  FREE (c->u.t.u.r);
-	}
 	c->u.t.sz = A_LEN (x);
 	c->u.t.u.r = x;
       }
+      config_assign (buf3, c, extend);
     }
-    else if (strcmp (s, "string_table") == 0) {
+    else if (strcmp (s, "string_table") == 0 ||
+	     strcmp (s, "string_tablex") == 0) {
+      int extend = (s[12] == 'x');
       GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_STR, "Switching types!?");
-	c = (config_t *)b->v;
-	if (c->u.t.sz > 0) {
-	  int i;
-	  for (i=0; i < c->u.t.sz; i++) {
-	    FREE (c->u.t.u.s[i]);
-	  }
-	  FREE (c->u.t.u.s);
-	}
-	FREE (b->v);
-      }
       c = newconfig ();
-      b->v = c;
       c->type = CONFIG_TABLE_STR;
-      {
-	A_DECL (char *, x);
-	A_INIT (x);
-	
-      /* read in a space-separated list of integers */
-	s = strtok (NULL, " \t\r");
-	if (!s) fatal_error ("Invalid format [%s:%d]", name, line);
-
-	do {
-	  if (s[0] != '"') {
-	    fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
-	  }
-	  strcpy (buf2, s);
-
-	  while (s && buf2[strlen(buf2)-1] != '"') {
-	    s = strtok (NULL, " \t\r");
-	    if (s) {
-	      strcat (buf2, " ");
-	      strcat (buf2, s);
-	    }
-	  }
-	  if (!s) {
-	    fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
-	  }
-
-	  buf2[strlen(buf2)-1] = '\0';
-
-	  A_APPEND (x, char *, create_string (buf2+1));
-
-	  s = strtok (NULL, " \t\r");
-
-	  if (s && s[0] == '#') break;  /* comment */
-
-	} while (s);
-
-	c->u.t.sz = A_LEN (x);
-	c->u.t.u.s = x;
-      }
-    }
-    else if (strcmp (s, "string_tablex") == 0) {
-      GET_NAME;
-      if (!(b = hash_lookup (H, buf3))) {
-	b = hash_add (H, buf3);
-	b->v = NULL;
-      }
-      else {
-	Assert (((config_t*)b->v)->type == CONFIG_TABLE_STR, "Switching types!?");
-      }
-      if (b->v) {
-	c = (config_t *)b->v;
-      }
-      else {
-	c = newconfig ();
-	b->v = c;
-	c->type = CONFIG_TABLE_STR;
-	c->u.t.sz = 0;
-	c->u.t.u.s = NULL;
-      }
-      {
-	A_DECL (char *, x);
-	A_INIT (x);
-	x = NULL;
-
-	if (c->u.t.sz > 0) {
-	  int i;
-	  A_NEWP (x, char *, c->u.t.sz);
-	  for (i=0; i < c->u.t.sz; i++) {
-	    A_NEWM (x, char *);
-	    A_NEXT (x) = c->u.t.u.s[i];
-	    A_INC (x);
-	  }
-	}
-	/* read in a space-separated list of integers */
-	s = strtok (NULL, " \t\r");
-	if (!s) fatal_error ("Invalid format [%s:%d]", name, line);
-
-	do {
-	  if (s[0] != '"') {
-	    fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
-	  }
-	  strcpy (buf2, s);
-
-	  while (s && buf2[strlen(buf2)-1] != '"') {
-	    s = strtok (NULL, " \t\r");
-	    if (s) {
-	      strcat (buf2, " ");
-	      strcat (buf2, s);
-	    }
-	  }
-	  if (!s) {
-	    fatal_error ("String on [%s:%d] needs to be of the form \"...\"", name, line);
-	  }
-
-	  buf2[strlen(buf2)-1] = '\0';
-
-	  A_APPEND (x, char *, create_string (buf2+1));
-
-	  s = strtok (NULL, " \t\r");
-
-	  if (s && s[0] == '#') break;  /* comment */
-
-	} while (s);
-	if (c->u.t.sz > 0) {
-	  FREE (c->u.t.u.s);
-	}
-	c->u.t.sz = A_LEN (x);
-	c->u.t.u.s = x;
-      }
+      config_read_strings (c, name, line, buf2);
+      config_assign (buf3, c, extend);
     } else if (strcmp (s, "begin") == 0) {
       initial_phase = 0;
       RAW_GET_NEXT;
@@ -826,7 +1366,7 @@ void config_read (const char *name)
 	fatal_error ("end found without matching begin [%s:%d]\n", name, line);
       }
       x--;
-      while (x >= 0 && prefix[x] != '.') 
+      while (x >= 0 && prefix[x] != '.')
 	x--;
       x++;
       prefix[x] = '\0';
@@ -836,9 +1376,9 @@ void config_read (const char *name)
     }
   }
   fclose (fp);
-  level--;
+  read_level--;
 
-  if (level == 0) {
+  if (read_level == 0) {
     for (i=0; i < A_LEN (files_read); i++) {
       FREE (files_read[i]);
     }
@@ -1209,11 +1749,11 @@ int config_exists (const char *s)
  *
  *   Returns type (-1 if it doesn't exist)
  *     0 = int
- *     1 = real
- *     2 = string
+ *     1 = string
+ *     2 = real
  *     3 = int table
- *     4 = real table
- *     5 = string table
+ *     4 = string table
+ *     5 = real table
  *    -1 = no such variable
  *
  *------------------------------------------------------------------------
@@ -56,6 +56,10 @@ void config_stdtech_path (const char *tech);
 /* read configuration file */
 void config_read (const char *s);
 
+/* directory for compiled configuration files (NULL to disable); the
+   default is $ACT_CONFIG_CACHE, if set */
+void config_set_cache (const char *dir);
+
 /* set prefix for the configuration */
 void config_push_prefix (const char *s);
 void config_pop_prefix (void);
@@ -87,7 +91,7 @@ void config_clear (void);
 
 /* check if variable exists */
 int config_exists (const char *s);
-int config_gettype (const char *s);   /* 0 : int, 1 : real, 2 : string, 3 + ... = table */
+int config_gettype (const char *s);   /* 0 : int, 1 : string, 2 : real, 3 + ... = table */
 					 
 
 /* dump config table to file */
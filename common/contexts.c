@@ -23,7 +23,9 @@
  */
 #include <stdio.h>
 #include <signal.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include "contexts.h"
 
 struct process_record {
@@ -31,13 +33,13 @@ struct process_record {
 };
 
 /* current process */
-process_t *current_process = NULL;
+__thread process_t *current_process = NULL;
 static process_t *terminated_process = NULL;
 
 #ifdef FAIR
 
 static struct itimerval mt;	/* the timer for the main thread */
-static int unfair = 0;
+static int unfair = 1;		/* cooperative until context_fair() */
 static int enable_mask;
 static int disable_mask;
 
@@ -208,6 +210,105 @@ void context_disable (void)
 #endif
 
  
+#ifdef CONTEXT_FAST_SWITCH
+/*------------------------------------------------------------------------
+ *
+ *  _context_swap (void **save_sp, void *sp) --
+ *
+ *     Push the callee-saved registers on the current stack, save the
+ *     stack pointer in *save_sp, switch to stack "sp", and pop the
+ *     registers saved there. The frame layout must match
+ *     context_init().
+ *
+ *------------------------------------------------------------------------
+ */
+#if defined(__APPLE__)
+#define CTX_SYM "__context_swap"
+#define CTX_TYPE ""
+#else
+#define CTX_SYM "_context_swap"
+#define CTX_TYPE ".type _context_swap,@function\n"
+#endif
+
+#if defined(__x86_64__)
+
+/* frame: mxcsr/x87 cw, r15, r14, r13, r12, rbx, rbp, return address */
+#define CTX_FRAME_WORDS 8
+
+__asm__ (
+  ".text\n"
+  ".globl " CTX_SYM "\n"
+  CTX_TYPE
+  ".p2align 4\n"
+  CTX_SYM ":\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+);
+
+#elif defined(__aarch64__)
+
+/* frame: x19-x28, x29 (fp), x30 (lr), d8-d15 */
+#define CTX_FRAME_WORDS 20
+
+__asm__ (
+  ".text\n"
+  ".globl " CTX_SYM "\n"
+  CTX_TYPE
+  ".p2align 4\n"
+  CTX_SYM ":\n"
+  "  sub sp, sp, #160\n"
+  "  stp x19, x20, [sp, #0]\n"
+  "  stp x21, x22, [sp, #16]\n"
+  "  stp x23, x24, [sp, #32]\n"
+  "  stp x25, x26, [sp, #48]\n"
+  "  stp x27, x28, [sp, #64]\n"
+  "  stp x29, x30, [sp, #80]\n"
+  "  stp d8, d9, [sp, #96]\n"
+  "  stp d10, d11, [sp, #112]\n"
+  "  stp d12, d13, [sp, #128]\n"
+  "  stp d14, d15, [sp, #144]\n"
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  mov sp, x1\n"
+  "  ldp x19, x20, [sp, #0]\n"
+  "  ldp x21, x22, [sp, #16]\n"
+  "  ldp x23, x24, [sp, #32]\n"
+  "  ldp x25, x26, [sp, #48]\n"
+  "  ldp x27, x28, [sp, #64]\n"
+  "  ldp x29, x30, [sp, #80]\n"
+  "  ldp d8, d9, [sp, #96]\n"
+  "  ldp d10, d11, [sp, #112]\n"
+  "  ldp d12, d13, [sp, #128]\n"
+  "  ldp d14, d15, [sp, #144]\n"
+  "  add sp, sp, #160\n"
+  "  ret\n"
+);
+
+#endif
+
+static void *main_sp;		/* saved state of the main thread */
+
+#endif /* CONTEXT_FAST_SWITCH */
+
 /*------------------------------------------------------------------------
  *
  * Called with interrupts disabled. Enables interrupts on termination.
@@ -216,10 +317,19 @@ void context_disable (void)
  */
 void context_switch (process_t *p)
 {
+#ifdef CONTEXT_FAST_SWITCH
+  process_t *prev = current_process;
+
+  if (prev != p) {
+    current_process = p;
+    _context_swap (prev ? &prev->c.sp : &main_sp, p->c.sp);
+  }
+#else
   if (!current_process || !_setjmp (current_process->c.buf)) {
     current_process = p;
     _longjmp (p->c.buf,1);
   }
+#endif
   if (terminated_process) {
     context_destroy (terminated_process);
     terminated_process = NULL;
@@ -286,7 +396,7 @@ void context_exit (void)
 /*
  * Crazy Ubuntu jmpbuf encoder/decoder functions
  */
-
+#if defined(__i386__)
 int
 DecodeJMPBUF(int j) 
 {
@@ -314,8 +424,9 @@ EncodeJMPBUF(int j)
 
    return retVal;
 }
+#endif
 
-#if defined(__x86_64__)
+#if defined(__x86_64__) && !defined(CONTEXT_FAST_SWITCH)
 unsigned long long EncodeJBRHEL(unsigned long long j)
 {
   unsigned long long ret;
@@ -357,7 +468,9 @@ void context_init (process_t *p, void (*f)(void))
   stack = p->c.stack;
   n = p->c.sz;
 
+#if !defined(CONTEXT_FAST_SWITCH)
   _setjmp (p->c.buf);
+#endif
 
 #if 0
   printf ("%llx context_init, %llx stack\n", (unsigned long long)context_init, 
@@ -375,7 +488,36 @@ void context_init (process_t *p, void (*f)(void))
   p->c.interrupted = 0;
 #endif
 
-#if defined(__sparc__) && !defined(__svr4__)
+#if defined(CONTEXT_FAST_SWITCH)
+
+#define INIT_SP(p) (unsigned long)((char*)(p)->c.stack + (p)->c.sz)
+#define CURR_SP(p) (unsigned long)(p)->c.sp
+#define SET_CURR_SP(p,v) ((p)->c.sp = (void *)(v))
+
+  {
+    /* build the frame _context_swap() pops, returning into the stub */
+    unsigned long *top, *frame;
+
+    top = (unsigned long *)(((unsigned long)stack + n) & ~15UL);
+#if defined(__x86_64__)
+    /* return address slot is 16-byte aligned, as if called */
+    frame = top - 2 - (CTX_FRAME_WORDS - 1);
+    for (i=0; i < CTX_FRAME_WORDS + 1; i++) {
+      frame[i] = 0;
+    }
+    frame[0] = 0x037f00001f80UL;	/* default mxcsr, x87 cw */
+    frame[CTX_FRAME_WORDS-1] = (unsigned long)context_stub;
+#else
+    frame = top - CTX_FRAME_WORDS;
+    for (i=0; i < CTX_FRAME_WORDS; i++) {
+      frame[i] = 0;
+    }
+    frame[11] = (unsigned long)context_stub; /* x30 */
+#endif
+    p->c.sp = frame;
+  }
+
+#elif defined(__sparc__) && !defined(__svr4__)
 
 #define INIT_SP(p) (int)((double*)(p)->c.stack + (p)->c.sz/sizeof(double)-11)
 #define CURR_SP(p) (p)->c.buf[2]
@@ -663,3 +805,63 @@ void context_read (FILE *fp, process_t *p)
   fscanf (fp, "%d%d%d\n", &p->c.in_cs, &p->c.pending, &p->c.interrupted);
 #endif
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Stack allocation
+ *
+ *------------------------------------------------------------------------
+ */
+static char *stack_pool = NULL;	/* free DEFAULT_STACK_SIZE stacks */
+
+static long context_pagesize (void)
+{
+  static long pg = 0;
+  if (pg == 0) {
+    pg = sysconf (_SC_PAGESIZE);
+    if (pg <= 0) {
+      pg = 4096;
+    }
+  }
+  return pg;
+}
+
+char *context_stack_alloc (int sz)
+{
+  long pg = context_pagesize ();
+  long len;
+  char *m;
+
+  if (sz == DEFAULT_STACK_SIZE && stack_pool) {
+    m = stack_pool;
+    stack_pool = *((char **)m);
+    return m;
+  }
+  len = ((sz + pg - 1)/pg)*pg;
+  m = (char *) mmap (NULL, len + pg, PROT_READ|PROT_WRITE,
+		     MAP_PRIVATE|MAP_ANON, -1, 0);
+  if (m == (char *)MAP_FAILED) {
+    return NULL;
+  }
+  /* guard page below the stack */
+  if (mprotect (m, pg, PROT_NONE) != 0) {
+    munmap (m, len + pg);
+    return NULL;
+  }
+  return m + pg + (len - sz);
+}
+
+void context_stack_free (char *stack, int sz)
+{
+  long pg = context_pagesize ();
+  long len;
+
+  if (sz == DEFAULT_STACK_SIZE) {
+    *((char **)stack) = stack_pool;
+    stack_pool = stack;
+    return;
+  }
+  len = ((sz + pg - 1)/pg)*pg;
+  munmap (stack - (len - sz) - pg, len + pg);
+}
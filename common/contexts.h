@@ -38,6 +38,14 @@
 #define LARGE_STACK_SIZE (0x1000 * 16)
 #endif
 
+/*
+ * Architectures with a native register-save context switch; the
+ * others use setjmp/longjmp with a patched jmp_buf.
+ */
+#if defined(__x86_64__) || defined(__aarch64__)
+#define CONTEXT_FAST_SWITCH
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -68,6 +76,9 @@ typedef struct process_record process_t;
  */
 typedef struct {
   jmp_buf buf;			/* state  */
+  void *sp;			/* saved stack pointer, with the
+				   registers pushed on the stack
+				   (CONTEXT_FAST_SWITCH) */
   char *stack;			/* stack  */
   int sz;			/* stack size */
   void (*start) ();		/* entry point */
@@ -81,9 +92,19 @@ typedef struct {
 
 /*
  * At any given instant, "current_process" points to the process record
- * for the currently executing thread of control.
+ * for the currently executing thread of control. It is per OS thread,
+ * since the M:N scheduler in thread.c runs processes on several OS
+ * threads.
  */
-extern process_t *current_process;
+extern __thread process_t *current_process;
+
+#ifdef CONTEXT_FAST_SWITCH
+/*
+ * Save the current context's registers and stack pointer in *save_sp,
+ * and resume the context saved in sp.
+ */
+extern void _context_swap (void **save_sp, void *sp);
+#endif
 
 
 /*
@@ -141,15 +162,24 @@ extern void context_init (process_t *, void (*f)(void));
 
 
 /*
- * Unfair scheduling
+ * Unfair scheduling: no timer interrupts. This is the default.
  */
 extern void context_unfair (void);
 
 /*
- * Fair scheduling: can be used to undo the first unfair call
+ * Fair scheduling: turn on time slicing using a virtual timer
+ * (only when compiled with FAIR).
  */
 extern void context_fair (void);
 
+/*
+ * Allocate/free a stack of sz bytes. Stacks have an inaccessible
+ * guard page below them, and stacks of DEFAULT_STACK_SIZE are kept
+ * in a pool for reuse.
+ */
+extern char *context_stack_alloc (int sz);
+extern void context_stack_free (char *stack, int sz);
+
 /*
  *  Exit
  */
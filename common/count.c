@@ -41,6 +41,7 @@ countw_t *count_new (int init_val)
   c->cnt = init_val;
   c->hd = NULL;
   c->tl = NULL;
+  c->lk = 0;
   
   context_enable ();
   return c;
@@ -70,13 +71,18 @@ void _count_free (countw_t *c, char *file, int line)
  */
 void count_await (countw_t *c, unsigned int val)
 {
+  lthread_t *t;
+
   context_disable ();
+  thread_lock (&c->lk);
   if (c->cnt < val) {
-    current_process->cdata1 = (void*)(long)val;
-    q_ins (c->hd, c->tl, current_process);
-    context_switch (context_select ());
+    t = lthread_self;
+    t->cdata1 = (void*)(long)val;
+    q_ins (c->hd, c->tl, t);
+    thread_suspend (&c->lk);
   }
   else {
+    thread_unlock (&c->lk);
     context_enable ();
   }
 }
@@ -84,29 +90,38 @@ void count_await (countw_t *c, unsigned int val)
 /* increment counter */
 void count_increment (countw_t *c, unsigned int amount)
 {
-  extern lthread_t *readyQh;
-  extern lthread_t *readyQt;
+  lthread_t *t, *prev, *next, *wake, *wake_tl;
 
   context_disable ();
+  thread_lock (&c->lk);
   c->cnt += amount;
+  wake = NULL;
   if (amount > 0 && c->hd) {
-    lthread_t *t, *prev;
     prev = NULL;
-    for (t = c->hd; t; t = t->next) {
-      if (((unsigned int)t->cdata1) >= c->cnt) {
-	q_ins (readyQh, readyQt, t);
-	t->in_readyq = 1;
+    for (t = c->hd; t; t = next) {
+      next = t->next;
+      if (((unsigned int)(long)t->cdata1) <= c->cnt) {
 	if (prev) {
-	  prev->next = t->next;
+	  prev->next = next;
 	}
 	else {
-	  c->hd = t->next;
+	  c->hd = next;
 	}
+	if (!next) {
+	  c->tl = prev;
+	}
+	q_ins (wake, wake_tl, t);
       }
       else {
 	prev = t;
       }
     }
   }
+  thread_unlock (&c->lk);
+  while (wake) {
+    t = wake;
+    wake = wake->next;
+    thread_make_ready (t);
+  }
   context_enable ();
 }
@@ -31,6 +31,7 @@ extern "C" {
 typedef struct {
   unsigned int cnt;
   lthread_t *hd, *tl;
+  int lk;			/* protects the fields above */
 } countw_t;
 
 countw_t *count_new (int init_val);
@@ -27,11 +27,12 @@
 #include "misc.h"
 
 
-static int cur_type = -1;
-static char *cur_msg = NULL;
+/* exception stacks are per-thread */
+static __thread int cur_type = -1;
+static __thread char *cur_msg = NULL;
 
-static except_t *root = NULL;
-static except_t *freelist = NULL;
+static __thread except_t *root = NULL;
+static __thread except_t *freelist = NULL;
 
 
 static except_t *alloc_except (void)
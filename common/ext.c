@@ -25,6 +25,7 @@
 #include <pwd.h>
 #include <ctype.h>
 #include <string.h>
+#include <pthread.h>
 #include "ext.h"
 #include "lex.h"
 #include "config.h"
@@ -37,6 +38,9 @@ static int num_devices = 0;
 static char **device_names = NULL;
 
 static int path_first_time = 1;
+static pthread_mutex_t path_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int ext_nthreads = 1;
 
 static
 struct pathlist {
@@ -187,7 +191,7 @@ void read_dotmagic (char *file)
 
 
 static
-FILE *mag_path_open (const char *name, FILE **dumpfile)
+FILE *_mag_path_open (const char *name, FILE **dumpfile)
 {
   struct pathlist *p;
   char *file, *try;
@@ -239,6 +243,21 @@ FILE *mag_path_open (const char *name, FILE **dumpfile)
   return NULL;
 }
 
+/*
+ * The search path and the user name expansion are shared state; the
+ * parallel reader opens files from several threads at once.
+ */
+static
+FILE *mag_path_open (const char *name, FILE **dumpfile)
+{
+  FILE *fp;
+
+  pthread_mutex_lock (&path_lock);
+  fp = _mag_path_open (name, dumpfile);
+  pthread_mutex_unlock (&path_lock);
+  return fp;
+}
+
 
 /*
  *
@@ -389,6 +408,40 @@ void addattr (struct ext_file *ext, char *n, char *attr)
   ext->attr = a;
 }
 
+/*------------------------------------------------------------------------
+ *
+ *  Node names are interned in a per-cell table. Every reference to a
+ *  node (aliases, caps, fets, area/perim) shares the same storage, and
+ *  equal names within a cell are equal pointers.
+ *
+ *------------------------------------------------------------------------
+ */
+static
+char *ext_intern (struct ext_file *ext, const char *s)
+{
+  hash_bucket_t *b;
+
+  b = hash_lookup (ext->names, s);
+  if (!b) {
+    b = hash_add (ext->names, s);
+  }
+  return b->key;
+}
+
+static
+void addalias (struct ext_file *ext, const char *a, const char *b, double cap)
+{
+  struct ext_alias *alias;
+
+  MALLOC (alias, struct ext_alias, 1);
+  alias->n1 = ext_intern (ext, a);
+  alias->n2 = ext_intern (ext, b);
+  alias->next = ext->aliases;
+  ext->aliases = alias;
+  if (cap != 0)
+    addcap (ext, alias->n1, alias->n2, cap, CAP_CORRECT);
+}
+
 /*------------------------------------------------------------------------
  *
  *  Expands alias lists out
@@ -396,145 +449,112 @@ void addattr (struct ext_file *ext, char *n, char *attr)
  *------------------------------------------------------------------------
  */
 static
-void expand_aliases (char *a, char *b, struct ext_file *ext, double cap)
+void expand_aliases (const char *a, const char *b, struct ext_file *ext,
+		     double cap)
 {
+  char bufa[MAXLINE], bufb[MAXLINE];
+  char n1[MAXLINE], n2[MAXLINE];
   char *s, *t;
-  struct ext_alias *alias;
-  char *sta, *stb;
   int i, j;
   int xrange, yrange;
   int xloa, yloa, xlob, ylob;
-  int lena, lenb;
 
-  lena = strlen (a) + 1;
-  lenb = strlen (b) + 1;
+  s = strchr (a, '[');
+  t = strchr (b, '[');
+  if (!s || !t) {
+    addalias (ext, a, b, cap);
+    return;
+  }
+  if (strlen (a) >= MAXLINE || strlen (b) >= MAXLINE)
+    fatal_error ("Merge line too long: %s, %s", a, b);
+
+  /* split copies of the names at the first '[' */
+  strcpy (bufa, a);
+  strcpy (bufb, b);
+  s = bufa + (s - a);
+  t = bufb + (t - b);
+  *s = '\0';
+  *t = '\0';
+  yrange = 0;
+  xrange = 0;
+
+  s++;
+  if (!*s) fatal_error ("Invalid merge line");
 
-  s = a;
-  while (*s && *s != '[')
+  s = getint (s, &xloa);
+  if (*s == ':') {
     s++;
-  t = b;
-  while (*t && *t != '[') t++;
-  if (!*s || !*t) {
-    MALLOC (alias, struct ext_alias, 1);
-    alias->n1 = Strdup(a);
-    alias->n2 = Strdup(b);
-    alias->next = ext->aliases;
-    ext->aliases = alias;
-    if (cap != 0) 
-      addcap (ext,Strdup(alias->n1), Strdup(alias->n2), cap, CAP_CORRECT);
+    s = getint (s, &i);
+    xrange = i - xloa + 1;
   }
-  else {
-    sta = s+1;
-    stb = t+1;
-    *s = '\0';
-    *t = '\0';
-    yrange = 0;
-    xrange = 0;
-
+  if (*s == ',') {
     s++;
-    if (!*s) fatal_error ("Invalid merge line");
-
-    s = getint (s, &xloa);
+    s = getint (s, &yloa);
     if (*s == ':') {
       s++;
       s = getint (s, &i);
-      xrange = i - xloa + 1;
+      yrange = i - yloa + 1;
     }
-    if (*s == ',') {
-      s++;
-      s = getint (s, &yloa);
-      if (*s == ':') {
-	s++;
-	s = getint (s, &i);
-	yrange = i - yloa + 1;
-      }
-      else
-	yrange = -1;
-    }
-    if (xrange == 0 && yrange <= 0) {
-      *(sta-1) = '[';
-      *(stb-1) = '[';
-      MALLOC (alias, struct ext_alias, 1);
-      alias->n1 = Strdup(a);
-      alias->n2 = Strdup(b);
-      alias->next = ext->aliases;
-      ext->aliases = alias;
-      if (cap != 0) 
-	addcap (ext,
-		Strdup(alias->n1), Strdup(alias->n2), cap, CAP_CORRECT);
-      FREE (a);
-      FREE (b);
-      return;
-    }
-    if (xrange == 0) xrange = 1;
-    if (yrange == -1) yrange = 1;
+    else
+      yrange = -1;
+  }
+  if (xrange == 0 && yrange <= 0) {
+    /* not a range, just an array element */
+    addalias (ext, a, b, cap);
+    return;
+  }
+  if (xrange == 0) xrange = 1;
+  if (yrange == -1) yrange = 1;
 
-    if (*s != ']')
-      fatal_error ("Error on merge line");
-    s++;
+  if (*s != ']')
+    fatal_error ("Error on merge line");
+  s++;
 
-    t++;
-    if (!*t) fatal_error ("Invalid merge line");
+  t++;
+  if (!*t) fatal_error ("Invalid merge line");
 
-    t = getint (t, &xlob);
+  t = getint (t, &xlob);
+  if (*t == ':') {
+    t++;
+    t = getint (t, &i);
+    if (xrange != (i - xlob + 1))
+      fatal_error ("Range check failed on merge line %s, %s", a, b);
+  }
+  else
+    if (xrange != 1)
+      fatal_error ("Range check failed on merge line %s, %s", a, b);
+  if (*t == ',') {
+    t++;
+    t = getint (t, &ylob);
     if (*t == ':') {
       t++;
       t = getint (t, &i);
-      if (xrange != (i - xlob + 1))
+      if (yrange != (i - ylob + 1))
 	fatal_error ("Range check failed on merge line %s, %s", a, b);
     }
     else
-      if (xrange != 1)
-	fatal_error ("Range check failed on merge line %s, %s", a, b);
-    if (*t == ',') {
-      t++;
-      t = getint (t, &ylob);
-      if (*t == ':') {
-	t++;
-	t = getint (t, &i);
-	if (yrange != (i - ylob + 1))
-	  fatal_error ("Range check failed on merge line %s, %s", a, b);
-      }
-      else
-	if (yrange != 1) fatal_error ("Range check failed on merge line %s, %s", a, b);
+      if (yrange != 1) fatal_error ("Range check failed on merge line %s, %s", a, b);
+  }
+  else
+    if (yrange != 0) fatal_error ("Range check failed");
+  if (*t != ']')
+    fatal_error ("Error on merge line");
+  t++;
+
+  if (yrange == 0)
+    for (i = 0; i < xrange; i++) {
+      snprintf (n1, MAXLINE, "%s[%d]%s", bufa, xloa+i, s);
+      snprintf (n2, MAXLINE, "%s[%d]%s", bufb, xlob+i, t);
+      addalias (ext, n1, n2, cap);
     }
-    else
-      if (yrange != 0) fatal_error ("Range check failed");
-    if (*t != ']')
-      fatal_error ("Error on merge line");
-    t++;
-
-    if (yrange == 0)
-      for (i = 0; i < xrange; i++) {
-	MALLOC (alias, struct ext_alias, 1);
-	MALLOC (alias->n1, char, lena);
-	sprintf (alias->n1, "%s[%d]%s", a, xloa+i, s);
-	MALLOC (alias->n2, char, lenb);
-	sprintf (alias->n2, "%s[%d]%s", b, xlob+i, t);
-	alias->next = ext->aliases;
-	ext->aliases = alias;
-	if (cap != 0) 
-	  addcap (ext,
-		  Strdup(alias->n1), Strdup(alias->n2), cap, CAP_CORRECT);
+  else {
+    for (i=0; i < xrange; i++)
+      for (j=0; j < yrange; j++) {
+	snprintf (n1, MAXLINE, "%s[%d,%d]%s", bufa, xloa+i, yloa+j, s);
+	snprintf (n2, MAXLINE, "%s[%d,%d]%s", bufb, xlob+i, ylob+j, t);
+	addalias (ext, n1, n2, cap);
       }
-    else {
-      for (i=0; i < xrange; i++)
-	for (j=0; j < yrange; j++) {
-	  MALLOC (alias, struct ext_alias, 1);
-	  MALLOC (alias->n1, char, lena);
-	  sprintf (alias->n1, "%s[%d,%d]%s", a, xloa+i, yloa+j, s);
-	  MALLOC (alias->n2, char, lenb);
-	  sprintf (alias->n2, "%s[%d,%d]%s", b, xlob+i, ylob+j, t);
-	  alias->next = ext->aliases;
-	  ext->aliases = alias;
-	  if (cap != 0) 
-	    addcap (ext,
-		    Strdup(alias->n1), Strdup(alias->n2), cap,CAP_CORRECT);
-	}
-    }
   }
-  FREE (a);
-  FREE (b);
 }
 
 
@@ -606,14 +626,174 @@ ext_validate_timestamp (const char *file)
  *
  *  Parse .ext file hierarchically
  *
+ *  Each distinct .ext file is parsed exactly once. Parsing a cell
+ *  discovers its subcells; any subcell that has not been seen before
+ *  is allocated immediately (so that the parent can link to it) and
+ *  queued for parsing. The queue is drained by a pool of worker
+ *  threads; when it is empty and no parse is in flight, the entire
+ *  subcell DAG has been read.
+ *
  *------------------------------------------------------------------------
  */
+struct ext_job {
+  const char *name;		/* file to parse */
+  FILE *fp;			/* already open file, if any */
+  struct ext_file *ext;		/* storage for the result */
+  struct ext_job *next;
+};
+
+struct ext_reader {
+  struct Hashtable *ehash;	/* file name -> struct ext_file */
+  struct ext_job *jobs;		/* cells waiting to be parsed */
+  int active;			/* # of cells being parsed */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+void ext_read_threads (int n)
+{
+  ext_nthreads = (n < 1) ? 1 : n;
+}
+
+static
+struct ext_file *ext_new (void)
+{
+  struct ext_file *ext;
+  
+  MALLOC (ext, struct ext_file, 1);
+  ext->fet = NULL;
+  ext->subcells = NULL;
+  ext->aliases = NULL;
+  ext->mark = 0;
+  ext->timestamp = 0;
+  ext->h = NULL;
+  ext->names = hash_new (8);
+  ext->cap = NULL;
+  ext->attr = NULL;
+  ext->ap = NULL;
+  return ext;
+}
+
+/*
+ * Return the (possibly not yet parsed) cell for file "name", queueing
+ * it for parsing the first time it is seen.
+ */
+static
+struct ext_file *ext_request (struct ext_reader *R, const char *name,
+			      FILE *fp)
+{
+  hash_bucket_t *eb;
+  struct ext_job *j;
+
+  pthread_mutex_lock (&R->lock);
+  eb = hash_lookup (R->ehash, name);
+  if (!eb) {
+    eb = hash_add (R->ehash, name);
+    eb->v = ext_new ();
+    NEW (j, struct ext_job);
+    j->name = eb->key;
+    j->fp = fp;
+    j->ext = (struct ext_file *) eb->v;
+    j->next = R->jobs;
+    R->jobs = j;
+    pthread_cond_signal (&R->cond);
+  }
+  pthread_mutex_unlock (&R->lock);
+  return (struct ext_file *) eb->v;
+}
+
+static void ext_parse (struct ext_reader *R, const char *name, FILE *fp,
+		       struct ext_file *ext);
+
+static
+void *ext_worker (void *arg)
+{
+  struct ext_reader *R = (struct ext_reader *) arg;
+  struct ext_job *j;
+
+  pthread_mutex_lock (&R->lock);
+  while (1) {
+    while (!R->jobs && R->active > 0) {
+      pthread_cond_wait (&R->cond, &R->lock);
+    }
+    if (!R->jobs) {
+      /* nothing queued and nothing in flight: we're done */
+      break;
+    }
+    j = R->jobs;
+    R->jobs = j->next;
+    R->active++;
+    pthread_mutex_unlock (&R->lock);
+
+    ext_parse (R, j->name, j->fp, j->ext);
+    FREE (j);
+
+    pthread_mutex_lock (&R->lock);
+    R->active--;
+    if (R->active == 0 && !R->jobs) {
+      pthread_cond_broadcast (&R->cond);
+    }
+  }
+  pthread_mutex_unlock (&R->lock);
+  return NULL;
+}
+
 struct ext_file *ext_read (const char *name)
 {
-  FILE *fp, *dump;
-  static char buf[MAXLINE];
-  static char tok1[MAXLINE], tok2[MAXLINE];
-  struct ext_file *ext = NULL;
+  struct ext_reader R;
+  struct ext_file *ext;
+  pthread_t *tids;
+  FILE *fp;
+  int i;
+
+  if (!device_names) {
+    if (config_exists ("net.ext_devs")) {
+      num_devices = config_get_table_size ("net.ext_devs");
+      device_names = config_get_table_string ("net.ext_devs");
+    }
+  }
+
+  R.ehash = hash_new (2);
+  R.jobs = NULL;
+  R.active = 0;
+  pthread_mutex_init (&R.lock, NULL);
+  pthread_cond_init (&R.cond, NULL);
+
+  /* the top-level file is looked up in the current directory first */
+  fp = fopen (name, "r");
+  ext = ext_request (&R, name, fp);
+
+  if (ext_nthreads > 1) {
+    MALLOC (tids, pthread_t, ext_nthreads-1);
+    for (i=0; i < ext_nthreads-1; i++) {
+      if (pthread_create (&tids[i], NULL, ext_worker, &R) != 0) {
+	fatal_error ("ext_read: could not create worker thread");
+      }
+    }
+    ext_worker (&R);
+    for (i=0; i < ext_nthreads-1; i++) {
+      pthread_join (tids[i], NULL);
+    }
+    FREE (tids);
+  }
+  else {
+    ext_worker (&R);
+  }
+
+  pthread_cond_destroy (&R.cond);
+  pthread_mutex_destroy (&R.lock);
+  hash_free (R.ehash);
+
+  return ext;
+}
+
+static
+void ext_parse (struct ext_reader *R, const char *name, FILE *fp,
+		struct ext_file *ext)
+{
+  FILE *dump;
+  char buf[MAXLINE];
+  char tok1[MAXLINE], tok2[MAXLINE];
   LEX_T *l;
   struct ext_fets *fet;
   struct ext_list *subcell;
@@ -624,53 +804,18 @@ struct ext_file *ext_read (const char *name)
   double cscale; /*, rscale;*/
   double lscale;
   double x;
-  static int depth = 0;
-  static struct Hashtable *ehash;
-  hash_bucket_t *eb;
 
   dump = NULL;
-  fp = NULL;
-  if (depth == 0) {
-    ehash = hash_new (2);
-    fp = fopen (name, "r");
-
-    if (!device_names) {
-      if (config_exists ("net.ext_devs")) {
-	num_devices = config_get_table_size ("net.ext_devs");
-	device_names = config_get_table_string ("net.ext_devs");
-      }
-    }
-  }
-
-  eb = hash_lookup (ehash, name);
-  if (eb) {
-    return (struct ext_file *)eb->v;
-  }
-  eb = hash_add (ehash, name);
-  
   if (!fp) {
     fp = mag_path_open (name, &dump);
   }
   if (!fp) {
     fatal_error ("Could not find extract file for `%s'", name);
   }
-  depth++;
-
 
   l = lex_string ("boo");
   l_comma = lex_addtoken (l, ",");
 
-  MALLOC (ext, struct ext_file, 1);
-  ext->fet = NULL;
-  ext->subcells = NULL;
-  ext->aliases = NULL;
-  ext->mark = 0;
-  ext->h = NULL;
-  ext->cap = NULL;
-  ext->attr = NULL;
-  ext->ap = NULL;
-  eb->v = ext;
-
   buf[MAXLINE-1] = '\n';
 
   if (fgets (buf, MAXLINE, fp)) {
@@ -684,13 +829,7 @@ struct ext_file *ext_read (const char *name)
     fclose (fp);
     if (dump) fclose (dump);
     lex_free (l);
-    depth--;
-
-    if (depth == 0) {
-      hash_free (ehash);
-      ehash = NULL;
-    }
-    return ext;
+    return;
   }
 
   if (dump) {
@@ -743,12 +882,7 @@ struct ext_file *ext_read (const char *name)
 	}
       }
       lex_free (l);
-      depth--;
-      if (depth == 0) {
-	hash_free (ehash);
-	ehash = NULL;
-      }
-      return ext;
+      return;
     }
     else {
       warning ("summary file for `%s' not used [empty]", name);
@@ -836,7 +970,7 @@ readext:
       }
       subcell->next = ext->subcells;
       ext->subcells = subcell;
-      subcell->ext = ext_read (subcell->file);
+      subcell->ext = ext_request (R, subcell->file, NULL);
     }
     else if (lex_have_keyw (l, "device")) {
       if (lex_have_keyw (l, "mosfet")) {
@@ -874,10 +1008,10 @@ readext:
 	/*dim2 = */(void)(lex_mustbe_number (l)*lscale);
 
 	/* substrate */
-	fet->sub = Strdup (lex_mustbe_string_id (l, name, line));
+	fet->sub = ext_intern (ext, lex_mustbe_string_id (l, name, line));
 
 	/* gate */
-	fet->g = Strdup(lex_mustbe_string_id (l, name, line));
+	fet->g = ext_intern (ext, lex_mustbe_string_id (l, name, line));
 
 	gperim = lex_mustbe_number (l)*lscale; /* convert to SI units */
 	fet->isweak = 0;
@@ -891,7 +1025,7 @@ readext:
 	  } while (lex_have (l,l_comma));
 
 	/* t1 */
-	fet->t1 = Strdup(lex_mustbe_string_id (l, name, line));
+	fet->t1 = ext_intern (ext, lex_mustbe_string_id (l, name, line));
 	t1perim = lex_mustbe_number (l)*lscale; /* convert to SI units */
 	if (strcmp (lex_tokenstring (l), "0") == 0)
 	  lex_getsym (l);
@@ -903,7 +1037,7 @@ readext:
 	if (!fet->t2) {
 	  fatal_error ("fet in layout does not have enough terminals; t=%s; gate=%s", fet->t1, fet->g);
 	}
-	fet->t2 = Strdup(fet->t2);
+	fet->t2 = ext_intern (ext, fet->t2);
 	t2perim = lex_mustbe_number (l)*lscale; /* convert to SI unitS
 						   */
 
@@ -945,10 +1079,10 @@ readext:
       lex_mustbe_number (l); lex_mustbe_number (l); lex_mustbe_number (l);
 
       /* substrate */
-      fet->sub = Strdup (lex_mustbe_string_id (l, name, line));
+      fet->sub = ext_intern (ext, lex_mustbe_string_id (l, name, line));
 
       /* gate */
-      fet->g = Strdup(lex_mustbe_string_id (l, name, line));
+      fet->g = ext_intern (ext, lex_mustbe_string_id (l, name, line));
 
       gperim = lex_mustbe_number (l)*lscale; /* convert to SI units */
       fet->isweak = 0;
@@ -962,7 +1096,7 @@ readext:
 	} while (lex_have (l,l_comma));
 
       /* t1 */
-      fet->t1 = Strdup(lex_mustbe_string_id (l, name, line));
+      fet->t1 = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       t1perim = lex_mustbe_number (l)*lscale; /* convert to SI units */
       if (strcmp (lex_tokenstring (l), "0") == 0)
 	lex_getsym (l);
@@ -974,7 +1108,7 @@ readext:
       if (!fet->t2) {
 	fatal_error ("fet in layout does not have enough terminals; t=%s; gate=%s", fet->t1, fet->g);
       }
-      fet->t2 = Strdup(fet->t2);
+      fet->t2 = ext_intern (ext, fet->t2);
       t2perim = lex_mustbe_number (l)*lscale; /* convert to SI unitS */
 
       fet->width = (t1perim + t2perim)/2;
@@ -985,13 +1119,13 @@ readext:
       ext->fet = fet;
     }
     else if (lex_have_keyw (l, "equiv")) {
-      s = Strdup(lex_mustbe_string_id (l, name, line));
-      t = Strdup(lex_mustbe_string_id (l, name, line));
+      s = ext_intern (ext, lex_mustbe_string_id (l, name, line));
+      t = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       expand_aliases (s, t, ext, 0);
     }
     else if (lex_have_keyw (l, "merge")) {
-      s = Strdup(lex_mustbe_string_id (l, name, line));
-      t = Strdup(lex_mustbe_string_id (l, name, line));
+      s = ext_intern (ext, lex_mustbe_string_id (l, name, line));
+      t = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       if (lex_sym (l) == l_integer || lex_sym (l) == l_real)
 	x = cscale*lex_mustbe_number (l);
       else
@@ -1000,7 +1134,7 @@ readext:
     }
     else if (lex_have_keyw (l, "node") || lex_have_keyw (l, "substrate")) {
       struct ext_ap *ap;
-      s = Strdup (lex_mustbe_string_id (l, name, line));
+      s = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       lex_mustbe_number (l); /* R */
       x = lex_mustbe_number(l)*cscale; /* C */
       /* FIXME: resistclass 1 = ndiff, 2 = pdiff -- hardcoded */
@@ -1008,10 +1142,10 @@ readext:
       lex_mustbe_number (l); /* y */
       lex_mustbe_string_contiguous_id (l); /* type */
 
-      addcap (ext, Strdup (s), NULL, x, CAP_GND);
+      addcap (ext, s, NULL, x, CAP_GND);
 
       if (!lex_eof (l)) {
-	ap = add_ap_empty (ext, Strdup (s));
+	ap = add_ap_empty (ext, s);
 	if (device_names) {
 	  int j;
 	  MALLOC (ap->area, double, num_devices);
@@ -1031,17 +1165,17 @@ readext:
 	  ap->perim[1] = lex_mustbe_number (l)*lscale;
 	}
       }
-      expand_aliases (s, Strdup(s), ext, 0);
+      expand_aliases (s, s, ext, 0);
     }
     else if (lex_have_keyw (l, "cap")) {
-      s = Strdup (lex_mustbe_string_id (l, name, line));
-      t = Strdup (lex_mustbe_string_id (l, name, line));
+      s = ext_intern (ext, lex_mustbe_string_id (l, name, line));
+      t = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       x = lex_mustbe_number (l)*cscale;
       addcap (ext, s, t, x, CAP_INTERNODE);
     }
     else if (lex_have_keyw (l, "subcap")) {
       /* figure out what to do */
-      s = Strdup (lex_mustbe_string_id (l, name, line));
+      s = ext_intern (ext, lex_mustbe_string_id (l, name, line));
       x = lex_mustbe_number (l)*cscale;
       addcap (ext, s, NULL, x, CAP_SUBSTRATE);
     }
@@ -1063,10 +1197,4 @@ readext:
   }
   fclose (fp);
   lex_free (l);
-  depth--;
-  if (depth == 0) {
-    hash_free (ehash);
-    ehash = NULL;
-  }
-  return ext;
 }
@@ -111,6 +111,7 @@ struct ext_file {
   int mark;
   unsigned long timestamp;
   struct Hashtable *h;		/* if hierarchical */
+  struct Hashtable *names;	/* interned node names for this cell */
   struct ext_fets *fet;		/* fets */
   struct ext_list *subcells;	/* subcells */
   struct ext_alias *aliases;	/* aliases */
@@ -121,6 +122,9 @@ struct ext_file {
 
 /* parse hierarchical extract file */
 extern struct ext_file *ext_read (const char *name);
+
+/* number of threads used by ext_read to parse distinct cells (default 1) */
+extern void ext_read_threads (int n);
 extern void ext_validate_timestamp (const char *name);
 
 #ifdef __cplusplus
@@ -41,9 +41,15 @@ typedef struct __el__ {
   struct __el__ *next;
 } elist;
 
-L_A_DECL(char *, string_tab);
+/*
+  The file name and error message caches are per-thread so that
+  several files can be parsed concurrently. Entries are never freed,
+  so pointers into them stay valid after the thread that created them
+  has exited.
+*/
+T_A_DECL(char *, string_tab);
 
-static struct Hashtable *ERRMSG = NULL;
+static __thread struct Hashtable *ERRMSG = NULL;
 
 struct _file_ {
   char **toks;
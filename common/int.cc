@@ -19,10 +19,133 @@
  *
  **************************************************************************
  */
+#include <pthread.h>
 #include "int.h"
 
 #define UNIT_SZ 
 
+/*------------------------------------------------------------------------
+ *
+ *   Storage. Numbers wider than BIGINT_INLINE units use buffers of
+ *   BIGINT_POOL_MIN << k units, recycled through per-thread free lists;
+ *   anything larger than the biggest class goes straight to malloc.
+ *   A thread's free lists are released when the thread exits.
+ *
+ *------------------------------------------------------------------------
+ */
+#define BIGINT_POOL_CLASSES 8	  /* size classes */
+#define BIGINT_POOL_MAX     64	  /* max # of free buffers per class */
+
+#define BIGINT_POOL_MIN						\
+  ((2*BIGINT_INLINE*sizeof (UNIT_TYPE) < sizeof (void *)) ?		\
+   (int)(sizeof (void *)/sizeof (UNIT_TYPE)) : 2*BIGINT_INLINE)
+
+struct bigint_pool {
+  UNIT_TYPE *hd[BIGINT_POOL_CLASSES];  /* free list; the link is stored
+					  in the buffer itself */
+  int n[BIGINT_POOL_CLASSES];
+  int registered;		/* set once the exit hook is installed */
+};
+
+static __thread struct bigint_pool _pool;
+
+static pthread_key_t _pool_key;
+static pthread_once_t _pool_once = PTHREAD_ONCE_INIT;
+
+/* thread exit: free the buffers on this thread's free lists */
+static void _pool_release (void *x)
+{
+  struct bigint_pool *p = (struct bigint_pool *) x;
+  UNIT_TYPE *v;
+
+  for (int k=0; k < BIGINT_POOL_CLASSES; k++) {
+    while (p->hd[k]) {
+      v = p->hd[k];
+      p->hd[k] = *((UNIT_TYPE **)v);
+      FREE (v);
+    }
+    p->n[k] = 0;
+  }
+  p->registered = 0;
+}
+
+static void _pool_key_init (void)
+{
+  pthread_key_create (&_pool_key, _pool_release);
+}
+
+UNIT_TYPE *BigInt::_alloc_words (int n, int *cap)
+{
+  UNIT_TYPE *v;
+  int k, sz;
+
+  sz = BIGINT_POOL_MIN;
+  for (k=0; k < BIGINT_POOL_CLASSES && sz < n; k++) {
+    sz = sz*2;
+  }
+  if (k == BIGINT_POOL_CLASSES) {
+    MALLOC (v, UNIT_TYPE, n);
+    *cap = n;
+    return v;
+  }
+  if (_pool.hd[k]) {
+    v = _pool.hd[k];
+    _pool.hd[k] = *((UNIT_TYPE **)v);
+    _pool.n[k]--;
+  }
+  else {
+    MALLOC (v, UNIT_TYPE, sz);
+  }
+  *cap = sz;
+  return v;
+}
+
+void BigInt::_free_words (UNIT_TYPE *v, int cap)
+{
+  int k, sz;
+
+  sz = BIGINT_POOL_MIN;
+  for (k=0; k < BIGINT_POOL_CLASSES && sz < cap; k++) {
+    sz = sz*2;
+  }
+  if (k == BIGINT_POOL_CLASSES || sz != cap ||
+      _pool.n[k] >= BIGINT_POOL_MAX) {
+    FREE (v);
+    return;
+  }
+  if (!_pool.registered) {
+    pthread_once (&_pool_once, _pool_key_init);
+    pthread_setspecific (_pool_key, &_pool);
+    _pool.registered = 1;
+  }
+  *((UNIT_TYPE **)v) = _pool.hd[k];
+  _pool.hd[k] = v;
+  _pool.n[k]++;
+}
+
+/*
+  Switch to a buffer with room for newlen units; if keep is set, the
+  current units are copied over
+*/
+void BigInt::_grow (int newlen, int keep)
+{
+  UNIT_TYPE *nv, *ov;
+  int ncap;
+
+  nv = _alloc_words (newlen, &ncap);
+  if (keep) {
+    ov = getV ();
+    for (int i=0; i < len && i < (cap ? cap : BIGINT_INLINE); i++) {
+      nv[i] = ov[i];
+    }
+  }
+  if (cap) {
+    _free_words (u.v, cap);
+  }
+  u.v = nv;
+  cap = ncap;
+}
+
 /*------------------------------------------------------------------------
  *
  *   Constructor. Destructor. Assignment.
@@ -31,6 +154,8 @@
  */
 BigInt::BigInt(int w, int s, int d)
 {
+  UNIT_TYPE *v;
+  
   len = 0;
   width = w;
   do {
@@ -38,32 +163,34 @@ BigInt::BigInt(int w, int s, int d)
     w = w - BIGINT_BITS_ONE;
   } while (w > 0);
   Assert (len > 0, "What?");
-  if (len >= 2) {
-    MALLOC (u.v, UNIT_TYPE, len);
-    for (int i=0; i < len; i++) {
-      u.v[i] = 0;
-    }
-  } else {
-    u.value = 0;
+  cap = 0;
+  if (len > BIGINT_INLINE) {
+    u.v = _alloc_words (len, &cap);
+  }
+  v = getV ();
+  for (int i=0; i < len; i++) {
+    v[i] = 0;
   }
   isdynamic = d;
   issigned = s;
 }
 
 /*-- copy constructor --*/
-BigInt::BigInt (BigInt &b)
+BigInt::BigInt (const BigInt &b)
 {
+  UNIT_TYPE *v;
+  
   isdynamic = b.isdynamic;
   issigned = b.issigned;
   len = b.len;
   width = b.width;
-  if (len >= 2) {
-    MALLOC (u.v, UNIT_TYPE, b.len);
-    for (int i=0; i < len; i++) {
-      u.v[i] = b.u.v[i];
-    }
-  } else {
-    u.value = b.u.value;
+  cap = 0;
+  if (len > BIGINT_INLINE) {
+    u.v = _alloc_words (len, &cap);
+  }
+  v = getV ();
+  for (int i=0; i < len; i++) {
+    v[i] = b.getVal (i);
   }
 }
 
@@ -73,38 +200,30 @@ BigInt::BigInt (BigInt &&b)
   isdynamic = b.isdynamic;
   issigned = b.issigned;
   len = b.len;
-  if (len >= 2) {
-    u.v = b.u.v;
-  } else {
-    u.value = b.u.value;
-  }
   width = b.width;
-  if (len >= 2) {
-    b.u.v = NULL;
-  } else {
-    b.u.value = 0;
-  }
+  cap = b.cap;
+  u = b.u;
+  b.cap = 0;
+  b.u.value[0] = 0;
   b.len = 0;
 }
 
 
 BigInt& BigInt::operator=(const BigInt &b)
 {
+  UNIT_TYPE *v;
+  
   if (&b == this) { return *this; }
-  if (len >= 2) {
-    FREE (u.v);
-  }
   isdynamic = b.isdynamic;
   issigned = b.issigned;
-  len = b.len;
   width = b.width;
-  if (len >= 2) {
-    MALLOC (u.v, UNIT_TYPE, len);
-    for (int i=0; i < len; i++) {
-      u.v[i] = b.u.v[i];
-    }
-  } else {
-    u.value = b.u.value;
+  if (b.len > (cap ? cap : BIGINT_INLINE)) {
+    _grow (b.len, 0);
+  }
+  len = b.len;
+  v = getV ();
+  for (int i=0; i < len; i++) {
+    v[i] = b.getVal (i);
   }
   return *this;
 }
@@ -112,20 +231,18 @@ BigInt& BigInt::operator=(const BigInt &b)
 BigInt& BigInt::operator=(BigInt &&b)
 {
   if (&b == this) { return *this; }
-  if (len >= 2) {
-    FREE (u.v);
+  if (cap) {
+    _free_words (u.v, cap);
   }
   isdynamic = b.isdynamic;
   issigned = b.issigned;
   len = b.len;
   width = b.width;
-  if (len >= 2) {
-    u.v = b.u.v;
-  } else {
-    u.value = b.u.value;
-  }
+  cap = b.cap;
+  u = b.u;
 
-  b.u.v = NULL;
+  b.cap = 0;
+  b.u.value[0] = 0;
   b.len = 0;
 
   return *this;
@@ -133,23 +250,16 @@ BigInt& BigInt::operator=(BigInt &&b)
 
 BigInt& BigInt::operator=(const UNIT_TYPE &b)
 {
-  if (len >= 2) {
-    FREE (u.v);
-  }
   isdynamic = 0;
   issigned = 0;
   len = 1;
   width = 8*sizeof(UNIT_TYPE);
-  u.value = b;
+  _setVal (0, b);
   return *this;
 }
 
 BigInt& BigInt::operator=(const std::string &b)
 {
-  if (len >= 2) {
-    FREE(u.v);
-  }
-
   int word_cnt = 0;
   int word_len = BIGINT_BITS_ONE/4;
   int word_num = 0;
@@ -159,17 +269,16 @@ BigInt& BigInt::operator=(const std::string &b)
   isdynamic = 0;
   issigned = 0;
 
+  int nlen;
   if ((4*(b.size()-2)) % BIGINT_BITS_ONE == 0) {
-    len = 4*(b.size()-2)/BIGINT_BITS_ONE;
-    if (len >= 2) {
-      MALLOC(u.v, UNIT_TYPE, len);
-    }
+    nlen = 4*(b.size()-2)/BIGINT_BITS_ONE;
   } else {
-    len = 1 + 4*(b.size()-2)/BIGINT_BITS_ONE;
-    if (len >= 2) {
-      MALLOC(u.v, UNIT_TYPE, len);
-    }
+    nlen = 1 + 4*(b.size()-2)/BIGINT_BITS_ONE;
+  }
+  if (nlen > (cap ? cap : BIGINT_INLINE)) {
+    _grow (nlen, 0);
   }
+  len = nlen;
 
   std::string hex_test = b.substr(0,2);
   if (hex_test != "0x") {
@@ -254,15 +363,11 @@ void BigInt::expandSpace (int amt)
   }
 
   _adjlen (x);
-  if (x > 1) {
-    for (; len < x; len++) {
-      u.v[len] = 0;
-      if (sa) {
-        u.v[len] = ~u.v[len];
-      }
+  for (; len < x; len++) {
+    _setVal (len, 0);
+    if (sa) {
+      _setVal (len, ~getVal (len));
     }
-  } else {
-    len = x;
   }
 }
 
@@ -284,11 +389,7 @@ void BigInt::squeezeSpace (int amt)
   UNIT_TYPE res = 0;
   res = ~res;
   res = res >> tmp;
-  if (len >= 2) {
-    u.v[len-1] = u.v[len-1] & res;
-  } else {
-    u.value = u.value & res;
-  }
+  _setVal (len-1, getVal (len-1) & res);
 
   int sa = 0;
   sa = isSigned() && isNegative();
@@ -306,51 +407,29 @@ void BigInt::squeezeSpace (int amt)
  */
 BigInt BigInt::operator-() const
 {
-  BigInt b;
+  BigInt b(*this);
+  UNIT_TYPE *v = b.getV ();
   int c = 1;
   int sa = isSigned() && isNegative();
 
-  b = (*this);
-  
-  if (len >= 2) {
-    for (int i=0; i < len; i++) {
-      b.u.v[i] = ~b.u.v[i];
-    }
-  } else {
-    b.u.value = ~b.u.value;
+  for (int i=0; i < len; i++) {
+    v[i] = ~v[i];
   }
 
   for (int i = 0; c == 1 && (i<len); i++) {
-    if (len >= 2) {
-      b.u.v[i] = b.u.v[i] + c;
-      if (b.u.v[i] == 0) {
-        c = 1;
-      } else {
-        c = 0;
-        break;
-      }
+    v[i] = v[i] + c;
+    if (v[i] == 0) {
+      c = 1;
     } else {
-      b.u.value = b.u.value + c;
-      if (b.u.value == 0) {
-        c = 1;
-      } else {
-        c = 0;
-        break;
-      }
+      c = 0;
+      break;
     }
   }
   if (c && isDynamic()) {
     b.expandSpace (1);
-    if (b.len >= 2) {
-      b.u.v[len-1] = 0;
-      if (sa) {
-        b.u.v[len-1] = ~b.u.v[len-1];
-      }
-    } else {
-      b.u.value = 0;
-      if (sa) {
-        b.u.value = ~b.u.value;
-      }
+    b._setVal (len-1, 0);
+    if (sa) {
+      b._setVal (len-1, ~b.getVal (len-1));
     }
     b.width++;
   }
@@ -703,6 +782,433 @@ int BigInt::operator>=(const BigInt &b) const
 }
 
 
+/*------------------------------------------------------------------------
+ *
+ *   Word-level helpers for multiplication and division. These work on
+ *   unsigned magnitudes stored as arrays of UNIT_TYPE digits, least
+ *   significant digit first.
+ *
+ *------------------------------------------------------------------------
+ */
+#if defined(BIGINT_TEST)
+typedef unsigned short bigint_dbl_t;
+#define BIGINT_HAVE_DBL
+#elif defined(__SIZEOF_INT128__)
+typedef unsigned __int128 bigint_dbl_t;
+#define BIGINT_HAVE_DBL
+#endif
+
+/* operands up to this many digits use stack buffers */
+#define BIGINT_STACK_DIGITS 16
+
+/* switch to Karatsuba when both operands have this many digits (>= 4) */
+#define BIGINT_KARATSUBA 32
+
+static int _karatsuba = BIGINT_KARATSUBA;
+
+void BigInt::setKaratsuba (int n)
+{
+  if (n <= 0) {
+    _karatsuba = BIGINT_KARATSUBA;
+  }
+  else {
+    _karatsuba = (n < 4 ? 4 : n);
+  }
+}
+
+#define BIGINT_HALF (BIGINT_BITS_ONE/2)
+
+/* a*b: returns the low digit, and the high digit in *hi */
+static inline UNIT_TYPE _umul (UNIT_TYPE a, UNIT_TYPE b, UNIT_TYPE *hi)
+{
+#ifdef BIGINT_HAVE_DBL
+  bigint_dbl_t p = (bigint_dbl_t)a * b;
+  *hi = (UNIT_TYPE)(p >> BIGINT_BITS_ONE);
+  return (UNIT_TYPE)p;
+#else
+  UNIT_TYPE lm = ((UNIT_TYPE)~(UNIT_TYPE)0) >> BIGINT_HALF;
+  UNIT_TYPE a0 = a & lm, a1 = a >> BIGINT_HALF;
+  UNIT_TYPE b0 = b & lm, b1 = b >> BIGINT_HALF;
+  UNIT_TYPE p00 = a0*b0, p01 = a0*b1, p10 = a1*b0, p11 = a1*b1;
+  UNIT_TYPE mid = (p00 >> BIGINT_HALF) + (p01 & lm) + (p10 & lm);
+
+  *hi = p11 + (p01 >> BIGINT_HALF) + (p10 >> BIGINT_HALF) + (mid >> BIGINT_HALF);
+  return (mid << BIGINT_HALF) | (p00 & lm);
+#endif
+}
+
+/* (hi,lo)/d with hi < d: returns the quotient, remainder in *r */
+static inline UNIT_TYPE _udiv (UNIT_TYPE hi, UNIT_TYPE lo, UNIT_TYPE d,
+			       UNIT_TYPE *r)
+{
+#ifdef BIGINT_HAVE_DBL
+  bigint_dbl_t n = ((bigint_dbl_t)hi << BIGINT_BITS_ONE) | lo;
+  *r = (UNIT_TYPE)(n % d);
+  return (UNIT_TYPE)(n / d);
+#else
+  for (int i=0; i < (int)BIGINT_BITS_ONE; i++) {
+    int top = (hi >> (BIGINT_BITS_ONE-1)) & 1;
+    hi = (hi << 1) | (lo >> (BIGINT_BITS_ONE-1));
+    lo = lo << 1;
+    if (top || hi >= d) {
+      hi = hi - d;
+      lo = lo | 1;
+    }
+  }
+  *r = hi;
+  return lo;
+#endif
+}
+
+static inline int _nlz (UNIT_TYPE x)
+{
+  int n = 0;
+  while (!((x >> (BIGINT_BITS_ONE-1)) & 1)) {
+    x = x << 1;
+    n++;
+  }
+  return n;
+}
+
+/* r[0..rn) += a[0..an), rn >= an; returns the carry out */
+static UNIT_TYPE _w_add (UNIT_TYPE *r, int rn, const UNIT_TYPE *a, int an)
+{
+  UNIT_TYPE c = 0;
+  int i;
+
+  for (i=0; i < an; i++) {
+    UNIT_TYPE t = r[i] + a[i];
+    UNIT_TYPE c1 = (t < a[i]);
+    r[i] = t + c;
+    c = c1 | (r[i] < c);
+  }
+  for (; c && i < rn; i++) {
+    r[i]++;
+    c = (r[i] == 0);
+  }
+  return c;
+}
+
+/* r[0..rn) -= a[0..an), rn >= an; returns the borrow out */
+static UNIT_TYPE _w_sub (UNIT_TYPE *r, int rn, const UNIT_TYPE *a, int an)
+{
+  UNIT_TYPE b = 0;
+  int i;
+
+  for (i=0; i < an; i++) {
+    UNIT_TYPE t = r[i] - a[i];
+    UNIT_TYPE b1 = (r[i] < a[i]);
+    r[i] = t - b;
+    b = b1 | (t < b);
+  }
+  for (; b && i < rn; i++) {
+    b = (r[i] == 0);
+    r[i]--;
+  }
+  return b;
+}
+
+/* r[0..an+bn) = a*b, schoolbook */
+static void _w_mul_basic (UNIT_TYPE *r, const UNIT_TYPE *a, int an,
+			  const UNIT_TYPE *b, int bn)
+{
+  for (int i=0; i < an+bn; i++) {
+    r[i] = 0;
+  }
+  for (int i=0; i < an; i++) {
+    UNIT_TYPE c = 0;
+    if (a[i] == 0) continue;
+    for (int j=0; j < bn; j++) {
+      UNIT_TYPE hi, lo;
+      lo = _umul (a[i], b[j], &hi);
+      lo = lo + c;
+      hi += (lo < c);
+      r[i+j] = r[i+j] + lo;
+      hi += (r[i+j] < lo);
+      c = hi;
+    }
+    r[i+bn] = c;
+  }
+}
+
+/* r[0..4) = a*b for two-digit a and b */
+static inline void _w_mul_2x2 (UNIT_TYPE *r, const UNIT_TYPE *a,
+			       const UNIT_TYPE *b)
+{
+  UNIT_TYPE h00, l01, h01, l10, h10, h11, c, c2;
+
+  r[0] = _umul (a[0], b[0], &h00);
+  l01 = _umul (a[0], b[1], &h01);
+  l10 = _umul (a[1], b[0], &h10);
+  r[2] = _umul (a[1], b[1], &h11);
+
+  r[1] = h00 + l01;
+  c = (r[1] < l01);
+  r[1] += l10;
+  c += (r[1] < l10);
+
+  r[2] += h01;
+  c2 = (r[2] < h01);
+  r[2] += h10;
+  c2 += (r[2] < h10);
+  r[2] += c;
+  c2 += (r[2] < c);
+
+  /* the product fits in four digits */
+  r[3] = h11 + c2;
+}
+
+/* r[0..an+bn) = a*b; r must not overlap a or b */
+static void _w_mul (UNIT_TYPE *r, const UNIT_TYPE *a, int an,
+		    const UNIT_TYPE *b, int bn)
+{
+  UNIT_TYPE *t;
+  int h;
+
+  if (an < bn) {
+    const UNIT_TYPE *x = a; a = b; b = x;
+    h = an; an = bn; bn = h;
+  }
+  if (bn < _karatsuba) {
+    _w_mul_basic (r, a, an, b, bn);
+    return;
+  }
+  h = (an + 1)/2;
+
+  if (bn <= h) {
+    /* unbalanced: a0*b + (a1*b) << h */
+    _w_mul (r, a, h, b, bn);
+    for (int i=h+bn; i < an+bn; i++) {
+      r[i] = 0;
+    }
+    MALLOC (t, UNIT_TYPE, an-h+bn);
+    _w_mul (t, a+h, an-h, b, bn);
+    _w_add (r+h, an+bn-h, t, an-h+bn);
+    FREE (t);
+    return;
+  }
+
+  /* Karatsuba: z0 = a0*b0, z2 = a1*b1, z1 = (a0+a1)(b0+b1) - z0 - z2 */
+  UNIT_TYPE *sa, *sb, *z1;
+  int n1 = 2*(h+1);
+
+  MALLOC (t, UNIT_TYPE, 2*(h+1) + n1);
+  sa = t;
+  sb = t + h + 1;
+  z1 = t + 2*(h+1);
+
+  for (int i=0; i < h; i++) {
+    sa[i] = a[i];
+    sb[i] = b[i];
+  }
+  sa[h] = _w_add (sa, h, a+h, an-h);
+  sb[h] = _w_add (sb, h, b+h, bn-h);
+
+  _w_mul (r, a, h, b, h);
+  _w_mul (r+2*h, a+h, an-h, b+h, bn-h);
+  _w_mul (z1, sa, h+1, sb, h+1);
+  _w_sub (z1, n1, r, 2*h);
+  _w_sub (z1, n1, r+2*h, an+bn-2*h);
+
+  /* z1 < 2^(2h digits + 1) */
+  while (n1 > 0 && z1[n1-1] == 0) n1--;
+  _w_add (r+h, an+bn-h, z1, n1);
+  FREE (t);
+}
+
+/*
+  q[0..m) = u/v, r[0..n) = u%v for u[0..m) and v[0..n), v != 0.
+  Knuth, TAOCP vol 2, 4.3.1, algorithm D.
+*/
+static void _w_divmod (const UNIT_TYPE *u, int m, const UNIT_TYPE *v, int n,
+		       UNIT_TYPE *q, UNIT_TYPE *r)
+{
+  UNIT_TYPE sbuf[2*BIGINT_STACK_DIGITS+1];
+  UNIT_TYPE *un, *vn;
+  int qn = m, rn = n;
+  int s;
+
+  for (int i=0; i < qn; i++) {
+    q[i] = 0;
+  }
+  for (int i=0; i < rn; i++) {
+    r[i] = 0;
+  }
+  while (n > 1 && v[n-1] == 0) n--;
+  while (m > 1 && u[m-1] == 0) m--;
+
+  if (m < n) {
+    for (int i=0; i < m; i++) {
+      r[i] = u[i];
+    }
+    return;
+  }
+
+  if (n == 1) {
+    UNIT_TYPE rem = 0;
+    for (int i=m-1; i >= 0; i--) {
+      q[i] = _udiv (rem, u[i], v[0], &rem);
+    }
+    r[0] = rem;
+    return;
+  }
+
+#ifdef BIGINT_HAVE_DBL
+  if (m == 2) {
+    /* two-digit operands: divide in double-width arithmetic */
+    bigint_dbl_t x = ((bigint_dbl_t)u[1] << BIGINT_BITS_ONE) | u[0];
+    bigint_dbl_t y = ((bigint_dbl_t)v[1] << BIGINT_BITS_ONE) | v[0];
+    bigint_dbl_t t = x / y;
+
+    q[0] = (UNIT_TYPE)t;
+    t = x - t*y;
+    r[0] = (UNIT_TYPE)t;
+    r[1] = (UNIT_TYPE)(t >> BIGINT_BITS_ONE);
+    return;
+  }
+#endif
+
+  if (m + n + 1 <= 2*BIGINT_STACK_DIGITS+1) {
+    un = sbuf;
+  }
+  else {
+    MALLOC (un, UNIT_TYPE, m + n + 1);
+  }
+  vn = un + m + 1;
+
+  /* normalize so that the top bit of the divisor is set */
+  s = _nlz (v[n-1]);
+  if (s == 0) {
+    for (int i=0; i < n; i++) {
+      vn[i] = v[i];
+    }
+    for (int i=0; i < m; i++) {
+      un[i] = u[i];
+    }
+    un[m] = 0;
+  }
+  else {
+    for (int i=n-1; i > 0; i--) {
+      vn[i] = (v[i] << s) | (v[i-1] >> (BIGINT_BITS_ONE-s));
+    }
+    vn[0] = v[0] << s;
+    un[m] = u[m-1] >> (BIGINT_BITS_ONE-s);
+    for (int i=m-1; i > 0; i--) {
+      un[i] = (u[i] << s) | (u[i-1] >> (BIGINT_BITS_ONE-s));
+    }
+    un[0] = u[0] << s;
+  }
+
+  for (int j=m-n; j >= 0; j--) {
+    UNIT_TYPE qhat, rhat, hi, lo, c, b;
+    int big;
+
+    /* estimate the quotient digit from the top two digits */
+    if (un[j+n] >= vn[n-1]) {
+      qhat = ~(UNIT_TYPE)0;
+      rhat = un[j+n-1] + vn[n-1];
+      big = (rhat < vn[n-1]);
+    }
+    else {
+      qhat = _udiv (un[j+n], un[j+n-1], vn[n-1], &rhat);
+      big = 0;
+    }
+    while (!big) {
+      lo = _umul (qhat, vn[n-2], &hi);
+      if (hi > rhat || (hi == rhat && lo > un[j+n-2])) {
+	qhat--;
+	rhat += vn[n-1];
+	big = (rhat < vn[n-1]);
+      }
+      else {
+	break;
+      }
+    }
+
+    /* un[j..j+n] -= qhat*vn */
+    c = 0;
+    b = 0;
+    for (int i=0; i < n; i++) {
+      UNIT_TYPE t, b1;
+      lo = _umul (qhat, vn[i], &hi);
+      lo = lo + c;
+      c = hi + (lo < c);
+      t = un[i+j] - lo;
+      b1 = (un[i+j] < lo);
+      un[i+j] = t - b;
+      b = b1 | (t < b);
+    }
+    {
+      UNIT_TYPE t = un[j+n] - c;
+      UNIT_TYPE b1 = (un[j+n] < c);
+      un[j+n] = t - b;
+      b = b1 | (t < b);
+    }
+    if (b) {
+      /* qhat was one too large: add back */
+      qhat--;
+      un[j+n] += _w_add (un+j, n, vn, n);
+    }
+    q[j] = qhat;
+  }
+
+  /* un-normalize the remainder */
+  for (int i=0; i < n; i++) {
+    if (s == 0) {
+      r[i] = un[i];
+    }
+    else {
+      r[i] = (un[i] >> s) | (un[i+1] << (BIGINT_BITS_ONE-s));
+    }
+  }
+  if (un != sbuf) {
+    FREE (un);
+  }
+}
+
+/* clear the bits above "width" in the top digit, like zeroClear() */
+static void _w_trim (UNIT_TYPE *w, int n, unsigned int width)
+{
+  int res = width - (n-1)*BIGINT_BITS_ONE;
+
+  if ((width % BIGINT_BITS_ONE) != 0 && res > 0 && res < (int)BIGINT_BITS_ONE) {
+    w[n-1] &= ~((~(UNIT_TYPE)0) << res);
+  }
+}
+
+/*
+  Unsigned magnitude of the number in w[0..len); returns 1 if the
+  number was negative
+*/
+int BigInt::_magnitude (UNIT_TYPE *w) const
+{
+  int neg = isSigned() && isNegative();
+
+  for (int i=0; i < len; i++) {
+    w[i] = neg ? ~getVal (i) : getVal (i);
+  }
+  if (neg) {
+    for (int i=0; i < len; i++) {
+      if (++w[i] != 0) break;
+    }
+  }
+  return neg;
+}
+
+/* two's complement in place, keeping the width */
+void BigInt::_negate ()
+{
+  UNIT_TYPE *w = getV ();
+  int i;
+
+  for (i=0; i < len; i++) {
+    w[i] = ~w[i];
+  }
+  for (i=0; i < len; i++) {
+    if (++w[i] != 0) break;
+  }
+}
+
 /*------------------------------------------------------------------------
  *
  *   Arithmetic
@@ -912,14 +1418,7 @@ BigInt BigInt::operator*(BigInt &b)
     b.issigned = 0;
   }
 
-  BigInt tmp(*this);
-  for (int i = 0; i < len; i++) {
-    tmp._setVal (i, 0);
-  }
-
-  tmp.toDynamic();
-  tmp.expandSpace(b.width);
-  tmp.width = width + b.width;
+  BigInt tmp(width + b.width, issigned, 1);
 
   if (isZero() == 1 || b.isZero() == 1) {
     return tmp;
@@ -951,125 +1450,75 @@ BigInt BigInt::operator*(BigInt &b)
     return tmp;
   }
 
-  int sa = 0;
+  UNIT_TYPE sbuf[3*BIGINT_STACK_DIGITS];
+  UNIT_TYPE *buf, *ya, *xb, *p;
+  int an, bn;
+  int sa;
 
-  BigInt x(b);
-  if (b.isSigned() && b.isNegative()) {
-    sa = sa ^ 0x1;
-    x = (-x);
+  if (2*(len + b.len) <= 3*BIGINT_STACK_DIGITS) {
+    buf = sbuf;
   }
-
-  BigInt y(*this);
-  if (isSigned() && isNegative()) {
-    sa = sa ^ 0x1;
-    y = (-y);
+  else {
+    MALLOC (buf, UNIT_TYPE, 2*(len + b.len));
   }
+  ya = buf;
+  xb = buf + len;
+  p = buf + len + b.len;
 
-  int k;
-  int l;
-  UNIT_TYPE carry = 0;
-
-  UNIT_TYPE mid = 0;
-
-  UNIT_TYPE par_prod1, par_prod2, par_prod3;
-  UNIT_TYPE a1, a2;
-  UNIT_TYPE b1, b2;
-
-  UNIT_TYPE um; //upper half mask
-  UNIT_TYPE lm; //lower half mask
-
-  um = 0;
-  um = ~um;
-  um = um >> (BIGINT_BITS_ONE/2);
-  lm = ~um;
-
-  for (auto i = 0; i < len; i++) {
-    for (auto j = 0; j < x.len; j++) {
-      k = i + j;
-
-      a1 = y.getVal (i) & um;
-      b1 = x.getVal (j) & um;
-      a2 = y.getVal (i) >> (BIGINT_BITS_ONE/2); 
-      b2 = x.getVal (j) >> (BIGINT_BITS_ONE/2);
+  sa = _magnitude (ya) ^ b._magnitude (xb);
 
-      par_prod1 = a1 * b1;
+  an = len;
+  bn = b.len;
+  while (an > 1 && ya[an-1] == 0) an--;
+  while (bn > 1 && xb[bn-1] == 0) bn--;
 
-      carry = (UNIT_TYPE)(par_prod1 + tmp.getVal (k)) < par_prod1;
-
-      tmp._setVal (k, tmp.getVal (k) + par_prod1);
-
-      l = k+1;
-      while (carry == 1) {
-        tmp._setVal (l, tmp.getVal (l) + carry);
-        if (tmp.getVal (l) == 0) {
-          carry = 1;
-          l++;
-        } else {
-          carry = 0;
-          break;
-        }
-      }
-
-      par_prod3 = a2 * b2;
-
-      carry = (UNIT_TYPE)(par_prod3 + tmp.getVal (k+1)) < par_prod3;
-
-      l = k+2;
-      while (carry == 1) {
-        tmp._setVal (l, tmp.getVal (l) + carry);
-        if (tmp.getVal (l) == 0) {
-          carry = 1;
-          l++;
-        } else {
-          carry = 0;
-          break;
-        }
-      }
-
-      tmp._setVal (k+1, tmp.getVal (k+1) + par_prod3);
-
-      mid = (tmp.getVal (k) >> BIGINT_BITS_ONE/2) | (tmp.getVal (k+1) << BIGINT_BITS_ONE/2);
-
-      par_prod2 = a2 * b1;
-      par_prod3 = a1 * b2;
-
-      carry = (UNIT_TYPE)(par_prod2 + par_prod3) < par_prod2;
-
-      par_prod2 = par_prod2 + par_prod3;
-
-      carry += (UNIT_TYPE)(mid + par_prod2) < mid;
-
-      mid = mid + par_prod2;
-
-      tmp._setVal (k,  (tmp.getVal (k) & um) | ((mid & um) << BIGINT_BITS_ONE/2));
-      tmp._setVal (k+1, (tmp.getVal (k+1) & lm) | ((mid & lm) >> BIGINT_BITS_ONE/2));
-
-      if (carry > 0) {
-        carry = carry << (BIGINT_BITS_ONE/2);
-        
-        l = k + 1;
-        while (carry > 0) {
-          if ((UNIT_TYPE)(tmp.getVal (l) + carry) < tmp.getVal (l)) {
-            tmp._setVal (l, tmp.getVal (l) + carry);
-            carry = 1;
-            l++;
-          } else {
-            tmp._setVal (l, tmp.getVal (l) + carry);
-            carry = 0;
-          }
-        }
-      }
+  UNIT_TYPE *r = tmp.getV ();
+  if (an == 1 && bn == 1) {
+    UNIT_TYPE hi;
+    r[0] = _umul (ya[0], xb[0], &hi);
+    if (tmp.len > 1) {
+      r[1] = hi;
     }
   }
+  else if (an <= 2 && bn <= 2) {
+    UNIT_TYPE a2[2], b2[2], p4[4];
+    a2[0] = ya[0];
+    a2[1] = (an == 2 ? ya[1] : 0);
+    b2[0] = xb[0];
+    b2[1] = (bn == 2 ? xb[1] : 0);
+    _w_mul_2x2 (p4, a2, b2);
+    for (int i=0; i < an+bn && i < tmp.len; i++) {
+      r[i] = p4[i];
+    }
+  }
+  else if (an + bn <= tmp.len) {
+    _w_mul (r, ya, an, xb, bn);
+  }
+  else {
+    /* the product always fits; only leading zero digits are dropped */
+    _w_mul (p, ya, an, xb, bn);
+    for (int i=0; i < tmp.len; i++) {
+      r[i] = p[i];
+    }
+  }
+  if (buf != sbuf) {
+    FREE (buf);
+  }
 
-  if(sa) {
-    tmp = (-tmp);
+  if (sa) {
+    tmp._negate ();
     tmp.toSigned();
   }
 
   return tmp;
 }
 
+BigInt &BigInt::operator*=(BigInt &b)
+{
+  *this = (*this) * b;
+  return *this;
+}
+
 void BigInt::_div(BigInt &b, int func)
 {
   if (isSigned() != b.isSigned()) {
@@ -1105,24 +1554,23 @@ void BigInt::_div(BigInt &b, int func)
     }
   }
 
-  int sa = 0;
-  BigInt x;
-  if (b.isSigned() && b.isNegative()) {
-    x = (-b);
-    sa = sa ^ 0x1;
-  } else {
-    x = b;
-  }
-
-  BigInt y;
-  if (isSigned() && isNegative()) {
-    y = (-(*this));
-    sa = sa ^ 0x1;
-  } else {
-    y = *this;
-  }
+  int sa = (isSigned() && isNegative()) ^ (b.isSigned() && b.isNegative());
 
   if (width <= BIGINT_BITS_ONE && b.width <= BIGINT_BITS_ONE) {
+    BigInt x;
+    if (b.isSigned() && b.isNegative()) {
+      x = (-b);
+    } else {
+      x = b;
+    }
+
+    BigInt y;
+    if (isSigned() && isNegative()) {
+      y = (-(*this));
+    } else {
+      y = *this;
+    }
+
     if (func == 0) {
       y._setVal (0, y.getVal (0)/x.getVal (0));
     } else {
@@ -1135,75 +1583,49 @@ void BigInt::_div(BigInt &b, int func)
     return;
   }
 
-  x.toUnsigned();
-  y.toUnsigned();
+  /* word-level long division of the magnitudes, in place */
+  UNIT_TYPE sbuf[4*BIGINT_STACK_DIGITS];
+  UNIT_TYPE *buf, *ya, *xb, *q, *r;
+  UNIT_TYPE *res;
 
-  BigInt tmp_q(*this);
-  BigInt tmp_r(*this);
-  for (int i = 0; i < len; i++) {
-    tmp_q._setVal (i, 0);
-    tmp_r._setVal (i, 0);
+  if (2*(len + b.len) <= 4*BIGINT_STACK_DIGITS) {
+    buf = sbuf;
+  }
+  else {
+    MALLOC (buf, UNIT_TYPE, 2*(len + b.len));
   }
-  tmp_q.toUnsigned();
-  tmp_q.toStatic();
+  ya = buf;
+  xb = ya + len;
+  q = xb + b.len;
+  r = q + len;
 
-  tmp_r.toUnsigned();
-  tmp_r.toStatic();
+  _magnitude (ya);
+  b._magnitude (xb);
+  _w_trim (ya, len, width);
+  _w_trim (xb, b.len, b.width);
 
-  BigInt one;
-  one.toStatic();
-  one.toUnsigned();
-  UNIT_TYPE l_one = 1;
-  one = l_one;
+  _w_divmod (ya, len, xb, b.len, q, r);
 
-  unsigned int word_num = len-1;
-  unsigned int res = width % BIGINT_BITS_ONE;
-  unsigned int shift = (res == 0) ? (BIGINT_BITS_ONE -1) : (res -1);
-  
-  for (auto k = width; k > 0; k--) {
-    tmp_q <<= 1;
-    tmp_r <<= 1;
-
-    if (((y.getVal (word_num) >> shift) & 0x1) == 1) {
-      tmp_r += one;
-    }
-    if (tmp_r >= x) {
-      tmp_r -= x;
-      tmp_q += one;
+  res = getV ();
+  for (int i=0; i < len; i++) {
+    if (func == 0) {
+      res[i] = q[i];
     }
-
-    if (shift == 0) {
-      word_num--;
-      shift = BIGINT_BITS_ONE -1;
-    } else {
-      shift--;
+    else {
+      res[i] = (i < b.len) ? r[i] : 0;
     }
   }
-
-  if (sa) {
-    if (func == 0) {
-      tmp_q = (-tmp_q);
-      tmp_q.toSigned();
-    } else {
-      tmp_r = (-tmp_r);
-      tmp_r.toSigned();
-    } 
-  }
-
-  if (isDynamic() == 0) {
-    if (func == 0) {
-      tmp_q.adjlen(len);
-    } else {
-      tmp_r.adjlen(len);
-    }
+  if (buf != sbuf) {
+    FREE (buf);
   }
 
-  if (func == 0) {
-    *this = tmp_q;
-  } else {
-    *this = tmp_r;
+  /* the result is static and unsigned unless it was negated */
+  issigned = 0;
+  isdynamic = 0;
+  if (sa) {
+    _negate ();
+    toSigned ();
   }
-
 }
 
 BigInt BigInt::operator/(BigInt &b)
@@ -1218,6 +1640,18 @@ BigInt BigInt::operator%(BigInt &b)
   return *this;
 }
 
+BigInt &BigInt::operator/=(BigInt &b)
+{
+  _div(b, 0);
+  return *this;
+}
+
+BigInt &BigInt::operator%=(BigInt &b)
+{
+  _div(b, 1);
+  return *this;
+}
+
 /*------------------------------------------------------------------------
  *
  *   Return Nth bit
@@ -1244,12 +1678,8 @@ unsigned int BigInt::nBit(unsigned long n)
  */
 int BigInt::isZero () const
 {
-  if (len >= 2) {
-    for (auto i = 0; i < len; i++) {
-      if (u.v[i] != 0) return 0;
-    }
-  } else {
-    if (u.value != 0) return 0;
+  for (auto i = 0; i < len; i++) {
+    if (getVal (i) != 0) return 0;
   }
   return 1;
 }
@@ -1270,17 +1700,12 @@ int BigInt::isOne () const
 
 int BigInt::isOneInt() const
 {
-  if (len >= 2) {
-    for (auto i = 1; i < len; i++) {
-      if (u.v[i] != 0) {
-        return 0;
-      }
+  for (auto i = 1; i < len; i++) {
+    if (getVal (i) != 0) {
+      return 0;
     }
-    //squeezeSpace((len-1) * BIGINT_BITS_ONE);
-    return 1;
-  } else {
-    return 1;
   }
+  return 1;
 }
 /*------------------------------------------------------------------------
  *
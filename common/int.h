@@ -63,12 +63,21 @@
 
 #define BIGINT_BITS_ONE (8*sizeof (UNIT_TYPE))
 
+/*
+  Numbers up to BIGINT_INLINE units are stored inside the BigInt;
+  wider ones use a buffer from a per-thread pool.
+*/
+#ifndef BIGINT_INLINE
+#define BIGINT_INLINE 4
+#endif
+
 class BigInt {
 public:
   BigInt () {
     len = 1;
     width = 1;
-    u.value = 0;
+    cap = 0;
+    u.value[0] = 0;
     isdynamic = 0;
     issigned = 0;
   }
@@ -76,12 +85,12 @@ public:
   BigInt (int w, int s, int d); 
 
   ~BigInt () {
-    if (len >= 2) {
-      FREE (u.v);
+    if (cap) {
+      _free_words (u.v, cap);
     }
   }
 
-  BigInt (BigInt &);    // copy constructor
+  BigInt (const BigInt &);    // copy constructor
   BigInt (BigInt &&);   // move constructor
 
   BigInt& operator=(const BigInt &);            // copy assignment
@@ -110,6 +119,9 @@ public:
   BigInt operator*(BigInt &);   
   BigInt operator/(BigInt &);   
   BigInt operator%(BigInt &);   
+  BigInt &operator*=(BigInt &);  // in-place variants
+  BigInt &operator/=(BigInt &);
+  BigInt &operator%=(BigInt &);
 
   BigInt &operator&=(const BigInt &);  
   BigInt &operator|=(const BigInt &);  
@@ -144,7 +156,7 @@ public:
   void decPrint (FILE *fp, int w = 0) const;
   
 
-  UNIT_TYPE getVal(int n) const { if (len >= 2) return u.v[n]; else return u.value; }
+  UNIT_TYPE getVal(int n) const { return cap ? u.v[n] : u.value[n]; }
   void setVal (int n, UNIT_TYPE nv) {
     if (n > len) {
       expandSpace(sizeof(UNIT_TYPE));
@@ -159,6 +171,10 @@ public:
   int isZero() const; //number is all zeros
 
   static BigInt sscan(const char *s);
+
+  /* multiply operands of at least n digits using Karatsuba; n <= 0
+     restores the default. Used for testing. */
+  static void setKaratsuba (int n);
   
 private:
   
@@ -166,47 +182,43 @@ private:
   short len;           // UNIT_TYPE amount
   unsigned int issigned:1;     // 1 - signed, 0 - unsigned
   unsigned int isdynamic:1;    // 1 - dynamic(no overflows) 0 - static
+  int cap;                     // units in u.v; 0 if stored in u.value
   
   union {
     UNIT_TYPE *v; // actual bits; 2's complement
-    UNIT_TYPE value;  // used when len <= 1 to avoid allocation
+    UNIT_TYPE value[BIGINT_INLINE];  // used when cap == 0
   } u;
   // rep. The number is sign-extended to the maximum width of the rep
 
   int isOneInt() const;
 
   inline void _setVal (int n, UNIT_TYPE nv) {
-    if (len >= 2) {
+    if (cap) {
       u.v[n] = nv;
     }
     else {
-      u.value = nv;
+      u.value[n] = nv;
     }
   }
 
+  /* make room for newlen units, keeping the current ones; a larger
+     buffer is kept when the number shrinks */
   inline void _adjlen (int newlen) {
-    if (len == newlen) return;
-    if (len <= 1) {
-      if (newlen >= 2) {
-        UNIT_TYPE oval = u.value;
-        MALLOC (u.v, UNIT_TYPE, newlen);
-        u.v[0] = oval;
-      }
-    } else {
-      if (newlen >= 2) {
-        REALLOC (u.v, UNIT_TYPE, newlen);
-      } else {
-        UNIT_TYPE oval = u.v[0];
-        FREE (u.v);
-        u.value = oval;
-      }
+    if (newlen > (cap ? cap : BIGINT_INLINE)) {
+      _grow (newlen, 1);
     }
     /* if this became zero width, clear the value */
-    if (newlen == 0) u.value = 0;
+    if (newlen == 0) _setVal (0, 0);
   }
 
+  void _grow (int newlen, int keep);
+  static UNIT_TYPE *_alloc_words (int n, int *cap);
+  static void _free_words (UNIT_TYPE *v, int cap);
+
   void _add (const BigInt &b, int cin);
   void _div (BigInt &b, int func);  //0 - div, 1 - rem
+  int _magnitude (UNIT_TYPE *w) const; // |value| into w[0..len)
+  void _negate ();                     // two's complement in place
 
   void signExtend ();
 
@@ -218,7 +230,7 @@ private:
 
   void cutZero(); //helper function to zero MSB zeros
 
-  UNIT_TYPE* getV() { if (len >= 2) return u.v; else return &u.value; };
+  UNIT_TYPE* getV() { return cap ? u.v : u.value; };
 };
 
 
@@ -262,7 +262,7 @@ static LEX_T *lmalloc (void)
 static void skipline (LEX_T *l)
 {
   int ln;
-  static char file[1024];
+  static __thread char file[1024];
   int i;
   int found = 0;
   
@@ -27,7 +27,7 @@
 #include "qops.h"
 
 
-static listitem_t *freelist = NULL;
+static __thread listitem_t *freelist = NULL;
 
 
 static listitem_t *allocitem (void)
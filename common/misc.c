@@ -27,6 +27,9 @@
 #include <ctype.h>
 #include "misc.h"
 
+int mem_alloc_counting = 0;
+unsigned long mem_alloc_count = 0;
+
 
 #ifdef MEM_DEBUG
 
@@ -62,6 +65,16 @@ void mem_log (const char *s, ...)
 #endif
 
 
+static __thread void (*fatal_hook) (void) = NULL;
+
+/*-------------------------------------------------------------------------
+ * install a per-thread fatal error handler
+ *-----------------------------------------------------------------------*/
+void fatal_error_hook (void (*f)(void))
+{
+  fatal_hook = f;
+}
+
 /*-------------------------------------------------------------------------
  * print error message and die.
  *-----------------------------------------------------------------------*/
@@ -69,6 +82,10 @@ void fatal_error (const char *s, ...)
 {
   va_list ap;
 
+  if (fatal_hook) {
+    (*fatal_hook) ();
+  }
+
   fprintf (stderr, "FATAL: ");
   va_start (ap, s);
   vfprintf (stderr, s, ap);
@@ -31,6 +31,20 @@
 extern "C" {
 #endif
 
+/*
+  Allocation counter (used by profilers). While mem_alloc_counting is
+  set, every MALLOC/REALLOC/NEW increments mem_alloc_count.
+*/
+extern int mem_alloc_counting;
+extern unsigned long mem_alloc_count;
+
+#define MEM_COUNT()							\
+  do {									\
+    if (mem_alloc_counting) {						\
+      __sync_fetch_and_add (&mem_alloc_count, 1);			\
+    }									\
+  } while (0)
+
 #ifndef MALLOC
 
 #ifdef MEM_DEBUG
@@ -48,6 +62,7 @@ void mem_log (const char *s, ...);
     fprintf (stderr, "FATAL: allocating zero-length block.\n\tFile %s, line %d\n", __FILE__, __LINE__); \
     exit (2);								\
   } else {								\
+    MEM_COUNT ();							\
     var = (type *) malloc (sizeof(type)*(size));			\
     if (!var) {								\
       fprintf (stderr, "FATAL: malloc of size %lu failed!\n\tFile %s, line %d\n", sizeof(type)*(size), __FILE__, __LINE__); \
@@ -66,6 +81,7 @@ void mem_log (const char *s, ...);
       exit (2);								\
     } else {								\
       MEM_LOG (("dealloc'ed %x @ %s:%d", var, __FILE__, __LINE__)); \
+      MEM_COUNT ();							\
       var = (type *) realloc (var, sizeof(type)*(size));		\
       if (!var) {							\
 	fprintf (stderr, "FATAL: realloc of size %lu failed!\n\tFile %s, line %d\n", sizeof(type)*(size), __FILE__, __LINE__); \
@@ -87,6 +103,13 @@ void mem_log (const char *s, ...);
 #define MAX(a,b) ( ((a) > (b)) ? (a) : (b) )
 
 void fatal_error (const char *s, ...);
+
+/*
+  Per-thread hook called by fatal_error() before it prints anything;
+  a hook that does not return (e.g. throws an exception) replaces the
+  default print-and-exit behavior for that thread. NULL removes it.
+*/
+void fatal_error_hook (void (*f)(void));
 void warning (const char *s, ...);
 char *Strdup (const char *);
 int my_strequalcase (const char *a, const char *b);
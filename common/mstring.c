@@ -23,6 +23,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "mstring.h"
 #include "misc.h"
 
@@ -34,6 +35,9 @@ struct strHashtable {
 
 static struct strHashtable *sH = NULL;
 
+/* the table is shared by all threads */
+static pthread_mutex_t sH_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*-- note this is copied from hash.c --*/
 
 static int T[] =
@@ -190,6 +194,7 @@ mstring_t *string_create (const char *s)
   int i;
   mstring_t *b;
 
+  pthread_mutex_lock (&sH_lock);
   string_init ();
 
   if (sH->n > (sH->size << 2)) {
@@ -205,7 +210,7 @@ mstring_t *string_create (const char *s)
     }
   }
   if (b) {
-    b->ref++;
+    __sync_fetch_and_add (&b->ref, 1);
   }
   else {
     b = (mstring_t *)malloc (sizeof (mstring_t) + strlen (s)*sizeof (char));
@@ -217,19 +222,20 @@ mstring_t *string_create (const char *s)
   }
 
   /*check_table (sH);*/
+  pthread_mutex_unlock (&sH_lock);
 
   return b;
 }
 		       
 mstring_t *string_dup (mstring_t *s)
 {
-  s->ref++;
+  __sync_fetch_and_add (&s->ref, 1);
   return s;
 }
 
 void string_free (mstring_t *s)
 {
-  s->ref--;
+  __sync_fetch_and_sub (&s->ref, 1);
   /* if s->ref == 0... */
 }
 
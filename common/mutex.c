@@ -25,9 +25,6 @@
 #include "mutex.h"
 #include "qops.h"
 
-extern lthread_t *readyQh;
-extern lthread_t *readyQt;
-
 
 /*------------------------------------------------------------------------
  *------------------------------------------------------------------------
@@ -50,6 +47,7 @@ mutex_t *mutex_new (void)
   }
   t->busy = 0;
   t->hd = NULL;
+  t->lk = 0;
   context_enable ();
   return t;
 }
@@ -61,16 +59,24 @@ void mutex_free (mutex_t *m)
   context_enable ();
 }
 
+/*
+ * An unlock with waiters hands the mutex straight to the first one, so
+ * the mutex is never free while someone is queued on it.
+ */
 static void mutex_lock_safe (mutex_t *m)
 {
+  lthread_t *t;
+
+  thread_lock (&m->lk);
   if (m->busy) {
-    q_ins (m->hd, m->tl, current_process);
-    context_switch (context_select ());
+    t = lthread_self;
+    q_ins (m->hd, m->tl, t);
+    thread_suspend (&m->lk);
     context_disable ();
-    if (m->busy)
-      printf ("HMMMMM!\n");
+    return;
   }
   m->busy = 1;
+  thread_unlock (&m->lk);
 }
 
 void mutex_lock (mutex_t *m)
@@ -83,16 +89,20 @@ void mutex_lock (mutex_t *m)
 static void mutex_unlock_safe (mutex_t *m)
 {
   lthread_t *t;
-  if (m->busy)
-    m->busy = 0;
-  else {
+
+  thread_lock (&m->lk);
+  if (!m->busy) {
     printf ("ERROR: unlock of an unlocked mutex!\n");
     exit (1);
   }
   if (m->hd) {
     q_del (m->hd, m->tl, t);
-    q_ins (readyQh, readyQt, t);
-    t->in_readyq = 1;
+    thread_unlock (&m->lk);
+    thread_make_ready (t);
+  }
+  else {
+    m->busy = 0;
+    thread_unlock (&m->lk);
   }
 }
 
@@ -126,6 +136,7 @@ cond_t *cond_new (mutex_t *m)
   c->hd = NULL;
   c->tl = NULL;
   c->lock = m;
+  c->lk = 0;
   context_enable ();
   return c;
 }
@@ -139,24 +150,35 @@ void cond_free (cond_t *c)
 
 void cond_wait (cond_t *c)
 {
+  lthread_t *t;
+
   context_disable ();
+  t = lthread_self;
+  thread_lock (&c->lk);
   mutex_unlock_safe (c->lock);
-  q_ins (c->hd, c->tl, current_process);
-  context_switch (context_select ());
+  q_ins (c->hd, c->tl, t);
+  thread_suspend (&c->lk);
 }
 
+/*
+ * The mutex is handed to the signalled thread; with no waiters it is
+ * released.
+ */
 void cond_signal (cond_t *c)
 {
   lthread_t *t;
 
   context_disable ();
+  thread_lock (&c->lk);
   if (c->hd) {
     q_del (c->hd, c->tl, t);
-    q_ins (readyQh, readyQt, t);
-    t->in_readyq = 1;
+    thread_unlock (&c->lk);
+    thread_make_ready (t);
   }
-  else
+  else {
+    thread_unlock (&c->lk);
     mutex_unlock_safe (c->lock);
+  }
   context_enable ();
 }
 
@@ -33,11 +33,13 @@ extern "C" {
 typedef struct {
   lthread_t *hd, *tl;
   int busy;
+  int lk;			/* protects the fields above */
 } mutex_t;
 
 typedef struct {
   lthread_t *hd, *tl;
   mutex_t *lock;
+  int lk;			/* protects the wait queue */
 } cond_t;
 
 mutex_t *mutex_new (void);
@@ -19,105 +19,676 @@
  *
  **************************************************************************
  */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
 #include "simdes.h"
 #include "int.h"
+#include "array.h"
 
-/* globals for sim object */
-int SimDES::initialized_sim = 0;
+/* per-thread state */
+thread_local SimEngine *SimEngine::current = NULL;
+thread_local Event *Event::ev_queue = NULL;
 
-int SimDES::_interrupt = 0;
+SimEngine::SimEngine ()
+{
+  curobj = NULL;
+  initialized_sim = 0;
+  _interrupt = 0;
+  for (int i=0; i < SIM_TIME_SIZE; i++) {
+    tm_offset[i] = 0;
+  }
+  curtime = 0;
+  w_now = 0;
+  memset (&w0, 0, sizeof (w0));
+  memset (&w1, 0, sizeof (w1));
+  n0 = 0;
+  n1 = 0;
+  far = heap_new (32);
+  ndead = 0;
+  nrevoked = 0;
+  by_type = NULL;
+  type_on = NULL;
+  ntypes = 0;
+  nevents = 0;
+
+  A_INIT (objs);
+  ck_seq = 0;
+  ck_prefix = NULL;
+  ck_interval = 0;
+  ck_next = 0;
+  ck_full_every = 8;
+
+  par = NULL;
+  part_id = 0;
+  mail_seq = 0;
+  mbox = NULL;
+}
 
-/* globals for events */
-Heap *SimDES::all = NULL;
-unsigned long SimDES::tm_offset[SIM_TIME_SIZE];
-unsigned long SimDES::curtime = 0;
-Event *Event::ev_queue = NULL;
-SimDES *SimDES::curobj = NULL;
+SimEngine::~SimEngine ()
+{
+  Init ();
+  heap_free (far, NULL);
+  if (by_type) {
+    FREE (by_type);
+    FREE (type_on);
+  }
+  A_FREE (objs);
+  if (ck_prefix) {
+    FREE (ck_prefix);
+  }
+  if (current == this) {
+    current = NULL;
+  }
+}
+
+SimEngine *SimEngine::Current ()
+{
+  if (!current) {
+    current = new SimEngine ();
+  }
+  return current;
+}
+
+void SimEngine::Init()
+{
+  for (int i=0;  i < SIM_TIME_SIZE; i++) {
+    tm_offset[i] = 0;
+  }
+  _q_clear ();
+  curtime = 0;
+  w_now = 0;
+  initialized_sim = 1;
+  ck_seq = 0;
+  ck_next = ck_interval;
+}
 
 /* create and destroy */
-SimDES::SimDES ()
+SimDES::SimDES (SimEngine *e)
 {
   break_point = 0;
   flags = 0;
 
-  if (!all) {
-    /* first time I'm here */
-    all = heap_new (32);
-  }
+  eng = e ? e : SimEngine::Current ();
+  pending = NULL;
 
-  if (!initialized_sim) {
-    initialized_sim = 1;
+  A_NEW (eng->objs, SimDES *);
+  A_NEXT (eng->objs) = this;
+  obj_id = A_LEN (eng->objs);
+  A_INC (eng->objs);
+  ck_dirty = 1;
+
+  if (!eng->initialized_sim) {
+    eng->initialized_sim = 1;
     for (int i=0; i < SIM_TIME_SIZE; i++) {
-      SimDES::tm_offset[i] = 0;
+      eng->tm_offset[i] = 0;
     }
   }
 }
 
-void SimDES::Init()
+/*
+  Objects must not outlive their engine. Events still pending for the
+  object are revoked, so the queue never refers to a deleted object.
+*/
+SimDES::~SimDES ()
 {
-  for (int i=0;  i < SIM_TIME_SIZE; i++) {
-    SimDES::tm_offset[i] = 0;
+  while (pending) {
+    pending->Remove ();
   }
-  SimDES::curtime = 0;
-  initialized_sim = 1;
+  eng->objs[obj_id] = NULL;
+}
+
+/*
+ * Timing wheel
+ */
+#define WORD_BITS (8*sizeof (unsigned long))
+#define WHEEL_MASK ((unsigned long)SIM_WHEEL_SZ-1)
+#define SPAN_MASK  ((1UL << (2*SIM_WHEEL_BITS))-1)
+
+/* first non-empty slot >= pos, -1 if none */
+int SimEngine::_wheel_next (struct sim_wheel *w, int pos)
+{
+  int i = pos / WORD_BITS;
+  unsigned long x = w->bm[i] & (~0UL << (pos % WORD_BITS));
 
-  for (int i=0; i < all->sz; i++) {
-    Event *ev = (Event *) all->value[i];
+  while (1) {
+    if (x) {
+      return i*WORD_BITS + __builtin_ctzl (x);
+    }
+    i++;
+    if (i == (int)SIM_WHEEL_WORDS) {
+      return -1;
+    }
+    x = w->bm[i];
+  }
+}
+
+void SimEngine::_wheel_add (struct sim_wheel *w, int slot, Event *ev, int front)
+{
+  if (!w->hd[slot]) {
+    ev->next = NULL;
+    ev->prev = NULL;
+    w->hd[slot] = ev;
+    w->tl[slot] = ev;
+    w->bm[slot/WORD_BITS] |= 1UL << (slot % WORD_BITS);
+  }
+  else if (front) {
+    ev->next = w->hd[slot];
+    ev->prev = NULL;
+    w->hd[slot]->prev = ev;
+    w->hd[slot] = ev;
+  }
+  else {
+    ev->next = NULL;
+    ev->prev = w->tl[slot];
+    w->tl[slot]->next = ev;
+    w->tl[slot] = ev;
+  }
+}
+
+void SimEngine::_wheel_unlink (struct sim_wheel *w, int slot, Event *ev)
+{
+  if (ev->prev) {
+    ev->prev->next = ev->next;
+  }
+  else {
+    w->hd[slot] = ev->next;
+  }
+  if (ev->next) {
+    ev->next->prev = ev->prev;
+  }
+  else {
+    w->tl[slot] = ev->prev;
+  }
+  if (!w->hd[slot]) {
+    w->bm[slot/WORD_BITS] &= ~(1UL << (slot % WORD_BITS));
+  }
+}
+
+/* detach the whole list in a slot */
+Event *SimEngine::_wheel_take (struct sim_wheel *w, int slot)
+{
+  Event *ev = w->hd[slot];
+  w->hd[slot] = NULL;
+  w->tl[slot] = NULL;
+  w->bm[slot/WORD_BITS] &= ~(1UL << (slot % WORD_BITS));
+  return ev;
+}
+
+static int _any (void *cookie, Event *ev, unsigned long tm)
+{
+  return 1;
+}
+
+/*
+ * Pending event indices
+ */
+void SimEngine::_pend_add (Event *ev)
+{
+  SimDES *o = ev->obj;
+  int t = ev->ev_type;
+
+  ev->o_prev = NULL;
+  ev->o_next = o->pending;
+  if (o->pending) {
+    o->pending->o_prev = ev;
+  }
+  o->pending = ev;
+
+  if (t >= ntypes || !type_on[t]) {
+    return;
+  }
+  ev->t_prev = NULL;
+  ev->t_next = by_type[t];
+  if (by_type[t]) {
+    by_type[t]->t_prev = ev;
+  }
+  by_type[t] = ev;
+}
+
+void SimEngine::_pend_del (Event *ev)
+{
+  if (ev->o_prev) {
+    ev->o_prev->o_next = ev->o_next;
+  }
+  else {
+    ev->obj->pending = ev->o_next;
+  }
+  if (ev->o_next) {
+    ev->o_next->o_prev = ev->o_prev;
+  }
+
+  if (ev->ev_type >= ntypes || !type_on[ev->ev_type]) {
+    return;
+  }
+  if (ev->t_prev) {
+    ev->t_prev->t_next = ev->t_next;
+  }
+  else {
+    by_type[ev->ev_type] = ev->t_next;
+  }
+  if (ev->t_next) {
+    ev->t_next->t_prev = ev->t_prev;
+  }
+}
+
+/*
+ * Insert a new pending event at time tm (>= w_now). If front is set,
+ * it goes ahead of other events at the same time.
+ */
+void SimEngine::_q_insert (unsigned long tm, Event *ev, int front)
+{
+  _pend_add (ev);
+  _q_place (tm, ev, front);
+}
+
+void SimEngine::_q_place (unsigned long tm, Event *ev, int front)
+{
+  ev->tm_lo = tm & SPAN_MASK;
+  if ((tm >> SIM_WHEEL_BITS) == (w_now >> SIM_WHEEL_BITS)) {
+    _wheel_add (&w0, tm & WHEEL_MASK, ev, front);
+    ev->q = SIM_EVQ_W0;
+    n0++;
+  }
+  else if ((tm >> (2*SIM_WHEEL_BITS)) == (w_now >> (2*SIM_WHEEL_BITS))) {
+    _wheel_add (&w1, (tm >> SIM_WHEEL_BITS) & WHEEL_MASK, ev, front);
+    ev->q = SIM_EVQ_W1;
+    n1++;
+  }
+  else {
+    heap_insert (far, tm, ev);
+    ev->q = SIM_EVQ_FAR;
+  }
+}
+
+/* drop revoked events from the top of the far heap */
+void SimEngine::_far_purge ()
+{
+  Event *ev;
+
+  while (heap_size (far) > 0) {
+    ev = (Event *) heap_peek_min (far);
+    if (!ev->kill) {
+      return;
+    }
+    heap_remove_min (far);
+    ndead--;
     delete ev;
-    all->value[i] = NULL;
   }
-  all->sz = 0;
 }
 
 /*
-  Nothing to do here...
-*/
-SimDES::~SimDES ()
-{ }
+ * Revoke a pending event
+ */
+void SimEngine::_revoke (Event *ev)
+{
+  if (ev->kill) {
+    return;
+  }
+  nrevoked++;
+  switch (ev->q) {
+  case SIM_EVQ_NONE:
+    /* being executed, or in a mailbox */
+    ev->kill = 1;
+    return;
+
+  case SIM_EVQ_W0:
+    _wheel_unlink (&w0, ev->tm_lo & WHEEL_MASK, ev);
+    n0--;
+    break;
+
+  case SIM_EVQ_W1:
+    _wheel_unlink (&w1, (ev->tm_lo >> SIM_WHEEL_BITS) & WHEEL_MASK, ev);
+    n1--;
+    break;
+
+  case SIM_EVQ_FAR:
+    /* dropped when it reaches the top of the heap */
+    ev->kill = 1;
+    _pend_del (ev);
+    ndead++;
+    return;
+  }
+  _pend_del (ev);
+  ev->q = SIM_EVQ_NONE;
+  delete ev;
+}
+
+void Event::Remove ()
+{
+  obj->eng->_revoke (this);
+}
+
+struct type_match {
+  int ev_type;
+  A_DECL (Event *, evs);
+};
+
+static int _collect_type (void *cookie, Event *ev, unsigned long tm)
+{
+  struct type_match *m = (struct type_match *)cookie;
+  if (ev->getType() == m->ev_type) {
+    A_NEW (m->evs, Event *);
+    A_NEXT (m->evs) = ev;
+    A_INC (m->evs);
+  }
+  return 0;
+}
+
+static int _is_type (void *cookie, Event *ev, unsigned long tm)
+{
+  return ev->getType() == (long)cookie;
+}
+
+void SimEngine::indexType (int ev_type)
+{
+  struct type_match m;
+  Event *ev;
+
+  if (ev_type >= ntypes) {
+    int sz = (ev_type < 8 ? 16 : 2*ev_type);
+    if (by_type) {
+      REALLOC (by_type, Event *, sz);
+      REALLOC (type_on, unsigned char, sz);
+    }
+    else {
+      MALLOC (by_type, Event *, sz);
+      MALLOC (type_on, unsigned char, sz);
+    }
+    for (int i=ntypes; i < sz; i++) {
+      by_type[i] = NULL;
+      type_on[i] = 0;
+    }
+    ntypes = sz;
+  }
+  if (type_on[ev_type]) {
+    return;
+  }
+  /* index the events that are already pending */
+  m.ev_type = ev_type;
+  A_INIT (m.evs);
+  _q_scan (_collect_type, &m);
+  type_on[ev_type] = 1;
+  for (int i=A_LEN (m.evs)-1; i >= 0; i--) {
+    ev = m.evs[i];
+    ev->t_prev = NULL;
+    ev->t_next = by_type[ev_type];
+    if (by_type[ev_type]) {
+      by_type[ev_type]->t_prev = ev;
+    }
+    by_type[ev_type] = ev;
+  }
+  A_FREE (m.evs);
+}
+
+Event *SimEngine::findPending (SimDES *obj, int ev_type)
+{
+  Event *ev;
+
+  if (obj) {
+    for (ev = obj->pending; ev; ev = ev->o_next) {
+      if (ev_type == -1 || ev->ev_type == ev_type) {
+	return ev;
+      }
+    }
+    return NULL;
+  }
+  if (ev_type == -1) {
+    return _q_scan (_any, NULL);
+  }
+  if (ev_type < ntypes && type_on[ev_type]) {
+    return by_type[ev_type];
+  }
+  return _q_scan (_is_type, (void *)(long)ev_type);
+}
 
 /*
- * Create a new event, insert into the queue
+ * w0 is empty: move the next w1 slot into w0, or pull in the next
+ * span from the far heap.
  */
-Event::Event (SimDES *s, int event_type, int delay, void *_cause)
+void SimEngine::_q_refill ()
+{
+  Event *ev, *tmp;
+  int s;
+
+  if (n1 > 0) {
+    s = _wheel_next (&w1, 0);
+    w_now = (w_now & ~SPAN_MASK) | ((unsigned long)s << SIM_WHEEL_BITS);
+    for (ev = _wheel_take (&w1, s); ev; ev = tmp) {
+      tmp = ev->next;
+      _wheel_add (&w0, ev->tm_lo & WHEEL_MASK, ev, 0);
+      ev->q = SIM_EVQ_W0;
+      n1--;
+      n0++;
+    }
+  }
+  else {
+    heap_key_t k;
+    unsigned long tm;
+
+    _far_purge ();
+    if (heap_size (far) == 0) {
+      return;
+    }
+    tm = heap_peek_minkey (far);
+    w_now = tm;
+    while (heap_size (far) > 0 &&
+	   (heap_peek_minkey (far) >> (2*SIM_WHEEL_BITS)) ==
+	   (tm >> (2*SIM_WHEEL_BITS))) {
+      ev = (Event *) heap_remove_min_key (far, &k);
+      if (ev->kill) {
+	ndead--;
+	delete ev;
+      }
+      else {
+	_q_place (k, ev, 0);
+      }
+    }
+  }
+}
+
+/*
+ * Time of the earliest pending event; returns 0 if there is none.
+ */
+int SimEngine::_q_peek (unsigned long *tm)
+{
+  Event *ev;
+
+  if (n0 > 0) {
+    *tm = (w_now & ~WHEEL_MASK) | _wheel_next (&w0, w_now & WHEEL_MASK);
+    return 1;
+  }
+  if (n1 > 0) {
+    ev = w1.hd[_wheel_next (&w1, 0)];
+    *tm = ev->tm_lo;
+    for (ev = ev->next; ev; ev = ev->next) {
+      if (ev->tm_lo < *tm) {
+	*tm = ev->tm_lo;
+      }
+    }
+    *tm |= w_now & ~SPAN_MASK;
+    return 1;
+  }
+  _far_purge ();
+  if (heap_size (far) > 0) {
+    *tm = heap_peek_minkey (far);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Remove the earliest pending event, NULL if there is none.
+ */
+Event *SimEngine::_q_remove (unsigned long *tm)
+{
+  Event *ev;
+  int s;
+
+  while (n0 == 0) {
+    if (n1 == 0 && heap_size (far) == 0) {
+      return NULL;
+    }
+    _q_refill ();
+  }
+  s = _wheel_next (&w0, w_now & WHEEL_MASK);
+  ev = w0.hd[s];
+  _wheel_unlink (&w0, s, ev);
+  n0--;
+  _pend_del (ev);
+  ev->q = SIM_EVQ_NONE;
+  w_now = (w_now & ~WHEEL_MASK) | s;
+  *tm = w_now;
+  return ev;
+}
+
+/*
+ * Walk through all pending events until fn returns non-zero; return
+ * that event.
+ */
+Event *SimEngine::_q_scan (int (*fn)(void *, Event *, unsigned long),
+			   void *cookie)
+{
+  Event *ev;
+
+  for (int s=0; s < SIM_WHEEL_SZ; s++) {
+    for (ev = w0.hd[s]; ev; ev = ev->next) {
+      if ((*fn)(cookie, ev, (w_now & ~WHEEL_MASK) | s)) {
+	return ev;
+      }
+    }
+  }
+  for (int s=0; s < SIM_WHEEL_SZ; s++) {
+    for (ev = w1.hd[s]; ev; ev = ev->next) {
+      if ((*fn)(cookie, ev, (w_now & ~SPAN_MASK) | ev->tm_lo)) {
+	return ev;
+      }
+    }
+  }
+  for (int i=0; i < heap_size (far); i++) {
+    ev = (Event *)far->value[i];
+    if (!ev->kill && (*fn)(cookie, ev, far->key[i])) {
+      return ev;
+    }
+  }
+  return NULL;
+}
+
+void SimEngine::_q_clear ()
 {
+  Event *ev, *tmp;
+
+  for (int s=0; s < SIM_WHEEL_SZ; s++) {
+    for (ev = _wheel_take (&w0, s); ev; ev = tmp) {
+      tmp = ev->next;
+      delete ev;
+    }
+    for (ev = _wheel_take (&w1, s); ev; ev = tmp) {
+      tmp = ev->next;
+      delete ev;
+    }
+  }
+  n0 = 0;
+  n1 = 0;
+  for (int i=0; i < far->sz; i++) {
+    ev = (Event *) far->value[i];
+    delete ev;
+    far->value[i] = NULL;
+  }
+  far->sz = 0;
+  ndead = 0;
+  for (int i=0; i < ntypes; i++) {
+    by_type[i] = NULL;
+  }
+  /* the events are gone; don't follow them back to their objects */
+  for (int i=0; i < A_LEN (objs); i++) {
+    if (objs[i]) {
+      objs[i]->pending = NULL;
+    }
+  }
+}
+
+/*
+ * Insert event into the queue
+ */
+void SimEngine::_schedule (Event *ev, int delay)
+{
+  if (par && par->running && current != this) {
+    /* sent from another partition */
+    if (!current || current->par != par) {
+      fatal_error ("Event for a parallel simulation created outside it");
+    }
+    if ((unsigned long)delay < par->lookahead) {
+      fatal_error ("Cross-partition event delay %d is less than the lookahead %lu",
+		   delay, par->lookahead);
+    }
+    _post (ev, current->curtime + delay);
+    return;
+  }
+
   /* check to see if the delay would cause "curtime" to roll over */
-  while (((unsigned long)~0UL - SimDES::curtime) < (unsigned)delay) {
-    /* let's walk through the heap to see if I can change the current
-       time reference */
+  if (((unsigned long)~0UL - curtime) < (unsigned)delay) {
+    /* shift the time reference down by a multiple of the wheel span,
+       so events in the wheel stay where they are */
     int i;
     unsigned long tm;
 
-    tm = heap_peek_minkey (SimDES::all);
-    /* the earliest time of all pending events is now tm */
+    if (par) {
+      fatal_error ("Time range too large for a parallel simulation");
+    }
+
+    /* all pending events are at or after curtime */
+    tm = curtime & ~SPAN_MASK;
 
     if (tm == 0) {
       fatal_error ("The dynamic range of time in the pending event list is too large to represent.\n");
     }
 
     /* adjust curtime by tm, and add tm in to the tm_offset[] array */
-    SimDES::curtime = SimDES::curtime - tm;
+    curtime = curtime - tm;
+    w_now = w_now - tm;
 
-    if (SimDES::tm_offset[0] + tm < SimDES::tm_offset[0]) {
+    if (tm_offset[0] + tm < tm_offset[0]) {
       /* time rolled over at 0, do the carries */
       for (i=1; i < SIM_TIME_SIZE; i++) {
-	SimDES::tm_offset[i]++;
-	if (SimDES::tm_offset[i] != 0) {
+	tm_offset[i]++;
+	if (tm_offset[i] != 0) {
 	  break;
 	}
       }
     }
-    SimDES::tm_offset[0] = SimDES::tm_offset[0] + tm;
+    tm_offset[0] = tm_offset[0] + tm;
       
-    for (i=0; i < SimDES::all->sz; i++) {
-      SimDES::all->key[i] -= tm;
+    for (i=0; i < far->sz; i++) {
+      far->key[i] -= tm;
     }
   }
+  _q_insert (curtime + delay, ev);
+}
 
+/*
+ * Create a new event, insert into the queue of the object's engine
+ */
+Event::Event (SimDES *s, int event_type, int delay, void *_cause)
+{
   obj = s;
   cause = _cause;
   ev_type = event_type;
   kill = 0;
-  heap_insert (SimDES::all, SimDES::curtime + delay, this);
+  q = SIM_EVQ_NONE;
+  s->eng->_schedule (this, delay);
+}
+
+Event::Event (SimDES *s, int event_type)
+{
+  obj = s;
+  cause = NULL;
+  ev_type = event_type;
+  kill = 0;
+  q = SIM_EVQ_NONE;
 }
 
 Event::~Event () { } 
@@ -125,12 +696,12 @@ Event::~Event () { }
 /*
  * Return the low order bits of the current simulation time
  */
-unsigned long SimDES::CurTimeLo() 
+unsigned long SimEngine::CurTimeLo() 
 {
   return tm_offset[0] + curtime;
 }
 
-BigInt SimDES::CurTime()
+BigInt SimEngine::CurTime()
 {
   int i;
   BigInt b;
@@ -155,99 +726,111 @@ BigInt SimDES::CurTime()
 #define IS_A_BREAKPOINT(ev)						\
   ((ev)->obj->break_point && ((ev)->obj->break_point == 1 ||		\
 			      ((ev)->ev_type == (ev)->obj->bp_ev_type)))
+
 /*
- * static method, run the entire simulation
+ * Execute one event that has been removed from the queue at time
+ * tm. *stop is set to 1 if the simulation should stop. Returns the
+ * event if it is a breakpoint (put back in the queue if requeue is
+ * set), NULL otherwise.
+ */
+Event *SimEngine::_step (Event *ev, unsigned long tm, int *stop, int requeue)
+{
+  SimEngine *prev;
+
+  *stop = 0;
+  /* current time needs to advance */
+  curtime = tm;
+  if (!ev->kill) {
+    if (IS_A_BREAKPOINT (ev)) {
+      if (requeue) {
+	_q_insert (tm, ev, 1);
+      }
+      *stop = 1;
+      return ev;
+    }
+    curobj = ev->obj;
+    curobj->ck_dirty = 1;
+    nevents++;
+
+    /* static SimDES calls made from Step() refer to this engine */
+    prev = current;
+    current = this;
+    if (!ev->obj->Step (ev)) {
+      *stop = 1;
+    }
+    current = prev;
+  }
+  delete ev;
+  if (ck_interval && curtime >= ck_next) {
+    _ck_auto ();
+  }
+  return NULL;
+}
+
+/*
+ * Run the entire simulation
  *
  *  Returns NULL if no more events, otherwise returns the event that
  *  caused the simulation to stop due to a break point.
  */
-Event *SimDES::Run ()
+Event *SimEngine::Run ()
 {
-  Event *ev;
-  unsigned long tm;
-  unsigned long long tm2;
-  
-  /* process all events in global time order */
-  while ((ev = (Event *)heap_remove_min_key (all, &tm2))) {
-    tm = tm2;
-    /* current time needs to advance */
-    curtime = tm;
-
-    /* execute event */
-    if (!ev->kill) {
-      if (IS_A_BREAKPOINT (ev)) {
-	break;
-      }
-      curobj = ev->obj;
-      if (!ev->obj->Step (ev)) {
-	delete ev;
-	return NULL;
-      }
+  Event *ev;
+  unsigned long tm2;
+  int stop;
+  
+  /* process all events in global time order */
+  while ((ev = _q_remove (&tm2))) {
+    ev = _step (ev, tm2, &stop, 0);
+    if (stop) {
+      return ev;
     }
-    delete ev;
     if (_interrupt) {
       return NULL;
     }
   }
-  return ev;
+  return NULL;
 }
 
 /*
- * static method, run the next n events in the simulation.
+ * Run the next n events in the simulation.
  * returns NULL on success, otherwise the event that caused the
  * simulation to stop (breakpoint)
  */
-Event *SimDES::Advance (long n)
+Event *SimEngine::Advance (long n)
 {
   Event *ev;
-  unsigned long tm;
-  unsigned long long tm2;
+  unsigned long tm2;
+  int stop;
 
   /* process all events in global time order */
-  while (n && (ev = (Event *)heap_remove_min_key (all, &tm2))) {
-    tm = tm2;
-    curtime = tm;
-    /* current time needs to advance */
-    if (!ev->kill) {
-      if (IS_A_BREAKPOINT(ev)) {
-	/* put the event back */
-	heap_insert (all, tm, ev);
-	break;
-      }
-      curobj = ev->obj;
-      if (!ev->obj->Step (ev)) {
-	delete ev;
-	return NULL;
-      }
+  while (n && (ev = _q_remove (&tm2))) {
+    ev = _step (ev, tm2, &stop, 1);
+    if (stop) {
+      return ev;
     }
-    delete ev;
     n--;
   }
-  if (n == 0) {
-    return NULL;
-  }
-  else {
-    return ev;
-  }
+  return NULL;
 }
 
 /*
- * static method, run simulation until "delay" time elapses.
+ * Run simulation until "delay" time elapses.
  * Returns NULL on success, otherwise returns the event that caused
  * the simulation to stop (breakpoint)
  */
-Event *SimDES::AdvanceTime (long delay)
+Event *SimEngine::AdvanceTime (long delay)
 {
   Event *ev;
   unsigned long tm;
+  int stop;
 
   /* process all events in global time order */
   do {
-    if (heap_peek_min (all) == NULL) {
-      /* nothing in the heap */
+    if (!_q_peek (&tm)) {
+      /* nothing pending */
       return NULL;
     }
-    tm = heap_peek_minkey (all);
     
     if (delay < (tm - curtime)) {
       /* I'm out of time, return */
@@ -257,26 +840,291 @@ Event *SimDES::AdvanceTime (long delay)
       delay = delay - (tm - curtime);
     }
 
-    ev = (Event *) heap_remove_min (all);
+    ev = _q_remove (&tm);
+    ev = _step (ev, tm, &stop, 1);
+    if (stop) {
+      return ev;
+    }
+  } while (1);
+  return NULL;
+}
 
-    /* current time needs to advance */
-    curtime = tm;
-    if (!ev->kill) {
-      if (IS_A_BREAKPOINT(ev)) {
-	heap_insert (all, tm, ev);
-	break;
+/*
+ * Cross-partition events
+ */
+struct sim_mail {
+  Event *ev;
+  unsigned long tm;		// absolute time of the event
+  int src;			// sending partition
+  unsigned long seq;		// send order within src
+  struct sim_mail *next;
+};
+
+void SimEngine::_post (Event *ev, unsigned long tm)
+{
+  struct sim_mail *m;
+
+  NEW (m, struct sim_mail);
+  m->ev = ev;
+  m->tm = tm;
+  m->src = current->part_id;
+  m->seq = current->mail_seq++;
+
+  m->next = mbox.load (std::memory_order_relaxed);
+  while (!mbox.compare_exchange_weak (m->next, m,
+				      std::memory_order_release,
+				      std::memory_order_relaxed))
+    ;
+}
+
+static int _mail_cmp (const void *a, const void *b)
+{
+  const struct sim_mail *x = *(const struct sim_mail **)a;
+  const struct sim_mail *y = *(const struct sim_mail **)b;
+
+  if (x->tm != y->tm) return x->tm < y->tm ? -1 : 1;
+  if (x->src != y->src) return x->src < y->src ? -1 : 1;
+  if (x->seq != y->seq) return x->seq < y->seq ? -1 : 1;
+  return 0;
+}
+
+void SimEngine::_drain (int deterministic)
+{
+  struct sim_mail *m, *tmp;
+
+  m = mbox.exchange (NULL, std::memory_order_acquire);
+  if (!m) {
+    return;
+  }
+  if (deterministic) {
+    A_DECL (struct sim_mail *, ml);
+    A_INIT (ml);
+    for (; m; m = m->next) {
+      A_NEW (ml, struct sim_mail *);
+      A_NEXT (ml) = m;
+      A_INC (ml);
+    }
+    qsort (ml, A_LEN (ml), sizeof (struct sim_mail *), _mail_cmp);
+    for (int i=0; i < A_LEN (ml); i++) {
+      if (ml[i]->ev->kill) {
+	delete ml[i]->ev;
       }
-      curobj = ev->obj;
-      if (!ev->obj->Step (ev)) {
-	delete ev;
-	return NULL;
+      else {
+	_q_insert (ml[i]->tm, ml[i]->ev);
       }
+      FREE (ml[i]);
     }
-    delete ev;
-  } while (1);
-  return ev;
+    A_FREE (ml);
+  }
+  else {
+    while (m) {
+      tmp = m->next;
+      if (m->ev->kill) {
+	delete m->ev;
+      }
+      else {
+	_q_insert (m->tm, m->ev);
+      }
+      FREE (m);
+      m = tmp;
+    }
+  }
+}
+
+/*
+ * Run all events before time "end". Returns the breakpoint event
+ * if one stopped the partition.
+ */
+Event *SimEngine::_run_window (unsigned long end, int *stop)
+{
+  Event *ev;
+  unsigned long tm2;
+
+  *stop = 0;
+  while (_q_peek (&tm2) && tm2 < end) {
+    ev = _q_remove (&tm2);
+    ev = _step (ev, tm2, stop, 1);
+    if (*stop) {
+      return ev;
+    }
+    if (_interrupt) {
+      *stop = 1;
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+
+/*
+ * Parallel kernel
+ */
+struct sim_par_run {
+  int nthreads;
+  pthread_barrier_t b;
+  pthread_mutex_t lock;
+
+  unsigned long end;		// current window is [.., end)
+  int done;			// set when the simulation is over
+
+  std::atomic<int> stop;	// a partition asked to stop
+  Event *stop_ev;		// breakpoint event, if any
+};
+
+struct sim_par_worker {
+  SimParallel *p;
+  int t;
+};
+
+SimParallel::SimParallel (int n, unsigned long _lookahead, int _det)
+{
+  if (n < 1) {
+    fatal_error ("SimParallel: need at least one partition");
+  }
+  if (_lookahead < 1) {
+    fatal_error ("SimParallel: lookahead must be positive");
+  }
+  nparts = n;
+  lookahead = _lookahead;
+  deterministic = _det;
+  running = 0;
+  r = NULL;
+  windows = 0;
+
+  MALLOC (parts, SimEngine *, nparts);
+  for (int i=0; i < nparts; i++) {
+    parts[i] = new SimEngine ();
+    parts[i]->par = this;
+    parts[i]->part_id = i;
+  }
+}
+
+SimParallel::~SimParallel ()
+{
+  for (int i=0; i < nparts; i++) {
+    delete parts[i];
+  }
+  FREE (parts);
+}
+
+/* called by one thread between windows */
+void SimParallel::_next_window ()
+{
+  unsigned long tm, min;
+  int found = 0;
+
+  if (r->stop) {
+    r->done = 1;
+    return;
+  }
+  min = 0;
+  for (int i=0; i < nparts; i++) {
+    if (parts[i]->_q_peek (&tm)) {
+      if (!found || tm < min) {
+	min = tm;
+	found = 1;
+      }
+    }
+  }
+  if (!found) {
+    r->done = 1;
+    return;
+  }
+  r->end = min + lookahead;
+  if (r->end < min) {
+    r->end = ~0UL;
+  }
+  windows++;
+}
+
+void *SimParallel::_worker (void *arg)
+{
+  struct sim_par_worker *w = (struct sim_par_worker *)arg;
+  SimParallel *p = w->p;
+  struct sim_par_run *r = p->r;
+  Event *ev;
+  int stop;
+
+  while (!r->done) {
+    for (int i=w->t; i < p->nparts; i += r->nthreads) {
+      ev = p->parts[i]->_run_window (r->end, &stop);
+      if (stop) {
+	pthread_mutex_lock (&r->lock);
+	if (!r->stop_ev) {
+	  r->stop_ev = ev;
+	}
+	pthread_mutex_unlock (&r->lock);
+	r->stop = 1;
+      }
+    }
+    pthread_barrier_wait (&r->b);
+    for (int i=w->t; i < p->nparts; i += r->nthreads) {
+      p->parts[i]->_drain (p->deterministic);
+    }
+    pthread_barrier_wait (&r->b);
+    if (w->t == 0) {
+      p->_next_window ();
+    }
+    pthread_barrier_wait (&r->b);
+  }
+  return NULL;
+}
+
+Event *SimParallel::Run (int nthreads)
+{
+  struct sim_par_worker *w;
+  pthread_t *tids;
+  Event *ret;
+
+  if (nthreads > nparts) {
+    nthreads = nparts;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+
+  NEW (r, struct sim_par_run);
+  r->nthreads = nthreads;
+  r->done = 0;
+  r->stop = 0;
+  r->stop_ev = NULL;
+  pthread_barrier_init (&r->b, NULL, nthreads);
+  pthread_mutex_init (&r->lock, NULL);
+
+  for (int i=0; i < nparts; i++) {
+    parts[i]->_interrupt = 0;
+  }
+  running = 1;
+  _next_window ();
+
+  MALLOC (w, struct sim_par_worker, nthreads);
+  MALLOC (tids, pthread_t, nthreads);
+  for (int i=0; i < nthreads; i++) {
+    w[i].p = this;
+    w[i].t = i;
+  }
+  for (int i=1; i < nthreads; i++) {
+    if (pthread_create (&tids[i], NULL, _worker, &w[i]) != 0) {
+      fatal_error ("SimParallel: could not create thread");
+    }
+  }
+  _worker (&w[0]);
+  for (int i=1; i < nthreads; i++) {
+    pthread_join (tids[i], NULL);
+  }
+  running = 0;
+
+  ret = r->stop_ev;
+  pthread_barrier_destroy (&r->b);
+  pthread_mutex_destroy (&r->lock);
+  FREE (r);
+  r = NULL;
+  FREE (w);
+  FREE (tids);
+  return ret;
 }
 
+
 void SimDES::Pause (int delay)
 {
   /* create an event */
@@ -486,9 +1334,9 @@ int WaitForOne::Notify (int ev_type, void *cause)
 int WaitForOne::Notify (int ev_type, int slot, void *cause) { return Notify (ev_type, cause); }
 
 
-bool SimDES::hasPendingEvent (void)
+bool SimEngine::hasPendingEvent (void)
 {
-  if (heap_size (all) > 0) {
+  if (_q_size () > 0) {
     return true;
   }
   else {
@@ -497,42 +1345,475 @@ bool SimDES::hasPendingEvent (void)
 }
 
 
-Event *SimDES::matchPendingEvent (bool (*matchfn) (Event *))
+static int _match1 (void *fn, Event *ev, unsigned long tm)
+{
+  return (*(bool (*)(Event *))fn) (ev) ? 1 : 0;
+}
+
+static int _match2 (void *fn, Event *ev, unsigned long tm)
+{
+  return (*(bool (*)(Event *, unsigned long))fn) (ev, tm) ? 1 : 0;
+}
+
+Event *SimEngine::matchPendingEvent (bool (*matchfn) (Event *))
+{
+  return _q_scan (_match1, (void *)matchfn);
+}
+
+Event *SimEngine::matchPendingEvent (bool (*matchfn) (Event *, unsigned long))
+{
+  return _q_scan (_match2, (void *)matchfn);
+}
+
+
+struct show_info {
+  FILE *fp;
+  void (*disp)(FILE *, Event *);
+  int i;
+};
+
+static int _show1 (void *cookie, Event *ev, unsigned long tm)
+{
+  struct show_info *si = (struct show_info *)cookie;
+
+  if (si->disp) {
+    (*si->disp) (si->fp, ev);
+  }
+  else {
+    fprintf (si->fp, " (%d,%d)", SIM_EV_FLAGS (ev->getType()),
+	     SIM_EV_TYPE (ev->getType()));
+  }
+  si->i++;
+  if (si->i % 10 == 0) {
+    fprintf (si->fp, "\n>>");
+  }
+  return 0;
+}
+
+void SimEngine::showAll (FILE *fp, void (*disp)(FILE *, Event *))
+{
+  struct show_info si;
+
+  si.fp = fp;
+  si.disp = disp;
+  si.i = 0;
+  fprintf (fp, " -- ev-heap --\n>>");
+  _q_scan (_show1, &si);
+  fprintf (fp, "\n --\n");
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoints
+ *
+ *  File layout (native byte order):
+ *     header:  "SIMDESCK", version, kind (0 = full, 1 = incremental),
+ *              seq, previous seq, curtime, tm_offset[], # events run,
+ *              # objects
+ *     events:  count, then (object id, ev_type, time) in queue order
+ *     objects: count, then (object id, length, SaveState() bytes)
+ *
+ *------------------------------------------------------------------------
+ */
+#define SIM_CK_MAGIC "SIMDESCK"
+#define SIM_CK_VERSION 1
+
+struct ck_event {
+  unsigned long tm;
+  unsigned int id;
+  unsigned int type;
+};
+
+struct ck_evlist {
+  A_DECL (struct ck_event, ev);
+};
+
+static int _ck_collect (void *cookie, Event *ev, unsigned long tm)
+{
+  struct ck_evlist *l = (struct ck_evlist *)cookie;
+
+  A_NEW (l->ev, struct ck_event);
+  A_NEXT (l->ev).tm = tm;
+  A_NEXT (l->ev).id = ev->getObj()->ckId();
+  A_NEXT (l->ev).type = ev->getType();
+  A_INC (l->ev);
+  return 0;
+}
+
+static void _ck_put (FILE *fp, const void *x, size_t sz, int *err)
+{
+  if (fwrite (x, 1, sz, fp) != sz) {
+    *err = 1;
+  }
+}
+
+static void _ck_get (FILE *fp, void *x, size_t sz, int *err)
+{
+  if (*err || fread (x, 1, sz, fp) != sz) {
+    *err = 1;
+    memset (x, 0, sz);
+  }
+}
+
+int SimEngine::Checkpoint (const char *file, int incremental)
 {
-  for (int i=0; i < heap_size (all); i++) {
-    if ((*matchfn)((Event *)all->value[i])) {
-      return (Event *)all->value[i];
+  FILE *fp;
+  unsigned int u;
+  unsigned long prev;
+  struct ck_evlist l;
+  char *buf;
+  size_t len;
+  int err = 0;
+
+  fp = fopen (file, "wb");
+  if (!fp) {
+    warning ("Checkpoint: could not open `%s' for writing", file);
+    return -1;
+  }
+  if (ck_seq == 0) {
+    incremental = 0;
+  }
+  prev = ck_seq;
+  ck_seq++;
+
+  _ck_put (fp, SIM_CK_MAGIC, 8, &err);
+  u = SIM_CK_VERSION;
+  _ck_put (fp, &u, sizeof (u), &err);
+  u = incremental ? 1 : 0;
+  _ck_put (fp, &u, sizeof (u), &err);
+  _ck_put (fp, &ck_seq, sizeof (ck_seq), &err);
+  _ck_put (fp, &prev, sizeof (prev), &err);
+  _ck_put (fp, &curtime, sizeof (curtime), &err);
+  _ck_put (fp, tm_offset, sizeof (tm_offset), &err);
+  _ck_put (fp, &nevents, sizeof (nevents), &err);
+  u = A_LEN (objs);
+  _ck_put (fp, &u, sizeof (u), &err);
+
+  /* event queue: wheel slots in FIFO order, then the far heap in
+     array order. Re-inserting in this order at the same time rebuilds
+     the same lists and heap, so ties are broken as before. */
+  A_INIT (l.ev);
+  _q_scan (_ck_collect, &l);
+  u = A_LEN (l.ev);
+  _ck_put (fp, &u, sizeof (u), &err);
+  for (int i=0; i < A_LEN (l.ev); i++) {
+    _ck_put (fp, &l.ev[i].id, sizeof (l.ev[i].id), &err);
+    _ck_put (fp, &l.ev[i].type, sizeof (l.ev[i].type), &err);
+    _ck_put (fp, &l.ev[i].tm, sizeof (l.ev[i].tm), &err);
+  }
+  A_FREE (l.ev);
+
+  /* objects */
+  u = 0;
+  for (int i=0; i < A_LEN (objs); i++) {
+    if (objs[i] && (!incremental || objs[i]->ck_dirty)) {
+      u++;
     }
   }
-  return NULL;
+  _ck_put (fp, &u, sizeof (u), &err);
+  for (int i=0; i < A_LEN (objs); i++) {
+    FILE *mfp;
+    if (!objs[i] || (incremental && !objs[i]->ck_dirty)) {
+      continue;
+    }
+    buf = NULL;
+    len = 0;
+    mfp = open_memstream (&buf, &len);
+    if (!mfp) {
+      err = 1;
+      break;
+    }
+    objs[i]->SaveState (mfp);
+    fclose (mfp);
+    u = i;
+    _ck_put (fp, &u, sizeof (u), &err);
+    u = len;
+    _ck_put (fp, &u, sizeof (u), &err);
+    _ck_put (fp, buf, len, &err);
+    free (buf);
+    objs[i]->ck_dirty = 0;
+  }
+  if (fclose (fp) != 0) {
+    err = 1;
+  }
+  if (err) {
+    warning ("Checkpoint: error writing `%s'", file);
+    return -1;
+  }
+  return 0;
 }
 
-Event *SimDES::matchPendingEvent (bool (*matchfn) (Event *, unsigned long))
+struct ck_state {
+  unsigned int id;
+  unsigned int len;
+  char *buf;
+};
+
+/*
+ * The whole file is read and checked before anything is changed, so
+ * a checkpoint that doesn't match the model or is corrupt leaves the
+ * simulation as it was.
+ */
+int SimEngine::Restore (const char *file)
 {
-  for (int i=0; i < heap_size (all); i++) {
-    if ((*matchfn)((Event *)all->value[i], all->key[i])) {
-      return (Event *)all->value[i];
+  FILE *fp;
+  char magic[8];
+  unsigned int u, version, kind, n, len;
+  unsigned long seq, prev, ck_time, ck_nevents;
+  unsigned long ck_offset[SIM_TIME_SIZE];
+  struct ck_evlist l;
+  A_DECL (struct ck_state, st);
+  int err = 0;
+
+  fp = fopen (file, "rb");
+  if (!fp) {
+    warning ("Restore: could not open `%s'", file);
+    return -1;
+  }
+  _ck_get (fp, magic, 8, &err);
+  _ck_get (fp, &version, sizeof (version), &err);
+  if (err || memcmp (magic, SIM_CK_MAGIC, 8) != 0 ||
+      version != SIM_CK_VERSION) {
+    warning ("Restore: `%s' is not a checkpoint file (version %d)",
+	     file, SIM_CK_VERSION);
+    fclose (fp);
+    return -1;
+  }
+  _ck_get (fp, &kind, sizeof (kind), &err);
+  _ck_get (fp, &seq, sizeof (seq), &err);
+  _ck_get (fp, &prev, sizeof (prev), &err);
+  if (!err && kind == 1 && prev != ck_seq) {
+    warning ("Restore: `%s' does not follow the last restored checkpoint",
+	     file);
+    fclose (fp);
+    return -1;
+  }
+  _ck_get (fp, &ck_time, sizeof (ck_time), &err);
+  _ck_get (fp, ck_offset, sizeof (ck_offset), &err);
+  _ck_get (fp, &ck_nevents, sizeof (ck_nevents), &err);
+  _ck_get (fp, &u, sizeof (u), &err);
+  if (!err && u != (unsigned)A_LEN (objs)) {
+    warning ("Restore: `%s' has %u objects, the model has %d",
+	     file, u, A_LEN (objs));
+    fclose (fp);
+    return -1;
+  }
+  if (kind > 1) {
+    err = 1;
+  }
+
+  A_INIT (l.ev);
+  _ck_get (fp, &n, sizeof (n), &err);
+  for (unsigned int i=0; !err && i < n; i++) {
+    A_NEW (l.ev, struct ck_event);
+    _ck_get (fp, &A_NEXT (l.ev).id, sizeof (A_NEXT (l.ev).id), &err);
+    _ck_get (fp, &A_NEXT (l.ev).type, sizeof (A_NEXT (l.ev).type), &err);
+    _ck_get (fp, &A_NEXT (l.ev).tm, sizeof (A_NEXT (l.ev).tm), &err);
+    if (err || A_NEXT (l.ev).id >= (unsigned)A_LEN (objs) ||
+	!objs[A_NEXT (l.ev).id] || A_NEXT (l.ev).tm < ck_time) {
+      err = 1;
+      break;
     }
+    A_INC (l.ev);
   }
-  return NULL;
+
+  A_INIT (st);
+  _ck_get (fp, &n, sizeof (n), &err);
+  for (unsigned int i=0; !err && i < n; i++) {
+    A_NEW (st, struct ck_state);
+    A_NEXT (st).buf = NULL;
+    _ck_get (fp, &A_NEXT (st).id, sizeof (A_NEXT (st).id), &err);
+    _ck_get (fp, &len, sizeof (len), &err);
+    A_NEXT (st).len = len;
+    if (err || A_NEXT (st).id >= (unsigned)A_LEN (objs) ||
+	!objs[A_NEXT (st).id]) {
+      err = 1;
+      break;
+    }
+    MALLOC (A_NEXT (st).buf, char, (len > 0 ? len : 1));
+    if (len > 0) {
+      _ck_get (fp, A_NEXT (st).buf, len, &err);
+    }
+    A_INC (st);
+  }
+  if (!err && fgetc (fp) != EOF) {
+    /* trailing junk */
+    err = 1;
+  }
+  fclose (fp);
+
+  if (!err) {
+    _q_clear ();
+    curtime = ck_time;
+    for (int i=0; i < SIM_TIME_SIZE; i++) {
+      tm_offset[i] = ck_offset[i];
+    }
+    nevents = ck_nevents;
+    w_now = curtime;
+    initialized_sim = 1;
+    for (int i=0; i < A_LEN (l.ev); i++) {
+      _q_insert (l.ev[i].tm, new Event (objs[l.ev[i].id], l.ev[i].type));
+    }
+    /* streams are opened one at a time: the C library keeps a list
+       of open streams, and closing one searches it */
+    for (int i=0; i < A_LEN (st); i++) {
+      FILE *mfp = fmemopen (st[i].buf, st[i].len, "rb");
+      if (mfp) {
+	objs[st[i].id]->RestoreState (mfp);
+	fclose (mfp);
+      }
+      else if (st[i].len > 0) {
+	fatal_error ("Restore: could not read the state of object %u",
+		     st[i].id);
+      }
+      /* else: this C library can't open an empty buffer, and there
+	 is nothing to restore */
+    }
+  }
+  for (int i=0; i < A_LEN (st); i++) {
+    if (st[i].buf) {
+      FREE (st[i].buf);
+    }
+  }
+  A_FREE (st);
+  A_FREE (l.ev);
+  if (err) {
+    warning ("Restore: `%s' is truncated or corrupt", file);
+    return -1;
+  }
+  for (int i=0; i < A_LEN (objs); i++) {
+    if (objs[i]) {
+      objs[i]->ck_dirty = 0;
+    }
+  }
+  ck_seq = seq;
+  if (ck_interval) {
+    ck_next = curtime + ck_interval;
+  }
+  return 0;
 }
 
+void SimEngine::setCheckpoint (const char *prefix, unsigned long interval,
+			       int full_every)
+{
+  if (ck_prefix) {
+    FREE (ck_prefix);
+  }
+  ck_prefix = Strdup (prefix);
+  ck_interval = interval;
+  ck_next = curtime + interval;
+  ck_full_every = full_every < 1 ? 1 : full_every;
+}
 
-void SimDES::showAll (FILE *fp, void (*disp)(FILE *, Event *))
+void SimEngine::_ck_auto ()
 {
-  fprintf (fp, " -- ev-heap --\n>>");
-  for (int i=0; i < heap_size (all); i++) {
-    Event *ev = (Event *)all->value[i];
-    if (disp) {
-      (*disp) (fp, ev);
+  char buf[10240];
+
+  snprintf (buf, 10240, "%s.%lu", ck_prefix, ck_seq + 1);
+  Checkpoint (buf, (ck_seq % ck_full_every) != 0);
+  ck_next = curtime + ck_interval;
+}
+
+/*
+ * Forked snapshots: the suspended child waits on a pipe
+ */
+struct ck_fork {
+  pid_t pid;
+  int fd;
+  struct ck_fork *next;
+};
+
+static struct ck_fork *ck_forks = NULL;
+
+pid_t SimEngine::forkCheckpoint ()
+{
+  int fds[2];
+  pid_t pid;
+  char c;
+
+  if (pipe (fds) < 0) {
+    return -1;
+  }
+  fflush (NULL);
+  pid = fork ();
+  if (pid < 0) {
+    close (fds[0]);
+    close (fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    /* snapshot: wait to be resumed. Close the write ends of the
+       earlier snapshots, or they would never see end-of-file when
+       they are dropped */
+    struct ck_fork *f;
+    close (fds[1]);
+    while (ck_forks) {
+      f = ck_forks;
+      ck_forks = f->next;
+      close (f->fd);
+      FREE (f);
     }
-    else {
-      fprintf (fp, " (%d,%d)", SIM_EV_FLAGS (ev->getType()),
-	       SIM_EV_TYPE (ev->getType()));
+    if (read (fds[0], &c, 1) != 1 || c != 'r') {
+      _exit (0);
     }
-    if ((i+1)%10 == 0) {
-      fprintf (fp, "\n>>");
+    close (fds[0]);
+    return 0;
+  }
+  close (fds[0]);
+
+  struct ck_fork *f;
+  NEW (f, struct ck_fork);
+  f->pid = pid;
+  f->fd = fds[1];
+  f->next = ck_forks;
+  ck_forks = f;
+  return pid;
+}
+
+static struct ck_fork *_ck_fork_remove (pid_t pid)
+{
+  struct ck_fork *f, *prev = NULL;
+
+  for (f = ck_forks; f; f = f->next) {
+    if (f->pid == pid) {
+      if (prev) {
+	prev->next = f->next;
+      }
+      else {
+	ck_forks = f->next;
+      }
+      return f;
     }
+    prev = f;
   }
-  fprintf (fp, "\n --\n");
+  return NULL;
+}
+
+int SimEngine::resumeCheckpoint (pid_t pid)
+{
+  struct ck_fork *f = _ck_fork_remove (pid);
+  char c = 'r';
+  int ret;
+
+  if (!f) {
+    return -1;
+  }
+  ret = (write (f->fd, &c, 1) == 1) ? 0 : -1;
+  close (f->fd);
+  FREE (f);
+  return ret;
+}
+
+void SimEngine::dropCheckpoint (pid_t pid)
+{
+  struct ck_fork *f = _ck_fork_remove (pid);
+
+  if (!f) {
+    return;
+  }
+  close (f->fd);
+  kill (pid, SIGKILL);
+  waitpid (pid, NULL, 0);
+  FREE (f);
 }
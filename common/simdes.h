@@ -50,14 +50,19 @@
  *
  */
 #include <stdio.h>
+#include <sys/types.h>
+#include <atomic>
 #include <common/misc.h>
 #include <common/heap.h>
 #include <common/list.h>
 #include <common/bitset.h>
 #include <common/sim.h>
 #include <common/int.h>
+#include <common/array.h>
 
 class SimDES;
+class SimEngine;
+class SimParallel;
 
 /*
  * Events: used to make forward progress in the simulation
@@ -93,8 +98,16 @@ public:
   /*
    * Used to make the simulator drop an event without executing
    * it. Used to revoke a pending event.
+   *
+   * The event may be freed by this call, so the pointer must not be
+   * used afterwards, not even for a second Remove(). (Remove() used
+   * to only mark the event, which was freed once it reached the head
+   * of the queue.) Events in the timing wheel are unlinked and freed
+   * immediately; far-future events, the event being executed, and
+   * events in a cross-partition mailbox are only marked. Must be
+   * called from the thread running the event's engine.
    */
-  void Remove () { kill = 1; }
+  void Remove ();
 
   void *operator new (size_t sz);
   void operator delete (void *v);
@@ -105,32 +118,295 @@ public:
   void *getCause() { return cause; }
 
 private:
+  Event (SimDES *s, int event_type); // not scheduled (checkpoint restore)
+
   unsigned int kill:1;		// set to 1 to make this an event that
 				// is discarded
   
   unsigned int ev_type:15;	// event type
 
+  unsigned int tm_lo:16;	// low order bits of the event time,
+				// used by the timing wheel
+
+  unsigned int q:2;		// where the event is queued (SIM_EVQ_...)
+
   SimDES *obj;		    // information about the event (see above)
 
   void *cause;			// information about event causality
+
+  Event *next, *prev;		// timing wheel slot list
+  Event *o_next, *o_prev;	// pending events for obj
+  Event *t_next, *t_prev;	// pending events with this ev_type
   
 
-  /* allocated event queue */
-  static Event *ev_queue;
+  /* allocated event queue (per thread) */
+  static thread_local Event *ev_queue;
   friend class SimDES;
+  friend class SimEngine;
 };
 
 /*
- *  Sim: used to model entities in the simulation. Details above.
+ *  SimEngine: one discrete-event simulation. The engine owns the
+ *  event queue, the current time, and the object being stepped.
+ *
+ *  Every SimDES object is bound to an engine when it is created. The
+ *  static SimDES management functions (Run, CurTime, ...) operate on
+ *  the current engine of the calling thread, so code written for a
+ *  single simulation works unchanged. Independent engines can be
+ *  driven from different threads at the same time.
  */
 
 #define SIM_TIME_SIZE 2
 
+/*
+ * One level of the timing wheel: a FIFO list of events per slot, and
+ * a bitmap of non-empty slots.
+ */
+#define SIM_EVQ_NONE    0	// not in the queue
+#define SIM_EVQ_W0      1	// first level of the wheel
+#define SIM_EVQ_W1      2	// second level of the wheel
+#define SIM_EVQ_FAR     3	// far-future heap
+
+#define SIM_WHEEL_BITS  8
+#define SIM_WHEEL_SZ    (1 << SIM_WHEEL_BITS)
+#define SIM_WHEEL_WORDS (SIM_WHEEL_SZ/(8*sizeof (unsigned long)))
+
+struct sim_wheel {
+  Event *hd[SIM_WHEEL_SZ], *tl[SIM_WHEEL_SZ];
+  unsigned long bm[SIM_WHEEL_WORDS];
+};
+
+class SimEngine {
+ public:
+  SimEngine ();
+  ~SimEngine ();
+
+  void Init ();			// reset simulation time, drop events
+
+  Event *Run ();		// run the simulation
+  Event *Advance (long n = 1);	// run n events
+  Event *AdvanceTime (long delay); // run all events upto the
+				   // specified delay in the future
+
+  bool hasPendingEvent ();
+  Event *matchPendingEvent (bool (*matchfn) (Event *));
+  Event *matchPendingEvent (bool (*matchfn) (Event *, unsigned long tm));
+
+  int isEmpty () { return initialized_sim ? 0 : 1; }
+
+  unsigned long CurTimeLo ();	// low order bits of the current time
+  BigInt CurTime ();		// full time
+  SimDES *CurObj () { return curobj; }
+
+  void interrupt () { _interrupt = 1; }
+  void resume () { _interrupt = 0; }
+
+  void showAll (FILE *fp, void (*disp)(FILE *, Event *) = NULL);
+
+  unsigned long numEvents () { return nevents; } // # events executed
+
+  /*
+    Pending events for object obj (any object if NULL) with event
+    type ev_type (any type if -1). Returns the first match. Pending
+    events are always indexed by object; lookups by type alone are
+    indexed only for types passed to indexType().
+  */
+  Event *findPending (SimDES *obj, int ev_type = -1);
+  void indexType (int ev_type);
+
+  int numPending () { return _q_size (); } // # live pending events
+  int numDead () { return ndead; } // # revoked events not yet
+				   // dropped from the queue
+  unsigned long numRevoked () { return nrevoked; } // # Remove() calls
+
+  /*
+    Checkpoints. Objects are identified by creation order, so a
+    checkpoint is restored into a freshly built model with the same
+    objects; each object saves and restores its own state with
+    SimDES::SaveState()/RestoreState(). Event causes are not saved.
+
+    An incremental checkpoint has the event queue and only the
+    objects that executed an event since the previous checkpoint.
+    Restore a full checkpoint, followed by the incremental ones after
+    it in order. Both return 0 on success, -1 on error.
+  */
+  int Checkpoint (const char *file, int incremental = 0);
+  int Restore (const char *file);
+
+  /*
+    Write checkpoints prefix.<n> every "interval" time units while
+    the simulation runs; every full_every-th one is a full checkpoint.
+    An interval of 0 turns this off.
+  */
+  void setCheckpoint (const char *prefix, unsigned long interval,
+		      int full_every = 8);
+
+  /*
+    Copy-on-write snapshot of the whole process, including SimThread
+    stacks: the state is kept by a suspended child. Returns the
+    child's pid (-1 on error) to the caller. The child returns 0 from
+    forkCheckpoint() when resumeCheckpoint() is called, and exits on
+    dropCheckpoint(). Only use from a single-threaded process.
+  */
+  static pid_t forkCheckpoint ();
+  static int resumeCheckpoint (pid_t pid);
+  static void dropCheckpoint (pid_t pid);
+
+  /*
+    The engine used by the static SimDES functions and by new SimDES
+    objects in the calling thread. Each thread gets its own default
+    engine on first use.
+  */
+  static SimEngine *Current ();
+  static void setCurrent (SimEngine *e) { current = e; }
+
+ private:
+  SimDES *curobj;		// current object being stepped
+
+  int initialized_sim;		// set once an object is bound
+
+  int _interrupt;		// interrupt flag
+
+  /*
+    The current time is actually (tm_offset + curtime)
+    When curtime becomes too large to represent, we shift curtime
+    down by a multiple of the wheel span and update tm_offset. Only
+    the far-future heap needs its keys adjusted.
+  */
+  unsigned long tm_offset[SIM_TIME_SIZE];
+  unsigned long curtime;	// current time
+
+  /*
+    Pending events. w_now is the wheel position (<= curtime). Events
+    that share w_now's time bits above SIM_WHEEL_BITS are in w0, one
+    slot per time unit. Events that share the bits above
+    2*SIM_WHEEL_BITS are in w1, one slot per SIM_WHEEL_SZ time units,
+    and are cascaded into w0 when it runs dry. Everything else is in
+    the far heap.
+  */
+  unsigned long w_now;
+  struct sim_wheel w0, w1;
+  int n0, n1;			// # events in w0, w1
+  Heap *far;			// far-future events
+  int ndead;			// # revoked events in far
+  unsigned long nrevoked;
+
+  /* pending events indexed by ev_type, for types in indexType() */
+  Event **by_type;
+  unsigned char *type_on;
+  int ntypes;
+
+  unsigned long nevents;	// # events executed
+
+  /* checkpoints */
+  A_DECL (SimDES *, objs);	// all objects, by id
+  unsigned long ck_seq;		// sequence # of the last checkpoint
+  char *ck_prefix;		// periodic checkpoints
+  unsigned long ck_interval, ck_next;
+  int ck_full_every;
+  void _ck_auto ();
+
+  void _q_insert (unsigned long tm, Event *ev, int front = 0);
+  void _q_place (unsigned long tm, Event *ev, int front);
+  void _far_purge ();
+  void _pend_add (Event *ev);
+  void _pend_del (Event *ev);
+  void _revoke (Event *ev);
+  int _q_peek (unsigned long *tm);
+  Event *_q_remove (unsigned long *tm);
+  void _q_refill ();
+  int _q_size () { return n0 + n1 + heap_size (far) - ndead; }
+  Event *_q_scan (int (*fn)(void *, Event *, unsigned long), void *cookie);
+  void _q_clear ();
+  static int _wheel_next (struct sim_wheel *w, int pos);
+  static void _wheel_add (struct sim_wheel *w, int slot, Event *ev, int front);
+  static Event *_wheel_take (struct sim_wheel *w, int slot);
+  static void _wheel_unlink (struct sim_wheel *w, int slot, Event *ev);
+
+  void _schedule (Event *ev, int delay);
+  Event *_step (Event *ev, unsigned long tm, int *stop, int requeue);
+
+  /*-- partition of a SimParallel simulation --*/
+  SimParallel *par;		// NULL for a stand-alone engine
+  int part_id;			// partition number
+  unsigned long mail_seq;	// sequence number for outgoing events
+  std::atomic<struct sim_mail *> mbox; // incoming events from other
+				       // partitions
+  void _post (Event *ev, unsigned long tm);
+  void _drain (int deterministic);
+  Event *_run_window (unsigned long end, int *stop);
+
+  static thread_local SimEngine *current;
+
+  friend class Event;
+  friend class SimDES;
+  friend class SimParallel;
+};
+
+
+/*
+ *  SimParallel: a simulation split into partitions, each of which is
+ *  a SimEngine with its own event queue. Objects are assigned to a
+ *  partition by constructing them with SimDES (par->Part (i)).
+ *
+ *  Synchronization is conservative. Any event sent from one partition
+ *  to another must have a delay of at least "lookahead". The kernel
+ *  repeatedly finds the earliest pending time T and lets every
+ *  partition run its events before T + lookahead independently.
+ *  Events sent to other partitions go through lock-free mailboxes
+ *  that are drained between windows.
+ *
+ *  In deterministic mode, mailbox events are inserted in (time,
+ *  source partition, send order) order. The result is then the same
+ *  for any number of threads.
+ */
+class SimParallel {
+ public:
+  SimParallel (int nparts, unsigned long lookahead, int deterministic = 0);
+  ~SimParallel ();
+
+  int numParts () { return nparts; }
+  SimEngine *Part (int i) { return parts[i]; }
+  unsigned long Lookahead () { return lookahead; }
+
+  /*
+    Run the simulation using nthreads OS threads. Partitions are
+    assigned to threads round-robin. Returns NULL when there are no
+    more events, or when some Step() returns 0; otherwise returns the
+    breakpoint event that stopped the simulation.
+  */
+  Event *Run (int nthreads = 1);
+
+  unsigned long numWindows () { return windows; }
+
+ private:
+  int nparts;
+  SimEngine **parts;
+  unsigned long lookahead;
+  int deterministic;
+
+  int running;			// set while Run() is active
+
+  /* shared state for Run() */
+  struct sim_par_run *r;
+  unsigned long windows;	// # of synchronization windows
+
+  static void *_worker (void *);
+  void _next_window ();
+
+  friend class SimEngine;
+};
+
+/*
+ *  Sim: used to model entities in the simulation. Details above.
+ */
 class SimDES {
  public:
-  SimDES ();		    // Inherit from this class. The
+  SimDES (SimEngine *e = NULL); // Inherit from this class. The
 			    // constructor should create the initial
-			    // event with type SIM_EV_INIT, if any
+			    // event with type SIM_EV_INIT, if any.
+			    // The object is bound to engine e, or to
+			    // the current engine if e is NULL.
   
   virtual ~SimDES ();
 
@@ -151,23 +427,43 @@ class SimDES {
   void SetBp (int ev_type) { bp_ev_type = ev_type; break_point = 2; }
   void ClrBp () { break_point = 0; }
 
-  /*-- simulation management --*/
+  SimEngine *Engine () { return eng; }
+
+  /* checkpoint support: override to save/restore the object state */
+  virtual void SaveState (FILE *fp) { }
+  virtual void RestoreState (FILE *fp) { }
+  int ckId () { return obj_id; } // object id used in checkpoints
+
+  /* first pending event for this object, optionally of type ev_type */
+  Event *firstPending (int ev_type = -1) {
+    return eng->findPending (this, ev_type);
+  }
+
+  /*-- simulation management: these use SimEngine::Current() --*/
 
-  static void Init();		// reset simulation time
+  static void Init() { SimEngine::Current()->Init(); }
 
-  static Event *Run();		// run the simulation
+  static Event *Run() { return SimEngine::Current()->Run(); }
 
-  static Event *Advance(long n = 1); // run n events
-  static Event *AdvanceTime (long delay); // run all events upto
-				       // specified delay in the
-				       // future
+  static Event *Advance(long n = 1) {
+    return SimEngine::Current()->Advance (n);
+  }
+  static Event *AdvanceTime (long delay) {
+    return SimEngine::Current()->AdvanceTime (delay);
+  }
 
   /** @return true if there are pending events **/
-  static bool hasPendingEvent();
-  static Event *matchPendingEvent (bool (*matchfn) (Event *));
-  static Event *matchPendingEvent (bool (*matchfn) (Event *, unsigned long tm));
+  static bool hasPendingEvent() {
+    return SimEngine::Current()->hasPendingEvent();
+  }
+  static Event *matchPendingEvent (bool (*matchfn) (Event *)) {
+    return SimEngine::Current()->matchPendingEvent (matchfn);
+  }
+  static Event *matchPendingEvent (bool (*matchfn) (Event *, unsigned long tm)) {
+    return SimEngine::Current()->matchPendingEvent (matchfn);
+  }
 
-  static int isEmpty() { return initialized_sim ? 0 : 1; }
+  static int isEmpty() { return SimEngine::Current()->isEmpty(); }
   /*
     The current time is represented in the simulation by an array of
     SIM_TIME_SIZE 64-bit values.
@@ -177,14 +473,18 @@ class SimDES {
 
       (tm_offset[]) + curtime
   */
-  static unsigned long CurTimeLo (); // low order bits of the current time
-  static BigInt CurTime (); // full time
-  static SimDES *CurObj () { return curobj; }
+  static unsigned long CurTimeLo () {
+    return SimEngine::Current()->CurTimeLo();
+  }
+  static BigInt CurTime () { return SimEngine::Current()->CurTime(); }
+  static SimDES *CurObj () { return SimEngine::Current()->CurObj(); }
 
-  static void interrupt () { _interrupt = 1; }
-  static void resume () { _interrupt = 0; }
+  static void interrupt () { SimEngine::Current()->interrupt(); }
+  static void resume () { SimEngine::Current()->resume(); }
 
-  static void showAll (FILE *fp, void (*disp)(FILE *, Event *) = NULL);
+  static void showAll (FILE *fp, void (*disp)(FILE *, Event *) = NULL) {
+    SimEngine::Current()->showAll (fp, disp);
+  }
 
 protected:
   unsigned int break_point:2;	// set a breakpoint on this object
@@ -193,30 +493,13 @@ protected:
   unsigned int flags:8;		// available flags
 
 private:
-  static SimDES *curobj;	// current object being stepped
-
-  /*-- object management --*/
-  static int initialized_sim;   // global check
-
-  static int _interrupt;	// interrupt flag
-
-  /*-- simulation runtime --*/
-
-  /*
-    The current time is actually (tm_offset + curtime)
-    When curtime becomes too large to represent, we walk through the
-    heap and modify all times in the heap, and update tm_offset.
-  */
-
-  static unsigned long tm_offset[SIM_TIME_SIZE];
-  /* if heap times get large, this will get used as the
-     offset into the current time
-  */
-
-  static unsigned long curtime;	// current time
-  static Heap *all;		// all events
+  SimEngine *eng;		// engine this object belongs to
+  Event *pending;		// pending events for this object
+  int obj_id;			// index in the engine's object table
+  unsigned int ck_dirty:1;	// stepped since the last checkpoint
 
   friend class Event;
+  friend class SimEngine;
 };
 
 class Condition {
@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 #include "thread.h"
 #include "qops.h"
 
@@ -47,6 +49,74 @@ static Time_t inconsistent_timer = 0;
 lthread_t *timerQh = NULL;
 lthread_t *timerQt = NULL;
 
+/*------------------------------------------------------------------------
+ *
+ *  M:N scheduling state. With one worker none of this is used, and
+ *  threads run on readyQh/readyQt as before.
+ *
+ *------------------------------------------------------------------------
+ */
+#define TH_OP_YIELD  0		/* thread is still ready */
+#define TH_OP_BLOCK  1		/* thread is in a wait queue */
+#define TH_OP_EXIT   2		/* thread finished */
+#define TH_OP_PAUSE  3		/* thread goes in the timer queue */
+
+struct thread_worker {
+  int id;
+  pthread_t tid;
+
+  int lk;			/* protects the ready queue */
+  lthread_t *qh, *qt;		/* ready queue */
+
+  void *sched_sp;		/* scheduler context */
+  lthread_t *cur;		/* thread being run */
+  int op;			/* why cur switched out (TH_OP_...) */
+  int *op_lock;			/* lock to release for TH_OP_BLOCK */
+  Time_t op_time;		/* wakeup time for TH_OP_PAUSE */
+};
+
+static int nworkers = 1;
+static struct thread_worker *workers = NULL;
+static __thread struct thread_worker *self_worker = NULL;
+
+static int live = 0;		/* # of ready or running threads */
+static int alloc_lk = 0;	/* thread records and stacks */
+static int timer_lk = 0;	/* timer queue */
+
+/*
+ * Thread-local state must be re-read after a context switch, since a
+ * thread may resume on a different worker; the empty asm keeps the
+ * compiler from reusing an earlier value.
+ */
+static struct thread_worker *worker_self (void) __attribute__((noinline));
+static struct thread_worker *worker_self (void)
+{
+  __asm__ __volatile__ ("" ::: "memory");
+  return self_worker;
+}
+
+lthread_t *thread_self (void) __attribute__((noinline));
+lthread_t *thread_self (void)
+{
+  __asm__ __volatile__ ("" ::: "memory");
+  return (lthread_t *)current_process;
+}
+
+void thread_lock (int *l)
+{
+  if (nworkers == 1) return;
+  while (__atomic_exchange_n (l, 1, __ATOMIC_ACQUIRE)) {
+    while (__atomic_load_n (l, __ATOMIC_RELAXED))
+      ;
+  }
+}
+
+void thread_unlock (int *l)
+{
+  if (nworkers == 1) return;
+  __atomic_store_n (l, 0, __ATOMIC_RELEASE);
+}
+
 /*------------------------------------------------------------------------
  *
  *   Lazy timer: guaranteed to go off just when some process in the
@@ -54,37 +124,60 @@ lthread_t *timerQt = NULL;
  *
  *------------------------------------------------------------------------
  */
-static void thread_insert_timer (lthread_t *t, Time_t tm)
+static int thread_insert_timer (lthread_t *t, Time_t tm)
 {
-  lthread_t *x;
+  lthread_t *x, *prev;
 
-  if (t->time >= tm) return;
+  if (t->time >= tm) return 0;
 
   t->time = tm;
 
+  /* keep the queue sorted by wakeup time */
+  prev = NULL;
   for (x = timerQh; x; x = x->next) {
     if (x->time > tm)
       break;
+    prev = x;
   }
-  if (!x) {
-    if (timerQh) {
-      timerQt->next = t;
-    }
-    else {
-      timerQh = t;
-    }
-    timerQt = t;
+  t->next = x;
+  if (prev) {
+    prev->next = t;
   }
   else {
-    t->next = x->next;
-    x->next = t;
-    if (!t->next)
-      timerQt = t;
+    timerQh = t;
+  }
+  if (!x) {
+    timerQt = t;
   }
+  return 1;
 }
 
+#ifdef CONTEXT_FAST_SWITCH
+/*
+ * Switch from the current thread back to its worker's scheduler
+ */
+static void worker_switch_out (int op, int *l, Time_t tm)
+{
+  struct thread_worker *w = worker_self ();
+
+  w->op = op;
+  w->op_lock = l;
+  w->op_time = tm;
+  _context_swap (&w->cur->c.sp, w->sched_sp);
+}
+#endif
+
 void thread_pause (int delay)
 {
+#ifdef CONTEXT_FAST_SWITCH
+  if (nworkers > 1) {
+    lthread_t *t = thread_self ();
+    if (t) {
+      worker_switch_out (TH_OP_PAUSE, NULL, time_add (delay, t->time));
+    }
+    return;
+  }
+#endif
   context_disable ();
   if (current_process) {
     thread_insert_timer (current_process, time_add (delay,
@@ -156,12 +249,11 @@ void context_destroy (lthread_t *t)
   if (t->name) free ((void *)t->name);
   if (t->file) free ((void *)t->file);
 #endif /* DEBUG_MODE */
-  if (t->c.sz == DEFAULT_STACK_SIZE) {
-    t->next = thread_freeq;
-    thread_freeq = t;
-  }
-  else
-    free (t);
+  thread_lock (&alloc_lk);
+  context_stack_free (t->c.stack, t->c.sz);
+  t->next = thread_freeq;
+  thread_freeq = t;
+  thread_unlock (&alloc_lk);
 }
 
 
@@ -212,6 +304,13 @@ lthread_t* context_select (void)
 }
 
 
+/* thread bodies return here, so exits go through the scheduler */
+static void thread_entry (void)
+{
+  (*thread_self()->func)();
+  thread_exit (0);
+}
+
 /*------------------------------------------------------------------------
  *
  *  _thread_new --
@@ -222,38 +321,42 @@ lthread_t* context_select (void)
  */
 lthread_t *
 _thread_new (void (*f)(void), int stksz, const char *name, int ready, 
-	     char *file, int line)
+	     const char *file, int line)
 {
   static int tid = 0;
+  static int init = 0;
   lthread_t *t;
 
   context_disable ();
-  if (tid == 0) {
+  thread_lock (&alloc_lk);
+  if (!init) {
     int i;
+    init = 1;
     for (i=0; i < THREAD_FAST_ALLOC; i++) {
       THREADS[i].next = thread_freeq;
       thread_freeq = THREADS+i;
     }
   }
-  if (stksz == 0 || stksz == DEFAULT_STACK_SIZE) {
+  if (stksz == 0) {
     stksz = DEFAULT_STACK_SIZE;
-    if (thread_freeq) {
-      t = thread_freeq;
-      thread_freeq = thread_freeq->next;
-    }
-    else
-      t = (lthread_t*)malloc(sizeof(lthread_t));
+  }
+  if (thread_freeq) {
+    t = thread_freeq;
+    thread_freeq = thread_freeq->next;
   }
   else
-    t = (lthread_t*)malloc(sizeof(lthread_t)-DEFAULT_STACK_SIZE+stksz);
-  if (!t) {
+    t = (lthread_t*)malloc(sizeof(lthread_t));
+  if (t) {
+    t->c.stack = context_stack_alloc (stksz);
+  }
+  t->tid = tid++;
+  thread_unlock (&alloc_lk);
+  if (!t || !t->c.stack) {
     printf ("Thread allocation failed, stack size=%d\n",stksz);
     exit (1);
   }
   t->sz = stksz;
-  t->c.stack = (char*) t->s;
   t->c.sz = stksz;
-  t->tid = tid++;
   t->line = line;
   t->exit_code = 0;
   t->in_readyq = 0;
@@ -287,10 +390,10 @@ _thread_new (void (*f)(void), int stksz, const char *name, int ready,
   /*t->name = NULL;*/
   /*#endif  DEBUG_MODE */
 
-  context_init (t, f);
+  t->func = f;
+  context_init (t, thread_entry);
   if (ready) {
-    t->in_readyq = 1;
-    q_ins (readyQh, readyQt, t);
+    thread_make_ready (t);
   }
   context_enable ();
   return t;
@@ -300,6 +403,16 @@ _thread_new (void (*f)(void), int stksz, const char *name, int ready,
 /* quit thread */
 void thread_exit (int code)
 {
+#ifdef CONTEXT_FAST_SWITCH
+  if (nworkers > 1) {
+    lthread_t *t = thread_self ();
+    if (t) {
+      t->exit_code = code;
+      worker_switch_out (TH_OP_EXIT, NULL, 0);
+    }
+    return;
+  }
+#endif
   context_disable ();
   if (current_process)
     current_process->exit_code = code;
@@ -309,6 +422,14 @@ void thread_exit (int code)
 /* voluntary context switch */
 void thread_idle (void)
 {
+#ifdef CONTEXT_FAST_SWITCH
+  if (nworkers > 1) {
+    if (thread_self ()) {
+      worker_switch_out (TH_OP_YIELD, NULL, 0);
+    }
+    return;
+  }
+#endif
   context_disable ();
   context_timeout ();
 }
@@ -319,9 +440,198 @@ const char *thread_name (void)
   return ((current_process) ? ((current_process)->name ? (current_process)->name : "-unknown-") : "-Main-thread-");
 }
 
+/*------------------------------------------------------------------------
+ *
+ *  M:N scheduler
+ *
+ *------------------------------------------------------------------------
+ */
+void thread_make_ready (lthread_t *t)
+{
+  struct thread_worker *w;
+
+  if (nworkers == 1) {
+    t->in_readyq = 1;
+    q_ins (readyQh, readyQt, t);
+    return;
+  }
+  w = worker_self ();
+  if (!w) {
+    w = &workers[0];
+  }
+  __atomic_add_fetch (&live, 1, __ATOMIC_ACQ_REL);
+  t->in_readyq = 1;
+  thread_lock (&w->lk);
+  q_ins (w->qh, w->qt, t);
+  thread_unlock (&w->lk);
+}
+
+void thread_suspend (int *l)
+{
+#ifdef CONTEXT_FAST_SWITCH
+  if (nworkers > 1) {
+    worker_switch_out (TH_OP_BLOCK, l, 0);
+    return;
+  }
+#endif
+  context_switch (context_select ());
+}
+
+int thread_num_workers (void)
+{
+  return nworkers;
+}
+
+void thread_set_workers (int n)
+{
+  lthread_t *t;
+  int i;
+
+  if (workers || n <= 1) {
+    return;
+  }
+#ifndef CONTEXT_FAST_SWITCH
+  printf ("WARNING: M:N scheduling not supported on this architecture\n");
+  return;
+#endif
+  workers = (struct thread_worker *) calloc (n, sizeof (struct thread_worker));
+  if (!workers) {
+    printf ("FATAL ERROR: malloc failed, file %s, line %d\n",
+	    __FILE__, __LINE__);
+    exit (1);
+  }
+  for (i=0; i < n; i++) {
+    workers[i].id = i;
+  }
+  nworkers = n;
+
+  /* threads created so far go to the first worker */
+  while (readyQh) {
+    q_del (readyQh, readyQt, t);
+    q_ins (workers[0].qh, workers[0].qt, t);
+    live++;
+  }
+}
+
+#ifdef CONTEXT_FAST_SWITCH
+static lthread_t *worker_next (struct thread_worker *w)
+{
+  struct thread_worker *v;
+  lthread_t *t, *x;
+  int i;
+
+  thread_lock (&w->lk);
+  q_del (w->qh, w->qt, t);
+  thread_unlock (&w->lk);
+
+  /* steal */
+  for (i=1; !t && i < nworkers; i++) {
+    v = &workers[(w->id + i) % nworkers];
+    if (!v->qh) continue;
+    thread_lock (&v->lk);
+    q_del (v->qh, v->qt, t);
+    thread_unlock (&v->lk);
+  }
+  if (!t) {
+    return NULL;
+  }
+
+  /* release timers, as in context_select() */
+  thread_lock (&timer_lk);
+  inconsistent_timer = time_max (inconsistent_timer, t->time);
+  while (timerQh && inconsistent_timer >= timerQh->time) {
+    q_del (timerQh, timerQt, x);
+    __atomic_add_fetch (&live, 1, __ATOMIC_ACQ_REL);
+    x->in_readyq = 1;
+    thread_lock (&w->lk);
+    q_ins (w->qh, w->qt, x);
+    thread_unlock (&w->lk);
+  }
+  thread_unlock (&timer_lk);
+  return t;
+}
+
+static void *worker_loop (void *arg)
+{
+  struct thread_worker *w = (struct thread_worker *)arg;
+  lthread_t *t;
+
+  self_worker = w;
+  while (1) {
+    t = worker_next (w);
+    if (!t) {
+      if (__atomic_load_n (&live, __ATOMIC_ACQUIRE) == 0) {
+	break;
+      }
+      sched_yield ();
+      continue;
+    }
+    t->in_readyq = 0;
+    w->cur = t;
+    current_process = t;
+    _context_swap (&w->sched_sp, t->c.sp);
+    current_process = NULL;
+
+    /* t is now switched out, and can be handed to other workers */
+    switch (w->op) {
+    case TH_OP_YIELD:
+      t->in_readyq = 1;
+      thread_lock (&w->lk);
+      q_ins (w->qh, w->qt, t);
+      thread_unlock (&w->lk);
+      break;
+
+    case TH_OP_BLOCK:
+      __atomic_sub_fetch (&live, 1, __ATOMIC_ACQ_REL);
+      thread_unlock (w->op_lock);
+      break;
+
+    case TH_OP_EXIT:
+      __atomic_sub_fetch (&live, 1, __ATOMIC_ACQ_REL);
+      context_destroy (t);
+      break;
+
+    case TH_OP_PAUSE:
+      thread_lock (&timer_lk);
+      if (thread_insert_timer (t, w->op_time)) {
+	__atomic_sub_fetch (&live, 1, __ATOMIC_ACQ_REL);
+	t = NULL;
+      }
+      thread_unlock (&timer_lk);
+      if (t) {
+	t->in_readyq = 1;
+	thread_lock (&w->lk);
+	q_ins (w->qh, w->qt, t);
+	thread_unlock (&w->lk);
+      }
+      break;
+    }
+  }
+  return NULL;
+}
+#endif
+
 /* simulate function */
 void simulate (void (*f)(void))
 {
+#ifdef CONTEXT_FAST_SWITCH
+  if (nworkers > 1) {
+    int i;
+    thread_cleanup = f;
+    for (i=1; i < nworkers; i++) {
+      if (pthread_create (&workers[i].tid, NULL, worker_loop, &workers[i])) {
+	printf ("FATAL ERROR: could not create worker thread\n");
+	exit (1);
+      }
+    }
+    worker_loop (&workers[0]);
+    for (i=1; i < nworkers; i++) {
+      pthread_join (workers[i].tid, NULL);
+    }
+    if (thread_cleanup) (*thread_cleanup)();
+    exit (0);
+  }
+#endif
   thread_cleanup = f;
   thread_exit (0);
 }
@@ -335,7 +645,7 @@ void Delay (Time_t d)
 {
   lthread_t *t;
 
-  t = (lthread_t*)current_process;
+  t = thread_self ();
   time_inc (t->time, d);
 }
 
@@ -343,14 +653,14 @@ Time_t CurrentTime (void)
 {
   lthread_t *t;
 
-  t = (lthread_t*)current_process;
+  t = thread_self ();
   if (!t) return 0;
   return t->time;
 }
 
 int thread_id (void)
 {
-  lthread_t *t = (lthread_t*)current_process;
+  lthread_t *t = thread_self ();
   return t->tid;
 }
 
@@ -45,16 +45,13 @@ struct process_record {
   int color;			/* odd/even queue setup */
   int in_readyq;		/* 1 if in the readyq */
   struct process_record *next;
-  double s[(DEFAULT_STACK_SIZE+sizeof(double)-1)/sizeof(double)]; 
-         /* stack; this crazy construct is to make the "s" field aligned
-	    properly on a sparc
-         */
+  void (*func)(void);		/* thread body */
 };
 
 typedef struct process_record lthread_t;
 
 lthread_t *_thread_new (void (*f)(void), int stksz, const char *name, int
-		       ready, char *file, int line);
+		       ready, const char *file, int line);
 
 #define thread_new(x,y)  _thread_new(x,y,NULL,1,__FILE__,__LINE__)
   /* create new thread */
@@ -85,7 +82,11 @@ void thread_print_name (lthread_t *);
 void thread_pause (int delay);
   /* suspend current process for some approximate amount of time */
 
-#define lthread_self ((lthread_t*)current_process)
+lthread_t *thread_self (void);
+  /* the current thread; safe to use after a thread has migrated
+     between workers */
+
+#define lthread_self (thread_self())
 
 extern void (*thread_cleanup)(void);
 
@@ -99,6 +100,28 @@ Time_t CurrentTime ();
 
 int thread_id (void);
 
+  /*
+     M:N scheduling: run threads on n OS worker threads, each with its
+     own ready queue; idle workers steal from the others. Call before
+     simulate(). Needs CONTEXT_FAST_SWITCH. FAIR time slicing and
+     channels (channel.h) only work with a single worker.
+  */
+void thread_set_workers (int n);
+int thread_num_workers (void);
+
+  /*
+     Primitives for synchronization objects. Wait queues are protected
+     by a spin lock (an int, initially 0; a no-op with one worker).
+     thread_suspend() blocks the current thread and releases the lock
+     once the thread has been switched out; thread_make_ready() puts a
+     blocked thread back in a ready queue. Call with interrupts
+     disabled.
+  */
+void thread_lock (int *l);
+void thread_unlock (int *l);
+void thread_suspend (int *l);
+void thread_make_ready (lthread_t *t);
+
   /* thread save/restore functions */
 void thread_write (FILE *fp, lthread_t *t, int save_ctxt);
 void thread_read (FILE *fp, lthread_t *t, int save_ctxt);  
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Garbage collector benchmark for the scheme interpreter.
+#
+#   gcbench.sh [-n commands] [-t table]
+#
+# Builds a long-lived table of list cells, and then runs a stream of
+# top-level commands that allocate short-lived lists, and occasionally
+# modify the table. Each command is a separate top-level evaluation,
+# and so is followed by a collection. A second phase runs the same
+# work inside a single evaluation, calling collect-garbage. The
+# statistics printed by gc-stats after each phase include the
+# allocation rate and the collection pause times.
+#
+# The commands are run by prsim, since it reads scheme commands from
+# its standard input.
+#
+
+ncmd=2000
+ntable=20
+while [ $# -gt 0 ]
+do
+	case "$1" in
+	-n) ncmd=$2; shift 2;;
+	-t) ntable=$2; shift 2;;
+	*) echo "Usage: $0 [-n commands] [-t table]"; exit 1;;
+	esac
+done
+
+dir=`cd \`dirname $0\`; pwd`
+PRSIM=${PRSIM:-$ACT_HOME/bin/prsim}
+
+(
+  echo "load-scm \"$dir/lists.scm\""
+  echo "define table '()"
+  i=0
+  while [ $i -lt $ntable ]
+  do
+	echo "define table (bench-grow table 1000)"
+	i=`expr $i + 1`
+  done
+  echo "# phase 1: top-level commands"
+  echo "gc-stats"
+  i=0
+  while [ $i -lt $ncmd ]
+  do
+	case `expr $i % 10` in
+	0) echo "bench-update table `expr $i % 500`";;
+	*) echo "bench-churn 200";;
+	esac
+	i=`expr $i + 1`
+  done
+  echo "gc-stats"
+  echo "# phase 2: one evaluation"
+  echo "define loop (lambda (n) (if (zero? n) #t (begin (bench-churn 200) (if (zero? (- n (* 10 (truncate (/ n 10))))) (collect-garbage) #t) (loop (- n 1)))))"
+  echo "loop `expr $ncmd / 10`"
+  echo "gc-stats"
+) | $PRSIM -r /dev/null | grep '^gc:'
@@ -0,0 +1,33 @@
+;
+; List-heavy workloads for the garbage collector benchmark; see
+; gcbench.sh. Recursion depth is kept to a few thousand calls, since the
+; evaluator recurses on the C stack.
+;
+
+(define bench-iota
+  (lambda (n acc)
+    (if (zero? n) acc (bench-iota (- n 1) (cons n acc)))))
+
+(define bench-rev
+  (lambda (l acc)
+    (if (null? l) acc (bench-rev (cdr l) (cons (car l) acc)))))
+
+(define bench-nth
+  (lambda (l k)
+    (if (zero? k) l (bench-nth (cdr l) (- k 1)))))
+
+; prepend n entries of the form (k "k" (k k)) to the list t
+(define bench-grow
+  (lambda (t n)
+    (if (zero? n) t
+	(bench-grow (cons (list n (number->string n) (list n n)) t) (- n 1)))))
+
+; short-lived garbage only
+(define bench-churn
+  (lambda (n)
+    (length (bench-rev (bench-grow '() n) '()))))
+
+; replace entry k of t with a new list: an old cell now points to new cells
+(define bench-update
+  (lambda (t k)
+    (set-car! (bench-nth t k) (list k (number->string k) (bench-iota 4 '())))))
@@ -147,8 +147,6 @@
 (define scm-stack-display-depth 0)	; default # of items displayed
                                         ; increase this when debugging scm code
 
-(define scm-gc-frequency 5)		; collect garbage every so often
-
 (define scm-stack-display-depth 10)      ; debug display
 
 ;
@@ -894,6 +894,7 @@ LispSetCarBang (char *name, Sexp *s, Sexp *f)
   }
   LispCollectAllocQ = 0;
   CAR(LLIST(ARG1(s))) = ARG2(s);
+  LispGCWriteBarrier (LLIST(ARG1(s)));
   return ARG1(s);
 }
 
@@ -924,6 +925,7 @@ LispSetCdrBang (char *name, Sexp *s, Sexp *f)
   }
   LispCollectAllocQ = 0;
   CDR(LLIST(ARG1(s))) = ARG2(s);
+  LispGCWriteBarrier (LLIST(ARG1(s)));
   return ARG1(s);
 }
 
@@ -114,6 +114,7 @@ extern LispObj *LispWait (char *, Sexp *, Sexp *);
  * utilities
  */
 extern LispObj *LispCollectGarbage (char *, Sexp *, Sexp *);
+extern LispObj *LispGCStats (char *, Sexp *, Sexp *);
 
 /*
  *  String functions
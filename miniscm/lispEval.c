@@ -121,6 +121,7 @@ static struct LispBuiltinFn FnTable[] = {
 
   /* utilities */
   { "collect-garbage", NULL, 0, LispCollectGarbage },
+  { "gc-stats", NULL, 0, LispGCStats },
 
   /* debugging help */
 
@@ -179,9 +180,14 @@ void
 LispFnInit (void)
 {
   int i;
+  LispObj *l;
   for (i=0; FnTable[i].name; i++) {
     (void) LispNewString (FnTable[i].name);
     FnTable[i].id = LispNewString (FnTable[i].name);
+    l = LispNewPermObj ();
+    LTYPE(l) = S_LAMBDA_BUILTIN;
+    LBUILTIN(l) = i;
+    LispSymbol (FnTable[i].id)->fn = l;
   }
 }
 
@@ -205,6 +211,7 @@ LispAddDynamicFunc (char *name, void *f)
 {
   int i;
   const char *id = LispNewString (name);
+  LispObj *l;
 
   for (i=0; FnTable[i].name; i++) {
     if (id == FnTable[i].id)
@@ -229,6 +236,10 @@ LispAddDynamicFunc (char *name, void *f)
   DyTable[DyTableNum].name = Strdup (name);
   DyTable[DyTableNum].id = id;
   DyTable[DyTableNum].f = (LispObj *(*)(char *, Sexp *)) f;
+  l = LispNewPermObj ();
+  LTYPE(l) = S_LAMBDA_BUILTIN_DYNAMIC;
+  LBUILTIN(l) = DyTableNum;
+  LispSymbol (id)->fn = l;
   DyTableNum++;
   return 1;
 }
@@ -267,10 +278,13 @@ ispair (Sexp *s)
  *
  *  lookup --
  *
- *      Lookup a name in a frame.
+ *      Lookup a name in a frame. The name is an interned symbol, so
+ *      builtins and top-level bindings are found in the symbol table;
+ *      only local frames are searched.
  *
  *  Results:
- *      Returns result of lookup.
+ *      Returns result of lookup. Builtins are shared objects, so
+ *      looking them up does not allocate.
  *
  *  Side effects:
  *      None.
@@ -281,36 +295,26 @@ ispair (Sexp *s)
 LispObj *
 lookup (char *s, Sexp *f)
 {
+  LispSymInfo *si;
   LispObj *l;
-  Sexp *f1;
-  int i;
-  const char *k;
+
+  si = LispSymbol (s);
 
   /* keywords have precedence */
-  k = LispNewString (s);
-  for (i=0; FnTable[i].name; i++)
-    if (FnTable[i].id == k) {
-      l = LispNewObj ();
-      LTYPE(l) = S_LAMBDA_BUILTIN;
-      LBUILTIN(l) = i;
-      return l;
-    }
-  for (i=0; i < DyTableNum; i++) {
-    if (DyTable[i].id == k) {
-      l = LispNewObj ();
-      LTYPE(l) = S_LAMBDA_BUILTIN_DYNAMIC;
-      LBUILTIN(l) = i;
-      return l;
-    }
-  }
+  if (si->fn)
+    return si->fn;
+
   /* look in frame */
   l = LispFrameLookup (s,f);
   if (l) return l;
+
   /* assume that it is a builtin command */
-  l = LispNewObj ();
-  LTYPE(l) = S_MAGIC_BUILTIN;
-  LSYM(l) = s;
-  return l;
+  if (!si->magic) {
+    si->magic = LispNewPermObj ();
+    LTYPE(si->magic) = S_MAGIC_BUILTIN;
+    LSYM(si->magic) = s;
+  }
+  return si->magic;
 }
 
 
@@ -720,11 +724,8 @@ evalList (Sexp *s, Sexp *f)
       LispStackPush (LSYM(CAR(s)));
     else if (LTYPE(CAR(s)) == S_LAMBDA_BUILTIN_DYNAMIC)
       LispStackPush (DyTable[LBUILTIN(CAR(s))].name);
-    else {
-      char *str;
-      str = LispFrameRevLookup (CAR(s),f);
-      LispStackPush (str ? str : "#proc-userdef");
-    }
+    else
+      LispStackPushProc (CAR(s),f);
     t = s;
     while (LTYPE(CDR(t)) == S_LIST && LLIST(CDR(t))) {
       CDR(t) = LispCopyObj (CDR(t));
@@ -767,9 +768,7 @@ evalList (Sexp *s, Sexp *f)
     LispStackPop ();
   }
   else if (LTYPE(CAR(s)) == S_LAMBDA) {
-    char *str;
-    str = LispFrameRevLookup (CAR(s),f);
-    LispStackPush (str ? str : "#proc-userdef");
+    LispStackPushProc (CAR(s),f);
     l = LispApply (LUSERDEF(CAR(s)), LLIST(CDR(s)),f);
     LispStackPop ();
   }
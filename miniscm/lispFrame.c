@@ -29,6 +29,7 @@
  */
 
 #include <stdio.h>
+#include <common/hash.h>
 #include "lisp.h"
 #include "lispInt.h"
 
@@ -43,6 +44,47 @@
 Sexp *LispMainFrame = NULL;	/* toplevel frame */
 LispObj *LispMainFrameObj = NULL;
 
+static struct iHashtable *SymTable = NULL; /* interned name -> LispSymInfo */
+
+
+/*-----------------------------------------------------------------------------
+ *
+ *  LispSymbol --
+ *
+ *      Return the evaluation information for a symbol. The argument
+ *      must be canonicalized using LispNewString().
+ *
+ *  Results:
+ *      Returns the symbol information, creating it if necessary.
+ *
+ *  Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+LispSymInfo *
+LispSymbol (const char *s)
+{
+  phash_bucket_t *b;
+  LispSymInfo *si;
+
+  if (!SymTable) {
+    SymTable = phash_new (128);
+  }
+  b = phash_lookup (SymTable, s);
+  if (b) {
+    return (LispSymInfo *) b->v;
+  }
+  NEW (si, LispSymInfo);
+  si->fn = NULL;
+  si->global = NULL;
+  si->magic = NULL;
+  b = phash_add (SymTable, s);
+  b->v = si;
+  return si;
+}
+
 /*-----------------------------------------------------------------------------
  *
  *  LispFrameInit --
@@ -84,6 +126,10 @@ findbinding (const char *name, Sexp *f)
 
   t = f;
   while (t) {
+    if (t == LispMainFrame) {
+      /* top-level bindings are cached in the symbol table */
+      return LispSymbol (name)->global;
+    }
     t1 = LLIST(CAR(t));
     while (t1) {
       if (LSYM(CAR(LLIST(CAR(t1)))) == name)
@@ -198,16 +244,26 @@ LispAddBinding (LispObj *name, LispObj *val, Sexp *f)
 {
   Sexp *t;
   LispObj *l;
+  LispSymInfo *si;
 
   if (LTYPE(name) != S_SYM) {
     fprintf (stderr, "LispAddBinding: invalid argument!\n");
     return;
   }
-  if (f) {
+  if (f == LispMainFrame) {
+    si = LispSymbol (LSYM(name));
+    if (si->global) {
+      CDR(si->global) = val;
+      LispGCWriteBarrier (si->global);
+      return;
+    }
+  }
+  else if (f) {
     t = LLIST(CAR(f));
     while (t) {
       if (LSYM(name) == LSYM(CAR(LLIST(CAR(t))))) {
 	CDR(LLIST(CAR(t))) = val;
+	LispGCWriteBarrier (LLIST(CAR(t)));
 	return;
       }
       t = LLIST(CDR(t));
@@ -216,6 +272,9 @@ LispAddBinding (LispObj *name, LispObj *val, Sexp *f)
   t = LispNewSexp ();
   CAR(t) = name;
   CDR(t) = val;
+  if (f == LispMainFrame) {
+    si->global = t;
+  }
   l = LispNewObj ();
   LTYPE(l) = S_LIST;
   LLIST(l) = t;
@@ -226,6 +285,7 @@ LispAddBinding (LispObj *name, LispObj *val, Sexp *f)
   LTYPE(l) = S_LIST;
   LLIST(l) = t;
   CAR(f) = l;
+  LispGCWriteBarrier (f);
 }
 
 
@@ -253,6 +313,7 @@ LispModifyBinding (LispObj *name, LispObj *val, Sexp *f)
   if (LTYPE(name) != S_SYM) return 0;
   if ((t = findbinding (LSYM(name),f))) {
     CDR(t) = val;
+    LispGCWriteBarrier (t);
     return 1;
   }
   return 0;
@@ -21,10 +21,9 @@
  */
 /*************************************************************************
  *
- *  lispGC.c -- 
+ *  lispGC.c --
  *
  *   This module contains the garbage collector.
- *   (N.B. This is really inefficient!)
  *
  *************************************************************************
  */
@@ -50,9 +49,23 @@
 #define GC_UNMARK(type,x) GC_SWMARK(type,x,0)
 #define GC_MARKED(x)     GC_SWMARKED(x,1)
 
+/* set the link field of x to y, preserving the mark on x */
+#define GC_LINK(type,x,y) x->n=(type)(((unsigned long)(y)) | GC_MARKVAL(x->n))
+
+/*
+  marks of cells in the old generation: LispObj's are marked 1, and
+  Sexp's are marked 3 (or 2, if they are in the remembered set)
+*/
+#define GC_OLD_SEXP 3
+#define GC_REM_SEXP 2
+
+#define GC_BLOCK 1024		/* cells allocated from malloc at a time */
+
+/* old generation */
 static Sexp *SexpMainAllocQ = NULL;
 static Sexp *SexpMainAllocQTail = NULL;
 
+/* nursery: everything allocated since the last collection */
 static Sexp *SexpAllocQ = NULL;
 static Sexp *SexpAllocQTail = NULL;
 
@@ -68,8 +81,37 @@ static LispObj *LispObjAllocQTail = NULL;
 static LispObj *LispObjFreeQ = NULL;
 static LispObj *LispObjFreeQTail = NULL;
 
-static Sexp *MarkedSexpQ;
-static LispObj *MarkedObjQ;
+/* unused cells in the current malloc'ed block */
+static Sexp *SexpBlock = NULL;
+static int SexpBlockFree = 0;
+static LispObj *LispObjBlock = NULL;
+static int LispObjBlockFree = 0;
+
+/* roots that are live during evaluation; see LispGCAddSexp() */
+static Sexp **GCRoots = NULL;
+static int GCRootsNum = 0;
+static int GCRootsMax = 0;
+
+/* old cells that may point into the nursery; see LispGCWriteBarrier() */
+static Sexp **GCRemember = NULL;
+static int GCRememberNum = 0;
+static int GCRememberMax = 0;
+
+/* size of the old generation, and the size that triggers a full
+   collection */
+static unsigned long GCOldCells = 0;
+static unsigned long GCOldLimit = 0;
+
+#define GC_MIN_OLD_LIMIT 16384
+
+static struct {
+  unsigned long objs, sexps;	/* cells allocated */
+  unsigned long promoted;	/* cells moved to the old generation */
+  int minor, major;		/* collections of each kind */
+  double minor_ms, major_ms;	/* total pause times */
+  double max_ms;		/* longest pause */
+  struct timeval start;		/* when the statistics were reset */
+} GCStats;
 
 int LispGCHasWork;
 int LispCollectAllocQ;
@@ -78,7 +120,8 @@ int LispCollectAllocQ;
  *
  *  LispNewObj --
  *
- *      Get a new object from the free list.
+ *      Get a new object from the free list. If the free list is empty,
+ *      the next unused object in the current block is returned.
  *
  *  Results:
  *      Returns the new object.
@@ -100,7 +143,12 @@ LispNewObj (void)
       FREE(LSTR(s));
   }
   else {
-    NEW (s, LispObj);
+    if (LispObjBlockFree == 0) {
+      MALLOC (LispObjBlock, LispObj, GC_BLOCK);
+      LispObjBlockFree = GC_BLOCK;
+    }
+    s = LispObjBlock++;
+    LispObjBlockFree--;
   }
   s->t = S_INT;
   s->u.l = NULL;
@@ -108,6 +156,36 @@ LispNewObj (void)
     LispObjAllocQTail = s;
   s->n = LispObjAllocQ;
   LispObjAllocQ = s;
+  GCStats.objs++;
+  return s;
+}
+
+
+/*-----------------------------------------------------------------------------
+ *
+ *  LispNewPermObj --
+ *
+ *      Get an object that is never collected. These are shared objects
+ *      (e.g. builtin functions) that are returned by symbol lookup, and
+ *      must not be modified.
+ *
+ *  Results:
+ *      Returns the new object.
+ *
+ *  Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+LispObj *
+LispNewPermObj (void)
+{
+  LispObj *s;
+  NEW (s, LispObj);
+  s->n = NULL;
+  s->t = S_INT;
+  s->u.l = NULL;
   return s;
 }
 
@@ -174,7 +252,8 @@ LispCopyObj (LispObj *l)
  *
  *  LispNewSexp --
  *
- *      Get a Sexp from the free list.
+ *      Get a Sexp from the free list, or from the current block if the
+ *      free list is empty.
  *
  *  Results:
  *      Returns the new Sexp.
@@ -194,7 +273,12 @@ LispNewSexp (void)
     SexpFreeQ = SexpFreeQ->n;
   }
   else {
-    NEW (s, Sexp);
+    if (SexpBlockFree == 0) {
+      MALLOC (SexpBlock, Sexp, GC_BLOCK);
+      SexpBlockFree = GC_BLOCK;
+    }
+    s = SexpBlock++;
+    SexpBlockFree--;
   }
   CAR(s) = NULL;
   CDR(s) = NULL;
@@ -202,6 +286,7 @@ LispNewSexp (void)
     SexpAllocQTail = s;
   s->n = SexpAllocQ;
   SexpAllocQ = s;
+  GCStats.sexps++;
   return s;
 }
 
@@ -236,64 +321,47 @@ LispCopySexp (Sexp *s)
 /*
  *
  *
- * The garbage collector is rather interesting. It has two modes of
- * operation. When evaluation has not executed any "define", "set!", 
- * "set-car!", or "set-cdr!" commands (the only ones which have side-effects),
- * everything allocated during the last evaluation is collected without
- * running a marking algorithm. As a result, normal magic commands will
- * be executed with O(1) garbage collection overhead. Note that strings
- * are free'd when the object is reused.
- * 
- * Scheme functions without side-effects will also execute with O(1)
- * garbage collection overhead.
- * 
- * The full mark/collect algorithm is executed once every 50 times the
- * real garbage collector is called :P This "constant-factor"
- * speedup actually makes a big difference in practice.
+ * The garbage collector is generational. Cells never move, since
+ * pointers to them are held all over the C code; instead, the two
+ * generations are kept on separate allocation queues, and cells in the
+ * old generation are left marked between collections. The marking
+ * algorithm stops at marked cells, so a minor collection only
+ * traverses the nursery: everything allocated since the last
+ * collection. Cells that survive a minor collection are moved to the
+ * old generation.
  *
- * The marking algorithm is O(NUSE), where NUSE = # of used nodes. We use
- * the Schorr-Waite-Deutch algorithm for a non-recursive traversal of the
- * nodes in use.
+ * The only way an old cell can point into the nursery is through one
+ * of the commands with side-effects: "define", "set!", "set-car!", or
+ * "set-cdr!". These call LispGCWriteBarrier(), which records the old
+ * cell in the remembered set; the cells in the remembered set are
+ * additional roots for a minor collection.
  *
- * The collection phase is O(NALLOC), where NALLOC = # of allocated nodes.
- * It could be reduced to O(NUSE) by changing the allocation list to one
- * that is doubly-linked.
+ * When evaluation has not executed any of these commands, nothing
+ * allocated during the last evaluation can be reached, and the entire
+ * nursery is collected without running a marking algorithm. As a
+ * result, normal magic commands will be executed with O(1) garbage
+ * collection overhead. Note that strings are free'd when the object
+ * is reused.
  *
+ * A full collection clears the marks in the old generation and marks
+ * everything from the roots. This is done when the old generation has
+ * doubled in size since the last full collection (or every
+ * "scm-gc-frequency" collections, if it is set).
  *
- */
-
-
-/*
+ * Collections at the end of a top-level evaluation move survivors to
+ * the old generation. A collection in the middle of evaluation
+ * ("collect-garbage") leaves survivors in the nursery, since partially
+ * constructed lists are written without the write barrier.
+ *
+ * The marking algorithm is O(NUSE), where NUSE = # of used nodes in the
+ * generation being collected. We use the Schorr-Waite-Deutch algorithm
+ * for a non-recursive traversal of the nodes in use.
+ *
+ * The collection phase is O(NALLOC), where NALLOC = # of allocated
+ * nodes in the generation being collected.
  *
- * Merge the main and current alloc q into the current alloc q.
  *
  */
-static
-void
-mergealloc (void)
-{
-  Sexp *s;
-  LispObj *l;
-
-  if (!SexpAllocQ) {
-    SexpAllocQ = SexpMainAllocQ;
-    SexpAllocQTail = SexpMainAllocQTail;
-  }
-  else {
-    SexpAllocQTail->n = SexpMainAllocQ;
-    if (SexpMainAllocQ)
-      SexpAllocQTail = SexpMainAllocQTail;
-  }
-  if (!LispObjAllocQ) {
-    LispObjAllocQ = LispObjMainAllocQ;
-    LispObjAllocQTail = LispObjMainAllocQTail;
-  }
-  else {
-    LispObjAllocQTail->n = LispObjMainAllocQ;
-    if (LispObjMainAllocQ)
-      LispObjAllocQTail = LispObjMainAllocQTail;
-  }
-}
 
 
 #define NIL(x)  ((LTYPE(x) != S_LIST && LTYPE(x) != S_LAMBDA) || (LLIST(x) == NULL))
@@ -311,7 +379,7 @@ mark_sw (LispObj *l)
   while (l != NULL) {
     GC_SWMARK(LispObj *, l->n, 1);
     GC_SWMARK(Sexp *, LLIST(l)->n, GC_MARKVAL (LLIST(l)->n)+1);
-    if (GC_MARKVAL(LLIST(l)->n) == 3 || 
+    if (GC_MARKVAL(LLIST(l)->n) == 3 ||
 	(!NIL(CAR(LLIST(l))) &&  GC_MARKVAL(LLIST(CAR(LLIST(l)))->n) == 0)) {
       t0=l; t1=CAR(LLIST(l)); t2=CDR(LLIST(l)); t3=m;
       CAR(LLIST(l))=t2; CDR(LLIST(l))=t3; m=t0; l=t1;
@@ -324,88 +392,336 @@ mark_sw (LispObj *l)
   }
 }
 
-static 
+/*
+ * Mark an object and everything reachable from it, stopping at marked
+ * Sexp's.
+ */
+static
 void
-collect_sw (void)
+mark_obj (LispObj *l)
 {
-  /* all marked objects have non-zero mark */
-  /* stoll through the alloc Q and split it into two things:
-     freeQ, mainallocQ
-  */
-  SexpMainAllocQ = NULL;
-  while (SexpAllocQ) {
-    if (GC_MARKVAL (SexpAllocQ->n) != 0) {
+  if (!NIL(l) && GC_MARKVAL (LLIST(l)->n) == 0) {
+    mark_sw (l);
+  }
+  else {
+    GC_MARK (LispObj *, l->n);
+  }
+}
+
+static
+void
+mark_roots (LispObj *fl)
+{
+  LispObj root;
+  int i;
+
+  mark_obj (fl);
+  for (i=0; i < GCRootsNum; i++) {
+    if (GCRoots[i]) {
+      root.n = NULL;
+      LTYPE(&root) = S_LIST;
+      LLIST(&root) = GCRoots[i];
+      mark_obj (&root);
+    }
+  }
+}
+
+/*
+ * Clear the marks on the old generation.
+ */
+static
+void
+unmark_old (void)
+{
+  Sexp *s;
+  LispObj *l;
+
+  for (s = SexpMainAllocQ; s; s = GC_TO_PTR(Sexp *, s->n)) {
+    GC_UNMARK (Sexp *, s->n);
+  }
+  for (l = LispObjMainAllocQ; l; l = GC_TO_PTR(LispObj *, l->n)) {
+    GC_UNMARK (LispObj *, l->n);
+  }
+}
+
+/*
+ * Split the queue q: unmarked cells are returned to the free list, and
+ * marked ones are appended to the queue hd/tl. If old is set, the
+ * queue is the old generation and the cells stay marked; otherwise the
+ * marks are cleared. Returns the number of cells kept.
+ */
+static
+unsigned long
+sweep_sexp (Sexp *q, Sexp **hd, Sexp **tl, int old)
+{
+  Sexp *next;
+  unsigned long n = 0;
+
+  while (q) {
+    next = GC_TO_PTR(Sexp *, q->n);
+    if (GC_MARKVAL (q->n) != 0) {
       /* used */
-      if (!SexpMainAllocQ) {
-	SexpMainAllocQ = SexpAllocQ;
-	SexpMainAllocQTail = SexpAllocQ;
+      if (!*hd) {
+	*hd = q;
+      }
+      else if (old) {
+	GC_LINK(Sexp *, (*tl), q);
       }
       else {
-	SexpMainAllocQTail->n = SexpAllocQ;
-	SexpMainAllocQTail = SexpAllocQ;
+	(*tl)->n = q;
       }
+      *tl = q;
+      n++;
     }
     else {
       if (!SexpFreeQ) {
-	SexpFreeQ = SexpAllocQ;
-	SexpFreeQTail = SexpAllocQ;
+	SexpFreeQ = q;
       }
       else {
-	SexpFreeQTail->n = SexpAllocQ;
-	SexpFreeQTail = SexpAllocQ;
+	SexpFreeQTail->n = q;
       }
+      SexpFreeQTail = q;
     }
-    SexpAllocQ = GC_TO_PTR(Sexp*, SexpAllocQ->n);
+    q = next;
   }
   if (SexpFreeQ)
     SexpFreeQTail->n = NULL;
-  if (SexpMainAllocQ)
-    SexpMainAllocQTail->n = NULL;
-  SexpAllocQ = NULL;
+  if (*hd) {
+    if (old) {
+      GC_LINK(Sexp *, (*tl), NULL);
+    }
+    else {
+      (*tl)->n = NULL;
+    }
+  }
+  return n;
+}
 
-  LispObjMainAllocQ = NULL;
-  while (LispObjAllocQ) {
-    if (GC_MARKVAL (LispObjAllocQ->n) != 0) {
+static
+unsigned long
+sweep_obj (LispObj *q, LispObj **hd, LispObj **tl, int old)
+{
+  LispObj *next;
+  unsigned long n = 0;
+
+  while (q) {
+    next = GC_TO_PTR(LispObj *, q->n);
+    if (GC_MARKVAL (q->n) != 0) {
       /* used */
-      if (!LispObjMainAllocQ) {
-	LispObjMainAllocQ = LispObjAllocQ;
-	LispObjMainAllocQTail = LispObjAllocQ;
+      if (!*hd) {
+	*hd = q;
+      }
+      else if (old) {
+	GC_LINK(LispObj *, (*tl), q);
       }
       else {
-	LispObjMainAllocQTail->n = LispObjAllocQ;
-	LispObjMainAllocQTail = LispObjAllocQ;
+	(*tl)->n = q;
       }
+      *tl = q;
+      n++;
     }
     else {
-      if (LTYPE(LispObjAllocQ) == S_STRING) {
-	FREE(LSTR(LispObjAllocQ));
-	LTYPE(LispObjAllocQ) = S_INT;
+      if (LTYPE(q) == S_STRING) {
+	FREE(LSTR(q));
+	LTYPE(q) = S_INT;
       }
       if (!LispObjFreeQ) {
-	LispObjFreeQ = LispObjAllocQ;
-	LispObjFreeQTail = LispObjAllocQ;
+	LispObjFreeQ = q;
       }
       else {
-	LispObjFreeQTail->n = LispObjAllocQ;
-	LispObjFreeQTail = LispObjAllocQ;
+	LispObjFreeQTail->n = q;
       }
+      LispObjFreeQTail = q;
     }
-    LispObjAllocQ = GC_TO_PTR(LispObj*, LispObjAllocQ->n);
+    q = next;
   }
   if (LispObjFreeQ)
     LispObjFreeQTail->n = NULL;
-  if (LispObjMainAllocQ)
-    LispObjMainAllocQTail->n = NULL;
+  if (*hd) {
+    if (old) {
+      GC_LINK(LispObj *, (*tl), NULL);
+    }
+    else {
+      (*tl)->n = NULL;
+    }
+  }
+  return n;
+}
+
+
+/*
+ * Collect the nursery. The roots are the root stack and the remembered
+ * set. If promote is set, survivors move to the old generation;
+ * otherwise they stay in the nursery.
+ */
+static
+void
+collect_minor (LispObj *fl, int promote)
+{
+  unsigned long n;
+  Sexp *sq;
+  LispObj *lq;
+  int i;
+
+  mark_roots (fl);
+  for (i=0; i < GCRememberNum; i++) {
+    sq = GCRemember[i];
+    mark_obj (CAR(sq));
+    mark_obj (CDR(sq));
+    if (promote) {
+      GC_SWMARK (Sexp *, sq->n, GC_OLD_SEXP);
+    }
+  }
+
+  sq = SexpAllocQ;
+  lq = LispObjAllocQ;
+  SexpAllocQ = NULL;
   LispObjAllocQ = NULL;
+  if (promote) {
+    GCRememberNum = 0;
+    n = sweep_sexp (sq, &SexpMainAllocQ, &SexpMainAllocQTail, 1);
+    n += sweep_obj (lq, &LispObjMainAllocQ, &LispObjMainAllocQTail, 1);
+    GCOldCells += n;
+    GCStats.promoted += n;
+  }
+  else {
+    sweep_sexp (sq, &SexpAllocQ, &SexpAllocQTail, 0);
+    sweep_obj (lq, &LispObjAllocQ, &LispObjAllocQTail, 0);
+  }
 }
-  
+
+
+/*
+ * Collect both generations. If promote is set, survivors in the
+ * nursery move to the old generation; otherwise the generations are
+ * unchanged.
+ */
+static
+void
+collect_full (LispObj *fl, int promote)
+{
+  Sexp *sq;
+  LispObj *lq;
+  unsigned long n;
+  int i, j;
+
+  unmark_old ();
+  mark_roots (fl);
+
+  if (promote) {
+    GCRememberNum = 0;
+  }
+  else {
+    /* keep the remembered cells that are still live */
+    j = 0;
+    for (i=0; i < GCRememberNum; i++) {
+      if (GC_MARKVAL (GCRemember[i]->n) != 0) {
+	GC_SWMARK (Sexp *, GCRemember[i]->n, GC_REM_SEXP);
+	GCRemember[j++] = GCRemember[i];
+      }
+    }
+    GCRememberNum = j;
+  }
+
+  sq = SexpMainAllocQ;
+  lq = LispObjMainAllocQ;
+  SexpMainAllocQ = NULL;
+  LispObjMainAllocQ = NULL;
+  n = sweep_sexp (sq, &SexpMainAllocQ, &SexpMainAllocQTail, 1);
+  n += sweep_obj (lq, &LispObjMainAllocQ, &LispObjMainAllocQTail, 1);
+
+  sq = SexpAllocQ;
+  lq = LispObjAllocQ;
+  if (promote) {
+    j = sweep_sexp (sq, &SexpMainAllocQ, &SexpMainAllocQTail, 1);
+    j += sweep_obj (lq, &LispObjMainAllocQ, &LispObjMainAllocQTail, 1);
+    SexpAllocQ = NULL;
+    LispObjAllocQ = NULL;
+    n += j;
+    GCStats.promoted += j;
+  }
+  else {
+    SexpAllocQ = NULL;
+    LispObjAllocQ = NULL;
+    sweep_sexp (sq, &SexpAllocQ, &SexpAllocQTail, 0);
+    sweep_obj (lq, &LispObjAllocQ, &LispObjAllocQTail, 0);
+  }
+  GCOldCells = n;
+}
+
+
+static
+double
+gc_elapsed (struct timeval *t)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - t->tv_sec)*1e3 + (now.tv_usec - t->tv_usec)*1e-3;
+}
+
+static
+void
+gc_pause (struct timeval *t, int *num, double *tot)
+{
+  double ms = gc_elapsed (t);
+
+  (*num)++;
+  *tot += ms;
+  if (ms > GCStats.max_ms) {
+    GCStats.max_ms = ms;
+  }
+}
+
+
+/*
+ * Run a minor collection, or a full one when the old generation has
+ * grown too large.
+ */
+static int skip_gc = -1;	/* minor collections before the next full one */
+
+static
+void
+gc_collect (LispObj *fl, int promote)
+{
+  LispObj *l;
+  struct timeval t;
+
+  gettimeofday (&t, NULL);
+  if (skip_gc < 0) {
+    extern Sexp *LispMainFrame;
+
+    l = LispFrameLookup (LispNewString ("scm-gc-frequency"), LispMainFrame);
+    if (l && LTYPE(l) == S_INT && LINTEGER(l)  >= 0)
+      skip_gc = LINTEGER(l);
+  }
+
+  if (skip_gc == 0 || GCOldCells > GCOldLimit) {
+    collect_full (fl, promote);
+    GCOldLimit = 2*GCOldCells;
+    if (GCOldLimit < GC_MIN_OLD_LIMIT) {
+      GCOldLimit = GC_MIN_OLD_LIMIT;
+    }
+    skip_gc = -1;
+    gc_pause (&t, &GCStats.major, &GCStats.major_ms);
+  }
+  else {
+    collect_minor (fl, promote);
+    if (skip_gc > 0) {
+      skip_gc--;
+    }
+    gc_pause (&t, &GCStats.minor, &GCStats.minor_ms);
+  }
+}
+
 
 /*-----------------------------------------------------------------------------
  *
  *  LispGC --
  *
- *      Run the garbage collector, assuming all reachable nodes are reachable
- *      from the Sexp passed to the garbage collector.
+ *      Run the garbage collector at the end of a top-level evaluation,
+ *      assuming all reachable nodes are reachable from the Sexp passed to
+ *      the garbage collector or the root stack.
  *
  *  Results:
  *      None.
@@ -415,20 +731,24 @@ collect_sw (void)
  *
  *-----------------------------------------------------------------------------
  */
-static int skip_gc = 50;	/* make this bigger if it is too slow :) */
 
 void
 LispGC (LispObj *fl)
 {
-  LispObj *l;
-  
-  if (LispCollectAllocQ) {
+  struct timeval t;
+
+  if (!GCStats.start.tv_sec) {
+    gettimeofday (&GCStats.start, NULL);
+  }
+
+  if (LispCollectAllocQ && GCRememberNum == 0) {
     /*
      * The last evaluation did not have any side-effects.
      * Collect everything allocated on the last pass and put it
      * back into the free list.
      *
      */
+    gettimeofday (&t, NULL);
     if (LispObjFreeQ) {
       LispObjFreeQTail->n = LispObjAllocQ;
       if (LispObjAllocQ)
@@ -449,34 +769,11 @@ LispGC (LispObj *fl)
     }
     LispObjAllocQ = NULL;
     SexpAllocQ = NULL;
+    gc_pause (&t, &GCStats.minor, &GCStats.minor_ms);
     return;
   }
-  if (skip_gc-- > 0) {
-    LispGCHasWork = 1;
-    mergealloc ();
-    SexpMainAllocQ = SexpAllocQ;
-    SexpMainAllocQTail = SexpAllocQTail;
-    LispObjMainAllocQ = LispObjAllocQ;
-    LispObjMainAllocQTail = LispObjAllocQTail;
-    SexpAllocQ = NULL;
-    LispObjAllocQ = NULL;
-    return;
-  }
-  skip_gc = 50;
-
-  if (fl) {
-    extern Sexp *LispMainFrame;
-
-    l = LispFrameLookup (LispNewString ("scm-gc-frequency"), LispMainFrame);
-    if (l && LTYPE(l) == S_INT && LINTEGER(l)  >= 0)
-      skip_gc = LINTEGER(l);
-  }
-
   if (fl) {
-    mergealloc ();
-    mark_sw(fl);
-    collect_sw ();
-    LispObjAllocQ = NULL;
+    gc_collect (fl, 1);
   }
   LispGCHasWork = 0;
 }
@@ -486,7 +783,8 @@ LispGC (LispObj *fl)
  *
  *  LispCollectGarbage --
  *
- *      Force garbage collection after this evaluation.
+ *      Collect garbage now. Since this is in the middle of evaluation,
+ *      nothing is moved to the old generation.
  *
  *  Results:
  *      Returns #t
@@ -502,14 +800,74 @@ LispCollectGarbage (char *name, Sexp *s, Sexp *f)
 {
   LispObj *l;
   extern LispObj *LispMainFrameObj;
-  
+
   if (ARG1P(s)) {
     fprintf (stderr, "Usage: (%s)\n", name);
     RETURN;
   }
-  skip_gc = 0;
   LispCollectAllocQ = 0;
-  LispGC (LispMainFrameObj);
+  gc_collect (LispMainFrameObj, 0);
+  l = LispNewObj ();
+  LTYPE(l) = S_BOOL;
+  LBOOL(l) = 1;
+  return l;
+}
+
+
+/*-----------------------------------------------------------------------------
+ *
+ *  LispGCStats --
+ *
+ *      Display garbage collection statistics since the last call, and
+ *      reset them.
+ *
+ *  Results:
+ *      Returns #t
+ *
+ *  Side effects:
+ *      Resets the statistics.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+LispObj *
+LispGCStats (char *name, Sexp *s, Sexp *f)
+{
+  LispObj *l;
+  double ms;
+  unsigned long cells;
+  int n;
+
+  if (ARG1P(s)) {
+    fprintf (stderr, "Usage: (%s)\n", name);
+    RETURN;
+  }
+  ms = GCStats.start.tv_sec ? gc_elapsed (&GCStats.start) : 0;
+  cells = GCStats.objs + GCStats.sexps;
+  n = GCStats.minor + GCStats.major;
+  printf ("gc: %.2f ms, %lu cells allocated", ms, cells);
+  if (ms > 0) {
+    printf (" (%.2f Mcells/s)", cells/ms*1e-3);
+  }
+  printf ("\n");
+  printf ("gc: %d minor (%.3f ms), %d major (%.3f ms)\n",
+	  GCStats.minor, GCStats.minor_ms, GCStats.major, GCStats.major_ms);
+  printf ("gc: pause avg %.3f ms, max %.3f ms\n",
+	  n ? (GCStats.minor_ms + GCStats.major_ms)/n : 0,
+	  GCStats.max_ms);
+  printf ("gc: %lu cells promoted; old generation %lu cells, remembered set %d\n",
+	  GCStats.promoted, GCOldCells, GCRememberNum);
+
+  GCStats.objs = 0;
+  GCStats.sexps = 0;
+  GCStats.promoted = 0;
+  GCStats.minor = 0;
+  GCStats.major = 0;
+  GCStats.minor_ms = 0;
+  GCStats.major_ms = 0;
+  GCStats.max_ms = 0;
+  gettimeofday (&GCStats.start, NULL);
+
   l = LispNewObj ();
   LTYPE(l) = S_BOOL;
   LBOOL(l) = 1;
@@ -522,31 +880,32 @@ LispCollectGarbage (char *name, Sexp *s, Sexp *f)
  *
  *  LispGCAddSexp --
  *
- *      Add an sexp to the list of roots used for garbage collection.
+ *      Add an sexp to the stack of roots used for garbage collection.
+ *      This is done for every list that is evaluated, so it does not
+ *      allocate any lisp objects.
  *
  *  Results:
  *      None.
  *
  *  Side effects:
- *      Modifies LispMainFrameObj list.
+ *      Modifies the root stack.
  *
  *------------------------------------------------------------------------
  */
 
 void LispGCAddSexp (Sexp *s)
 {
-  extern LispObj *LispMainFrameObj;
-  Sexp *t;
-
-  t = LispNewSexp ();
-  CAR(t) = LispNewObj ();
-  LTYPE(CAR(t)) = S_LIST;
-  LLIST(CAR(t)) = s;
-  CDR(t) = LispMainFrameObj;
-  
-  LispMainFrameObj = LispNewObj ();
-  LTYPE(LispMainFrameObj) = S_LIST;
-  LLIST(LispMainFrameObj) = t;
+  if (GCRootsNum == GCRootsMax) {
+    if (GCRootsMax == 0) {
+      GCRootsMax = 1024;
+      MALLOC (GCRoots, Sexp *, GCRootsMax);
+    }
+    else {
+      GCRootsMax *= 2;
+      REALLOC (GCRoots, Sexp *, GCRootsMax);
+    }
+  }
+  GCRoots[GCRootsNum++] = s;
 }
 
 
@@ -555,26 +914,61 @@ void LispGCAddSexp (Sexp *s)
  *
  *  LispGCRemoveSexp --
  *
- *      Remove an Sexp from the list of roots for garbage collection.
+ *      Remove an Sexp from the stack of roots for garbage collection.
  *
  *  Results:
  *      None.
  *
  *  Side effects:
- *      Modifies LispMainFrameObj list.
+ *      Modifies the root stack.
  *
  *------------------------------------------------------------------------
  */
 
 void LispGCRemoveSexp (Sexp *s)
 {
-  extern LispObj *LispMainFrameObj;
-  LispObj *l;
-  
-  if (LLIST(CAR(LLIST(LispMainFrameObj))) != s) {
+  if (GCRootsNum == 0 || GCRoots[GCRootsNum-1] != s) {
     warning ("Fatal internal error. Proceed at your own risk!\n");
     return;
   }
+  GCRootsNum--;
+}
+
 
-  LispMainFrameObj = CDR(LLIST(LispMainFrameObj));
+/*------------------------------------------------------------------------
+ *
+ *  LispGCWriteBarrier --
+ *
+ *      Called after the car or cdr field of an existing Sexp is
+ *      modified. If the Sexp is in the old generation, it is added to
+ *      the remembered set so that the next minor collection sees what
+ *      it points to.
+ *
+ *  Results:
+ *      None.
+ *
+ *  Side effects:
+ *      Modifies the remembered set.
+ *
+ *------------------------------------------------------------------------
+ */
+
+void LispGCWriteBarrier (Sexp *s)
+{
+  if (GC_MARKVAL (s->n) != GC_OLD_SEXP) {
+    /* in the nursery, or already remembered */
+    return;
+  }
+  if (GCRememberNum == GCRememberMax) {
+    if (GCRememberMax == 0) {
+      GCRememberMax = 1024;
+      MALLOC (GCRemember, Sexp *, GCRememberMax);
+    }
+    else {
+      GCRememberMax *= 2;
+      REALLOC (GCRemember, Sexp *, GCRememberMax);
+    }
+  }
+  GC_SWMARK (Sexp *, s->n, GC_REM_SEXP);
+  GCRemember[GCRememberNum++] = s;
 }
@@ -112,11 +112,22 @@ typedef struct Sexp {
   LispObj *l[2];
 } Sexp;
 
+/*
+ * Evaluation-time information about an interned symbol, so that
+ * evaluating a symbol is a table lookup rather than a search.
+ */
+typedef struct LispSymInfo {
+  LispObj *fn;		/* builtin function, or NULL */
+  Sexp *global;		/* ( name . value ) in the top-level frame, or NULL */
+  LispObj *magic;	/* the symbol as a builtin command, once needed */
+} LispSymInfo;
+
 /*
  * Internal commands 
  */
 
 extern LispObj *LispNewObj ();
+extern LispObj *LispNewPermObj (void);
 extern LispObj *LispCopyObj (LispObj *);
 
 extern Sexp *LispNewSexp ();
@@ -143,7 +154,9 @@ extern int LispGCHasWork;
 extern int LispCollectAllocQ;
 extern void LispGCAddSexp (Sexp *);
 extern void LispGCRemoveSexp (Sexp *);
+extern void LispGCWriteBarrier (Sexp *);
 
+extern LispSymInfo *LispSymbol (const char *s);
 extern LispObj *LispFrameLookup (const char *s, Sexp *f);
 extern char *LispFrameRevLookup (LispObj *l, Sexp *f);
 extern void LispFrameInit (void);
@@ -153,6 +166,7 @@ extern Sexp *LispFramePush (Sexp *);
 extern int LispModifyBinding (LispObj *name, LispObj *val, Sexp *f);
 
 extern void LispStackPush (char *);
+extern void LispStackPushProc (LispObj *, Sexp *);
 extern void LispStackPop (void);
 extern void LispStackDisplay (void);
 extern void LispStackClear (void);
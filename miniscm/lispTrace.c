@@ -36,6 +36,8 @@
 typedef struct stack {
   struct stack *n;
   char *s;
+  LispObj *l;			/* user-defined procedure, if s is NULL */
+  Sexp *f;			/* ... and the frame it was called from */
   struct stack *next;
 } TRACE;
 
@@ -94,6 +96,35 @@ LispStackPush (char *name)
 }
 
 
+/*------------------------------------------------------------------------
+ *
+ *  LispStackPushProc --
+ *
+ *      Push a user-defined procedure onto the call stack. Its name is
+ *      only looked up if the stack is displayed.
+ *
+ *  Results:
+ *      none.
+ *
+ *  Side effects:
+ *      None.
+ *
+ *------------------------------------------------------------------------
+ */
+
+void
+LispStackPushProc (LispObj *l, Sexp *f)
+{
+  TRACE *t;
+  t = StackNew();
+  t->s = NULL;
+  t->l = l;
+  t->f = f;
+  t->next = current;
+  current = t;
+}
+
+
 /*------------------------------------------------------------------------
  *
  *  LispStackPop --
@@ -156,8 +187,12 @@ LispStackDisplay (void)
   if (depth > 0)
     fprintf (stderr, "Stack trace:\n");
   while (t && i < depth) {
+    char *s = t->s;
     i++;
-    fprintf (stderr, "\tcalled from: %s\n", t->s);
+    if (!s) {
+      s = LispFrameRevLookup (t->l, t->f);
+    }
+    fprintf (stderr, "\tcalled from: %s\n", s ? s : "#proc-userdef");
     t = t->next;
   }
   if (i < depth || depth == 0)
@@ -0,0 +1,56 @@
+#
+# Stores from old cells into new ones. Every top-level command is
+# followed by a collection, which promotes its survivors to the old
+# generation; the young cells stored into old ones by set-car!,
+# set-cdr!, define and set! must survive the minor collections that
+# follow.
+#
+define scm-echo-result #t
+define iota (lambda (n acc) (if (zero? n) acc (iota (- n 1) (cons n acc))))
+define nth (lambda (l k) (if (zero? k) l (nth (cdr l) (- k 1))))
+define churn (lambda (n) (length (iota n '())))
+define strs (lambda (n acc) (if (zero? n) acc (strs (- n 1) (cons (string-append "s" (number->string n)) acc))))
+# an old table
+define table (iota 50 '())
+churn 500
+# set-car! and set-cdr! of old cells, then minor collections
+set-car! (nth table 10) (list 'young (list 1 2) "str")
+set-cdr! (nth table 48) (list 51 52 (iota 3 '()))
+churn 500
+length (strs 200 '())
+churn 500
+car (nth table 10)
+nth table 48
+length table
+# young cells that point to more young cells
+set-car! (nth table 20) (list (list (list 'deep) "deeper"))
+length (strs 300 '())
+car (nth table 20)
+# the same old cell written twice between collections
+begin (set-car! (nth table 30) (list 'first)) (set-car! (nth table 30) (list 'second)) (churn 100)
+churn 500
+car (nth table 30)
+# a store, then collections in the middle of the same evaluation
+begin (set-car! (nth table 5) (iota 4 '())) (collect-garbage) (churn 300) (collect-garbage) (car (nth table 5))
+churn 500
+car (nth table 5)
+# globals redefined and set to new values
+define g (list "g" 1)
+churn 500
+define g (list "g" 2)
+length (strs 200 '())
+begin g
+set! g (cons "g" (iota 3 '()))
+churn 500
+begin g
+# a closure in the old generation that updates its own frame
+define counter (lambda (n) (lambda () (begin (set! n (cons (length n) n)) n)))
+define c (counter '())
+churn 500
+c
+c
+length (strs 200 '())
+c
+churn 500
+begin (c) (collect-garbage) (churn 200) (collect-garbage) (c)
+length table
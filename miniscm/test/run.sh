@@ -0,0 +1,118 @@
+#!/bin/sh
+
+echo
+echo "************************************************************************"
+echo "*               Testing scheme interpreter                             *"
+echo "************************************************************************"
+echo
+
+#
+# The interpreter is a library; prsim reads scheme commands from its
+# standard input, one top-level command per line, and so it is used to
+# run the scripts.
+#
+SCM=$ACT_HOME/bin/prsim
+if [ ! -x $SCM ]; then
+  echo "prsim is not installed; skipping"
+  echo
+  exit 0
+fi
+
+check_echo=0
+myecho()
+{
+  if [ $check_echo -eq 0 ]
+  then
+	check_echo=1
+	count=`echo -n "" | wc -c | awk '{print $1}'`
+	if [ $count -gt 0 ]
+	then
+		check_echo=2
+	fi
+  fi
+  if [ $check_echo -eq 1 ]
+  then
+	echo -n "$@"
+  else
+	echo "$@\c"
+  fi
+}
+
+
+fail=0
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+#
+# Each script is run twice: with the default collection schedule, and
+# with a full collection after every command. Both runs must match
+# runs/<test>.stdout and runs/<test>.stderr (empty if missing).
+#
+myecho " "
+for t in symbols generations
+do
+	for gc in default full
+	do
+		myecho ".[$t:$gc]"
+		ok=1
+		if [ $gc = full ]
+		then
+			pre="define scm-gc-frequency 1"
+		else
+			pre=""
+		fi
+		(echo "$pre"; cat $t.scm) | $SCM -r /dev/null > runs/$t.t.stdout 2> runs/$t.t.stderr
+		if ! cmp runs/$t.t.stdout runs/$t.stdout >/dev/null 2>/dev/null
+		then
+			echo
+			myecho "** FAILED TEST $t:$gc: stdout"
+			fail=`expr $fail + 1`
+			ok=0
+			if [ ! x$ACT_TEST_VERBOSE = x ]; then
+				diff runs/$t.t.stdout runs/$t.stdout
+			fi
+		fi
+		if [ -f runs/$t.stderr ]
+		then
+			cmp runs/$t.t.stderr runs/$t.stderr >/dev/null 2>/dev/null
+		else
+			[ ! -s runs/$t.t.stderr ]
+		fi
+		if [ $? -ne 0 ]
+		then
+			if [ $ok -eq 1 ]
+			then
+				echo
+				myecho "** FAILED TEST $t:$gc:"
+			fi
+			myecho " stderr"
+			fail=`expr $fail + 1`
+			ok=0
+		fi
+		if [ $ok -eq 0 ]
+		then
+			echo " **"
+			myecho " "
+		fi
+	done
+done
+echo
+
+
+if [ $fail -ne 0 ]
+then
+	if [ $fail -eq 1 ]
+	then
+		echo "--- Summary: 1 test failed ---"
+	else
+		echo "--- Summary: $fail tests failed ---"
+	fi
+	exit 1
+else
+	echo
+	echo "SUCCESS! All tests passed."
+fi
+echo
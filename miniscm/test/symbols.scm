@@ -0,0 +1,63 @@
+#
+# Symbol resolution and frames across collections. Each line is a
+# top-level command, and so is followed by a collection.
+#
+define scm-echo-result #t
+# globals, redefined and set after collections
+define a 1
+begin a
+collect-garbage
+define a 2
+begin a
+set! a 3
+begin (collect-garbage) a
+# a symbol seen for the first time after several collections
+define fresh-name (list 'fresh-name "fresh")
+begin fresh-name
+string->symbol "made-at-runtime"
+define s (string->symbol "made-at-runtime")
+symbol->string s
+# locals shadow globals; builtins are found before any binding, so
+# "g" fails and prints a stack trace
+define f (lambda (a car) (begin (collect-garbage) (cons a car)))
+f 10 20
+begin a
+car (list 5 6)
+define g (lambda (length) (+ length 1))
+g 41
+length (list 1 2 3)
+# a global with a new name is visible; one named after a builtin is not
+define cadr (lambda (l) (car (cdr l)))
+cadr (list 1 2 3)
+define list? (lambda (x) 'shadowed)
+list? (list 1)
+define h (lambda (list?) list?)
+h 7
+# closures keep their frames across collections
+define mk (lambda (n) (lambda (x) (+ x n)))
+define add5 (mk 5)
+define add7 (mk 7)
+collect-garbage
+add5 10
+add7 10
+define n 100
+add5 1
+define fns (list (mk 1) (mk 2) (mk 3))
+begin (collect-garbage) ((car (cdr fns)) 10)
+# local defines stay local
+define k (lambda (x) (begin (define a 50) (collect-garbage) (+ a x)))
+k 1
+begin a
+# collections deep inside a recursion
+define deep (lambda (n acc) (if (zero? n) (begin (collect-garbage) acc) (deep (- n 1) (cons (list n (mk n)) acc))))
+define d (deep 200 '())
+length d
+car (car d)
+(car (cdr (car (cdr d)))) 1000
+begin (collect-garbage) (collect-garbage) ((car (cdr (car d))) 1)
+# many distinct symbols, then the old ones again
+define names (lambda (i acc) (if (zero? i) acc (names (- i 1) (cons (string->symbol (string-append "sym-" (number->string i))) acc))))
+length (names 2000 '())
+begin (collect-garbage) fresh-name
+begin a
+add7 1
@@ -44,6 +44,13 @@ struct act_varinfo {
 };
 
 
+/*
+  Gates whose variables (outputs, @-labels, and inputs) fit in
+  ACT_TT_MAXVARS also carry a truth table per pull-up/pull-down
+  expression, one 64-bit word each.
+*/
+#define ACT_TT_MAXVARS 6
+
 class act_prsinfo {
  private:
   int leak_adjust;
@@ -84,6 +91,10 @@ class act_prsinfo {
 
   int *match_perm;		// used to report match!
 
+  int tt_valid;			/* 1 if the truth tables are set */
+  unsigned long long tt_up[ACT_TT_MAXVARS]; /* truth table for up[i] */
+  unsigned long long tt_dn[ACT_TT_MAXVARS]; /* truth table for dn[i] */
+
 
   act_prsinfo(int _leak_flag) {
     cell = NULL;
@@ -92,6 +103,7 @@ class act_prsinfo {
     nat = 0;
     tval = -1;
     match_perm = NULL;
+    tt_valid = 0;
     nattr = NULL;
     at_perm = NULL;
     leak_adjust = _leak_flag;
@@ -529,6 +541,106 @@ static int _equal_expr_helper (act_prs_expr_t *a, act_prs_expr_t *b,
   }
 }
 
+/*
+  Truth table of a scrubbed expression, where variable/label i is
+  bit i of the minterm index.
+*/
+static unsigned long long _tt_var (int i)
+{
+  static const unsigned long long vars[ACT_TT_MAXVARS] = {
+    0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+    0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL
+  };
+  Assert (0 <= i && i < ACT_TT_MAXVARS, "Truth table variable out of range");
+  return vars[i];
+}
+
+static unsigned long long _tt_expr (act_prs_expr_t *e)
+{
+  switch (e->type) {
+  case ACT_PRS_EXPR_AND:
+    return _tt_expr (e->u.e.l) & _tt_expr (e->u.e.r);
+  case ACT_PRS_EXPR_OR:
+    return _tt_expr (e->u.e.l) | _tt_expr (e->u.e.r);
+  case ACT_PRS_EXPR_NOT:
+    return ~_tt_expr (e->u.e.l);
+  case ACT_PRS_EXPR_VAR:
+    return _tt_var ((unsigned long)e->u.v.id);
+  case ACT_PRS_EXPR_LABEL:
+    return _tt_var ((unsigned long)e->u.l.label);
+  case ACT_PRS_EXPR_TRUE:
+    return ~0ULL;
+  case ACT_PRS_EXPR_FALSE:
+    return 0;
+  default:
+    fatal_error ("loops in expanded prs?");
+    return 0;
+  }
+}
+
+static void _compute_truth_tables (struct act_prsinfo *pi)
+{
+  pi->tt_valid = 0;
+  if (pi->nvars > ACT_TT_MAXVARS) {
+    return;
+  }
+  for (int i=0; i < A_LEN (pi->up); i++) {
+    pi->tt_up[i] = pi->up[i] ? _tt_expr (pi->up[i]) : 0;
+    pi->tt_dn[i] = pi->dn[i] ? _tt_expr (pi->dn[i]) : 0;
+  }
+  pi->tt_valid = 1;
+}
+
+/*
+  Rename the variables of truth table t (over n variables) using
+  perm: variable j of t becomes variable perm[j] of the result.
+*/
+static unsigned long long _tt_permute (unsigned long long t, int *perm, int n)
+{
+  unsigned long long r = 0;
+
+  for (int x=0; x < (1 << n); x++) {
+    int y = 0;
+    for (int j=0; j < n; j++) {
+      y |= ((x >> perm[j]) & 1) << j;
+    }
+    r |= ((t >> y) & 1ULL) << x;
+  }
+  return r;
+}
+
+/*
+  Structurally equal expressions compute the same function, so if
+  the truth tables differ the expressions cannot match. Returns 1 if
+  a match is still possible.
+*/
+static int _tt_may_match (struct act_prsinfo *k1, struct act_prsinfo *k2,
+			  int *perm)
+{
+  unsigned long long mask;
+  int n = k1->nvars;
+
+  if (!k1->tt_valid || !k2->tt_valid) {
+    return 1;
+  }
+  mask = (n == ACT_TT_MAXVARS) ? ~0ULL : ((1ULL << (1 << n)) - 1);
+
+  for (int i=0; i < A_LEN (k1->up); i++) {
+    if (perm[i] >= A_LEN (k2->up)) {
+      continue;
+    }
+    if (k1->up[i] && k2->up[perm[i]] &&
+	((k1->tt_up[i] ^ _tt_permute (k2->tt_up[perm[i]], perm, n)) & mask)) {
+      return 0;
+    }
+    if (k1->dn[i] && k2->dn[perm[i]] &&
+	((k1->tt_dn[i] ^ _tt_permute (k2->tt_dn[perm[i]], perm, n)) & mask)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 /*
   non-zero if equal, 0 otherwise
 
@@ -656,6 +768,10 @@ static int match_prsinfo (struct act_prsinfo *k1,
      the attribute values match; we need to try all permutations of
      let's say i.
   */
+  if (!_tt_may_match (k1, k2, perm)) {
+    FREE (perm);
+    return 0;
+  }
   for (i=0; i < A_LEN (k1->up); i++) {
     if (!_equal_expr (k1->up[i], k2->up[perm[i]], perm, chk_width)) {
 #if 0
@@ -2065,6 +2181,8 @@ struct act_prsinfo *ActCellPass::_gen_prs_attributes (act_prs_lang_t *prs,
   }
   FREE (tmp);
 
+  _compute_truth_tables (ret);
+
   current_idmap = imap;
   imap.moved ();
 
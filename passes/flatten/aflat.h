@@ -26,6 +26,9 @@
 
 #include <act/act.h>
 
+struct act_apply_walk;
+struct act_apply_piece;
+
 class ActApplyPass : public ActPass {
  public:
   ActApplyPass (Act *a);
@@ -43,6 +46,25 @@ class ActApplyPass : public ActPass {
   void setChannelFn (void (*f) (void *, Channel *));
   void setDataFn (void (*f) (void *, Data *));
 
+  /*
+    Streaming mode: instead of ActIds, the callbacks get flat names
+    and the output file they should write to. Names are built in a
+    single buffer and are only valid for the duration of the call.
+  */
+  void setInstNameFn (void (*f) (void *, FILE *, const char *, UserDef *));
+  void setConnPairNameFn (void (*f) (void *, FILE *,
+				     const char *, const char *));
+
+  /*
+    Number of threads used by runStream(). With more than one
+    thread, the top-level instances are split into pieces that are
+    flattened into separate buffers and written out in order; the
+    name callbacks must then be safe to call concurrently.
+  */
+  void setThreads (int n);
+
+  int runStream (FILE *fp, Process *p = NULL);
+
   void printns (FILE *fp);
 
  private:
@@ -60,38 +82,57 @@ class ActApplyPass : public ActPass {
   
   void (*apply_user_fn) (void *, ActId *, UserDef *);
   void (*apply_conn_fn) (void *, ActId *, ActId *);
+  void (*apply_user_name_fn) (void *, FILE *, const char *, UserDef *);
+  void (*apply_conn_name_fn) (void *, FILE *, const char *, const char *);
   void *cookie;
-  
-  list_t *prefixes;
-  list_t *prefix_array;
-  list_t *suffixes;
-  list_t *suffix_array;
+  int nthreads;
+
+  struct act_apply_walk *_w;	/* serial walk in progress, for printns() */
 
   /*-- private functions --*/
-  void push_namespace_name (const char *);
+  void push_namespace_name (struct act_apply_walk *, const char *);
+  void pop_namespace_name (struct act_apply_walk *);
   
-  void push_name (const char *, Array *arr = NULL);
-  void pop_name ();
+  void push_name (struct act_apply_walk *, const char *, Array *arr = NULL);
+  void pop_name (struct act_apply_walk *);
     
-  void push_name_suffix (const char *, Array *arr = NULL);
-  void pop_name_suffix ();
+  void push_name_suffix (struct act_apply_walk *, const char *,
+			 Array *arr = NULL);
+  void pop_name_suffix (struct act_apply_walk *);
+
+  void _emit_inst (struct act_apply_walk *, UserDef *);
+  void _emit_pair (struct act_apply_walk *, ActId *, int, ActId *, int);
 
-  void _flat_connections_bool (ValueIdx *vx);
+  void _flat_connections_bool (struct act_apply_walk *, ValueIdx *vx);
   
-  void _flat_single_connection (ActId *one, Array *oa,
+  void _flat_single_connection (struct act_apply_walk *,
+				ActId *one, Array *oa,
 				ActId *two, Array *ta,
 				const char *nm, Arraystep *na,
 				ActNamespace *isoneglobal,
 				ActNamespace *istwoglobal);
 
-  void _flat_rec_bool_conns (ActId *one, ActId *two, UserDef *ux,
+  void _flat_rec_bool_conns (struct act_apply_walk *,
+			     ActId *one, ActId *two, UserDef *ux,
 			     Array *oa, Array *ta,
 			     ActNamespace *isoneglobal,
 			     ActNamespace *istwoglobal);
   
-  void _any_global_conns (act_connection *c);
-  void _flat_scope (Scope *);
-  void _flat_ns (ActNamespace *);
+  void _any_global_conns (struct act_apply_walk *, act_connection *c);
+  void _flat_inst (struct act_apply_walk *, ValueIdx *, UserDef *,
+		   Array *, int recurse = 1);
+  void _flat_vx_conns (struct act_apply_walk *, ValueIdx *);
+  void _flat_vx (struct act_apply_walk *, ValueIdx *);
+  void _flat_scope (struct act_apply_walk *, Scope *);
+  void _flat_ns (struct act_apply_walk *, ActNamespace *);
+
+  /*-- parallel streaming --*/
+  void _split_ns (struct act_apply_walk *, ActNamespace *, list_t *);
+  void _split_scope (struct act_apply_walk *, Scope *, list_t *);
+  list_t *_split (struct act_apply_walk *, list_t *, int *);
+  void _run_piece (struct act_apply_walk *, struct act_apply_piece *);
+  static void *_stream_worker (void *);
+  void _stream_par (FILE *fp, Process *p);
 
 };
 
@@ -23,98 +23,282 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "aflat.h"
 #include <common/config.h>
+#include <common/array.h>
 #include <act/iter.h>
 
 /*-- a pass to walk through all connection pairs --*/
 
+/* room reserved for printing one local identifier */
+#define APPLY_NAMELEN 10240
+
+/*
+  One level of the hierarchical name: either a namespace or an
+  instance. The flat name of the current scope is kept in a single
+  buffer; each level remembers where to truncate it. For the ActId
+  callbacks, the same name is also kept as two ActId chains (the two
+  sides of a connection) that are extended and pruned in place.
+*/
+struct act_apply_level {
+  int len, nslen;		/* buffer state to restore */
+  int ns;			/* 1 if this is a namespace */
+  Array *a;			/* array index, owned by the level */
+  ActId *id[2];			/* chain elements, ActId callbacks only */
+};
+
+struct act_apply_walk {
+  FILE *fp;			/* streaming output; NULL for ActIds */
+
+  char *buf;			/* flat name of the current scope */
+  int len, max;
+  int nslen;			/* namespace part of buf */
+
+  ActId *hd[2];			/* prefix chains, ActId callbacks only */
+  A_DECL (struct act_apply_level, lev);
+  A_DECL (struct act_apply_level, suf);
+
+  char *name[2];		/* scratch space for connection names */
+  int namesz[2];
+};
+
+static struct act_apply_walk *_walk_new (FILE *fp)
+{
+  struct act_apply_walk *w;
+
+  NEW (w, struct act_apply_walk);
+  w->fp = fp;
+  w->max = 128;
+  MALLOC (w->buf, char, w->max);
+  w->buf[0] = '\0';
+  w->len = 0;
+  w->nslen = 0;
+  w->hd[0] = NULL;
+  w->hd[1] = NULL;
+  A_INIT (w->lev);
+  A_INIT (w->suf);
+  for (int k=0; k < 2; k++) {
+    w->namesz[k] = APPLY_NAMELEN;
+    MALLOC (w->name[k], char, w->namesz[k]);
+  }
+  return w;
+}
 
-void ActApplyPass::printns (FILE *fp)
+static void _walk_free (struct act_apply_walk *w)
 {
-  for (listitem_t *li = list_first (prefixes); li; li = list_next (li)) {
-    char *x = (char *) list_value (li);
-    if (x[strlen(x)-1] == ':') {
-      fprintf (fp, "%s", x);
-    }
-    else {
-      return;
-    }
+  Assert (A_LEN (w->lev) == 0 && A_LEN (w->suf) == 0, "Unbalanced walk");
+  A_FREE (w->lev);
+  A_FREE (w->suf);
+  FREE (w->buf);
+  FREE (w->name[0]);
+  FREE (w->name[1]);
+  FREE (w);
+}
+
+/* set the current scope name; only used when streaming */
+static void _walk_setname (struct act_apply_walk *w, const char *s, int nslen)
+{
+  int len = strlen (s);
+  if (len + 1 > w->max) {
+    w->max = len + 1;
+    REALLOC (w->buf, char, w->max);
   }
+  strcpy (w->buf, s);
+  w->len = len;
+  w->nslen = nslen;
 }
 
-void ActApplyPass::push_namespace_name (const char *s)
+static void _walk_grow (struct act_apply_walk *w, int extra)
 {
-  char *n;
-  MALLOC (n, char, strlen (s)+3);
-  snprintf (n, strlen(s)+3, "%s::", s);
-  list_append (prefixes, n);
-  list_append (prefix_array, NULL);
+  if (w->len + extra > w->max) {
+    while (w->len + extra > w->max) {
+      w->max *= 2;
+    }
+    REALLOC (w->buf, char, w->max);
+  }
 }
 
-void ActApplyPass::push_name (const char *s, Array *t)
+/* print the flat name of id, relative to the current scope if pfx */
+static const char *_walk_sprint (struct act_apply_walk *w, int k,
+				 ActId *id, int pfx)
 {
-  list_append (prefixes, s);
-  list_append (prefix_array, t);
+  int pos = 0;
+  if (pfx && w->len + 1 + APPLY_NAMELEN > w->namesz[k]) {
+    w->namesz[k] = w->len + 1 + APPLY_NAMELEN;
+    REALLOC (w->name[k], char, w->namesz[k]);
+  }
+  if (pfx && w->len > 0) {
+    memcpy (w->name[k], w->buf, w->len);
+    pos = w->len;
+    if (w->len > w->nslen) {
+      w->name[k][pos++] = '.';
+    }
+  }
+  w->name[k][pos] = '\0';
+  id->sPrint (w->name[k] + pos, w->namesz[k] - pos);
+  return w->name[k];
 }
 
-void ActApplyPass::push_name_suffix (const char *s, Array *t)
+void ActApplyPass::printns (FILE *fp)
 {
-  list_append (suffixes, s);
-  list_append (suffix_array, t);
+  if (_w && _w->nslen > 0) {
+    fprintf (fp, "%.*s", _w->nslen, _w->buf);
+  }
 }
 
-void ActApplyPass::pop_name_suffix ()
+void ActApplyPass::push_namespace_name (struct act_apply_walk *w,
+					const char *s)
 {
-  list_delete_tail (suffixes);
-  Array *a = (Array *) list_delete_tail (suffix_array);
-  if (a) {
-    delete a;
+  struct act_apply_level *l;
+  int n = strlen (s);
+
+  A_NEW (w->lev, struct act_apply_level);
+  l = &A_NEXT (w->lev);
+  l->len = w->len;
+  l->nslen = w->nslen;
+  l->ns = 1;
+  l->a = NULL;
+
+  Assert (w->len == w->nslen, "Namespace inside an instance?");
+  _walk_grow (w, n + 3);
+  snprintf (w->buf + w->len, n + 3, "%s::", s);
+  w->len += n + 2;
+  w->nslen = w->len;
+
+  if (!w->fp) {
+    /* a namespace prefix is a single component of the chain */
+    for (int k=0; k < 2; k++) {
+      l->id[k] = new ActId (w->buf);
+      w->hd[k] = l->id[k];
+    }
   }
+  A_INC (w->lev);
 }
 
-static ActId *suffix_to_id (list_t *suffixes, list_t *suffix_array)
+void ActApplyPass::push_name (struct act_apply_walk *w, const char *s, Array *t)
 {
-  listitem_t *li, *mi;
-  Array *a;
-  char *s;
-  ActId *id, *tail;
-
-  id = NULL;
-  tail = NULL;
-  if (suffixes) {
-    mi = list_first (suffix_array);
-    for (li = list_first (suffixes); li; li = list_next (li)) {
-      a = (Array *) list_value (mi);
-      s = (char *) list_value (li);
-
-      if (!id) {
-	id = new ActId (s);
-	tail = id;
+  struct act_apply_level *l;
+  int n = A_LEN (w->lev);
+
+  A_NEW (w->lev, struct act_apply_level);
+  l = &A_NEXT (w->lev);
+  l->len = w->len;
+  l->nslen = w->nslen;
+  l->ns = 0;
+  l->a = t;
+
+  if (w->fp) {
+    int sl = strlen (s);
+    _walk_grow (w, sl + 2 + (t ? APPLY_NAMELEN : 1));
+    if (w->len > w->nslen) {
+      w->buf[w->len++] = '.';
+    }
+    memcpy (w->buf + w->len, s, sl + 1);
+    w->len += sl;
+    if (t) {
+      t->sPrint (w->buf + w->len, APPLY_NAMELEN);
+      w->len += strlen (w->buf + w->len);
+    }
+  }
+  else {
+    for (int k=0; k < 2; k++) {
+      l->id[k] = new ActId (s, t);
+      if (n > 0) {
+	w->lev[n-1].id[k]->Append (l->id[k]);
       }
       else {
-	tail->Append (new ActId (s));
-	tail = tail->Rest();
+	w->hd[k] = l->id[k];
+      }
+    }
+  }
+  A_INC (w->lev);
+}
+
+void ActApplyPass::pop_name (struct act_apply_walk *w)
+{
+  struct act_apply_level *l;
+  int n = A_LEN (w->lev);
+
+  Assert (n > 0, "pop_name: empty prefix");
+  l = &w->lev[n-1];
+
+  if (!w->fp) {
+    for (int k=0; k < 2; k++) {
+      if (n > 1) {
+	if (l->ns) {
+	  w->hd[k] = w->lev[n-2].id[k];
+	}
+	else {
+	  w->lev[n-2].id[k]->prune();
+	}
       }
-      if (a) {
-	tail->setArray (a);
+      else {
+	w->hd[k] = NULL;
       }
-      mi = list_next (mi);
+      /* the array belongs to the level */
+      l->id[k]->setArray (NULL);
+      delete l->id[k];
     }
   }
-  return id;
-}  
+  if (l->a) {
+    delete l->a;
+  }
+  w->len = l->len;
+  w->nslen = l->nslen;
+  w->buf[w->len] = '\0';
+  A_LEN_RAW (w->lev)--;
+}
+
+void ActApplyPass::pop_namespace_name (struct act_apply_walk *w)
+{
+  Assert (A_LEN (w->lev) > 0 && A_LAST (w->lev).ns, "Hmm");
+  pop_name (w);
+}
 
-void ActApplyPass::pop_name ()
+/*
+  The suffix is the part of a name below a connection point; it is
+  kept as two ActId chains that are attached to the tails of the two
+  local identifiers being connected.
+*/
+void ActApplyPass::push_name_suffix (struct act_apply_walk *w,
+				     const char *s, Array *t)
 {
-  char *s = (char *) list_delete_tail (prefixes);
-  if (s[strlen(s)-1] == ':') {
-    FREE (s);
+  struct act_apply_level *l;
+  int n = A_LEN (w->suf);
+
+  A_NEW (w->suf, struct act_apply_level);
+  l = &A_NEXT (w->suf);
+  l->ns = 0;
+  l->a = t;
+  for (int k=0; k < 2; k++) {
+    l->id[k] = new ActId (s, t);
+    if (n > 0) {
+      w->suf[n-1].id[k]->Append (l->id[k]);
+    }
+  }
+  A_INC (w->suf);
+}
+
+void ActApplyPass::pop_name_suffix (struct act_apply_walk *w)
+{
+  struct act_apply_level *l;
+  int n = A_LEN (w->suf);
+
+  Assert (n > 0, "pop_name_suffix: empty suffix");
+  l = &w->suf[n-1];
+  for (int k=0; k < 2; k++) {
+    if (n > 1) {
+      w->suf[n-2].id[k]->prune();
+    }
+    l->id[k]->setArray (NULL);
+    delete l->id[k];
   }
-  Array *a = (Array *) list_delete_tail (prefix_array);
-  if (a) {
-    delete a;
+  if (l->a) {
+    delete l->a;
   }
+  A_LEN_RAW (w->suf)--;
 }
 
 static ActId *tailid (ActId *id)
@@ -126,104 +310,79 @@ static ActId *tailid (ActId *id)
   return id;
 }
 
-static void prefix_print ();
+#define WANT_CONNS(w) ((w)->fp ? (apply_conn_name_fn != NULL)	\
+		       : (apply_conn_fn != NULL))
 
-static ActId *prefix_to_id (list_t *prefixes, list_t *prefix_array,
-			    ActId **tailp)
+void ActApplyPass::_emit_inst (struct act_apply_walk *w, UserDef *ux)
 {
-  listitem_t *li, *mi, *id_start;
-  Array *a;
-  char *s;
-  ActId *id, *tail;
-
-  id = NULL;
-  tail = NULL;
-  if (prefixes) {
-    char *ns_name;
-    int ns_len = 0;
-    for (li = list_first (prefixes); li; li = list_next (li)) {
-      char *s = (char *) list_value (li);
-      if (s[strlen(s)-1] != ':') {
-	break;
-      }
-      ns_len += strlen (s);
-    }
-    if (ns_len > 0) {
-      MALLOC (ns_name, char, ns_len + 1);
-      for (mi = list_first (prefixes); mi != li; mi = list_next (mi)) {
-	strcat (ns_name, (char *)list_value (mi));
-      }
-      id = new ActId (ns_name);
-      tail = id;
-      FREE (ns_name);
-      id_start = li;
-    }
-    else {
-      id_start = NULL;
-    }
-    
-    mi = list_first (prefix_array);
-    for (li = list_first (prefixes); li; li = list_next (li)) {
-      if (id_start != NULL && li != id_start) {
-	mi = list_next (mi);
-	continue;
-      }
-      else {
-	id_start = NULL;
-      }
-      
-      a = (Array *) list_value (mi);
-      s = (char *) list_value (li);
-
-      if (!id) {
-	id = new ActId (s);
-	tail = id;
-      }
-      else {
-	tail->Append (new ActId (s));
-	tail = tail->Rest();
-      }
-      if (a) {
-	tail->setArray (a);
-      }
-      mi = list_next (mi);
+  if (w->fp) {
+    if (apply_user_name_fn) {
+      (*apply_user_name_fn) (cookie, w->fp, w->buf, ux);
     }
   }
-  if (tailp) {
-    *tailp = tail;
+  else if (apply_user_fn) {
+    (*apply_user_fn) (cookie, w->hd[0], ux);
   }
-  return id;
 }
 
-static void nullify_arrays (ActId *id)
+/*
+  Report a connection between one and two. If pfx1 (pfx2) is set,
+  the name is relative to the current scope; otherwise it is
+  already a complete name.
+*/
+void ActApplyPass::_emit_pair (struct act_apply_walk *w,
+			       ActId *one, int pfx1, ActId *two, int pfx2)
 {
-  while (id) {
-    id->setArray (NULL);
-    id = id->Rest();
+  if (w->fp) {
+    const char *s1 = _walk_sprint (w, 0, one, pfx1);
+    const char *s2 = _walk_sprint (w, 1, two, pfx2);
+    (*apply_conn_name_fn) (cookie, w->fp, s1, s2);
+  }
+  else {
+    int n = A_LEN (w->lev);
+    ActId *tl1, *tl2;
+
+    if (n > 0 && pfx1) {
+      tl1 = w->lev[n-1].id[0];
+      tl1->Append (one);
+      one = w->hd[0];
+    }
+    else {
+      tl1 = NULL;
+    }
+    if (n > 0 && pfx2) {
+      tl2 = w->lev[n-1].id[1];
+      tl2->Append (two);
+      two = w->hd[1];
+    }
+    else {
+      tl2 = NULL;
+    }
+    (*apply_conn_fn) (cookie, one, two);
+    if (tl1) {
+      tl1->prune();
+    }
+    if (tl2) {
+      tl2->prune();
+    }
   }
 }
 
-static void suffix_print (list_t *suffixes, list_t *suffix_array)
+/* prefix a global identifier with its namespace, if needed */
+static ActId *_global_id (act_connection *c, ActId *id)
 {
-  listitem_t *li, *mi;
-  Array *a;
-  
-  printf (".");
-  if (suffixes) {
-    mi = list_first (suffix_array);
-    for (li = list_first (suffixes); li; li = list_next (li)) {
-      a = (Array *) list_value (mi);
-      printf ("%s", (char *)list_value (li));
-      if (a) {
-	a->Print (stdout);
-      }
-      printf (".");
-      mi = list_next (mi);
-    }
+  if (c->getvx()->global && c->getvx()->global != ActNamespace::Global()) {
+    char *buf = c->getvx()->global->Name (true);
+    ActId *tmp = new ActId (buf);
+    FREE (buf);
+    tmp->Append (id);
+    return tmp;
   }
+  return id;
 }
 
-void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
+void ActApplyPass::_flat_connections_bool (struct act_apply_walk *w,
+					   ValueIdx *vx)
 {
   act_connection *c = vx->connection();
   ActConniter iter(c);
@@ -265,44 +424,13 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
 
       ActId *id1, *id2;
       ActId *tail1, *tail2;
-      ActId *hd1, *hd2, *tl1, *tl2;
 
-      if (!is_global) {
-	hd1 = prefix_to_id (prefixes, prefix_array, &tl1);
-	hd2 = prefix_to_id (prefixes, prefix_array, &tl2);
-      }
-      else {
-	hd1 = NULL;
-	hd2 = NULL;
-      }
-
-      id1 = c->toid();
-      id2 = tmp->toid();
-
-      if (c->getvx()->global && c->getvx()->global != ActNamespace::Global()) {
-	char *buf = c->getvx()->global->Name (true);
-	ActId *tmp2 = new ActId (buf);
-	tmp2->Append (id1);
-	FREE (buf);
-	id1 = tmp2;
-      }
-
-      if (tmp->getvx()->global && tmp->getvx()->global != ActNamespace::Global()) {
-	char *buf = tmp->getvx()->global->Name (true);
-	ActId *tmp2 = new ActId (buf);
-	FREE (buf);
-	tmp2->Append (id2);
-	id2 = tmp2;
-      }
+      id1 = _global_id (c, c->toid());
+      id2 = _global_id (tmp, tmp->toid());
 
       tail1 = tailid (id1);
       tail2 = tailid (id2);
 
-      if (hd1 && hd2) {
-	tl1->Append (id1);
-	tl2->Append (id2);
-      }
-
       while (!s1->isend()) {
 	Array *a1, *a2;
 	Assert (!s2->isend(), "What?");
@@ -313,12 +441,7 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
 	tail1->setArray (a1);
 	tail2->setArray (a2);
 
-	if (hd1 && hd2) {
-	  (*apply_conn_fn) (cookie, hd1, hd2);
-	}
-	else {
-	  (*apply_conn_fn) (cookie, id1, id2);
-	}
+	_emit_pair (w, id1, !is_global, id2, !is_global);
 
 	delete a1;
 	delete a2;
@@ -334,72 +457,15 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
       tail2->setArray (NULL);
       delete id1;
       delete id2;
-
-      if (hd1 && hd2) {
-	tl1->prune();
-	tl2->prune();
-	nullify_arrays (hd1);
-	nullify_arrays (hd2);
-	delete hd1;
-	delete hd2;
-      }
     }
     else {
-      ActId *head1, *tail1;
-      ActId *head2, *tail2;
       ActId *id1, *id2;
 
-      if (is_global) {
-	head1 = NULL;
-	head2 = NULL;
-      }
-      else {
-	head1 = prefix_to_id (prefixes, prefix_array, &tail1);
-	head2 = prefix_to_id (prefixes, prefix_array, &tail2);
-      }
-      
-      id1 = c->toid();
-      if (c->getvx()->global && c->getvx()->global != ActNamespace::Global()) {
-	char *buf = c->getvx()->global->Name (true);
-	ActId *tmp2 = new ActId (buf);
-	tmp2->Append (id1);
-	FREE (buf);
-	id1 = tmp2;
-      }
+      id1 = _global_id (c, c->toid());
+      id2 = _global_id (tmp, tmp->toid());
 
-      if (head1) {
-	tail1->Append (id1);
-      }
-      
-      id2 = tmp->toid();
-
-      if (tmp->getvx()->global && tmp->getvx()->global != ActNamespace::Global()) {
-	char *buf = tmp->getvx()->global->Name (true);
-	ActId *tmp2 = new ActId (buf);
-	FREE (buf);
-	tmp2->Append (id2);
-	id2 = tmp2;
-      }
-      
-      if (head2) {
-	tail2->Append (id2);
-      }
+      _emit_pair (w, id1, !is_global, id2, !is_global);
 
-      if (head1) {
-	(*apply_conn_fn) (cookie, head1, head2);
-      }
-      else {
-	(*apply_conn_fn) (cookie, id1, id2);
-      }
-
-      if (head1) {
-	tail1->prune();
-	tail2->prune();
-	nullify_arrays (head1);
-	nullify_arrays (head2);
-	delete head1;
-	delete head2;
-      }
       delete id1;
       delete id2;
     }
@@ -414,23 +480,9 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
 
       ActConniter iter2(d);
       ActId *id1, *id2;
-      ActId *hd1, *hd2, *tl1, *tl2;
-
-      if (is_global) {
-	hd1 = NULL;
-	hd2 = NULL;
-      }
-      else {
-	hd1 = prefix_to_id (prefixes, prefix_array, &tl1);
-	hd2 = prefix_to_id (prefixes, prefix_array, &tl2);
-      }
 
       id1 = d->toid();
 
-      if (hd1) {
-	tl1->Append (id1);
-      }
-
       for (iter2 = iter2.begin(); iter2 != iter2.end(); iter2++) {
 
 	tmp = *iter2;
@@ -442,14 +494,7 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
 	if (ig != is_global) continue;
 
 	id2 = tmp->toid();
-	if (hd2) {
-	  tl2->Append (id2);
-	  (*apply_conn_fn) (cookie, hd1, hd2);
-	  tl2->prune();
-	}
-	else {
-	  (*apply_conn_fn) (cookie, id1, id2);
-	}
+	_emit_pair (w, id1, !is_global, id2, !is_global);
 	delete id2;
       }
       delete id1;
@@ -458,17 +503,17 @@ void ActApplyPass::_flat_connections_bool (ValueIdx *vx)
 }
 
 /* if nm == NULL, there are no suffixes! */
-void ActApplyPass::_flat_single_connection (ActId *one, Array *oa,
+void ActApplyPass::_flat_single_connection (struct act_apply_walk *w,
+					    ActId *one, Array *oa,
 					    ActId *two, Array *ta,
 					    const char *nm, Arraystep *na,
 					    ActNamespace *isoneglobal,
 					    ActNamespace *istwoglobal)
 {
-  ActId *id1, *id2;
-  ActId *tail1, *tail2;
-  ActId *tmp1, *tmp2;
-  ActId *suf1, *suf2;
+  ActId *id[2], *tmp[2], *leaf[2];
+  ActNamespace *g[2];
   Array *na_arr;
+  int k;
 
   if (na) {
     na_arr = na->toArray();
@@ -477,78 +522,35 @@ void ActApplyPass::_flat_single_connection (ActId *one, Array *oa,
     na_arr = NULL;
   }
 
-  /*-- ok, construct two ids here and call the apply function! --*/
-  if (isoneglobal) {
-    if (isoneglobal != ActNamespace::Global()) {
-      char *buf = isoneglobal->Name(true);
-      id1 = new ActId (buf);
-      tail1 = id1;
-      FREE (buf);
-    }
-    else {
-      tail1 = NULL;
-    }
-  }
-  else {
-    id1 = prefix_to_id (prefixes, prefix_array, &tail1);
-  }
-  if (tail1) {
-    tail1->Append (one);
-  }
-  else {
-    id1 = one;
-  }
-  tmp1 = tailid (one);
+  id[0] = one;
+  id[1] = two;
+  g[0] = isoneglobal;
+  g[1] = istwoglobal;
 
-  if (nm) {
-    suf1 = suffix_to_id (suffixes, suffix_array);
-    tmp1->Append (suf1);
-    if (suf1) {
-      suf1 = tailid (suf1);
+  /*-- ok, construct two ids here and call the apply function! --*/
+  for (k=0; k < 2; k++) {
+    tmp[k] = tailid (id[k]);
+    if (nm) {
+      /* id.<suffix>.nm */
+      leaf[k] = new ActId (nm, na_arr);
+      if (A_LEN (w->suf) > 0) {
+	tmp[k]->Append (w->suf[0].id[k]);
+	A_LAST (w->suf).id[k]->Append (leaf[k]);
+      }
+      else {
+	tmp[k]->Append (leaf[k]);
+      }
     }
     else {
-      suf1 = tmp1;
+      leaf[k] = NULL;
     }
-    suf1->Append (new ActId (nm, na_arr));
-  }
-  else {
-    suf1 = tmp1;
-  }
-
-  if (istwoglobal) {
-    if (istwoglobal != ActNamespace::Global()) {
-      char *buf = istwoglobal->Name (true);
-      id2 = new ActId (buf);
-      tail2 = id2;
+    if (g[k] && g[k] != ActNamespace::Global()) {
+      char *buf = g[k]->Name (true);
+      ActId *nsid = new ActId (buf);
       FREE (buf);
+      nsid->Append (id[k]);
+      id[k] = nsid;
     }
-    else {
-      tail2 = NULL;
-    }
-  }
-  else {
-    id2 = prefix_to_id (prefixes, prefix_array, &tail2);
-  }
-  if (tail2) {
-    tail2->Append (two);
-  }
-  else {
-    id2 = two;
-  }
-  tmp2 = tailid (two);
-  if (nm) {
-    suf2 = suffix_to_id (suffixes, suffix_array);
-    tmp2->Append (suf2);
-    if (suf2) {
-      suf2 = tailid (suf2);
-    }
-    else {
-      suf2 = tmp2;
-    }
-    suf2->Append (new ActId (nm, na_arr));
-  }
-  else {
-    suf2 = tmp2;
   }
 
   if (oa && ta) {
@@ -562,10 +564,10 @@ void ActApplyPass::_flat_single_connection (ActId *one, Array *oa,
       a1 = s1->toArray();
       a2 = s2->toArray();
 
-      tmp1->setArray (a1);
-      tmp2->setArray (a2);
+      tmp[0]->setArray (a1);
+      tmp[1]->setArray (a2);
 
-      (*apply_conn_fn) (cookie, id1, id2);
+      _emit_pair (w, id[0], !isoneglobal, id[1], !istwoglobal);
 
       delete a1;
       delete a2;
@@ -573,35 +575,29 @@ void ActApplyPass::_flat_single_connection (ActId *one, Array *oa,
       s1->step();
       s2->step();
     }
-    tmp1->setArray (NULL);
-    tmp2->setArray (NULL);
+    tmp[0]->setArray (NULL);
+    tmp[1]->setArray (NULL);
     delete s1;
     delete s2;
   }
   else {
-    (*apply_conn_fn) (cookie, id1, id2);
+    _emit_pair (w, id[0], !isoneglobal, id[1], !istwoglobal);
   }
     
-  /* dealloc prefix and suffix */
-  if (tail1) {
-    tail1->prune();
-    nullify_arrays (id1);
-    delete id1;
-  }
-  if (tmp1->Rest()) {
-    nullify_arrays (tmp1->Rest());
-    delete tmp1->Rest();
-    tmp1->prune();
-  }
-  if (tail2) {
-    tail2->prune();
-    nullify_arrays (id2);
-    delete id2;
-  }
-  if (tmp2->Rest()) {
-    nullify_arrays (tmp2->Rest());
-    delete tmp2->Rest();
-    tmp2->prune();
+  /* detach namespace, suffix, and leaf */
+  for (k=0; k < 2; k++) {
+    if (id[k] != (k == 0 ? one : two)) {
+      id[k]->prune();
+      delete id[k];
+    }
+    tmp[k]->prune();
+    if (leaf[k]) {
+      if (A_LEN (w->suf) > 0) {
+	A_LAST (w->suf).id[k]->prune();
+      }
+      leaf[k]->setArray (NULL);
+      delete leaf[k];
+    }
   }
   if (na_arr) {
     delete na_arr;
@@ -609,7 +605,8 @@ void ActApplyPass::_flat_single_connection (ActId *one, Array *oa,
 }
 
 
-void ActApplyPass::_flat_rec_bool_conns (ActId *one, ActId *two, UserDef *ux,
+void ActApplyPass::_flat_rec_bool_conns (struct act_apply_walk *w,
+					 ActId *one, ActId *two, UserDef *ux,
 					 Array *oa, Array *ta,
 					 ActNamespace *isoneglobal,
 					 ActNamespace *istwoglobal)
@@ -633,22 +630,24 @@ void ActApplyPass::_flat_rec_bool_conns (ActId *one, ActId *two, UserDef *ux,
       if (vx->t->arrayInfo()) {
 	Arraystep *p = vx->t->arrayInfo()->stepper ();
 	while (!p->isend()) {
-	  push_name_suffix (vx->getName (), p->toArray());
+	  push_name_suffix (w, vx->getName (), p->toArray());
 
 	  if (TypeFactory::isProcessType (rux)) {
 	    if (rux != p->curProc()) {
 	      rux = p->curProc();
 	    }
 	  }
-	  _flat_rec_bool_conns (one, two, rux, oa, ta, isoneglobal, istwoglobal);
-	  pop_name_suffix ();
+	  _flat_rec_bool_conns (w, one, two, rux, oa, ta,
+				isoneglobal, istwoglobal);
+	  pop_name_suffix (w);
 	  p->step();
 	}
       }
       else {
-	push_name_suffix (vx->getName());
-	_flat_rec_bool_conns (one, two, rux, oa, ta, isoneglobal, istwoglobal);
-	pop_name_suffix ();
+	push_name_suffix (w, vx->getName());
+	_flat_rec_bool_conns (w, one, two, rux, oa, ta,
+			      isoneglobal, istwoglobal);
+	pop_name_suffix (w);
       }
     }
     else if (TypeFactory::isBoolType (vx->t)) {
@@ -656,20 +655,21 @@ void ActApplyPass::_flat_rec_bool_conns (ActId *one, ActId *two, UserDef *ux,
       if (vx->t->arrayInfo()) {
 	Arraystep *p = vx->t->arrayInfo()->stepper();
 	while (!p->isend()) {
-	  _flat_single_connection (one, oa, two, ta, vx->getName (), p,
+	  _flat_single_connection (w, one, oa, two, ta, vx->getName (), p,
 				   isoneglobal, istwoglobal);
 	  p->step();
 	}
       }
       else {
-	_flat_single_connection (one, oa, two, ta, vx->getName(), NULL,
+	_flat_single_connection (w, one, oa, two, ta, vx->getName(), NULL,
 				 isoneglobal, istwoglobal);
       }
     }
   }
 }
 
-void ActApplyPass::_any_global_conns (act_connection *c)
+void ActApplyPass::_any_global_conns (struct act_apply_walk *w,
+				      act_connection *c)
 {
   act_connection *root;
   list_t *stack;
@@ -697,20 +697,12 @@ void ActApplyPass::_any_global_conns (act_connection *c)
 	two = c->toid();
 
 	if (TypeFactory::isUserType (xit)) {
-	  suffixes = list_new ();
-	  suffix_array = list_new ();
-
-	  _flat_rec_bool_conns (one, two, rux,
+	  _flat_rec_bool_conns (w, one, two, rux,
 				 it->arrayInfo(), xit->arrayInfo(),
 				root->getvx()->global, NULL);
-
-	  list_free (suffixes);
-	  list_free (suffix_array);
-	  suffixes = NULL;
-	  suffix_array = NULL;
 	}
 	else if (TypeFactory::isBoolType (xit)) {
-	  _flat_single_connection (one, it->arrayInfo(),
+	  _flat_single_connection (w, one, it->arrayInfo(),
 				    two, xit->arrayInfo(),
 				    NULL, NULL,
 				   root->getvx()->global, NULL);
@@ -731,240 +723,238 @@ void ActApplyPass::_any_global_conns (act_connection *c)
 }
 
 
-void ActApplyPass::_flat_scope (Scope *s)
+/*
+  Instance vx (element arr, which the callee owns) of type ux: report
+  it, and then flatten it if recurse is set.
+*/
+void ActApplyPass::_flat_inst (struct act_apply_walk *w, ValueIdx *vx,
+			       UserDef *ux, Array *arr, int recurse)
 {
-  ActInstiter inst(s);
+  push_name (w, vx->getName(), arr);
+  _emit_inst (w, ux);
+  if (recurse) {
+    _flat_scope (w, ux->CurScope());
+  }
+  pop_name (w);
+}
 
-  for (inst = inst.begin(); inst != inst.end(); inst++) {
-    ValueIdx *vx;
-    UserDef *ux;
-    InstType *it;
-    int count;
+/* connections that have vx as the primary ValueIdx */
+void ActApplyPass::_flat_vx_conns (struct act_apply_walk *w, ValueIdx *vx)
+{
+  InstType *it = vx->t;
 
-    vx = *inst;
-    if (TypeFactory::isParamType (vx->t)) continue;
+  /* not the special case of global to non-global connection; vx
+     is the primary ValueIdx */
+  if (vx->hasConnection()) {
+    int is_global_conn;
 
-    if (!vx->isPrimary()) {
-      if (vx->connection()->isglobal()) continue;
-      
-      /* Check if this or any of its sub-objects is connected to a
-	 global signal. If so, just emit that connection and nothing
-	 else. 
-      */
-      if (apply_conn_fn) {
-	_any_global_conns (vx->connection());
-      }
-      continue;
+    if (vx->connection()->isglobal()) {
+      /* only emit connections when the other vx is a global */
+      is_global_conn = 1;
     }
-
-    it = vx->t;
-    ux = dynamic_cast<UserDef *>(it->BaseType());
-    
-    if (ux) {
-      /* set scope here */
-      Arraystep *step;
-
-      if (it->arrayInfo()) {
-	step = it->arrayInfo()->stepper();
-      }
-      else {
-	step = NULL;
-      }
-
-      do {
-	if (!step || (!step->isend() && vx->isPrimary (step->index()))) {
-	  if (step) {
-	    push_name (vx->getName(), step->toArray());
-	  }
-	  else {
-	    push_name (vx->getName());
-	  }
-
-	  if (TypeFactory::isProcessType (ux)) {
-	    if (step && step->curProc() != ux) {
-	      ux = step->curProc();
-	    }
-	  }
-
-	  /*-- process me --*/
-	  if (apply_user_fn) {
-	    ActId *proc_inst = prefix_to_id (prefixes, prefix_array, NULL);
-	    (*apply_user_fn) (cookie, proc_inst, ux);
-	    nullify_arrays (proc_inst);
-	    delete proc_inst;
-	  }
-	  _flat_scope (ux->CurScope());
-	  pop_name ();
-	}
-	if (step) {
-	  step->step();
-	}
-      } while (step && !step->isend());
-      if (step) {
-	delete step;
-      }
+    else {
+      /* only emit local connections */
+      is_global_conn = 0;
     }
+      
+    /* ok, now we get to look at this more closely */
+    if (TypeFactory::isUserType (it)) {
+      /* user-defined---now expand recursively */
+      UserDef *rux = dynamic_cast<UserDef *>(it->BaseType());
+      act_connection *c;
+      c = vx->connection();
+      if (c->hasDirectconnections()) {
+	/* ok, we have other user-defined things directly connected,
+	   take care of this */
+	ActId *one, *two;
+	ActConniter ci(c);
+	int ig;
 
-    if (!apply_conn_fn) continue;
-
-    /* not the special case of global to non-global connection; vx
-       is the primary ValueIdx */
-    if (vx->hasConnection()) {
-      int is_global_conn;
+	one = c->toid();
+	for (ci = ci.begin(); ci != ci.end(); ci++) {
+	  if (*ci == c) continue; // don't print connections to yourself
 
-      if (vx->connection()->isglobal()) {
-	/* only emit connections when the other vx is a global */
-	is_global_conn = 1;
-      }
-      else {
-	/* only emit local connections */
-	is_global_conn = 0;
-      }
-      
-      /* ok, now we get to look at this more closely */
-      if (TypeFactory::isUserType (it)) {
-	/* user-defined---now expand recursively */
-	UserDef *rux = dynamic_cast<UserDef *>(it->BaseType());
-	act_connection *c;
-	c = vx->connection();
-	if (c->hasDirectconnections()) {
-	  /* ok, we have other user-defined things directly connected,
-	     take care of this */
-	  ActId *one, *two;
-	  ActConniter ci(c);
-	  int ig;
-
-	  one = c->toid();
-	  for (ci = ci.begin(); ci != ci.end(); ci++) {
-	    if (*ci == c) continue; // don't print connections to yourself
-
-	    ig = (*ci)->isglobal();
-	    if (!(!ig || ig == is_global_conn)) continue; // only print global
-	    // to global or
-	    // non-global to non-global
+	  ig = (*ci)->isglobal();
+	  if (!(!ig || ig == is_global_conn)) continue; // only print global
+	  // to global or
+	  // non-global to non-global
 	      
-	    two = (*ci)->toid();
-	    suffixes = list_new ();
-	    suffix_array = list_new ();
-	    _flat_rec_bool_conns (one, two, rux, it->arrayInfo(),
-				  ((*ci)->vx ?
-				   (*ci)->vx->t->arrayInfo() : NULL),
-				  c->getvx()->global,
-				  (*ci)->getvx()->global);
-
-	    list_free (suffixes);
-	    list_free (suffix_array);
-	    suffixes = NULL;
-	    suffix_array = NULL;
-	    delete two;
-	  }
-	  delete one;
+	  two = (*ci)->toid();
+	  _flat_rec_bool_conns (w, one, two, rux, it->arrayInfo(),
+				((*ci)->vx ?
+				 (*ci)->vx->t->arrayInfo() : NULL),
+				c->getvx()->global,
+				(*ci)->getvx()->global);
+	  delete two;
 	}
-	if (c->hasSubconnections()) {
-	  /* we have connections to components of this as well, check! */
-	  list_t *sublist = list_new ();
-	  list_append (sublist, c);
-
-	  while ((c = (act_connection *)list_delete_tail (sublist))) {
-	    Assert (c->hasSubconnections(), "Invariant fail");
-
-	    for (int i=0; i < c->numSubconnections(); i++) {
-	      if (c->hasDirectconnections (i)) {
-		if (c->isPrimary (i)) {
-		  int type;
-		  InstType *xit;
-		  ActId *one, *two;
-		  ActConniter ci(c->a[i]);
-		  int ig;
-
-
-		  type = c->a[i]->getctype();
-		  it = c->a[i]->getvx()->t;
+	delete one;
+      }
+      if (c->hasSubconnections()) {
+	/* we have connections to components of this as well, check! */
+	list_t *sublist = list_new ();
+	list_append (sublist, c);
+
+	while ((c = (act_connection *)list_delete_tail (sublist))) {
+	  Assert (c->hasSubconnections(), "Invariant fail");
+
+	  for (int i=0; i < c->numSubconnections(); i++) {
+	    if (c->hasDirectconnections (i)) {
+	      if (c->isPrimary (i)) {
+		int type;
+		InstType *xit;
+		ActId *one, *two;
+		ActConniter ci(c->a[i]);
+		int ig;
+
+
+		type = c->a[i]->getctype();
+		it = c->a[i]->getvx()->t;
 		
-		  UserDef *rux = dynamic_cast<UserDef *> (it->BaseType());
+		UserDef *rux = dynamic_cast<UserDef *> (it->BaseType());
 
-		  /* now find the type */
-		  if (type == 0 || type == 1) {
-		    xit = it;
-		  }
-		  else {
-		    Assert (rux, "what?");
-		    xit = rux->getPortType (i);
-		  }
+		/* now find the type */
+		if (type == 0 || type == 1) {
+		  xit = it;
+		}
+		else {
+		  Assert (rux, "what?");
+		  xit = rux->getPortType (i);
+		}
 
-		  one = c->a[i]->toid();
-		  for (ci = ci.begin(); ci != ci.end(); ci++) {
-		    int type2;
-		    if (*ci == c->a[i]) continue;
+		one = c->a[i]->toid();
+		for (ci = ci.begin(); ci != ci.end(); ci++) {
+		  int type2;
+		  if (*ci == c->a[i]) continue;
 
-		    ig = (*ci)->isglobal();
-		    if (!(!ig || ig == is_global_conn)) continue;
+		  ig = (*ci)->isglobal();
+		  if (!(!ig || ig == is_global_conn)) continue;
 		  
-		    two = (*ci)->toid();
-		    type2 = (*ci)->getctype();
-
-		    ActNamespace *g1, *g2;
-		    g1 = c->a[i]->getvx()->global;
-		    g2 = (*ci)->getvx()->global;
-
-		    if (TypeFactory::isUserType (xit)) {
-		      suffixes = list_new ();
-		      suffix_array = list_new ();
-		      if (type == 1 || type2 == 1) {
-			_flat_rec_bool_conns (one, two, rux, NULL, NULL,
-					      g1, g2);
-		      }
-		      else {
-			_flat_rec_bool_conns (one, two, rux, xit->arrayInfo(),
-					      (*ci)->getvx()->t->arrayInfo(),
-					      g1, g2);
-		      }
-		      list_free (suffixes);
-		      list_free (suffix_array);
-		      suffixes = NULL;
-		      suffix_array = NULL;
+		  two = (*ci)->toid();
+		  type2 = (*ci)->getctype();
+
+		  ActNamespace *g1, *g2;
+		  g1 = c->a[i]->getvx()->global;
+		  g2 = (*ci)->getvx()->global;
+
+		  if (TypeFactory::isUserType (xit)) {
+		    if (type == 1 || type2 == 1) {
+		      _flat_rec_bool_conns (w, one, two, rux, NULL, NULL,
+					    g1, g2);
 		    }
-		    else if (TypeFactory::isBoolType (xit)) {
-		      if (type == 1 || type2 == 1) {
-			_flat_single_connection (one, NULL,
-						 two, NULL,
-						 NULL, NULL, g1, g2);
-		      }
-		      else {
-			_flat_single_connection (one, xit->arrayInfo(),
-						 two,
-						 (*ci)->getvx()->t->arrayInfo(),
-						 NULL, NULL, g1, g2);
-		      }
+		    else {
+		      _flat_rec_bool_conns (w, one, two, rux, xit->arrayInfo(),
+					    (*ci)->getvx()->t->arrayInfo(),
+					    g1, g2);
 		    }
-		    delete two;
 		  }
-		  delete one;
-		}
-		else {
-		  if (apply_conn_fn && !c->a[i]->isglobal()) {
-		    _any_global_conns (c->a[i]);
+		  else if (TypeFactory::isBoolType (xit)) {
+		    if (type == 1 || type2 == 1) {
+		      _flat_single_connection (w, one, NULL,
+					       two, NULL,
+					       NULL, NULL, g1, g2);
+		    }
+		    else {
+		      _flat_single_connection (w, one, xit->arrayInfo(),
+					       two,
+					       (*ci)->getvx()->t->arrayInfo(),
+					       NULL, NULL, g1, g2);
+		    }
 		  }
+		  delete two;
 		}
+		delete one;
 	      }
-	      if (c->a[i] && c->a[i]->hasSubconnections ()) {
-		list_append (sublist, c->a[i]);
+	      else {
+		if (!c->a[i]->isglobal()) {
+		  _any_global_conns (w, c->a[i]);
+		}
 	      }
 	    }
+	    if (c->a[i] && c->a[i]->hasSubconnections ()) {
+	      list_append (sublist, c->a[i]);
+	    }
+	  }
+	}
+	list_free (sublist);
+      }
+    }
+    else if (TypeFactory::isBoolType (it)) {
+      /* print connections! */
+      _flat_connections_bool (w, vx);
+    }
+  }
+}
+
+void ActApplyPass::_flat_vx (struct act_apply_walk *w, ValueIdx *vx)
+{
+  UserDef *ux;
+  InstType *it;
+
+  if (TypeFactory::isParamType (vx->t)) return;
+
+  if (!vx->isPrimary()) {
+    if (vx->connection()->isglobal()) return;
+      
+    /* Check if this or any of its sub-objects is connected to a
+       global signal. If so, just emit that connection and nothing
+       else. 
+    */
+    if (WANT_CONNS (w)) {
+      _any_global_conns (w, vx->connection());
+    }
+    return;
+  }
+
+  it = vx->t;
+  ux = dynamic_cast<UserDef *>(it->BaseType());
+    
+  if (ux) {
+    /* set scope here */
+    Arraystep *step;
+
+    if (it->arrayInfo()) {
+      step = it->arrayInfo()->stepper();
+    }
+    else {
+      step = NULL;
+    }
+
+    do {
+      if (!step || (!step->isend() && vx->isPrimary (step->index()))) {
+	if (TypeFactory::isProcessType (ux)) {
+	  if (step && step->curProc() != ux) {
+	    ux = step->curProc();
 	  }
-	  list_free (sublist);
 	}
+
+	/*-- process me --*/
+	_flat_inst (w, vx, ux, step ? step->toArray() : NULL);
       }
-      else if (TypeFactory::isBoolType (it)) {
-	/* print connections! */
-	_flat_connections_bool (vx);
+      if (step) {
+	step->step();
       }
+    } while (step && !step->isend());
+    if (step) {
+      delete step;
     }
   }
+
+  if (WANT_CONNS (w)) {
+    _flat_vx_conns (w, vx);
+  }
 }
 
+void ActApplyPass::_flat_scope (struct act_apply_walk *w, Scope *s)
+{
+  ActInstiter inst(s);
+
+  for (inst = inst.begin(); inst != inst.end(); inst++) {
+    _flat_vx (w, *inst);
+  }
+}
 
-void ActApplyPass::_flat_ns (ActNamespace *ns)
+
+void ActApplyPass::_flat_ns (struct act_apply_walk *w, ActNamespace *ns)
 {
   /* sub-namespaces */
   ActNamespaceiter iter(ns);
@@ -972,31 +962,30 @@ void ActApplyPass::_flat_ns (ActNamespace *ns)
   for (iter = iter.begin(); iter != iter.end(); iter++) {
     ActNamespace *t = *iter;
 
-    push_namespace_name (t->getName());
-    _flat_ns (t);
-    pop_name ();
+    push_namespace_name (w, t->getName());
+    _flat_ns (w, t);
+    pop_namespace_name (w);
   }
 
   /* connections! */
-  _flat_scope (ns->CurScope());
+  _flat_scope (w, ns->CurScope());
 }
 
 
-
 ActApplyPass::ActApplyPass (Act *a) : ActPass (a, "apply")
 {
   apply_user_fn = NULL;
   apply_conn_fn = NULL;
+  apply_user_name_fn = NULL;
+  apply_conn_name_fn = NULL;
   cookie = NULL;
+  nthreads = 1;
 
   apply_per_proc_fn = NULL;
   apply_per_channel_fn = NULL;
   apply_per_data_fn = NULL;
 
-  prefixes = NULL;
-  prefix_array = NULL;
-  suffixes = NULL;
-  suffix_array = NULL;
+  _w = NULL;
 }
 
 
@@ -1008,16 +997,6 @@ ActApplyPass::~ActApplyPass()
 
 int ActApplyPass::init ()
 {
-  if (prefixes) {
-    list_free (prefixes);
-  }
-  prefixes = list_new ();
-
-  if (prefix_array) {
-    list_free (prefix_array);
-  }
-  prefix_array = list_new ();
-
   _finished = 1;
   return 1;
 }
@@ -1038,6 +1017,29 @@ void ActApplyPass::setConnPairFn (void (*f) (void *, ActId *, ActId *))
   apply_conn_fn = f;
 }
 
+void ActApplyPass::setInstNameFn (void (*f) (void *, FILE *,
+					     const char *, UserDef *))
+{
+  apply_user_name_fn = f;
+}
+
+void ActApplyPass::setConnPairNameFn (void (*f) (void *, FILE *,
+						 const char *, const char *))
+{
+  apply_conn_name_fn = f;
+}
+
+void ActApplyPass::setThreads (int n)
+{
+  if (n == 0) {
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+  }
+  if (n < 1) {
+    n = 1;
+  }
+  nthreads = n;
+}
+
 void ActApplyPass::setProcFn (void (*f) (void *, Process *))
 {
   apply_per_proc_fn = f;
@@ -1069,12 +1071,15 @@ int ActApplyPass::run (Process *p)
     /*-- do nothing --*/
   }
   else {
+    _w = _walk_new (NULL);
     if (!p) {
-      _flat_ns (a->Global ());
+      _flat_ns (_w, a->Global ());
     }
     else {
-      _flat_scope (p->CurScope ());
+      _flat_scope (_w, p->CurScope ());
     }
+    _walk_free (_w);
+    _w = NULL;
   }
   
   _finished = 2;
@@ -1082,6 +1087,359 @@ int ActApplyPass::run (Process *p)
 }
 
 
+int ActApplyPass::runStream (FILE *fp, Process *p)
+{
+  init ();
+
+  if (!completed()) {
+    ActPass::run (p);
+  }
+
+  if (!a->Global()->CurScope()->isExpanded()) {
+    fatal_error ("ActApplyPass: must be called after expansion!");
+  }
+
+  if (!apply_conn_name_fn && !apply_user_name_fn) {
+    /*-- do nothing --*/
+  }
+  else if (nthreads > 1) {
+    _stream_par (fp, p);
+  }
+  else {
+    _w = _walk_new (fp);
+    if (!p) {
+      _flat_ns (_w, a->Global ());
+    }
+    else {
+      _flat_scope (_w, p->CurScope ());
+    }
+    _walk_free (_w);
+    _w = NULL;
+  }
+
+  _finished = 2;
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Parallel streaming
+ *
+ *  The walk is cut into pieces, listed in the order in which the
+ *  serial walk visits them: all of an instance (APPLY_VX), just the
+ *  instance callback for one element of it (APPLY_INST), or the
+ *  connections it owns (APPLY_CONNS). Starting from the top-level
+ *  instances, instances are replaced by the pieces they contain
+ *  until there is enough to keep the threads busy. Consecutive pieces
+ *  are grouped into jobs; each job is written into its own buffer,
+ *  and the buffers are copied to the output in order.
+ *
+ *------------------------------------------------------------------------
+ */
+enum act_apply_piece_type {
+  APPLY_VX,
+  APPLY_INST,
+  APPLY_CONNS
+};
+
+struct act_apply_piece {
+  act_apply_piece_type type;
+  char *name;			/* flat name of the enclosing scope */
+  int nslen;			/* namespace part of the name */
+  ValueIdx *vx;
+  UserDef *ux;			/* APPLY_INST: type of the element */
+  Array *a;			/* APPLY_INST: the element */
+};
+
+struct act_apply_job {
+  int start, end;		/* pieces [start,end) */
+  int done;
+  char *out;			/* output buffer */
+  size_t len;
+};
+
+struct act_apply_par {
+  ActApplyPass *ap;
+  act_apply_piece **piece;
+  act_apply_job *job;
+  int njobs;
+  int next;			/* next job to run */
+  int flushed;			/* # of jobs written out */
+  int window;			/* max # of jobs buffered */
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* a job was written out */
+  pthread_cond_t done;		/* a job finished */
+};
+
+static act_apply_piece *_piece_new (act_apply_piece_type type,
+				    struct act_apply_walk *w, ValueIdx *vx)
+{
+  act_apply_piece *p;
+
+  NEW (p, act_apply_piece);
+  p->type = type;
+  p->name = Strdup (w->buf);
+  p->nslen = w->nslen;
+  p->vx = vx;
+  p->ux = NULL;
+  p->a = NULL;
+  return p;
+}
+
+static void _piece_free (act_apply_piece *p)
+{
+  if (p->a) {
+    delete p->a;
+  }
+  FREE (p->name);
+  FREE (p);
+}
+
+void ActApplyPass::_split_scope (struct act_apply_walk *w, Scope *s,
+				 list_t *l)
+{
+  ActInstiter inst(s);
+
+  for (inst = inst.begin(); inst != inst.end(); inst++) {
+    ValueIdx *vx = *inst;
+    if (TypeFactory::isParamType (vx->t)) continue;
+    list_append (l, _piece_new (APPLY_VX, w, vx));
+  }
+}
+
+void ActApplyPass::_split_ns (struct act_apply_walk *w, ActNamespace *ns,
+			      list_t *l)
+{
+  ActNamespaceiter iter(ns);
+
+  for (iter = iter.begin(); iter != iter.end(); iter++) {
+    ActNamespace *t = *iter;
+
+    push_namespace_name (w, t->getName());
+    _split_ns (w, t, l);
+    pop_namespace_name (w);
+  }
+  _split_scope (w, ns->CurScope(), l);
+}
+
+/* replace each instance by its pieces; mirrors _flat_vx() */
+list_t *ActApplyPass::_split (struct act_apply_walk *w, list_t *l,
+			      int *changed)
+{
+  list_t *ret = list_new ();
+  act_apply_piece *p;
+  UserDef *ux;
+
+  *changed = 0;
+  while (!list_isempty (l)) {
+    p = (act_apply_piece *) list_delete_head (l);
+    if (p->type != APPLY_VX || !p->vx->isPrimary() ||
+	!(ux = dynamic_cast<UserDef *>(p->vx->t->BaseType()))) {
+      list_append (ret, p);
+      continue;
+    }
+    ValueIdx *vx = p->vx;
+    Arraystep *step;
+
+    _walk_setname (w, p->name, p->nslen);
+    if (vx->t->arrayInfo()) {
+      step = vx->t->arrayInfo()->stepper();
+    }
+    else {
+      step = NULL;
+    }
+    do {
+      if (!step || (!step->isend() && vx->isPrimary (step->index()))) {
+	act_apply_piece *q;
+	if (TypeFactory::isProcessType (ux)) {
+	  if (step && step->curProc() != ux) {
+	    ux = step->curProc();
+	  }
+	}
+	q = _piece_new (APPLY_INST, w, vx);
+	q->ux = ux;
+	q->a = step ? step->toArray() : NULL;
+	list_append (ret, q);
+
+	push_name (w, vx->getName(), step ? step->toArray() : NULL);
+	_split_scope (w, ux->CurScope(), ret);
+	pop_name (w);
+      }
+      if (step) {
+	step->step();
+      }
+    } while (step && !step->isend());
+    if (step) {
+      delete step;
+    }
+    list_append (ret, _piece_new (APPLY_CONNS, w, vx));
+    _piece_free (p);
+    *changed = 1;
+  }
+  list_free (l);
+  return ret;
+}
+
+void ActApplyPass::_run_piece (struct act_apply_walk *w, act_apply_piece *p)
+{
+  _walk_setname (w, p->name, p->nslen);
+  switch (p->type) {
+  case APPLY_VX:
+    _flat_vx (w, p->vx);
+    break;
+
+  case APPLY_INST:
+    _flat_inst (w, p->vx, p->ux, p->a, 0);
+    p->a = NULL;
+    break;
+
+  case APPLY_CONNS:
+    if (WANT_CONNS (w)) {
+      _flat_vx_conns (w, p->vx);
+    }
+    break;
+  }
+}
+
+void *ActApplyPass::_stream_worker (void *arg)
+{
+  act_apply_par *par = (act_apply_par *) arg;
+  struct act_apply_walk *w;
+  act_apply_job *j;
+
+  w = _walk_new (NULL);
+
+  pthread_mutex_lock (&par->lock);
+  while (1) {
+    while (par->next < par->njobs &&
+	   par->next >= par->flushed + par->window) {
+      pthread_cond_wait (&par->work, &par->lock);
+    }
+    if (par->next >= par->njobs) {
+      break;
+    }
+    j = &par->job[par->next++];
+    pthread_mutex_unlock (&par->lock);
+
+    w->fp = open_memstream (&j->out, &j->len);
+    if (!w->fp) {
+      fatal_error ("ActApplyPass: could not allocate output buffer");
+    }
+    for (int i=j->start; i < j->end; i++) {
+      par->ap->_run_piece (w, par->piece[i]);
+    }
+    fclose (w->fp);
+    w->fp = NULL;
+
+    pthread_mutex_lock (&par->lock);
+    j->done = 1;
+    pthread_cond_broadcast (&par->done);
+  }
+  pthread_mutex_unlock (&par->lock);
+
+  _walk_free (w);
+  list_cleanup ();
+  return NULL;
+}
+
+void ActApplyPass::_stream_par (FILE *fp, Process *p)
+{
+  struct act_apply_walk *w;
+  act_apply_par par;
+  list_t *l;
+  listitem_t *li;
+  pthread_t *tids;
+  int n, changed, i;
+
+  /*-- cut the walk into pieces --*/
+  w = _walk_new (fp);
+  l = list_new ();
+  if (!p) {
+    _split_ns (w, a->Global(), l);
+  }
+  else {
+    _split_scope (w, p->CurScope(), l);
+  }
+  for (i=0; i < 16 && list_length (l) < 4*nthreads; i++) {
+    l = _split (w, l, &changed);
+    if (!changed) break;
+  }
+  _walk_free (w);
+
+  n = list_length (l);
+  if (n == 0) {
+    list_free (l);
+    return;
+  }
+  MALLOC (par.piece, act_apply_piece *, n);
+  i = 0;
+  for (li = list_first (l); li; li = list_next (li)) {
+    par.piece[i++] = (act_apply_piece *) list_value (li);
+  }
+  list_free (l);
+
+  /*-- group consecutive pieces into jobs --*/
+  par.njobs = 16*nthreads;
+  if (par.njobs > n) {
+    par.njobs = n;
+  }
+  MALLOC (par.job, act_apply_job, par.njobs);
+  for (i=0; i < par.njobs; i++) {
+    par.job[i].start = (long)n*i/par.njobs;
+    par.job[i].end = (long)n*(i+1)/par.njobs;
+    par.job[i].done = 0;
+    par.job[i].out = NULL;
+    par.job[i].len = 0;
+  }
+  par.ap = this;
+  par.next = 0;
+  par.flushed = 0;
+  par.window = 4*nthreads;
+  pthread_mutex_init (&par.lock, NULL);
+  pthread_cond_init (&par.work, NULL);
+  pthread_cond_init (&par.done, NULL);
+
+  MALLOC (tids, pthread_t, nthreads);
+  for (i=0; i < nthreads; i++) {
+    if (pthread_create (&tids[i], NULL, _stream_worker, &par) != 0) {
+      fatal_error ("Could not create flattening thread");
+    }
+  }
+
+  /*-- write out the buffers in order --*/
+  for (i=0; i < par.njobs; i++) {
+    pthread_mutex_lock (&par.lock);
+    while (!par.job[i].done) {
+      pthread_cond_wait (&par.done, &par.lock);
+    }
+    pthread_mutex_unlock (&par.lock);
+
+    fwrite (par.job[i].out, 1, par.job[i].len, fp);
+    free (par.job[i].out);
+
+    pthread_mutex_lock (&par.lock);
+    par.flushed = i+1;
+    pthread_cond_broadcast (&par.work);
+    pthread_mutex_unlock (&par.lock);
+  }
+
+  for (i=0; i < nthreads; i++) {
+    pthread_join (tids[i], NULL);
+  }
+  FREE (tids);
+  pthread_mutex_destroy (&par.lock);
+  pthread_cond_destroy (&par.work);
+  pthread_cond_destroy (&par.done);
+
+  for (i=0; i < n; i++) {
+    _piece_free (par.piece[i]);
+  }
+  FREE (par.piece);
+  FREE (par.job);
+}
+
+
 void *ActApplyPass::local_op (Process *p, int mode)
 {
   if (mode == 1) {
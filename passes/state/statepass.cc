@@ -28,18 +28,60 @@
 #include <common/config.h>
 #include <act/passes/statepass.h>
 
-static act_connection *_inv_hash (struct pHashtable *H, int idx)
+/*
+ * Reverse map arrays: offset -> connection
+ */
+static act_connection **_inv_new (int n)
 {
-  phash_iter_t iter;
-  phash_bucket_t *ib;
-  
-  phash_iter_init (H, &iter);
-  while ((ib = phash_iter_next (H, &iter))) {
-    if (ib->i == idx) {
-      return (act_connection *)ib->key;
+  act_connection **a;
+
+  if (n <= 0) {
+    return NULL;
+  }
+  MALLOC (a, act_connection *, n);
+  for (int i=0; i < n; i++) {
+    a[i] = NULL;
+  }
+  return a;
+}
+
+static void _inv_init (state_inv_t *inv, state_counts *sc)
+{
+  inv->bools = _inv_new (sc->numBools());
+  inv->xbools = _inv_new (sc->numCHPBools());
+  inv->ints = _inv_new (sc->numInts());
+  inv->chans = _inv_new (sc->numChans());
+}
+
+static void _inv_free (state_inv_t *inv)
+{
+  if (inv->bools) { FREE (inv->bools); }
+  if (inv->xbools) { FREE (inv->xbools); }
+  if (inv->ints) { FREE (inv->ints); }
+  if (inv->chans) { FREE (inv->chans); }
+  inv->bools = NULL;
+  inv->xbools = NULL;
+  inv->ints = NULL;
+  inv->chans = NULL;
+}
+
+/* set entries idx .. idx+len-1; out of range entries are ignored */
+static void _inv_set (act_connection **a, int n, int idx, int len,
+		      act_connection *c)
+{
+  for (int i=0; i < len; i++) {
+    if (idx + i >= 0 && idx + i < n) {
+      a[idx + i] = c;
     }
   }
-  return NULL;
+}
+
+static act_connection *_inv_get (act_connection **a, int n, int idx)
+{
+  if (!a || idx < 0 || idx >= n) {
+    return NULL;
+  }
+  return a[idx];
 }
 
 void *ActStatePass::local_op (Process *p, int mode)
@@ -289,6 +331,14 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
   si->chp_ismulti = 0;
   si->inst = NULL;
 
+  /* bools are numbered in the first pass, the rest once the final
+     chp numbering is known */
+  si->linv.bools = _inv_new (si->local.numBools());
+  si->linv.xbools = NULL;
+  si->linv.ints = NULL;
+  si->linv.chans = NULL;
+  _inv_init (&si->pinv, &si->ports);
+
   int nportchptot = si->ports.numCHPVars();
   int localchp = chp_count - nportchptot;
 
@@ -328,6 +378,9 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
   int idx = 0;
   int chpidx = 0;
 
+  /* first-pass chp numbering: only used for driver warnings */
+  act_connection **chpinv = _inv_new (localchp);
+
   si->map = phash_new (8);
 
   struct pHashtable *_cmap = phash_new (4);
@@ -376,9 +429,13 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       x = phash_add (_cmap, pb->key);
       x->i = idx;
       Assert (v->a, "What?");
+      _inv_set (si->linv.bools, si->local.numBools(), idx,
+		v->a->size()*ts.numBools(), (act_connection *)pb->key);
       idx += v->a->size()*ts.numBools();
       x = phash_add (_cmap, (act_connection*) (((unsigned long)pb->key)|1));
       x->i = chpidx;
+      _inv_set (chpinv, localchp, chpidx, ts.numInts()*v->a->size(),
+		(act_connection *)pb->key);
       chpidx += ts.numInts()*v->a->size();
       si->all.addVar (ts, v->a->size());
       si->all.addBool (-v->a->size()*ts.numBools());
@@ -387,6 +444,8 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       x = phash_add (/*si->map*/ _cmap, pb->key);
       x->i = chpidx;
       Assert (v->a, "Huh?");
+      _inv_set (chpinv, localchp, chpidx, v->a->size(),
+		(act_connection *)pb->key);
       chpidx += v->a->size();
       si->all.addInt (v->a->size());
 
@@ -404,6 +463,8 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       /* any dynamic variable has to be in chp */
       x = phash_add (/*si->map*/ _cmap, pb->key);
       x->i = idx;
+      _inv_set (si->linv.bools, si->local.numBools(), idx, v->a->size(),
+		(act_connection *)pb->key);
       idx += v->a->size();
       for (int i=0; i < v->a->size(); i++) {
 	if (bitset_tst (tmpbits, idx - 1 - i)) {
@@ -470,11 +531,15 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
 
 	/* port index is a negative value */
 	x->i = ocount - si->ports.numBools();
+	_inv_set (si->pinv.bools, si->ports.numBools(), -x->i - 1, 1,
+		  (act_connection *)pb->key);
       }
       else if (!v->isglobal) {
 	/*-- globals not handled here --*/
 	phash_bucket_t *x = phash_add (si->map, pb->key);
 	x->i = idx++;
+	_inv_set (si->linv.bools, si->local.numBools(), x->i, 1,
+		  (act_connection *)pb->key);
 	ocount = x->i + si->ports.numBools();
       }
 
@@ -542,6 +607,7 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       else if (!v->isglobal) {
 	phash_bucket_t *x = phash_add (/*si->map*/ _cmap, pb->key);
 	x->i = chpidx++;
+	_inv_set (chpinv, localchp, x->i, 1, (act_connection *)pb->key);
 	ocount = x->i + nportchptot;
 
 	if (v->ischan) {
@@ -879,7 +945,7 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
     for (int i=0; i < si->local.numBools(); i++) {
       if (bitset_tst (inpbits, i + si->ports.numBools()) &&
 	  !bitset_tst (tmpbits, i + si->ports.numBools())) {
-	act_connection *tmpc = _inv_hash (si->map, i);
+	act_connection *tmpc = si->linv.bools[i];
 	Assert (tmpc, "How did we get here?");
 	ActId *tmpid = tmpc->toid();
 	if (!err_ctxt) {
@@ -897,7 +963,7 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
     for (int i=0; i < localchp; i++) {
       if (bitset_tst (inpchp, i + nportchptot) &&
 	  !bitset_tst (tmpchp, i + nportchptot)) {
-	act_connection *tmpc = _inv_hash (/*si->map*/ _cmap, i);
+	act_connection *tmpc = chpinv[i];
 	Assert (tmpc, "How did we get here?");
 	ActId *tmpid = tmpc->toid();
 	if (!err_ctxt) {
@@ -923,11 +989,18 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
     bitset_free (inpchp);
     bitset_free (chpmulti);
   }
+  if (chpinv) {
+    FREE (chpinv);
+  }
 
   /* re-do CHP numbering in the map! */
 
   state_counts c_idx;
 
+  si->linv.xbools = _inv_new (si->local.numCHPBools());
+  si->linv.ints = _inv_new (si->local.numInts());
+  si->linv.chans = _inv_new (si->local.numChans());
+
   hash_iter_init (cdHtmp, &niter);
   while ((nb = hash_iter_next (cdHtmp, &niter))) {
     pb = phash_lookup (b->cdH, nb->v);
@@ -945,6 +1018,8 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       x = phash_add (si->map, (act_connection *)(((unsigned long)pb->key)|1));
       x->i = c_idx.numInts();
       getStructCount (v->isstruct, &ts);
+      _inv_set (si->linv.ints, si->local.numInts(), x->i,
+		ts.numInts()*v->a->size(), (act_connection *)pb->key);
       c_idx.addVar (ts, v->a->size());
       phash_delete (_cmap, (act_connection*)(((unsigned long)pb->key)|1));
     }
@@ -954,6 +1029,8 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
       phash_delete (_cmap, pb->key);
       x = phash_add (si->map, pb->key);
       x->i = c_idx.numInts();
+      _inv_set (si->linv.ints, si->local.numInts(), x->i, v->a->size(),
+		(act_connection *)pb->key);
       c_idx.addInt (v->a->size());
     }
     else {
@@ -1015,12 +1092,19 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
 	Assert (x, "What?");
 	if (v->ischan) {
 	  x->i = ocount - si->ports.numChans();
+	  _inv_set (si->pinv.chans, si->ports.numChans(), -x->i - 1, 1,
+		    (act_connection *)pb->key);
 	}
 	else if (v->isint) {
 	  x->i = ocount - si->ports.numInts();
+	  _inv_set (si->pinv.ints, si->ports.numInts(), -x->i - 1, 1,
+		    (act_connection *)pb->key);
 	}
 	else {
 	  x->i = ocount - si->ports.numAllBools();
+	  _inv_set (si->pinv.xbools, si->ports.numCHPBools(),
+		    -x->i - 1 - si->ports.numBools(), 1,
+		    (act_connection *)pb->key);
 	}
       }
       else if (!v->isglobal) {
@@ -1030,14 +1114,20 @@ stateinfo_t *ActStatePass::countLocalState (Process *p)
 	x = phash_add (si->map, pb->key);
 	if (v->ischan) {
 	  x->i = c_idx.numChans();
+	  _inv_set (si->linv.chans, si->local.numChans(), x->i, 1,
+		    (act_connection *)pb->key);
 	  c_idx.addChan();
 	}
 	else if (v->isint) {
 	  x->i = c_idx.numInts();
+	  _inv_set (si->linv.ints, si->local.numInts(), x->i, 1,
+		    (act_connection *)pb->key);
 	  c_idx.addInt();
 	}
 	else {
 	  x->i = si->all.numBools() + c_idx.numCHPBools();
+	  _inv_set (si->linv.xbools, si->local.numCHPBools(),
+		    c_idx.numCHPBools(), 1, (act_connection *)pb->key);
 	  c_idx.addCHPBool();
 	}
       }
@@ -1083,6 +1173,19 @@ ActStatePass::ActStatePass (Act *a, int inst_offset) : ActPass (a, "collect_stat
 
   _black_box_mode = config_get_int ("net.black_box_mode");
   _inst_offsets = inst_offset;
+  _root_si = NULL;
+
+  _ginv.bools = NULL;
+  _ginv.xbools = NULL;
+  _ginv.ints = NULL;
+  _ginv.chans = NULL;
+
+  A_INIT (_layout);
+  _layout = NULL;
+  _layout_H = NULL;
+  for (int i=0; i < 4; i++) {
+    _layout_own[i] = NULL;
+  }
 }
 
 void ActStatePass::free_local (void *v)
@@ -1101,6 +1204,8 @@ void ActStatePass::free_local (void *v)
   if (s->inst) {
     phash_free (s->inst);
   }
+  _inv_free (&s->linv);
+  _inv_free (&s->pinv);
   
   FREE (s);
 }
@@ -1154,6 +1259,10 @@ int ActStatePass::run (Process *p)
 
   /*-- add state info maps for globals --*/
   state_counts idx;
+
+  _inv_free (&_ginv);
+  _inv_init (&_ginv, &_globals);
+  _layout_free ();
   
   for (int i=0; i < A_LEN (nl->used_globals); i++) {
     act_booleanized_var_t *v;
@@ -1166,10 +1275,16 @@ int ActStatePass::run (Process *p)
       b = phash_add (_root_si->map, nl->used_globals[i].c);
       if (dv->isint) {
 	b->i = idx.numInts() - _globals.numInts();
+	_inv_set (_ginv.ints, _globals.numInts(),
+		  -b->i - dv->a->size(), dv->a->size(),
+		  nl->used_globals[i].c);
 	idx.addInt (dv->a->size());
       }
       else {
 	b->i = idx.numBools() - _globals.numBools();
+	_inv_set (_ginv.bools, _globals.numBools(),
+		  -b->i - dv->a->size(), dv->a->size(),
+		  nl->used_globals[i].c);
 	idx.addBool (dv->a->size());
       }
     }
@@ -1181,14 +1296,20 @@ int ActStatePass::run (Process *p)
       b = phash_add (_root_si->map, nl->used_globals[i].c);
       if (v->ischan) {
 	b->i = idx.numChans() - _globals.numChans();
+	_inv_set (_ginv.chans, _globals.numChans(), -b->i - 1, 1,
+		  nl->used_globals[i].c);
 	idx.addChan ();
       }
       else if (v->isint) {
 	b->i = idx.numInts() - _globals.numInts();
+	_inv_set (_ginv.ints, _globals.numInts(), -b->i - 1, 1,
+		  nl->used_globals[i].c);
 	idx.addInt ();
       }
       else {
 	b->i = idx.numBools() - _globals.numBools();
+	_inv_set (_ginv.bools, _globals.numBools(), -b->i - 1, 1,
+		  nl->used_globals[i].c);
 	idx.addBool();
       }
     }
@@ -1480,8 +1601,35 @@ int ActStatePass::getTypeDynamicStructOffset (stateinfo_t *si,
   return 0;
 }
 
+/*
+ * Dynamic arrays occupy a range of offsets that all map back to the
+ * array connection. Return the element index for offset "off", or -1
+ * if "c" is not a dynamic array.
+ */
+static int _dyn_offset (stateinfo_t *si, act_connection *c, int off,
+			int type)
+{
+  phash_bucket_t *b;
+
+  b = phash_lookup (si->bnl->cdH, c);
+  if (!b) {
+    return -1;
+  }
+  act_dynamic_var_t *dv = (act_dynamic_var_t *) b->v;
+  if (dv->isstruct && type == 1) {
+    b = phash_lookup (si->map, (act_connection *)(((unsigned long)c)|1));
+  }
+  else {
+    b = phash_lookup (si->map, c);
+  }
+  Assert (b, "What?");
+  return off - b->i;
+}
+
 act_connection *ActStatePass::getConnFromOffset (stateinfo_t *si, int off, int type, int *doff)
 {
+  act_connection *c;
+  
   if (!si) {
     return NULL;
   }
@@ -1491,134 +1639,56 @@ act_connection *ActStatePass::getConnFromOffset (stateinfo_t *si, int off, int t
   if (isGlobalOffset (off)) {
     off = globalIdx (off);
     si = rootStateInfo ();
-    if (off >= A_LEN (si->bnl->used_globals)) {
-      return NULL;
+    if (type == 0) {
+      c = _inv_get (_ginv.bools, _globals.numBools(), off);
+    }
+    else if (type == 1) {
+      c = _inv_get (_ginv.ints, _globals.numInts(), off);
     }
     else {
-      return si->bnl->used_globals[off].c;
+      c = _inv_get (_ginv.chans, _globals.numChans(), off);
+    }
+    if (c) {
+      /* map value for this global is -off-1 */
+      *doff = _dyn_offset (si, c, -off - 1, type);
     }
+    return c;
   }
   else if (isPortOffset (off)) {
     off = portIdx (off);
     if (type == 0 && off < si->ports.numBools()) {
       /* -- booleanized ports -- */
-      for (int i=A_LEN (si->bnl->ports)-1; i >= 0; i--) {
-	if (si->bnl->ports[i].omit) continue;
-	if (off == 0) {
-	  return si->bnl->ports[i].c;
-	}
-	off--;
-      }
+      return _inv_get (si->pinv.bools, si->ports.numBools(), off);
+    }
+    else if (type == 0) {
+      return _inv_get (si->pinv.xbools, si->ports.numCHPBools(),
+		       off - si->ports.numBools());
+    }
+    else if (type == 1) {
+      return _inv_get (si->pinv.ints, si->ports.numInts(), off);
     }
     else {
-      off = off - si->ports.numBools();
-      /* -- chp ports: wrong -- */
-      for (int i=A_LEN (si->bnl->chpports)-1; i >= 0; i--) {
-	if (si->bnl->chpports[i].omit) continue;
-	phash_bucket_t *xb = phash_lookup (si->bnl->cH,
-					   si->bnl->chpports[i].c);
-	if (!xb) {
-	  continue;
-	}
-	act_booleanized_var_t *xv = (act_booleanized_var_t *)xb->v;
-	if (xv->used) {
-	  continue;
-	}
-	if ((type == 2 || type == 3) && xv->ischan) {
-	  if (off == 0) {
-	    return si->bnl->chpports[i].c;
-	  }
-	  off--;
-	}
-	else if (type == 1 && xv->isint) {
-	  if (off == 0) {
-	    return si->bnl->chpports[i].c;
-	  }
-	  off--;
-	}
-	else if (type == 0 && !(xv->isint || xv->ischan)) {
-	  if (off == 0) {
-	    return si->bnl->chpports[i].c;
-	  }
-	  off--;
-	}
-      }
+      return _inv_get (si->pinv.chans, si->ports.numChans(), off);
     }
-    /* something went wrong */
-    return NULL;
   }
   else {
-    act_connection *c;
-    phash_bucket_t *b;
-    phash_iter_t bi;
-
-    phash_iter_init (si->map, &bi);
-
-    /* -- check variables -- */
-    while ((b = phash_iter_next (si->map, &bi))) {
-      if (b->i == off) {
-	c = (act_connection *)b->key;
-	
-	/* check if c has the right type! */
-	phash_bucket_t *xb;
-	act_booleanized_var_t *v;
-	xb = phash_lookup (si->bnl->cH, c);
-
-	if (xb) {
-	  v = (act_booleanized_var_t *)xb->v;
-	  if (v->isint && type == 1) {
-	    return c;
-	  }
-	  else if (v->ischan && (type == 2 || type == 3)) {
-	    return c;
-	  }
-	  else if (type == 0) {
-	    return c;
-	  }
-	  /*-- else continue searching --*/
-	}
-	else {
-	  act_dynamic_var_t *dv;
-
-	  if (b->key & 1) {
-	    c = (act_connection *) (b->key & ~1UL);
-	  }
-
-	  xb = phash_lookup (si->bnl->cdH, c);
-	  Assert (xb, "What?!");
-	  dv = (act_dynamic_var_t *)xb->v;
-	  if (type == 1 && dv->isint) {
-	    *doff = 0;
-	    return c;
-	  }
-	  else if (type == 0) {
-	    *doff = 0;
-	    return c;
-	  }
-	  /* -- else continue searching -- */
-	}
-      }
+    if (type == 0 && off < si->local.numBools()) {
+      c = _inv_get (si->linv.bools, si->local.numBools(), off);
     }
-
-    /* -- search dynamic info -- */
-    phash_iter_init (si->bnl->cdH, &bi);
-    while ((b = phash_iter_next (si->bnl->cdH, &bi))) {
-      act_dynamic_var_t *dv = (act_dynamic_var_t *)b->v;
-      act_connection *c = (act_connection *)b->key;
-      phash_bucket_t *xb = phash_lookup (si->map, c);
-      Assert (xb, "What?");
-      if (xb->i < off && off < xb->i + dv->a->size()) {
-	if (type == 1 && dv->isint) {
-	  *doff = off - xb->i;
-	  return c;
-	}
-	else if (type == 0) {
-	  *doff = off - xb->i;
-	  return c;
-	}
-      }
+    else if (type == 0) {
+      c = _inv_get (si->linv.xbools, si->local.numCHPBools(),
+		    off - si->all.numBools());
     }
-    return NULL;
+    else if (type == 1) {
+      c = _inv_get (si->linv.ints, si->local.numInts(), off);
+    }
+    else {
+      c = _inv_get (si->linv.chans, si->local.numChans(), off);
+    }
+    if (c) {
+      *doff = _dyn_offset (si, c, off, type);
+    }
+    return c;
   }  
 }
 
@@ -1650,6 +1720,8 @@ bool ActStatePass::connExists (stateinfo_t *si, act_connection *c)
 ActStatePass::~ActStatePass()
 {
   /* free stuff */
+  _layout_free ();
+  _inv_free (&_ginv);
 }
 
 
@@ -1973,3 +2045,430 @@ int ActStatePass::checkIdExists (ActId *id)
   }
   return 1;
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Flattened state layout
+ *
+ *   One row per process instance in the design, in depth-first
+ *   order. The local state of the rows tiles the flat offset space of
+ *   the top-level process, so a dense owner table per type maps any
+ *   flat offset back to its row.
+ *
+ *------------------------------------------------------------------------
+ */
+
+/*
+ * sPrint() truncates to the buffer size; grow the buffer until the
+ * whole string fits. The result must be freed by the caller.
+ */
+static char *_layout_array_string (Array *a)
+{
+  int sz = 64;
+  char *buf;
+
+  while (1) {
+    MALLOC (buf, char, sz);
+    buf[0] = '\0';
+    a->sPrint (buf, sz);
+    if ((int)strlen (buf) < sz - 1) {
+      return buf;
+    }
+    FREE (buf);
+    sz *= 2;
+  }
+}
+
+static char *_layout_id_string (ActId *id, ActId *end)
+{
+  int sz = 256;
+  char *buf;
+
+  while (1) {
+    MALLOC (buf, char, sz);
+    buf[0] = '\0';
+    id->sPrint (buf, sz, end);
+    if ((int)strlen (buf) < sz - 1) {
+      return buf;
+    }
+    FREE (buf);
+    sz *= 2;
+  }
+}
+
+void ActStatePass::_layout_add (int parent, ValueIdx *vx, int elem,
+				Process *p, state_counts base)
+{
+  stateinfo_t *si;
+  int row;
+  char *idx;
+  char *name;
+  int len;
+
+  si = (parent == -1) ? _root_si : getStateInfo (p);
+  Assert (si, "Missing state info!");
+
+  /* -- instance path -- */
+  if (parent == -1) {
+    name = Strdup ("");
+  }
+  else {
+    idx = NULL;
+    if (elem >= 0) {
+      Array *a = vx->t->arrayInfo()->unOffset (elem);
+      idx = _layout_array_string (a);
+      delete a;
+    }
+    len = strlen (_layout[parent].name) + strlen (vx->getName()) +
+      (idx ? strlen (idx) : 0) + 2;
+    MALLOC (name, char, len);
+    snprintf (name, len, "%s%s%s%s", _layout[parent].name,
+	      _layout[parent].name[0] ? "." : "", vx->getName(),
+	      idx ? idx : "");
+    if (idx) {
+      FREE (idx);
+    }
+  }
+
+  row = A_LEN (_layout);
+  A_NEW (_layout, state_layout_t);
+  A_NEXT (_layout).name = name;
+  A_NEXT (_layout).p = p;
+  A_NEXT (_layout).si = si;
+  A_NEXT (_layout).base = base;
+  A_NEXT (_layout).parent = parent;
+  A_NEXT (_layout).vx = vx;
+  A_NEXT (_layout).elem = elem;
+  A_INC (_layout);
+
+  hash_add (_layout_H, name)->i = row;
+
+  /* -- local state belongs to this row -- */
+  for (int k=0; k < si->local.numBools(); k++) {
+    _layout_own[0][base.numBools() + k] = row;
+  }
+  for (int k=0; k < si->local.numCHPBools(); k++) {
+    _layout_own[1][base.numCHPBools() + k] = row;
+  }
+  for (int k=0; k < si->local.numInts(); k++) {
+    _layout_own[2][base.numInts() + k] = row;
+  }
+  for (int k=0; k < si->local.numChans(); k++) {
+    _layout_own[3][base.numChans() + k] = row;
+  }
+
+  /* -- sub-instances follow the local state, as in countLocalState() -- */
+  state_counts off = base;
+  off.addVar (si->local);
+
+  ActUniqProcInstiter i(p ? p->CurScope() : ActNamespace::Global()->CurScope());
+
+  for (i = i.begin(); i != i.end(); i++) {
+    ValueIdx *ux = *i;
+    Process *x = dynamic_cast<Process *>(ux->t->BaseType());
+    if (!x->isExpanded()) {
+      continue;
+    }
+    stateinfo_t *ti;
+    if (ux->t->arrayInfo()) {
+      Array *xa = ux->t->arrayInfo();
+      int pos = 0;
+      if (!ux->t->isMixedArray()) {
+	xa = NULL;
+	ti = getStateInfo (x);
+	Assert (ti, "Missing state info!");
+	for (int k=0; k < ux->t->arrayInfo()->size(); k++) {
+	  if (ux->isPrimary (k)) {
+	    _layout_add (row, ux, k, x, off);
+	    off.addVar (ti->all);
+	  }
+	}
+      }
+      while (xa) {
+	x = dynamic_cast<Process *> (xa->getArrayType()->BaseType());
+	Assert (x, "What happened?");
+	ti = getStateInfo (x);
+	Assert (ti, "Missing state info!");
+	for (int k=0; k < xa->getRangeSize(); k++) {
+	  if (ux->isPrimary (k + pos)) {
+	    _layout_add (row, ux, k + pos, x, off);
+	    off.addVar (ti->all);
+	  }
+	}
+	pos += xa->getRangeSize ();
+	xa = xa->Next ();
+      }
+    }
+    else {
+      ti = getStateInfo (x);
+      Assert (ti, "Missing state info!");
+      _layout_add (row, ux, -1, x, off);
+      off.addVar (ti->all);
+    }
+  }
+}
+
+int ActStatePass::buildLayout ()
+{
+  if (_layout_H) {
+    return A_LEN (_layout);
+  }
+  if (!_root_si) {
+    return 0;
+  }
+
+  state_counts root = _root_si->all;
+  int sz[4];
+
+  sz[0] = root.numBools();
+  sz[1] = root.numCHPBools();
+  sz[2] = root.numInts();
+  sz[3] = root.numChans();
+
+  for (int i=0; i < 4; i++) {
+    if (sz[i] > 0) {
+      MALLOC (_layout_own[i], int, sz[i]);
+      for (int k=0; k < sz[i]; k++) {
+	_layout_own[i][k] = -1;
+      }
+    }
+  }
+  _layout_H = hash_new (32);
+
+  state_counts zero;
+  _layout_add (-1, NULL, -1, _root_si->bnl->p, zero);
+
+  return A_LEN (_layout);
+}
+
+void ActStatePass::_layout_free ()
+{
+  if (!_layout_H) {
+    return;
+  }
+  hash_free (_layout_H);
+  _layout_H = NULL;
+  for (int i=0; i < A_LEN (_layout); i++) {
+    FREE (_layout[i].name);
+  }
+  A_FREE (_layout);
+  A_INIT (_layout);
+  _layout = NULL;
+  for (int i=0; i < 4; i++) {
+    if (_layout_own[i]) {
+      FREE (_layout_own[i]);
+    }
+    _layout_own[i] = NULL;
+  }
+}
+
+int ActStatePass::layoutFind (const char *path)
+{
+  hash_bucket_t *b;
+
+  if (!buildLayout ()) {
+    return -1;
+  }
+  b = hash_lookup (_layout_H, path);
+  if (!b) {
+    return -1;
+  }
+  return b->i;
+}
+
+act_connection *ActStatePass::layoutConn (int off, int type, int *row,
+					  int *doff)
+{
+  int r, loc;
+
+  *row = -1;
+  *doff = -1;
+  if (!buildLayout ()) {
+    return NULL;
+  }
+
+  state_counts root = _root_si->all;
+
+  if (off < 0) {
+    /* globals and top-level ports are not flattened */
+    r = 0;
+    loc = off;
+  }
+  else if (type == 0 && off < root.numBools()) {
+    r = _layout_own[0][off];
+    loc = off - _layout[r].base.numBools();
+  }
+  else if (type == 0) {
+    off -= root.numBools();
+    if (off >= root.numCHPBools()) {
+      return NULL;
+    }
+    r = _layout_own[1][off];
+    loc = _layout[r].si->all.numBools() + off -
+      _layout[r].base.numCHPBools();
+  }
+  else if (type == 1) {
+    if (off >= root.numInts()) {
+      return NULL;
+    }
+    r = _layout_own[2][off];
+    loc = off - _layout[r].base.numInts();
+  }
+  else {
+    if (off >= root.numChans()) {
+      return NULL;
+    }
+    r = _layout_own[3][off];
+    loc = off - _layout[r].base.numChans();
+  }
+  if (r < 0) {
+    return NULL;
+  }
+  *row = r;
+  return getConnFromOffset (_layout[r].si, loc, type, doff);
+}
+
+int ActStatePass::layoutOffset (int row, act_connection *c,
+				int *offset, int *type)
+{
+  int off, ty;
+
+  if (!buildLayout ()) {
+    return 0;
+  }
+  if (row < 0 || row >= A_LEN (_layout)) {
+    return 0;
+  }
+
+  while (1) {
+    state_layout_t *r = &_layout[row];
+    
+    if (!getTypeOffset (r->si, c, &off, &ty, NULL)) {
+      return 0;
+    }
+    if (!isPortOffset (off) || r->parent == -1) {
+      break;
+    }
+    
+    /* -- port: the state is allocated in the parent -- */
+    Array *a = NULL;
+    if (r->elem >= 0) {
+      a = r->vx->t->arrayInfo()->unOffset (r->elem);
+    }
+    ActId *tmp = new ActId (r->vx->getName(), a);
+    tmp->Append (c->toid());
+
+    Process *pp = _layout[r->parent].p;
+    c = tmp->Canonical (pp ? pp->CurScope() :
+			ActNamespace::Global()->CurScope());
+    delete tmp;
+    if (!c) {
+      return 0;
+    }
+    row = r->parent;
+  }
+
+  if (off >= 0) {
+    state_layout_t *r = &_layout[row];
+    if (ty == 0) {
+      if (off < r->si->local.numBools()) {
+	off += r->base.numBools();
+      }
+      else {
+	off = _root_si->all.numBools() + r->base.numCHPBools() +
+	  off - r->si->all.numBools();
+      }
+    }
+    else if (ty == 1) {
+      off += r->base.numInts();
+    }
+    else {
+      off += r->base.numChans();
+    }
+  }
+  *offset = off;
+  if (type) {
+    *type = ty;
+  }
+  return 1;
+}
+
+int ActStatePass::layoutOffset (ActId *id, int *offset, int *type)
+{
+  char *path;
+  int row;
+  ActId *rest;
+
+  if (!buildLayout ()) {
+    return 0;
+  }
+
+  /*
+    Use the layout rows to partition the ID rather than the process
+    types: elements of mixed arrays have different types.
+  */
+  row = 0;
+  rest = id;
+  while (!id->isNamespace() && rest->Rest()) {
+    int nrow;
+    path = _layout_id_string (id, rest->Rest());
+    nrow = layoutFind (path);
+    FREE (path);
+    if (nrow == -1) {
+      break;
+    }
+    row = nrow;
+    rest = rest->Rest();
+  }
+
+  Process *p = _layout[row].p;
+  act_connection *c = rest->Canonical (p ? p->CurScope() :
+				       ActNamespace::Global()->CurScope());
+  if (!c) {
+    return 0;
+  }
+  return layoutOffset (row, c, offset, type);
+}
+
+int ActStatePass::layoutName (int off, int type, char *buf, int sz)
+{
+  act_connection *c;
+  int row, doff, k;
+
+  c = layoutConn (off, type, &row, &doff);
+  if (!c) {
+    return 0;
+  }
+
+  buf[0] = '\0';
+  if (off >= 0 && _layout[row].name[0]) {
+    snprintf (buf, sz, "%s.", _layout[row].name);
+  }
+  k = strlen (buf);
+
+  ActId *tid = c->toid();
+  tid->sPrint (buf + k, sz - k);
+  delete tid;
+
+  if (doff >= 0) {
+    /* -- element of a dynamic array -- */
+    stateinfo_t *si = (off < 0) ? _root_si : _layout[row].si;
+    phash_bucket_t *b = phash_lookup (si->bnl->cdH, c);
+    Assert (b, "What?");
+    act_dynamic_var_t *dv = (act_dynamic_var_t *) b->v;
+    int elem = doff;
+    if (dv->isstruct) {
+      /* -- array of structures: name the element, not the field -- */
+      state_counts ts;
+      getStructCount (dv->isstruct, &ts);
+      int per = (type == 1) ? ts.numInts() : ts.numBools();
+      elem = (per > 0) ? doff / per : 0;
+    }
+    Array *a = dv->a->unOffset (elem);
+    k = strlen (buf);
+    a->sPrint (buf + k, sz - k);
+    delete a;
+  }
+  return 1;
+}
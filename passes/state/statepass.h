@@ -77,6 +77,19 @@ public:
   state_counts() { bools = 0; xbools = 0; chans = 0; ints = 0; }
 };
 
+/*
+ * Dense reverse map from a state offset back to its connection
+ * pointer. Entries for dynamic arrays all point to the array
+ * connection; the element is the distance from the array's base
+ * offset in the forward map.
+ */
+typedef struct {
+  act_connection **bools;	// booleans
+  act_connection **xbools;	// extra chp booleans
+  act_connection **ints;	// integers
+  act_connection **chans;	// channels
+} state_inv_t;
+
 typedef struct {
   act_boolean_netlist_t *bnl;	// the basis for this calculation
 
@@ -130,9 +143,36 @@ typedef struct {
   int chp_ismulti;		// multidriver through CHP
 
   struct pHashtable *inst;	// used for instance offsets
+
+  state_inv_t linv;		// local offset -> connection. bools
+				// and ints/chans are indexed by
+				// offset; xbools by offset -
+				// all.numBools()
+  state_inv_t pinv;		// port index (portIdx()) ->
+				// connection; xbools are indexed by
+				// port index - ports.numBools()
   
 } stateinfo_t;
 
+
+/*
+ * One row of the flattened state layout of a design: an instance
+ * path, and the flat offsets at which its local state starts.
+ *
+ * The flat numbering is the one used by the top-level process: bools
+ * are 0 .. all.numBools()-1 followed by the extra chp bools; ints and
+ * channels each have their own range.
+ */
+typedef struct {
+  char *name;			// instance path; "" for the top level
+  Process *p;			// process type for the instance
+  stateinfo_t *si;		// its state info
+  state_counts base;		// flat offsets for its local state
+  int parent;			// row of the parent, -1 for the top level
+  ValueIdx *vx;			// instance in the parent scope
+  int elem;			// array element, -1 if not an array
+} state_layout_t;
+
 class ActStatePass : public ActPass {
 public:
   ActStatePass (Act *a, int inst_offset = 0);
@@ -215,6 +255,29 @@ public:
 
   void setVerbose (bool flag) { _verbose = flag; }
 
+  /*-- 
+    Flattened state layout for the whole design, built on demand and
+    cached until the pass is freed. Flat offsets use the type
+    convention of getTypeOffset(); extra chp bools use type 0 with
+    offsets past the booleans.
+    --*/
+  int buildLayout ();		/*< returns the number of rows */
+  int layoutRows () { return A_LEN (_layout); }
+  state_layout_t *layoutRow (int i) { return &_layout[i]; }
+
+  int layoutFind (const char *path); /*< row for instance path, -1 if
+				       missing */
+
+  /* flat offset -> row and connection; *doff as in getConnFromOffset() */
+  act_connection *layoutConn (int off, int type, int *row, int *doff);
+
+  /* connection in a row -> flat offset; return 0 on error, 1 on success */
+  int layoutOffset (int row, act_connection *c, int *offset, int *type);
+  int layoutOffset (ActId *id, int *offset, int *type);
+
+  /* flat offset -> full name; return 0 on error, 1 on success */
+  int layoutName (int off, int type, char *buf, int sz);
+
   static void getStructCount (Data *d, state_counts *sc);
 
 private:
@@ -230,6 +293,15 @@ private:
 
   stateinfo_t *_root_si;	// top-level state info
   state_counts _globals;
+  state_inv_t _ginv;		// global index (globalIdx()) -> connection
+
+  A_DECL (state_layout_t, _layout);
+  struct Hashtable *_layout_H;	// instance path -> row
+  int *_layout_own[4];		// flat offset -> row, for bools,
+				// extra chp bools, ints, chans
+  void _layout_add (int parent, ValueIdx *vx, int elem, Process *p,
+		    state_counts base);
+  void _layout_free ();
   
   ActBooleanizePass *bp;
   FILE *_fp;
@@ -26,7 +26,8 @@
 #include <common/file.h>
 #include <common/misc.h>
 
-static int T[E_NUMBER] = {
+/* parser state is per-thread, so files can be parsed concurrently */
+static __thread int T[E_NUMBER] = {
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
   -1, -1, -1, -1, -1, -1, -1, -1
@@ -40,17 +41,21 @@ Expr *(*expr_parse_basecase_num)(LFILE *l) = NULL;
 Expr *(*expr_parse_basecase_bool)(LFILE *l) = NULL;
 int (*expr_parse_newtokens)(LFILE *l) = NULL;
 int (*expr_free_special_default)(Expr *e) = NULL;
+int (*expr_save_id)(FILE *, void *) = NULL;
+void *(*expr_load_id)(FILE *) = NULL;
+int (*expr_save_special_default)(FILE *, Expr *) = NULL;
+int (*expr_load_special_default)(FILE *, Expr *) = NULL;
 
 #define PUSH(x) file_push_position(x)
 #define POP(x)  file_pop_position(x)
 #define SET(x)  file_set_position(x)
 #define INFO(x)
 
-static int paren_count = 0;
+static __thread int paren_count = 0;
 
-static LFILE *Tl;
+static __thread LFILE *Tl;
 
-static int end_gt_mode = 0;
+static __thread int end_gt_mode = 0;
 
 void expr_inc_parens (void)
 {
@@ -228,7 +233,7 @@ int expr_parse_isany (LFILE *l)
 */
 static Expr *BE (void);
 static Expr *I (void);
-static int int_real_only;
+static __thread int int_real_only;
 
 static Expr *newexpr (void)
 {
@@ -1270,3 +1275,209 @@ Expr *expr_parse_any (LFILE *l)
 
   return e;
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Saving and restoring parse trees
+ *
+ *   Integers are written seven bits at a time (low bits first, high
+ *   bit set if more follow); signed values are zig-zag encoded so
+ *   small negative numbers stay short. Strings are written as length
+ *   + 1 followed by the characters, with 0 used for NULL.
+ *
+ *------------------------------------------------------------------------
+ */
+void expr_save_uint (FILE *fp, unsigned long v)
+{
+  while (v >= 0x80) {
+    putc_unlocked ((int)(v & 0x7f) | 0x80, fp);
+    v >>= 7;
+  }
+  putc_unlocked ((int)v, fp);
+}
+
+unsigned long expr_load_uint (FILE *fp)
+{
+  unsigned long v = 0;
+  int shift = 0;
+  int c;
+
+  while ((c = getc_unlocked (fp)) != EOF) {
+    v |= ((unsigned long)(c & 0x7f)) << shift;
+    if (!(c & 0x80)) break;
+    shift += 7;
+  }
+  return v;
+}
+
+void expr_save_int (FILE *fp, long v)
+{
+  expr_save_uint (fp, ((unsigned long)v << 1) ^ (unsigned long)(v >> (8*sizeof (long)-1)));
+}
+
+long expr_load_int (FILE *fp)
+{
+  unsigned long v = expr_load_uint (fp);
+  return (long)(v >> 1) ^ -(long)(v & 1);
+}
+
+void expr_save_real (FILE *fp, double v)
+{
+  fwrite (&v, sizeof (double), 1, fp);
+}
+
+double expr_load_real (FILE *fp)
+{
+  double v = 0;
+  if (fread (&v, sizeof (double), 1, fp) != 1) {
+    return 0;
+  }
+  return v;
+}
+
+void expr_save_string (FILE *fp, const char *s)
+{
+  unsigned long len;
+  if (!s) {
+    expr_save_uint (fp, 0);
+    return;
+  }
+  len = strlen (s);
+  expr_save_uint (fp, len + 1);
+  fwrite (s, 1, len, fp);
+}
+
+static __thread char *load_buf = NULL;
+static __thread unsigned long load_buf_sz = 0;
+
+const char *expr_load_string (FILE *fp)
+{
+  unsigned long len = expr_load_uint (fp);
+
+  if (len == 0) {
+    return NULL;
+  }
+  if (len > load_buf_sz) {
+    if (load_buf) {
+      FREE (load_buf);
+    }
+    load_buf_sz = (len < 128) ? 128 : len;
+    MALLOC (load_buf, char, load_buf_sz);
+  }
+  len--;
+  if (len > 0 && fread (load_buf, 1, len, fp) != len) {
+    len = 0;
+  }
+  load_buf[len] = '\0';
+  return load_buf;
+}
+
+int expr_save (FILE *fp, Expr *e)
+{
+  int r;
+
+  if (!e) {
+    expr_save_uint (fp, 0);
+    return 1;
+  }
+  expr_save_uint (fp, e->type + 1);
+
+  if (expr_save_special_default) {
+    r = (*expr_save_special_default) (fp, e);
+    if (r != 0) {
+      return (r > 0);
+    }
+  }
+
+  switch (e->type) {
+  case E_INT:
+  case E_TRUE:
+  case E_FALSE:
+    if (e->u.ival.v_extra) {
+      return 0;
+    }
+    expr_save_uint (fp, e->u.ival.v);
+    break;
+
+  case E_REAL:
+    expr_save_real (fp, e->u.f);
+    break;
+
+  case E_VAR:
+  case E_PROBE:
+    if (!expr_save_id) {
+      return 0;
+    }
+    return (*expr_save_id) (fp, e->u.e.l);
+
+  case E_FUNCTION:
+    expr_save_string (fp, e->u.fn.s);
+    return expr_save (fp, e->u.fn.r);
+
+  case E_RAWFREE:
+    expr_save_string (fp, (char *)e->u.e.l);
+    return expr_save (fp, e->u.e.r);
+
+  default:
+    if (!expr_save (fp, e->u.e.l)) {
+      return 0;
+    }
+    return expr_save (fp, e->u.e.r);
+  }
+  return 1;
+}
+
+Expr *expr_load (FILE *fp)
+{
+  Expr *e;
+  unsigned long type = expr_load_uint (fp);
+  const char *s;
+
+  if (type == 0) {
+    return NULL;
+  }
+  e = newexpr ();
+  e->type = type - 1;
+
+  if (expr_load_special_default &&
+      (*expr_load_special_default) (fp, e)) {
+    return e;
+  }
+
+  switch (e->type) {
+  case E_INT:
+  case E_TRUE:
+  case E_FALSE:
+    e->u.ival.v = expr_load_uint (fp);
+    e->u.ival.v_extra = NULL;
+    break;
+
+  case E_REAL:
+    e->u.f = expr_load_real (fp);
+    break;
+
+  case E_VAR:
+  case E_PROBE:
+    e->u.e.l = (Expr *) (*expr_load_id) (fp);
+    break;
+
+  case E_FUNCTION:
+    s = expr_load_string (fp);
+    e->u.fn.s = s ? Strdup (s) : NULL;
+    e->u.fn.r = expr_load (fp);
+    break;
+
+  case E_RAWFREE:
+    s = expr_load_string (fp);
+    e->u.e.l = s ? (Expr *) Strdup (s) : NULL;
+    e->u.e.r = expr_load (fp);
+    break;
+
+  default:
+    e->u.e.l = expr_load (fp);
+    e->u.e.r = expr_load (fp);
+    break;
+  }
+  return e;
+}
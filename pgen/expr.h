@@ -234,6 +234,38 @@ extern int expr_gettoken (int t);
 extern void expr_print (pp_t *, Expr *);
 /*  Print expression */
 
+extern int expr_save (FILE *, Expr *);
+/* Write out a parsed expression tree; returns 0 if it contains
+   something that cannot be saved */
+
+extern Expr *expr_load (FILE *);
+/* Read back an expression tree written by expr_save() */
+
+extern int (*expr_save_id) (FILE *, void *);
+  /* Save an id structure; return 0 if it cannot be saved */
+
+extern void *(*expr_load_id) (FILE *);
+  /* Read back an id structure written by expr_save_id */
+
+extern int (*expr_save_special_default)(FILE *, Expr *);
+  /* save the fields of a special expression; return 1 if it was
+     used, 0 otherwise, -1 if the expression cannot be saved */
+
+extern int (*expr_load_special_default)(FILE *, Expr *);
+  /* read back fields written by expr_save_special_default; the type
+     field is already set. Return 1 if it was used, 0 otherwise */
+
+/* compact encoding used by expr_save() and generated save routines */
+extern void expr_save_uint (FILE *, unsigned long);
+extern unsigned long expr_load_uint (FILE *);
+extern void expr_save_int (FILE *, long);
+extern long expr_load_int (FILE *);
+extern void expr_save_real (FILE *, double);
+extern double expr_load_real (FILE *);
+extern void expr_save_string (FILE *, const char *);
+extern const char *expr_load_string (FILE *);
+  /* returns a per-thread buffer, overwritten by the next call */
+
 extern const char *expr_operator_name (int type);
 /* return string corresponding to the operator token */
 
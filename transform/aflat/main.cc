@@ -35,11 +35,15 @@ static enum output_formats {
 #define EXTRA_ARGS  NULL, (export_format == LVS_FMT ? 1 : 0)
 
 /* hash table for labels */
-static struct Hashtable *labels;
+static __thread struct Hashtable *labels;
+
+/* output for the instance being printed */
+static __thread FILE *_outfp;
 
 void usage (char *s)
 {
-  fprintf (stderr, "Usage: %s [act-options] [-c] [-prsim|-lvs] <file.act>\n", s);
+  fprintf (stderr, "Usage: %s [act-options] [-j<n>] [-c] [-prsim|-lvs] <file.act>\n", s);
+  fprintf (stderr, "  -j<n> : flatten using <n> threads (-j: one per processor)\n");
   exit (1);
 }
 
@@ -47,26 +51,46 @@ void usage (char *s)
 static void print_connect()
 {
   if (export_format == LVS_FMT) {
-    printf ("connect ");
+    fprintf (_outfp, "connect ");
   }
   else {
-    printf ("= ");
+    fprintf (_outfp, "= ");
   }
 }
 
 #define ARRAY_STYLE (export_format == LVS_FMT ? 1 : 0)
 #define EXTRA_ARGS  NULL, (export_format == LVS_FMT ? 1 : 0)
 
-static ActId *current_prefix = NULL;
+static __thread const char *current_prefix = NULL;
+
+/*
+  Print id without the array index on its last component; the shared
+  identifier can't be modified since instances may be printed
+  concurrently.
+*/
+static void id_print_noarray (ActId *id)
+{
+  ActId *tl = id;
+  while (tl->Rest()) {
+    tl = tl->Rest();
+  }
+  if (tl != id) {
+    id->Print (_outfp, tl, ARRAY_STYLE);
+    if (id->Rest() != tl || !id->isNamespace()) {
+      fprintf (_outfp, ".");
+    }
+  }
+  fprintf (_outfp, "%s", tl->getName());
+}
 
+/* if str is non-empty, it replaces the array index of id */
 static void prefix_id_print (Scope *s, ActId *id, const char *str = "")
 {
-  printf ("\"");
+  fprintf (_outfp, "\"");
   if (s->Lookup (id, 0)) {
     if (current_prefix) {
       if (id->getName()[0] != ':') {
-	current_prefix->Print (stdout);
-	printf (".");
+	fprintf (_outfp, "%s.", current_prefix);
       }
     }
   }
@@ -81,26 +105,31 @@ static void prefix_id_print (Scope *s, ActId *id, const char *str = "")
     }
     else {
       char *tmp = vx->global->Name ();
-      printf ("%s::", tmp);
+      fprintf (_outfp, "%s::", tmp);
       FREE (tmp);
     }
   }
-  id->Print (stdout, EXTRA_ARGS);
-  printf ("%s\"", str);
+  if (str[0]) {
+    id_print_noarray (id);
+  }
+  else {
+    id->Print (_outfp, EXTRA_ARGS);
+  }
+  fprintf (_outfp, "%s\"", str);
 }
 
 
 #define PREC_BEGIN(myprec)			\
   do {						\
     if ((myprec) < prec) {			\
-      printf ("(");				\
+      fprintf (_outfp, "(");				\
     }						\
   } while (0)
 
 #define PREC_END(myprec)			\
   do {						\
     if ((myprec) < prec) {			\
-      printf (")");				\
+      fprintf (_outfp, ")");				\
     }						\
   } while (0)
 
@@ -108,7 +137,7 @@ static void prefix_id_print (Scope *s, ActId *id, const char *str = "")
   do {						\
     PREC_BEGIN(myprec);				\
     _print_prs_expr (s, e->u.e.l, (myprec), flip);	\
-    printf ("%s", (sym));			\
+    fprintf (_outfp, "%s", (sym));			\
     _print_prs_expr (s, e->u.e.r, (myprec), flip);	\
     PREC_END (myprec);				\
   } while (0)
@@ -116,7 +145,7 @@ static void prefix_id_print (Scope *s, ActId *id, const char *str = "")
 #define EMIT_UNOP(myprec,sym)			\
   do {						\
     PREC_BEGIN(myprec);				\
-    printf ("%s", sym);				\
+    fprintf (_outfp, "%s", sym);				\
     _print_prs_expr (s, e->u.e.l, (myprec), flip);	\
     PREC_END (myprec);				\
   } while (0)
@@ -143,7 +172,7 @@ static void _print_prs_expr (Scope *s, act_prs_expr_t *e, int prec, int flip)
     
   case ACT_PRS_EXPR_VAR:
     if (flip) {
-      printf ("~");
+      fprintf (_outfp, "~");
     }
     prefix_id_print (s, e->u.v.id);
     break;
@@ -162,19 +191,19 @@ static void _print_prs_expr (Scope *s, act_prs_expr_t *e, int prec, int flip)
     }
     pl = (act_prs_lang_t *) b->v;
     if (pl->u.one.dir == 0) {
-      printf ("~");
+      fprintf (_outfp, "~");
     }
-    printf ("(");
+    fprintf (_outfp, "(");
     _print_prs_expr (s, pl->u.one.e, 0, flip);
-    printf (")");
+    fprintf (_outfp, ")");
     break;
 
   case ACT_PRS_EXPR_TRUE:
-    printf ("true");
+    fprintf (_outfp, "true");
     break;
     
   case ACT_PRS_EXPR_FALSE:
-    printf ("false");
+    fprintf (_outfp, "false");
     break;
 
   default:
@@ -215,13 +244,13 @@ static void print_attr_prefix (act_attr_t *attr, int force_after)
     have_after = 1;
   }
   if (weak) {
-    printf ("weak ");
+    fprintf (_outfp, "weak ");
   }
   if (unstab) {
-    printf ("unstab ");
+    fprintf (_outfp, "unstab ");
   }
   if (have_after) {
-    printf ("after %d ", after);
+    fprintf (_outfp, "after %d ", after);
   }
 }
 
@@ -254,7 +283,6 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	  fprintf (stderr, "\n");
 	  fatal_error ("Timing directive: LHS cannot be an array!");
 	}
-	ActId *tl[2];
 	Arraystep *as[2];
 
 	for (int i=1; i < 3; i++) {
@@ -265,50 +293,41 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	    else {
 	      as[i-1] = it[i]->arrayInfo()->stepper();
 	    }
-	    tl[i-1] = spec->ids[i]->Tail();
 	  }
 	  else {
-	    tl[i-1] = NULL;
 	    as[i-1] = NULL;
 	  }
 	}
 
 	if (!as[0] && !as[1]) {
-	  printf ("timing(");
+	  fprintf (_outfp, "timing(");
 	  prefix_id_print (s, spec->ids[0]);
 
 #define PRINT_EXTRA(x)					\
 	  do {						\
 	    if (spec->extra[x] & 0x03) {		\
 	      if ((spec->extra[x] & 0x03) == 1) {	\
-		printf ("+");				\
+		fprintf (_outfp, "+");				\
 	      }						\
 	      else {					\
-		printf ("-");				\
+		fprintf (_outfp, "-");				\
 	      }						\
 	    }						\
 	  } while (0)
 
 	  PRINT_EXTRA (0);
-	  printf (",");
+	  fprintf (_outfp, ",");
 	  prefix_id_print (s, spec->ids[1]);
 	  PRINT_EXTRA (1);
-	  printf (",");
+	  fprintf (_outfp, ",");
 	  prefix_id_print (s, spec->ids[2]);
 	  PRINT_EXTRA (2);
 	  if (e) {
-	    printf (",%d", delay);
+	    fprintf (_outfp, ",%d", delay);
 	  }
-	  printf (")\n");
+	  fprintf (_outfp, ")\n");
 	}
 	else {
-	  if (aref[1]) {
-	    tl[0]->setArray (NULL);
-	  }
-	  if (aref[2]) {
-	    tl[1]->setArray (NULL);
-	  }
-	  
 	  while ((as[0] && !as[0]->isend()) ||
 		 (as[1] && !as[1]->isend())) {
 	    char *tmp[2];
@@ -321,10 +340,10 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	      }
 	    }
 	    
-	    printf ("timing(");
+	    fprintf (_outfp, "timing(");
 	    prefix_id_print (s, spec->ids[0]);
 	    PRINT_EXTRA (0);
-	    printf (",");
+	    fprintf (_outfp, ",");
 	    if (tmp[0]) {
 	      prefix_id_print (s, spec->ids[1], tmp[0]);
 	      FREE (tmp[0]);
@@ -333,7 +352,7 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	      prefix_id_print (s, spec->ids[1]);
 	    }
 	    PRINT_EXTRA (1);
-	    printf (",");
+	    fprintf (_outfp, ",");
 	    if (tmp[1]) {
 	      prefix_id_print (s, spec->ids[2], tmp[1]);
 	      FREE (tmp[1]);
@@ -343,9 +362,9 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	    }
 	    PRINT_EXTRA (2);
 	    if (e) {
-	      printf (",%d", delay);
+	      fprintf (_outfp, ",%d", delay);
 	    }
-	    printf (")\n");
+	    fprintf (_outfp, ")\n");
 
 	    if (as[1]) {
 	      as[1]->step();
@@ -384,12 +403,6 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	  if (as[1]) {
 	    delete as[1];
 	  }
-	  if (aref[1]) {
-	    tl[0]->setArray (aref[1]);
-	  }
-	  if (aref[2]) {
-	    tl[1]->setArray (aref[2]);
-	  }
 	}
       }
       spec = spec->next;
@@ -408,7 +421,7 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	 (strcmp (tmp, "exclhi") == 0 || strcmp (tmp, "excllo") == 0))) {
       if (spec->count > 0) {
 	int comma = 0;
-	printf ("%s(", tmp);
+	fprintf (_outfp, "%s(", tmp);
 	for (int i=0; i < spec->count; i++) {
 	  Array *aref;
 	  id = spec->ids[i];
@@ -419,25 +432,16 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	    Arraystep *astep;
 	    Array *a = it->arrayInfo();
 
-	    id = id->Tail();
-	    
 	    if (aref) {
 	      astep = a->stepper (aref);
-	      a = aref;
 	    }
 	    else {
 	      astep = a->stepper();
-	      a = NULL;
-	    }
-	    int restore = 0;
-	    if (id->arrayInfo()) {
-	      id->setArray (NULL);
-	      restore = 1;
 	    }
 	    while (!astep->isend()) {
 	      char *tmp = astep->string();
 	      if (comma != 0) {
-		printf (",");
+		fprintf (_outfp, ",");
 	      }
 	      prefix_id_print (s, spec->ids[i], tmp);
 	      comma = 1;
@@ -445,19 +449,16 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	      astep->step();
 	    }
 	    delete astep;
-	    if (restore) {
-	      id->setArray (a);
-	    }
 	  }
 	  else {
 	    if (comma != 0) {
-	      printf (",");
+	      fprintf (_outfp, ",");
 	    }
 	    prefix_id_print (s, spec->ids[i]);
 	    comma = 1;
 	  }
 	}
-	printf (")\n");
+	fprintf (_outfp, ")\n");
       }
       if (spec->count == -1) {
 	const char *specname = tmp;
@@ -481,10 +482,10 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 		if (vx->isPrimary (cnt)) {
 		  char *tmp = astep->string();
 		  if (comma != 0) {
-		    printf (",");
+		    fprintf (_outfp, ",");
 		  }
 		  else {
-		    printf ("%s(", specname);
+		    fprintf (_outfp, "%s(", specname);
 		  }
 		  prefix_id_print (s, base, tmp);
 		  comma = 1;
@@ -496,13 +497,13 @@ static void aflat_print_spec (Scope *s, act_spec *spec)
 	      delete astep;
 	    }
 	    else {
-	      printf ("%s(", specname);
+	      fprintf (_outfp, "%s(", specname);
 	      prefix_id_print (s, base);
 	      comma = 1;
 	    }
 	    delete base;
 	    if (comma) {
-	      printf (")\n");
+	      fprintf (_outfp, ")\n");
 	    }
 	  }
 	}	  
@@ -534,38 +535,38 @@ static void aflat_print_prs (Scope *s, act_prs_lang_t *p)
       else {
 	print_attr_prefix (p->u.one.attr, 0);
 	_print_prs_expr (s, p->u.one.e, 0, 0);
-	printf ("->");
+	fprintf (_outfp, "->");
 	prefix_id_print (s, p->u.one.id);
 	if (p->u.one.dir) {
-	  printf ("+\n");
+	  fprintf (_outfp, "+\n");
 	}
 	else {
-	  printf ("-\n");
+	  fprintf (_outfp, "-\n");
 	}
 	if (p->u.one.arrow_type == 1) {
 	  print_attr_prefix (p->u.one.attr, 0);
-	  printf ("~(");
+	  fprintf (_outfp, "~(");
 	  _print_prs_expr (s, p->u.one.e, 0, 0);
-	  printf (")");
-	  printf ("->");
+	  fprintf (_outfp, ")");
+	  fprintf (_outfp, "->");
 	  prefix_id_print (s, p->u.one.id);
 	  if (p->u.one.dir) {
-	    printf ("-\n");
+	    fprintf (_outfp, "-\n");
 	  }
 	  else {
-	    printf ("+\n");
+	    fprintf (_outfp, "+\n");
 	  }
 	}
 	else if (p->u.one.arrow_type == 2) {
 	  print_attr_prefix (p->u.one.attr, 0);
 	  _print_prs_expr (s, p->u.one.e, 0, 1);
-	  printf ("->");
+	  fprintf (_outfp, "->");
 	  prefix_id_print (s, p->u.one.id);
 	  if (p->u.one.dir) {
-	    printf ("-\n");
+	    fprintf (_outfp, "-\n");
 	  }
 	  else {
-	    printf ("+\n");
+	    fprintf (_outfp, "+\n");
 	  }
 	}
 	else if (p->u.one.arrow_type != 0) {
@@ -578,20 +579,20 @@ static void aflat_print_prs (Scope *s, act_prs_lang_t *p)
       if (p->u.p.g) {
 	/* passn */
 	prefix_id_print (s, p->u.p.g);
-	printf (" & ~");
+	fprintf (_outfp, " & ~");
 	prefix_id_print (s, p->u.p.s);
-	printf (" -> ");
+	fprintf (_outfp, " -> ");
 	prefix_id_print (s, p->u.p.d);
-	printf ("-\n");
+	fprintf (_outfp, "-\n");
       }
       if (p->u.p._g) {
-	printf ("~");
+	fprintf (_outfp, "~");
 	prefix_id_print (s, p->u.p._g);
-	printf (" & ");
+	fprintf (_outfp, " & ");
 	prefix_id_print (s, p->u.p.s);
-	printf (" -> ");
+	fprintf (_outfp, " -> ");
 	prefix_id_print (s, p->u.p.d);
-	printf ("+\n");
+	fprintf (_outfp, "+\n");
       }
       break;
     case ACT_PRS_TREE:
@@ -627,9 +628,10 @@ static void aflat_ns (ActNamespace *ns)
   aflat_dump (ns->CurScope(), ns->getprs(), ns->getspec());
 }
 		     
-void aflat_body (void *cookie, ActId *prefix, UserDef *u)
+void aflat_body (void *cookie, FILE *fp, const char *prefix, UserDef *u)
 {
   Assert (u->isExpanded(), "What?");
+  _outfp = fp;
   current_prefix = prefix;
   if (labels) {
     hash_clear (labels);
@@ -638,17 +640,11 @@ void aflat_body (void *cookie, ActId *prefix, UserDef *u)
   current_prefix = NULL;
 }
 
-ActApplyPass *gpass;
-
-void aflat_conns (void *cookie, ActId *id1, ActId *id2)
+void aflat_conns (void *cookie, FILE *fp, const char *id1, const char *id2)
 {
+  _outfp = fp;
   print_connect ();
-
-  printf ("\"");
-  id1->Print (stdout);
-  printf ("\" \"");
-  id2->Print (stdout);
-  printf ("\"\n");
+  fprintf (_outfp, "\"%s\" \"%s\"\n", id1, id2);
 }
 
 
@@ -658,15 +654,22 @@ int main (int argc, char **argv)
   char *file;
   int do_cells = 0;
   char *cells = NULL;
+  int nthreads = 1;
 
   Act::Init (&argc, &argv);
   
   export_format = PRSIM_FMT;
 
-  if (argc < 2 || argc > 4) usage (argv[0]);
+  if (argc < 2 || argc > 5) usage (argv[0]);
 
   int idx = 1;
 
+  if (strncmp (argv[idx], "-j", 2) == 0) {
+    /* -j alone: one thread per processor */
+    nthreads = atoi (argv[idx]+2);
+    idx++;
+  }
+  if (idx >= argc) usage (argv[0]);
   if (strncmp (argv[idx], "-c", 2) == 0) {
      do_cells = 1;
      if (argv[idx][2] == '\0') {
@@ -706,11 +709,12 @@ int main (int argc, char **argv)
 
   ActApplyPass *ap = new ActApplyPass (a);
 
-  gpass = ap;
+  ap->setInstNameFn (aflat_body);
+  ap->setConnPairNameFn (aflat_conns);
+  ap->setThreads (nthreads);
+  ap->runStream (stdout);
 
-  ap->setInstFn (aflat_body);
-  ap->setConnPairFn (aflat_conns);
-  ap->run();
+  _outfp = stdout;
   aflat_ns (a->Global());
 
   //aflat_prs (a, export_format);
@@ -88,6 +88,22 @@ do
             diff runs/$i.t.stderr runs/$i.stderr
         fi
 	fi
+	# threaded flattening must produce exactly the same output
+	$ACTTOOL -j3 $i > runs/$i.j.t.stdout 2>/dev/null
+	if ! cmp runs/$i.t.stdout runs/$i.j.t.stdout >/dev/null 2>/dev/null
+	then
+		if [ $ok -eq 1 ]
+		then
+			echo
+			myecho "** FAILED TEST $i:"
+		fi
+		myecho " -j3"
+		fail=`expr $fail + 1`
+		ok=0
+		if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            diff runs/$i.t.stdout runs/$i.j.t.stdout
+        fi
+	fi
 	if [ $ok -eq 1 ]
 	then
 		if [ $num -eq $lim ]
@@ -116,64 +116,127 @@ char *name_munge_glob (const char *name)
 
 static void usage (char *name)
 {
-  fprintf (stderr, "Usage: %s [act-options] [-c <mincap>] [-s <scale>] <file.ext>\n", name);
+  fprintf (stderr, "Usage: %s [act-options] [-c <mincap>] [-s <scale>] [-j <threads>] <file.ext>\n", name);
   fprintf (stderr, " -c <mincap> : filter caps at or below this threshold\n");
   fprintf (stderr, " -s <scale>  : scale all units by <scale>\n");
+  fprintf (stderr, " -j <threads>: number of threads used to read .ext files\n");
   exit (1);
 }
 
-static struct Hashtable *seen = NULL;
-
-struct alias_tree {
-  struct alias_tree *up;
-  struct alias_tree *noglob;
-  hash_bucket_t *b;
-  char *name;
+/*
+  Connectivity for each cell is kept in an integer-indexed union-find
+  structure. Every distinct .ext name in the cell is interned once in
+  the cell's name table, which maps it to a node index. Sets are
+  linked by rank with path compression; the node whose name is used
+  for the whole set (the "representative") is recorded at the root
+  of the tree, since the naming rules for global signals are
+  independent of the shape of the tree.
+*/
+struct ext_node {
+  int up;			// parent in the union-find tree
+  int rank;			// rank, valid at the root
+  int rep;			// representative node, valid at the root
   int global;  // 0 = not a global, 1 = name with !,
                // 2 = global with ! stripped off
+  hash_bucket_t *b;		// interned .ext name
+  char *name;			// SPICE name, computed on demand
   double cap_gnd;
-  double *perim, *area;
 };
 
+struct ext_cell {
+  struct Hashtable *N;		// .ext name -> node index
+  A_DECL (struct ext_node, node);
+  double *area, *perim;		// num_devices entries per node
+};
+
+static struct Hashtable *seen = NULL;
 
-struct alias_tree *getroot (struct alias_tree *a)
+#define NODE(C,i) ((C)->node[(i)])
+
+static struct ext_cell *newcell ()
 {
-  while (a->up) {
-    a = a->up;
-  }
-  return a;
+  struct ext_cell *C;
+
+  NEW (C, struct ext_cell);
+  C->N = hash_new (32);
+  A_INIT (C->node);
+  C->area = NULL;
+  C->perim = NULL;
+  return C;
 }
 
-struct alias_tree *getroot_noglob (struct alias_tree *a)
+static int newnode (struct ext_cell *C, hash_bucket_t *b, int global)
 {
-  struct alias_tree *tmp;
+  int i;
+
+  if (A_LEN (C->node) == A_MAX (C->node)) {
+    A_NEW (C->node, struct ext_node);
+    REALLOC (C->area, double, A_MAX (C->node)*num_devices);
+    REALLOC (C->perim, double, A_MAX (C->node)*num_devices);
+  }
+  i = A_LEN (C->node);
+  A_INC (C->node);
+
+  NODE(C,i).up = i;
+  NODE(C,i).rank = 0;
+  NODE(C,i).rep = i;
+  NODE(C,i).global = global;
+  NODE(C,i).b = b;
+  NODE(C,i).name = NULL;
+  NODE(C,i).cap_gnd = 0;
+  for (int k=0; k < num_devices; k++) {
+    C->area[i*num_devices+k] = 0;
+    C->perim[i*num_devices+k] = 0;
+  }
+  b->i = i;
+  return i;
+}
 
-  tmp = a;
-  while (a->noglob) {
-    a = a->noglob;
+static int findroot (struct ext_cell *C, int i)
+{
+  while (NODE(C,i).up != i) {
+    NODE(C,i).up = NODE(C,NODE(C,i).up).up;  // path halving
+    i = NODE(C,i).up;
   }
+  return i;
+}
 
-  while (tmp->noglob) {
-    struct alias_tree *x;
-    x = tmp->noglob;
-    tmp->noglob = a;
-    tmp = x;
-  }
-  
-  return a;
+/* representative of the set containing node i */
+static int getalias (struct ext_cell *C, int i)
+{
+  return NODE(C,findroot (C, i)).rep;
 }
 
-struct alias_tree *getalias (struct alias_tree *a)
+/* merge the sets containing i and j; rep becomes the representative */
+static void unionsets (struct ext_cell *C, int i, int j, int rep)
 {
-  struct alias_tree *root, *tmp;
+  i = findroot (C, i);
+  j = findroot (C, j);
+  if (i == j) return;
+  if (NODE(C,i).rank < NODE(C,j).rank) {
+    int tmp = i;
+    i = j;
+    j = tmp;
+  }
+  NODE(C,j).up = i;
+  if (NODE(C,i).rank == NODE(C,j).rank) {
+    NODE(C,i).rank++;
+  }
+  NODE(C,i).rep = rep;
+}
 
-  root = getroot (a);
-  while (a->up) {
-    tmp = a->up;
-    a->up = root;
-    a = tmp;
+/* SPICE name for node i */
+static const char *spname (struct ext_cell *C, int i)
+{
+  if (!NODE(C,i).name) {
+    if (NODE(C,i).global == 2) {
+      NODE(C,i).name = NODE(C,i).b->key;
+    }
+    else {
+      NODE(C,i).name = name_munge (NODE(C,i).b->key);
+    }
   }
-  return root;
+  return NODE(C,i).name;
 }
 
 void global_name (const char *name, int *start, int *end)
@@ -202,27 +265,6 @@ void print_substr (const char *name, int s, int e)
   }
 }
 
-static struct alias_tree *newnode ()
-{
-  struct alias_tree *a;
-  
-  NEW (a, struct alias_tree);
-  a->b = NULL;
-  a->global = 0;
-  a->up = NULL;
-  a->noglob = NULL;
-  a->name = NULL;
-  a->cap_gnd = 0;
-  MALLOC (a->area, double, num_devices);
-  MALLOC (a->perim, double, num_devices);
-  for (int i=0; i < num_devices; i++) {
-    a->area[i] = 0;
-    a->perim[i] = 0;
-  }
-  return a;
-}
-
-
 static int islocal (char *s)
 {
   int i = 0;
@@ -234,27 +276,24 @@ static int islocal (char *s)
 }
 
 /*
-  name is in the EXT file namespace 
+  name is in the EXT file namespace; returns the representative node
 */
-struct alias_tree *getname (struct Hashtable *N, const char *name)
+static int getname (struct ext_cell *C, const char *name)
 {
   hash_bucket_t *b;
-  struct alias_tree *a;
+  int a;
   int l;
 
-  b = hash_lookup (N, name);
+  b = hash_lookup (C->N, name);
   if (!b) {
-    b = hash_add (N, name);
-    a = newnode ();
-    a->name = name_munge (b->key);
-    b->v = a;
-    a->b = b;
+    b = hash_add (C->N, name);
+    a = newnode (C, b, 0);
     l = strlen (b->key);
 
     /* if the name has a "!" in it, it is a global signal */
     while (l > 0) {
       if (b->key[l] == '!') {
-	a->global = 1;
+	NODE(C,a).global = 1;
 	break;
       }
       if (b->key[l] == '/') {
@@ -262,12 +301,12 @@ struct alias_tree *getname (struct Hashtable *N, const char *name)
       }
       l--;
     }
-    if (a->global) {
+    if (NODE(C,a).global) {
       /* a->global = 1 => the signal has a ! */
       int s, e;
       char *tmp;
       hash_bucket_t *g;
-      struct alias_tree *x;
+      int x;
 
       global_name (b->key, &s, &e);
       /* s, e correspond to start and end indices in b->key that
@@ -282,140 +321,84 @@ struct alias_tree *getname (struct Hashtable *N, const char *name)
 	e--;
       }
       /* tmp is the name of the global, without the ! */
-      g = hash_lookup (N, tmp);
+      g = hash_lookup (C->N, tmp);
       if (!g) {
-	g = hash_add (N, tmp);
-	x = newnode ();
-	x->global = 2;
-	x->name = g->key;
-	addglobal (x->name);
-	g->v = x;
-	x->b = g;
+	g = hash_add (C->N, tmp);
+	newnode (C, g, 2);
+	addglobal (g->key);
       }
-      x = (struct alias_tree *)g->v;
-      a->up = x;
+      x = g->i;
+      unionsets (C, a, x, getalias (C, x));
       FREE (tmp);
     }
   }
-  return getalias ((struct alias_tree *)b->v);
+  return getalias (C, b->i);
 }
 
-void mergealias (struct alias_tree *a1, struct alias_tree *a2)
+void mergealias (struct ext_cell *C, int a1, int a2)
 {
-  struct alias_tree *t1, *t2;
+  int win, lose;
+
+  a1 = getalias (C, a1);
+  a2 = getalias (C, a2);
+  if (a1 == a2) return;
 
-  /* noglob merge trees */
-  t1 = getroot_noglob (a1);
-  t2 = getroot_noglob (a2);
-  if (t1 != t2) {
-    t1->noglob = t2;
+  if (!NODE(C,a2).global) {
+    win = a1;
   }
-  
-  a1 = getalias (a1);
-  a2 = getalias (a2);
-  if (a1 != a2) {
-    if (!a2->global) {
-      a2->up = a1;
-      a2->cap_gnd += a1->cap_gnd;
-      a1->cap_gnd = 0;
-    }
-    else if (!a1->global) {
-      a1->up = a2;
-      a1->cap_gnd += a2->cap_gnd;
-      a2->cap_gnd = 0;
-    }
-    else if (a2->global == 1) {
-      a2->up = a1;
-      a2->cap_gnd += a1->cap_gnd;
-      a1->cap_gnd = 0;
-    }
-    else if (a1->global == 1) {
-      a1->up = a2;
-      a1->cap_gnd += a2->cap_gnd;
-      a2->cap_gnd = 0;
-    }
-    else {
-      warning ("Connecting `%s' and `%s': two globals?", a1->name, a2->name);
-      a1->up = a2;
-      a1->cap_gnd += a2->cap_gnd;
-      a2->cap_gnd = 0;
-    }
+  else if (!NODE(C,a1).global) {
+    win = a2;
   }
-}
-
-static struct alias_tree *get_cur_node (hash_bucket_t *b, struct Hashtable *cur,
-					char *buf, int l, int bufsz)
-{
-  struct alias_tree *x = (struct alias_tree *)b->v;
-  hash_bucket_t *newb;
-  struct alias_tree *newx;
-  
-  if (x->global == 2) {
-    newb = hash_lookup (cur, b->key);
-    if (!newb) {
-      return NULL;
-    }
-    else {
-      return (struct alias_tree *)newb->v;
-    }
+  else if (NODE(C,a2).global == 1) {
+    win = a1;
   }
-  else {
-    snprintf (buf+l+1, bufsz - l - 1,  "%s", b->key);
-    newb = hash_lookup (cur, buf);
-    if (!newb) {
-      return NULL;
-    }
-    else {
-      return (struct alias_tree *)newb->v;
-    }
+  else if (NODE(C,a1).global == 1) {
+    win = a2;
   }
+  else {
+    warning ("Connecting `%s' and `%s': two globals?",
+	     spname (C, a1), spname (C, a2));
+    win = a2;
+  }
+  lose = (win == a1) ? a2 : a1;
+  NODE(C,lose).cap_gnd += NODE(C,win).cap_gnd;
+  NODE(C,win).cap_gnd = 0;
+  unionsets (C, a1, a2, win);
 }
 
-static void import_base_node (hash_bucket_t *b, struct Hashtable *cur,
-			      char *buf, int l, int bufsz)
+/*
+  Import node b from a subcell into the current cell, with the
+  instance prefix in buf[0..l]. Returns the node index in the current
+  cell.
+*/
+static int import_base_node (hash_bucket_t *b, struct ext_cell *sub,
+			     struct ext_cell *cur, char *buf, int l, int bufsz)
 {
-  struct alias_tree *x = (struct alias_tree *)b->v;
-  int new_node;
+  int x = b->i;
+  const char *key;
   hash_bucket_t *newb;
-  struct alias_tree *newx;
-
-  snprintf (buf+l+1, bufsz - l - 1, "%s", b->key);
 
-  new_node = 1;
-
-  if (x->global == 2) {
-    newb = hash_lookup (cur, b->key);
-    if (!newb) {
-      newb = hash_add (cur, b->key);
-    }
-    else {
-      new_node = 0;
-    }
+  if (NODE(sub,x).global == 2) {
+    key = b->key;
   }
   else {
-    newb = hash_lookup (cur, buf);
-    if (newb) {
-      new_node = 0;
-    }
-    else {
-      newb = hash_add (cur, buf);
-    }
+    snprintf (buf+l+1, bufsz - l - 1, "%s", b->key);
+    key = buf;
   }
-  if (new_node) {
-    newx = newnode();
-    newx->name = name_munge (newb->key);
-    newx->global = x->global;
-    newb->v = newx;
-    newx->b = newb;
+  newb = hash_lookup (cur->N, key);
+  if (!newb) {
+    newb = hash_add (cur->N, key);
+    newnode (cur, newb, NODE(sub,x).global);
   }
+  return newb->i;
 }
 
-static void import_subcell_conns (struct Hashtable *N,
+static void import_subcell_conns (struct ext_cell *C,
 				  const char *instname, const char *tname,
 				  int xl, int xh, int yl, int yh)
 {
-  struct Hashtable *sub;
-  hash_bucket_t *b, *tb;
+  struct ext_cell *sub;
+  hash_bucket_t *b;
   char *strbuf;
   int l, t;
 
@@ -423,11 +406,11 @@ static void import_subcell_conns (struct Hashtable *N,
 
   b = hash_lookup (seen, tname);
   Assert (b, "What?");
-  sub = (struct Hashtable *) b->v;
+  sub = (struct ext_cell *) b->v;
 
   t = 0;
-  for (int i=0; i < sub->size; i++) {
-    for (b = sub->head[i]; b; b = b->next) {
+  for (int i=0; i < sub->N->size; i++) {
+    for (b = sub->N->head[i]; b; b = b->next) {
       int x = strlen (b->key);
       if (x > t) {
 	t = x;
@@ -466,29 +449,18 @@ static void import_subcell_conns (struct Hashtable *N,
     }
     l = strlen (strbuf) - 1;
 
-    for (int i=0; i < sub->size; i++) {
-      for (b = sub->head[i]; b; b = b->next) {
-	struct alias_tree *base;
-	struct alias_tree *x, *x1;
-
-	base = (struct alias_tree *)b->v;
-	import_base_node (b, N, strbuf, l, strbuf_sz);
+    for (int i=0; i < sub->N->size; i++) {
+      for (b = sub->N->head[i]; b; b = b->next) {
+	int x, x1, r;
 
 	/* x is the current node */
-	x = get_cur_node (b, N, strbuf, l, strbuf_sz);
+	x = import_base_node (b, sub, C, strbuf, l, strbuf_sz);
 
 	/* now import connections */
-	if (base->up) {
-	  import_base_node (base->up->b, N, strbuf, l, strbuf_sz);
-	  x1 = get_cur_node (base->up->b, N, strbuf, l, strbuf_sz);
-	  Assert (x1, "What?");
-	  x->up = x1;
-	}
-	if (base->noglob) {
-	  import_base_node (base->noglob->b, N, strbuf, l, strbuf_sz);
-	  x1 = get_cur_node (base->noglob->b, N, strbuf, l, strbuf_sz);
-	  Assert (x1, "What?");
-	  x->noglob = x1;
+	r = getalias (sub, b->i);
+	if (r != b->i) {
+	  x1 = import_base_node (NODE(sub,r).b, sub, C, strbuf, l, strbuf_sz);
+	  unionsets (C, x, x1, getalias (C, x1));
 	}
       }
     }
@@ -538,7 +510,7 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
 {
   hash_bucket_t *b;
   int l;
-  struct Hashtable *N;
+  struct ext_cell *C;
   int devcount = 1;
   const char *extra_fet_string;
   
@@ -549,8 +521,8 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
   b = hash_add (seen, name);
 
   /*-- create names table --*/
-  N = hash_new (32);
-  b->v = N;
+  C = newcell ();
+  b->v = C;
 
   if (config_exists ("net.extra_fet_string")) {
     extra_fet_string = config_get_string ("net.extra_fet_string");
@@ -579,7 +551,7 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
       yl = lst->ylo;
       yh = lst->yhi;
     }
-    import_subcell_conns (N, lst->id, lst->file, xl, xh, yl, yh);
+    import_subcell_conns (C, lst->id, lst->file, xl, xh, yl, yh);
   }
 
   if (!toplevel) {
@@ -670,19 +642,19 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
   /*-- process aliases --*/
   printf ("* -- connections ---\n");
   for (struct ext_alias *a = E->aliases; a; a = a->next) {
-    struct alias_tree *t1, *t2;
-    t1 = getname (N, a->n1);
-    t2 = getname (N, a->n2);
+    int t1, t2;
+    t1 = getname (C, a->n1);
+    t2 = getname (C, a->n2);
     if (t1 != t2) {
       char *s1, *s2;
-      if (t1->global) {
+      if (NODE(C,t1).global) {
 	s1 = name_munge_glob (a->n1);
       }
       else {
 	s1 = name_munge (a->n1);
       }
       
-      if (t2->global) {
+      if (NODE(C,t2).global) {
 	s2 = name_munge_glob (a->n2);
       }
       else {
@@ -693,19 +665,19 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
       FREE (s2);
     }
     if (islocal (a->n1)) {
-      mergealias (t1, t2);
+      mergealias (C, t1, t2);
     }
     else {
-      mergealias (t2, t1);
+      mergealias (C, t2, t1);
     }      
   }
 
   /*-- process area/perim --*/
   for (struct ext_ap *a = E->ap; a; a = a->next) {
-    struct alias_tree *t = getname (N, a->node);
+    int t = getname (C, a->node);
     for (int i=0; i < num_devices; i++) {
-      t->area[i] += a->area[i];
-      t->perim[i] += a->perim[i];
+      C->area[t*num_devices+i] += a->area[i];
+      C->perim[t*num_devices+i] += a->perim[i];
     }
   }
 
@@ -713,19 +685,20 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
   if (E->fet) {
     printf ("* -- fets ---\n");
     for (struct ext_fets *fl = E->fet; fl; fl = fl->next) {
-      struct alias_tree *tsrc, *tdrain, *t;
+      int tsrc, tdrain, t;
+      int ds, dd;
       if (use_subckt_models) {
 	printf ("x");
       }
       printf ("M%d ", devcount++);
-      tdrain = getname (N, fl->t2); /* drain */
-      printf ("%s ", tdrain->name); /* gate */
-      t = getname (N, fl->g);  /* src */
-      printf ("%s ", t->name);
-      tsrc = getname (N, fl->t1);
-      printf ("%s ", tsrc->name);
-      t = getname (N, fl->sub);
-      printf ("%s ", t->name);
+      tdrain = getname (C, fl->t2); /* drain */
+      printf ("%s ", spname (C, tdrain)); /* gate */
+      t = getname (C, fl->g);  /* src */
+      printf ("%s ", spname (C, t));
+      tsrc = getname (C, fl->t1);
+      printf ("%s ", spname (C, tsrc));
+      t = getname (C, fl->sub);
+      printf ("%s ", spname (C, t));
       if (devnames) {
 	printf ("%s ", config_get_string (devnames[fl->type]));
       }
@@ -737,22 +710,24 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
 	  printf ("nfet ");
 	}
       }
+      ds = tsrc*num_devices + fl->type;
+      dd = tdrain*num_devices + fl->type;
       printf ("W=");
       print_number (stdout, fl->width*scale);
       printf (" L=");
       print_number (stdout, fl->length*scale);
       printf ("\n+ AS=");
-      print_number (stdout, tsrc->area[fl->type]*scale*scale);
+      print_number (stdout, C->area[ds]*scale*scale);
       printf (" PS=");
-      print_number (stdout, tsrc->perim[fl->type]*scale);
-      tsrc->area[fl->type] = 0;
-      tsrc->perim[fl->type] = 0;
+      print_number (stdout, C->perim[ds]*scale);
+      C->area[ds] = 0;
+      C->perim[ds] = 0;
       printf (" AD=");
-      print_number (stdout, tdrain->area[fl->type]*scale*scale);
+      print_number (stdout, C->area[dd]*scale*scale);
       printf (" PD=");
-      print_number (stdout, tdrain->perim[fl->type]*scale);
-      tdrain->area[fl->type] = 0;
-      tdrain->perim[fl->type] = 0;
+      print_number (stdout, C->perim[dd]*scale);
+      C->area[dd] = 0;
+      C->perim[dd] = 0;
 
       if (extra_fet_string) {
 	printf (" %s", extra_fet_string);
@@ -767,52 +742,53 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
 
     /*--- collect cap to GND ---*/
     for (struct ext_cap *l = E->cap; l; l = l->next) {
-      struct alias_tree *t, *u;
+      int t, u;
 
-      t = getname (N, l->n1);
+      t = getname (C, l->n1);
       if (l->type == CAP_GND || l->type == CAP_SUBSTRATE) {
 	if (l->type == CAP_GND) {
-	  t->cap_gnd += l->cap;
+	  NODE(C,t).cap_gnd += l->cap;
 	}
       }
       else {
-	u = getname (N, l->n2);
-	if (strcmp (t->name, gnd_node) == 0) {
-	  u->cap_gnd += l->cap;
+	u = getname (C, l->n2);
+	if (strcmp (spname (C, t), gnd_node) == 0) {
+	  NODE(C,u).cap_gnd += l->cap;
 	}
-	else if (strcmp (u->name, gnd_node) == 0) {
-	  t->cap_gnd += l->cap;
+	else if (strcmp (spname (C, u), gnd_node) == 0) {
+	  NODE(C,t).cap_gnd += l->cap;
 	}
       }
     }
       
     for (struct ext_cap *l = E->cap; l; l = l->next) {
-      struct alias_tree *t, *u;
+      int t, u;
 
       if (l->type == CAP_GND || l->type == CAP_SUBSTRATE) continue;
     
-      t = getname (N, l->n1);
-      u = getname (N, l->n2);
-      if (strcmp (t->name, gnd_node) == 0) {
+      t = getname (C, l->n1);
+      u = getname (C, l->n2);
+      if (strcmp (spname (C, t), gnd_node) == 0) {
 	continue;
       }
-      else if (strcmp (u->name, gnd_node) == 0) {
+      else if (strcmp (spname (C, u), gnd_node) == 0) {
 	continue;
       }
 
       if (l->cap < mincap) continue;
     
-      printf ("C%d %s %s %gF\n", devcount++, t->name, u->name, l->cap*1.0e15);
+      printf ("C%d %s %s %gF\n", devcount++, spname (C, t), spname (C, u),
+	      l->cap*1.0e15);
     }
 
     /* print caps to GND */
-    for (int i=0; i < N->size; i++) {
-      for (hash_bucket_t *b = N->head[i]; b; b = b->next) {
-	struct alias_tree *t = (struct alias_tree *)b->v;
-	if (t->cap_gnd > 0 && t->cap_gnd >= mincap) {
-	  if (strcmp (t->name, gnd_node) == 0) continue;
-	  printf ("C%d %s %s %gF\n", devcount++, t->name,
-		  gnd_node, t->cap_gnd*1.0e15);
+    for (int i=0; i < C->N->size; i++) {
+      for (hash_bucket_t *b = C->N->head[i]; b; b = b->next) {
+	int t = b->i;
+	if (NODE(C,t).cap_gnd > 0 && NODE(C,t).cap_gnd >= mincap) {
+	  if (strcmp (spname (C, t), gnd_node) == 0) continue;
+	  printf ("C%d %s %s %gF\n", devcount++, spname (C, t),
+		  gnd_node, NODE(C,t).cap_gnd*1.0e15);
 	}
       }
     }
@@ -829,19 +805,25 @@ void ext2spice (const char *name, struct ext_file *E, int toplevel)
     }
   }
 
-#if 0  
-  /*--- delete hashtable ---*/
-  for (int i=0; i < N->size; i++) {
-    for (hash_bucket_t *b = N->head[i]; b; b = b->next) {
-      FREE (b->v);
+  /*
+    The subcircuit has been written out. Parent cells only need its
+    names and connectivity to import it, so release the device
+    geometry and the SPICE names.
+  */
+  for (int i=0; i < A_LEN (C->node); i++) {
+    if (NODE(C,i).name && NODE(C,i).global != 2) {
+      FREE (NODE(C,i).name);
     }
+    NODE(C,i).name = NULL;
+  }
+  if (C->area) {
+    FREE (C->area);
+    FREE (C->perim);
+    C->area = NULL;
+    C->perim = NULL;
   }
-  hash_free (N);
-#endif  
-  N = NULL;
 }
 
-
 int main (int argc, char **argv)
 {
   int ch;
@@ -853,7 +835,7 @@ int main (int argc, char **argv)
 
   Act::Init (&argc, &argv);
 
-  while ((ch = getopt (argc, argv, "c:s:")) != -1) {
+  while ((ch = getopt (argc, argv, "c:s:j:")) != -1) {
     switch (ch) {
     case 'c':
       mincap = atof (optarg);
@@ -861,6 +843,9 @@ int main (int argc, char **argv)
     case 's':
       scale = atof (optarg);
       break;
+    case 'j':
+      ext_read_threads (atoi (optarg));
+      break;
     default:
       usage(argv[0]);
       break;
@@ -45,69 +45,79 @@ then
 	mkdir runs
 fi
 
-myecho " "
-num=0
-count=0
-lim=10
-while [ -f ${count}.ext ]
+#
+# Read the .ext files with one thread, and then with two; both runs
+# must match the saved output.
+#
+for jobs in 1 2
 do
-	i=${count}.ext
-	count=`expr $count + 1`
-	bname=`expr $i : '\(.*\).ext'`
-	num=`expr $num + 1`
-        if [ $bname -lt 10 ]
-        then
-	   myecho ".[0$bname]"
-        else
-	   myecho ".[$bname]"
-        fi
-	$ACTTOOL $i  > runs/$i.t.stdout 2> runs/$i.t.stderr
-	ok=1
-	if ! cmp runs/$i.t.stdout runs/$i.stdout >/dev/null 2>/dev/null
+	if [ $jobs -gt 1 ]
 	then
-		echo 
-		myecho "** FAILED TEST $i: stdout"
-		fail=`expr $fail + 1`
-		ok=0
-		if [ ! x$ACT_TEST_VERBOSE = x ]; then
-            diff runs/$i.t.stdout runs/$i.stdout
-        fi
+		echo " -j $jobs:"
 	fi
-	if ! cmp runs/$i.t.stderr runs/$i.stderr >/dev/null 2>/dev/null
-	then
-		if [ $ok -eq 1 ]
+	myecho " "
+	num=0
+	count=0
+	lim=10
+	while [ -f ${count}.ext ]
+	do
+		i=${count}.ext
+		count=`expr $count + 1`
+		bname=`expr $i : '\(.*\).ext'`
+		num=`expr $num + 1`
+	        if [ $bname -lt 10 ]
+	        then
+		   myecho ".[0$bname]"
+	        else
+		   myecho ".[$bname]"
+	        fi
+		$ACTTOOL -j $jobs $i  > runs/$i.t.stdout 2> runs/$i.t.stderr
+		ok=1
+		if ! cmp runs/$i.t.stdout runs/$i.stdout >/dev/null 2>/dev/null
 		then
-			echo
-			myecho "** FAILED TEST $i:"
+			echo 
+			myecho "** FAILED TEST $i -j $jobs: stdout"
+			fail=`expr $fail + 1`
+			ok=0
+			if [ ! x$ACT_TEST_VERBOSE = x ]; then
+	            diff runs/$i.t.stdout runs/$i.stdout
+	        fi
 		fi
-		myecho " stderr"
-		fail=`expr $fail + 1`
-		ok=0
-		if [ ! x$ACT_TEST_VERBOSE = x ]; then
-            diff runs/$i.t.stderr runs/$i.stderr
-        fi
-	fi
-	if [ $ok -eq 1 ]
-	then
-		if [ $num -eq $lim ]
+		if ! cmp runs/$i.t.stderr runs/$i.stderr >/dev/null 2>/dev/null
 		then
-			echo 
+			if [ $ok -eq 1 ]
+			then
+				echo
+				myecho "** FAILED TEST $i -j $jobs:"
+			fi
+			myecho " stderr"
+			fail=`expr $fail + 1`
+			ok=0
+			if [ ! x$ACT_TEST_VERBOSE = x ]; then
+	            diff runs/$i.t.stderr runs/$i.stderr
+	        fi
+		fi
+		if [ $ok -eq 1 ]
+		then
+			if [ $num -eq $lim ]
+			then
+				echo 
+				myecho " "
+				num=0
+			fi
+		else
+			echo " **"
 			myecho " "
 			num=0
 		fi
-	else
-		echo " **"
-		myecho " "
-		num=0
+	done
+
+	if [ $num -ne 0 ]
+	then
+		echo
 	fi
 done
 
-if [ $num -ne 0 ]
-then
-	echo
-fi
-
-
 if [ $fail -ne 0 ]
 then
 	if [ $fail -eq 1 ]
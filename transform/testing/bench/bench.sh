@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# Run the synthetic benchmark suite.
+#
+#   bench.sh [-s small|large] [-n seed] [outdir]
+#
+# For each design, outdir gets the generated <name>.act file, the
+# driver output <name>.out, and the phase profile <name>.json. The
+# generator is deterministic, so results from different runs (or
+# different versions of the tools) are directly comparable.
+#
+
+size=large
+seed=1
+while [ $# -gt 0 ]
+do
+	case "$1" in
+	-s) size=$2; shift 2;;
+	-n) seed=$2; shift 2;;
+	-*) echo "Usage: $0 [-s small|large] [-n seed] [outdir]"; exit 1;;
+	*) break;;
+	esac
+done
+outdir=${1:-bench.out}
+
+ARCH=`$VLSI_TOOLS_SRC/scripts/getarch`
+OS=`$VLSI_TOOLS_SRC/scripts/getos`
+EXT=${ARCH}_${OS}
+dir=`dirname $0`
+if [ -f $dir/test_bench.$EXT ] && [ -f $dir/bench_gen.$EXT ]; then
+  BENCH=$dir/test_bench.$EXT
+  GEN=$dir/bench_gen.$EXT
+else
+  BENCH=$ACT_HOME/bin/test_bench
+  GEN=$ACT_HOME/bin/bench_gen
+fi
+
+#
+# Arrays and connection sets are kept below act.subconnection_limit
+# (30000 by default).
+#
+case $size in
+small)
+	designs="hier:3:4 array:100 templ:20 prs:50 chp:30 conn:100"
+	;;
+large)
+	designs="hier:6:10 array:20000 templ:2000 prs:20000 chp:5000 conn:20000"
+	;;
+*)
+	echo "$0: unknown size \`$size'"
+	exit 1
+	;;
+esac
+
+if [ ! -d $outdir ]
+then
+	mkdir -p $outdir
+fi
+
+printf "%-8s %12s %12s\n" design instances "wall(ms)"
+for d in $designs
+do
+	name=`echo $d | sed 's/:.*//'`
+	args=`echo $d | sed 's/:/ /g'`
+	$GEN -s $seed $args > $outdir/$name.act || exit 1
+	if ! $BENCH -prof=json:$outdir/$name.json $outdir/$name.act 'top<>' > $outdir/$name.out 2> $outdir/$name.err
+	then
+		echo "$name: failed, see $outdir/$name.err"
+		continue
+	fi
+	inst=`sed -n 's/.*: \([0-9]*\) process instances.*/\1/p' $outdir/$name.out`
+	wall=`sed -n '1s/.*"wall_ms": \([0-9.]*\).*/\1/p' $outdir/$name.json`
+	printf "%-8s %12s %12s\n" $name $inst $wall
+done
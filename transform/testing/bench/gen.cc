@@ -0,0 +1,246 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------
+ *
+ *  Synthetic design generator for benchmarking
+ *
+ *   Each design is a function of its kind, size, and seed only: the
+ *  pseudo-random choices use a private generator, so the same command
+ *  line produces the same file on every platform. The top-level
+ *  process is always top<>.
+ *
+ *------------------------------------------------------------------------
+ */
+
+static unsigned long _seed = 1;
+
+static unsigned int _rand (unsigned int n)
+{
+  _seed = _seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (unsigned int) ((_seed >> 33) % n);
+}
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s [-s seed] <kind> <size> [<size2>]\n", name);
+  fprintf (stderr, "  hier <depth> <fanout> : hierarchy with fanout^depth leaf cells\n");
+  fprintf (stderr, "  array <n>             : one array of n cells\n");
+  fprintf (stderr, "  templ <n>             : n distinct template instances\n");
+  fprintf (stderr, "  prs <n>               : a process with n production rules\n");
+  fprintf (stderr, "  chp <n>               : a process with n CHP statements\n");
+  fprintf (stderr, "  conn <n>              : n random connections between arrays\n");
+  exit (1);
+}
+
+static void emit_cells (FILE *fp)
+{
+  fprintf (fp, "defproc inv (bool? i; bool! o)\n");
+  fprintf (fp, "{\n  prs {\n    i => o-\n  }\n}\n\n");
+
+  fprintf (fp, "defproc nand2 (bool? a, b; bool! o)\n");
+  fprintf (fp, "{\n  prs {\n    a & b => o-\n  }\n}\n\n");
+
+  fprintf (fp, "defproc celem (bool? a, b; bool! o)\n");
+  fprintf (fp, "{\n  bool _o;\n  prs {\n");
+  fprintf (fp, "    a & b -> _o-\n    ~a & ~b -> _o+\n    _o => o-\n  }\n}\n\n");
+}
+
+/*
+ * Deep hierarchy: h0 is a small leaf; hk is a chain of "fanout" copies
+ * of h(k-1). Every level is a distinct type.
+ */
+static void gen_hier (FILE *fp, int depth, int fanout)
+{
+  emit_cells (fp);
+
+  fprintf (fp, "defproc h0 (bool? i; bool! o)\n{\n");
+  fprintf (fp, "  inv x;\n  celem y;\n");
+  fprintf (fp, "  x.i = i;\n  y.a = x.o;\n  y.b = i;\n  o = y.o;\n}\n\n");
+
+  for (int k=1; k <= depth; k++) {
+    fprintf (fp, "defproc h%d (bool? i; bool! o)\n{\n", k);
+    fprintf (fp, "  h%d x[%d];\n", k-1, fanout);
+    fprintf (fp, "  x[0].i = i;\n");
+    fprintf (fp, "  (j:%d: x[j].o = x[j+1].i;)\n", fanout-1);
+    fprintf (fp, "  o = x[%d].o;\n}\n\n", fanout-1);
+  }
+
+  fprintf (fp, "defproc top ()\n{\n  bool i, o;\n");
+  fprintf (fp, "  h%d t;\n  t.i = i;\n  t.o = o;\n}\n\ntop t;\n", depth);
+}
+
+/* a wide array of cells connected in a ring of chains */
+static void gen_array (FILE *fp, int n)
+{
+  emit_cells (fp);
+
+  fprintf (fp, "defproc top ()\n{\n");
+  fprintf (fp, "  inv x[%d];\n  nand2 y[%d];\n", n, n);
+  fprintf (fp, "  (j:%d: x[j].o = y[j].a; y[j].b = x[(j+%d) %% %d].o;)\n",
+	   n, 1 + _rand (n), n);
+  fprintf (fp, "  (j:%d: y[j].o = x[j+1].i;)\n", n-1);
+  fprintf (fp, "  y[%d].o = x[0].i;\n}\n\ntop t;\n", n-1);
+}
+
+/* n distinct instantiations of parameterized processes */
+static void gen_templ (FILE *fp, int n)
+{
+  emit_cells (fp);
+
+  fprintf (fp, "template<pint W, K>\n");
+  fprintf (fp, "defproc chain (bool? i; bool! o)\n{\n");
+  fprintf (fp, "  bool n[W+1];\n  inv x[W];\n");
+  fprintf (fp, "  n[0] = i;\n");
+  fprintf (fp, "  (j:W: x[j].i = n[j]; x[j].o = n[j+1];)\n");
+  fprintf (fp, "  [ K %% 2 = 0 -> nand2 z0; z0.a = n[W]; z0.b = n[0]; o = z0.o;\n");
+  fprintf (fp, "  [] else -> celem z1; z1.a = n[W]; z1.b = n[W/2]; o = z1.o;\n  ]\n}\n\n");
+
+  fprintf (fp, "defproc top ()\n{\n");
+  for (int q=0; q < n; q++) {
+    fprintf (fp, "  chain<%d, %d> c%d;\n", 1 + _rand (16), q, q);
+  }
+  for (int q=0; q < n-1; q++) {
+    fprintf (fp, "  c%d.o = c%d.i;\n", q, q+1);
+  }
+  fprintf (fp, "}\n\ntop t;\n");
+}
+
+/* one process with n combinational production rules */
+static void gen_prs (FILE *fp, int n)
+{
+  fprintf (fp, "defproc top ()\n{\n  bool v[%d];\n  prs {\n", n+1);
+  for (int i=1; i <= n; i++) {
+    int lits = 1 + _rand (4);
+    fprintf (fp, "    ");
+    for (int k=0; k < lits; k++) {
+      if (k > 0) {
+	fprintf (fp, _rand (3) == 0 ? " | " : " & ");
+      }
+      fprintf (fp, "v[%d]", _rand (i));
+    }
+    fprintf (fp, " => v[%d]-\n", i);
+  }
+  fprintf (fp, "  }\n}\n\ntop t;\n");
+}
+
+/* one process with n CHP statements */
+static void gen_chp (FILE *fp, int n)
+{
+  const int nv = 16;
+  static const char *ops[] = { "+", "-", "&", "|", "^" };
+
+  fprintf (fp, "defproc top ()\n{\n");
+  fprintf (fp, "  chan(int<8>) L, R;\n  int<8> x[%d];\n", nv);
+  fprintf (fp, "  chp {\n    *[ L?x[0]");
+  for (int i=0; i < n; i++) {
+    int a = _rand (nv), b = _rand (nv), c = _rand (nv);
+    fprintf (fp, ";\n       ");
+    switch (_rand (4)) {
+    case 0:
+      fprintf (fp, "[ x[%d] > x[%d] -> x[%d] := x[%d] %s %d [] else -> skip ]",
+	       a, b, c, a, ops[_rand (5)], _rand (256));
+      break;
+    case 1:
+      fprintf (fp, "x[%d] := x[%d] %s %d", a, b, ops[_rand (5)], _rand (256));
+      break;
+    default:
+      fprintf (fp, "x[%d] := x[%d] %s x[%d]", a, b, ops[_rand (5)], c);
+      break;
+    }
+  }
+  fprintf (fp, ";\n       R!x[%d]\n     ]\n  }\n}\n\ntop t;\n", _rand (nv));
+}
+
+/* n random connections between two arrays, as separate statements */
+static void gen_conn (FILE *fp, int n)
+{
+  emit_cells (fp);
+
+  fprintf (fp, "defproc top ()\n{\n  bool a[%d], b[%d];\n", n, n);
+  fprintf (fp, "  inv x[%d];\n", n);
+  fprintf (fp, "  (j:%d: x[j].i = a[j]; x[j].o = b[j];)\n", n);
+  for (int i=0; i < n; i++) {
+    fprintf (fp, "  a[%d] = b[%d];\n", _rand (n), _rand (n));
+  }
+  fprintf (fp, "}\n\ntop t;\n");
+}
+
+int main (int argc, char **argv)
+{
+  char *name = argv[0];
+  int n, m;
+
+  if (argc > 2 && strcmp (argv[1], "-s") == 0) {
+    _seed = strtoul (argv[2], NULL, 0);
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc < 3) {
+    usage (name);
+  }
+  n = atoi (argv[2]);
+  m = (argc > 3) ? atoi (argv[3]) : 0;
+  if (n < 1 || argc > 4) {
+    usage (name);
+  }
+
+  printf ("/* bench_gen -s %lu %s %d", _seed, argv[1], n);
+  if (argc > 3) {
+    printf (" %d", m);
+  }
+  printf (" */\n\n");
+
+  if (strcmp (argv[1], "hier") == 0) {
+    if (m < 2) {
+      usage (name);
+    }
+    gen_hier (stdout, n, m);
+  }
+  else if (argc > 3) {
+    usage (name);
+  }
+  else if (strcmp (argv[1], "array") == 0) {
+    gen_array (stdout, n);
+  }
+  else if (strcmp (argv[1], "templ") == 0) {
+    gen_templ (stdout, n);
+  }
+  else if (strcmp (argv[1], "prs") == 0) {
+    gen_prs (stdout, n);
+  }
+  else if (strcmp (argv[1], "chp") == 0) {
+    gen_chp (stdout, n);
+  }
+  else if (strcmp (argv[1], "conn") == 0) {
+    gen_conn (stdout, n);
+  }
+  else {
+    usage (name);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <map>
+#include <act/act.h>
+#include <act/iter.h>
+#include <act/passes.h>
+#include <act/profile.h>
+#include <common/config.h>
+
+/*
+ *  Benchmark driver: reads, expands, and runs the core passes on a
+ *  design. Times are collected by the phase profiler; use -prof=json:file
+ *  to save them.
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s [act-options] [-p <pass>,...] <actfile> <process>\n", name);
+  fprintf (stderr, "  passes: booleanize, netgen, state, cells (default: all)\n");
+  exit (1);
+}
+
+static int _enabled (const char *list, const char *pass)
+{
+  int len = strlen (pass);
+  const char *s;
+
+  if (!list) {
+    return 1;
+  }
+  for (s = list; (s = strstr (s, pass)); s += len) {
+    if ((s == list || s[-1] == ',') && (s[len] == '\0' || s[len] == ',')) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* number of process instances in the hierarchy rooted at p */
+static unsigned long _count (Process *p, std::map<Process *, unsigned long> &m,
+			     unsigned long *types)
+{
+  std::map<Process *, unsigned long>::iterator it = m.find (p);
+  unsigned long n = 1;
+
+  if (it != m.end()) {
+    return it->second;
+  }
+
+  ActInstiter i(p->CurScope());
+  for (i = i.begin(); i != i.end(); i++) {
+    ValueIdx *vx = *i;
+    if (TypeFactory::isProcessType (vx->t)) {
+      Process *x = dynamic_cast<Process *> (vx->t->BaseType());
+      if (!x->isExpanded()) {
+	continue;
+      }
+      Array *a = vx->t->arrayInfo();
+      if (!a) {
+	n += _count (x, m, types);
+      }
+      /* sparse arrays may have a different type for each block */
+      for (; a; a = a->Next()) {
+	if (a->getArrayType()) {
+	  x = dynamic_cast<Process *> (a->getArrayType()->BaseType());
+	}
+	n += a->getRangeSize() * _count (x, m, types);
+      }
+    }
+  }
+  m[p] = n;
+  (*types)++;
+  return n;
+}
+
+int main (int argc, char **argv)
+{
+  Act *a;
+  const char *passes = NULL;
+  int ch;
+
+  /* initialize ACT library */
+  Act::Init (&argc, &argv);
+
+  while ((ch = getopt (argc, argv, "p:")) != -1) {
+    switch (ch) {
+    case 'p':
+      passes = optarg;
+      break;
+    default:
+      usage (argv[0]);
+      break;
+    }
+  }
+  if (optind != argc - 2) {
+    usage (argv[0]);
+  }
+
+  /* the profiler is the timer */
+  if (!act_prof_enabled) {
+    act_prof_setup ("text");
+  }
+
+  a = new Act (argv[optind]);
+  a->Expand ();
+
+  Process *p = a->findProcess (argv[optind+1]);
+  if (!p) {
+    fatal_error ("Could not find process `%s' in file `%s'", argv[optind+1],
+		 argv[optind]);
+  }
+  if (!p->isExpanded()) {
+    fatal_error ("Process `%s' is not expanded.", argv[optind+1]);
+  }
+
+  {
+    std::map<Process *, unsigned long> m;
+    unsigned long types = 0;
+    unsigned long n = _count (p, m, &types);
+    printf ("design: %s: %lu process instances, %lu process types\n",
+	    argv[optind], n, types);
+    fflush (stdout);
+  }
+
+  if (_enabled (passes, "booleanize")) {
+    ActBooleanizePass *bp = new ActBooleanizePass (a);
+    bp->run (p);
+  }
+  if (_enabled (passes, "netgen")) {
+    ActNetlistPass *np = new ActNetlistPass (a);
+    np->run (p);
+  }
+  if (_enabled (passes, "state")) {
+    ActStatePass *sp = new ActStatePass (a);
+    sp->run (p);
+  }
+  /* last, since it replaces production rules with cells */
+  if (_enabled (passes, "cells")) {
+    ActCellPass *cp = new ActCellPass (a);
+    cp->run (p);
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#!/bin/sh
+
+echo
+echo "************************************************************************"
+echo "*               Testing benchmark generator and driver                 *"
+echo "************************************************************************"
+echo
+
+
+ARCH=`$VLSI_TOOLS_SRC/scripts/getarch`
+OS=`$VLSI_TOOLS_SRC/scripts/getos`
+EXT=${ARCH}_${OS}
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../test_bench.$EXT ]; then
+  ACTTOOL=$ACT_HOME/bin/test_bench
+  GEN=$ACT_HOME/bin/bench_gen
+  echo "testing installation"
+echo
+else
+  ACTTOOL=../test_bench.$EXT
+  GEN=../bench_gen.$EXT
+fi
+
+check_echo=0
+myecho()
+{
+  if [ $check_echo -eq 0 ]
+  then
+	check_echo=1
+	count=`echo -n "" | wc -c | awk '{print $1}'`
+	if [ $count -gt 0 ]
+	then
+		check_echo=2
+	fi
+  fi
+  if [ $check_echo -eq 1 ]
+  then
+	echo -n "$@"
+  else
+	echo "$@\c"
+  fi
+}
+
+
+fail=0
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+#
+# The generated designs must match the saved ones exactly; the driver
+# output (the design statistics) must match as well.
+#
+myecho " "
+for d in hier:3:4 array:100 templ:20 prs:50 chp:30 conn:100
+do
+	name=`echo $d | sed 's/:.*//'`
+	args=`echo $d | sed 's/:/ /g'`
+	myecho ".[$name]"
+	ok=1
+	$GEN $args > runs/$name.t.act
+	if ! cmp runs/$name.t.act $name.act >/dev/null 2>/dev/null
+	then
+		echo
+		myecho "** FAILED TEST $name: design"
+		fail=`expr $fail + 1`
+		ok=0
+	fi
+	$ACTTOOL -prof=json:runs/$name.t.json runs/$name.t.act 'top<>' > runs/$name.t.stdout 2> runs/$name.t.stderr
+	if ! cmp runs/$name.t.stdout runs/$name.stdout >/dev/null 2>/dev/null
+	then
+		if [ $ok -eq 1 ]
+		then
+			echo
+			myecho "** FAILED TEST $name:"
+		fi
+		myecho " stdout"
+		fail=`expr $fail + 1`
+		ok=0
+		if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            diff runs/$name.t.stdout runs/$name.stdout
+        fi
+	fi
+	if [ -s runs/$name.t.stderr ]
+	then
+		if [ $ok -eq 1 ]
+		then
+			echo
+			myecho "** FAILED TEST $name:"
+		fi
+		myecho " stderr"
+		fail=`expr $fail + 1`
+		ok=0
+	fi
+	if [ $ok -eq 0 ]
+	then
+		echo " **"
+		myecho " "
+	fi
+done
+echo
+
+
+if [ $fail -ne 0 ]
+then
+	if [ $fail -eq 1 ]
+	then
+		echo "--- Summary: 1 test failed ---"
+	else
+		echo "--- Summary: $fail tests failed ---"
+	fi
+	exit 1
+else
+	echo
+	echo "SUCCESS! All tests passed."
+fi
+echo
@@ -0,0 +1,466 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <common/int.h>
+#include <common/mytime.h>
+
+/*
+ *  Tests for BigInt multiplication and division. Results from the
+ *  Karatsuba and long-division code are compared against a
+ *  schoolbook product and a bit-serial division computed here,
+ *  for operand sizes on either side of the thresholds where int.cc
+ *  switches algorithms. The pool test checks that the per-thread
+ *  buffer pools are released when threads exit.
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s <test>\n", name);
+  fprintf (stderr, "  mul   : randomized products around the Karatsuba threshold\n");
+  fprintf (stderr, "  div   : randomized quotients and remainders\n");
+  fprintf (stderr, "  pool  : buffer pools of exited threads are freed\n");
+  fprintf (stderr, "  bench : ns per multiply and divide by operand size\n");
+  exit (1);
+}
+
+typedef unsigned long word_t;
+
+/* xorshift; the sequence is fixed so failures are reproducible */
+static word_t _seed = 0x9e3779b97f4a7c15UL;
+
+static word_t rnd (void)
+{
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 7;
+  _seed ^= _seed << 17;
+  return _seed;
+}
+
+/* random digits, with runs of all-zero and all-one digits to
+   exercise carries and the quotient correction step */
+static void rnd_digits (word_t *d, int n)
+{
+  int style = rnd () % 4;
+
+  for (int i=0; i < n; i++) {
+    switch (style) {
+    case 0:
+      d[i] = rnd ();
+      break;
+    case 1:
+      d[i] = ~0UL;
+      break;
+    case 2:
+      d[i] = (rnd () % 3 == 0) ? 0 : rnd ();
+      break;
+    default:
+      d[i] = (rnd () & 1) ? ~0UL : (1UL << (rnd () % 64));
+      break;
+    }
+  }
+  if (d[n-1] == 0) {
+    d[n-1] = 1;
+  }
+}
+
+static BigInt mkint (const word_t *d, int n)
+{
+  BigInt x (64*n, 0, 0);
+
+  for (int i=0; i < n; i++) {
+    x.setVal (i, d[i]);
+  }
+  return x;
+}
+
+/* compare the low n digits of x against d, and check that the rest
+   of x is zero */
+static int same (const BigInt &x, const word_t *d, int n)
+{
+  for (int i=0; i < (int)x.getLen(); i++) {
+    if (x.getVal (i) != (i < n ? d[i] : 0)) {
+      return 0;
+    }
+  }
+  for (int i=x.getLen(); i < n; i++) {
+    if (d[i] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Reference arithmetic
+ *
+ *------------------------------------------------------------------------
+ */
+static void ref_mul (word_t *r, const word_t *a, int an,
+		     const word_t *b, int bn)
+{
+  for (int i=0; i < an+bn; i++) {
+    r[i] = 0;
+  }
+  for (int i=0; i < an; i++) {
+    word_t c = 0;
+    for (int j=0; j < bn; j++) {
+      unsigned __int128 t = (unsigned __int128)a[i]*b[j] + r[i+j] + c;
+      r[i+j] = (word_t)t;
+      c = (word_t)(t >> 64);
+    }
+    r[i+bn] = c;
+  }
+}
+
+/* r >= b on n digits */
+static int ref_ge (const word_t *r, const word_t *b, int n)
+{
+  for (int i=n-1; i >= 0; i--) {
+    if (r[i] != b[i]) {
+      return r[i] > b[i];
+    }
+  }
+  return 1;
+}
+
+#define MAXDIV 40
+
+/* bit-serial restoring division; q has an digits, r has an+1 */
+static void ref_div (word_t *q, word_t *r, const word_t *a, int an,
+		     const word_t *b, int bn)
+{
+  word_t bb[MAXDIV+1];
+
+  for (int i=0; i <= an; i++) {
+    bb[i] = (i < bn) ? b[i] : 0;
+    r[i] = 0;
+  }
+  for (int i=0; i < an; i++) {
+    q[i] = 0;
+  }
+  for (int k=64*an-1; k >= 0; k--) {
+    for (int i=an; i > 0; i--) {
+      r[i] = (r[i] << 1) | (r[i-1] >> 63);
+    }
+    r[0] = (r[0] << 1) | ((a[k/64] >> (k%64)) & 1);
+    if (ref_ge (r, bb, an+1)) {
+      word_t bw = 0;
+      for (int i=0; i <= an; i++) {
+	word_t t = r[i] - bb[i] - bw;
+	bw = (r[i] < bb[i]) || (r[i] - bb[i] < bw);
+	r[i] = t;
+      }
+      q[k/64] |= (1UL << (k%64));
+    }
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Multiplication
+ *
+ *------------------------------------------------------------------------
+ */
+
+/* operand sizes in digits: around the 1x1 and 2x2 fast paths, the
+   default Karatsuba threshold (32), and one recursion level down */
+static const int mul_sizes[] = { 1, 2, 3, 4, 5, 15, 16, 17,
+				 31, 32, 33, 63, 64, 65 };
+#define NMUL (int)(sizeof (mul_sizes)/sizeof (mul_sizes[0]))
+
+/* Karatsuba thresholds: default, never (schoolbook), and the
+   smallest allowed so the recursion is exercised on small inputs */
+static const int mul_thresh[] = { 0, 1 << 20, 4 };
+
+static void test_mul (void)
+{
+  word_t a[65], b[65], r[130];
+  int cases = 0, errs = 0;
+
+  for (int i=0; i < NMUL; i++) {
+    for (int j=0; j < NMUL; j++) {
+      for (int rep=0; rep < 4; rep++) {
+	int an = mul_sizes[i];
+	int bn = mul_sizes[j];
+
+	rnd_digits (a, an);
+	rnd_digits (b, bn);
+	ref_mul (r, a, an, b, bn);
+
+	for (int k=0; k < 3; k++) {
+	  BigInt::setKaratsuba (mul_thresh[k]);
+	  BigInt x = mkint (a, an);
+	  BigInt y = mkint (b, bn);
+	  BigInt z = x * y;
+	  cases++;
+	  if (!same (z, r, an+bn)) {
+	    if (errs < 10) {
+	      printf ("mismatch: %d x %d digits, threshold %d\n", an, bn,
+		      mul_thresh[k]);
+	    }
+	    errs++;
+	  }
+	}
+      }
+    }
+  }
+  BigInt::setKaratsuba (0);
+  printf ("mul: %s\n", errs ? "FAILED" : "ok");
+  if (errs) {
+    printf ("%d of %d products differ\n", errs, cases);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Division
+ *
+ *------------------------------------------------------------------------
+ */
+
+/* sizes around the single-digit, two-digit and stack-buffer paths */
+static const int div_sizes[] = { 1, 2, 3, 4, 16, 17, 18, 33, MAXDIV };
+#define NDIV (int)(sizeof (div_sizes)/sizeof (div_sizes[0]))
+
+static void test_div (void)
+{
+  word_t a[MAXDIV], b[MAXDIV], q[MAXDIV], r[MAXDIV+1];
+  int cases = 0, errs = 0;
+
+  for (int i=0; i < NDIV; i++) {
+    for (int j=0; j <= i; j++) {
+      for (int rep=0; rep < 8; rep++) {
+	int an = div_sizes[i];
+	int bn = div_sizes[j];
+
+	rnd_digits (a, an);
+	rnd_digits (b, bn);
+	if (rep == 0 && an == bn) {
+	  /* quotient is 0 or 1 */
+	  b[bn-1] = a[an-1];
+	}
+	ref_div (q, r, a, an, b, bn);
+
+	BigInt x = mkint (a, an);
+	BigInt y = mkint (b, bn);
+	BigInt xq = x;
+	BigInt xr = x;
+	xq /= y;
+	xr %= y;
+	cases++;
+	if (!same (xq, q, an) || !same (xr, r, an+1)) {
+	  if (errs < 10) {
+	    printf ("mismatch: %d / %d digits\n", an, bn);
+	  }
+	  errs++;
+	  continue;
+	}
+
+	/* q*b + r == a */
+	BigInt p = xq * y;
+	p.toDynamic ();
+	p += xr;
+	if (!same (p, a, an)) {
+	  if (errs < 10) {
+	    printf ("q*b + r != a: %d / %d digits\n", an, bn);
+	  }
+	  errs++;
+	}
+      }
+    }
+  }
+  printf ("div: %s\n", errs ? "FAILED" : "ok");
+  if (errs) {
+    printf ("%d of %d divisions differ\n", errs, cases);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Thread exit
+ *
+ *------------------------------------------------------------------------
+ */
+#define POOL_THREADS 8
+#define POOL_ROUNDS  50
+#define POOL_SLACK   1024		/* KB */
+
+/* resident set size in KB, or -1 */
+static long rss_kb (void)
+{
+  char buf[128];
+  long sz, res;
+  int fd, n;
+
+  fd = open ("/proc/self/statm", O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  n = read (fd, buf, sizeof (buf) - 1);
+  close (fd);
+  if (n <= 0) {
+    return -1;
+  }
+  buf[n] = '\0';
+  if (sscanf (buf, "%ld %ld", &sz, &res) != 2) {
+    return -1;
+  }
+  return res * (sysconf (_SC_PAGESIZE)/1024);
+}
+
+/* fill every size class of this thread's pool */
+static void *pool_body (void *)
+{
+  for (int w = 100; w < 4000; w += 37) {
+    BigInt *x[64];
+
+    for (int i=0; i < 64; i++) {
+      x[i] = new BigInt (w, 0, 0);
+      x[i]->setVal (0, i);
+    }
+    for (int i=0; i < 64; i++) {
+      delete x[i];
+    }
+  }
+  return NULL;
+}
+
+static void pool_round (void)
+{
+  pthread_t t[POOL_THREADS];
+
+  for (int i=0; i < POOL_THREADS; i++) {
+    pthread_create (&t[i], NULL, pool_body, NULL);
+  }
+  for (int i=0; i < POOL_THREADS; i++) {
+    pthread_join (t[i], NULL);
+  }
+}
+
+/*
+ * After a warm-up round, more rounds of short-lived threads must
+ * not grow the process; each round keeps about 0.5MB in pools if they
+ * are not freed.
+ */
+static void test_pool (void)
+{
+  long before, after;
+
+  pool_round ();
+  before = rss_kb ();
+  for (int r=0; r < POOL_ROUNDS; r++) {
+    pool_round ();
+  }
+  after = rss_kb ();
+  if (before < 0 || after < 0) {
+    printf ("pool: ok\n");
+  }
+  else if (after - before > POOL_SLACK) {
+    printf ("pool: grew by %ld KB over %d rounds\n", after - before,
+	    POOL_ROUNDS);
+  }
+  else {
+    printf ("pool: ok\n");
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Microbenchmark
+ *
+ *------------------------------------------------------------------------
+ */
+static const int bench_sizes[] = { 1, 2, 4, 16, 32, 64, 128 };
+#define NBENCH (int)(sizeof (bench_sizes)/sizeof (bench_sizes[0]))
+
+static void test_bench (void)
+{
+  word_t a[256], b[128];
+
+  printf ("%8s %12s %12s\n", "digits", "mul ns/op", "div ns/op");
+  for (int i=0; i < NBENCH; i++) {
+    int n = bench_sizes[i];
+    long iter = 4000000L/(n*n) + 1000;
+    double tm, td;
+
+    for (int k=0; k < 2*n; k++) {
+      a[k] = rnd ();
+    }
+    for (int k=0; k < n; k++) {
+      b[k] = rnd ();
+    }
+    BigInt x = mkint (a, n);
+    BigInt y = mkint (b, n);
+    BigInt w = mkint (a, 2*n);
+
+    realtime_msec ();
+    for (long k=0; k < iter; k++) {
+      BigInt z = x * y;
+    }
+    tm = realtime_msec ()*1e6/iter;
+
+    for (long k=0; k < iter; k++) {
+      BigInt z = w;
+      z /= y;
+    }
+    td = realtime_msec ()*1e6/iter;
+
+    printf ("%8d %12.1f %12.1f\n", n, tm, td);
+  }
+}
+
+
+int main (int argc, char **argv)
+{
+  if (argc != 2) {
+    usage (argv[0]);
+  }
+  if (strcmp (argv[1], "mul") == 0) {
+    test_mul ();
+  }
+  else if (strcmp (argv[1], "div") == 0) {
+    test_div ();
+  }
+  else if (strcmp (argv[1], "pool") == 0) {
+    test_pool ();
+  }
+  else if (strcmp (argv[1], "bench") == 0) {
+    test_bench ();
+  }
+  else {
+    usage (argv[0]);
+  }
+  return 0;
+}
@@ -0,0 +1,483 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include <common/array.h>
+
+/*
+ *  Tests for the configuration image cache. Each read through the
+ *  cache is compared against the same read with the cache turned off,
+ *  and the cache directory is inspected to see if the image was
+ *  reused (hit) or written again (miss). Images are written to a
+ *  temporary file and renamed, so a miss always changes the inode.
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s <test>\n", name);
+  fprintf (stderr, "  files : include, _tablex, program values, prefixes, edits\n");
+  fprintf (stderr, "  tech  : the generic technology files, cold and warm\n");
+  exit (1);
+}
+
+static char *scratch;
+static char *cachedir;
+
+static char *scratch_file (const char *name)
+{
+  char *s;
+  int len = strlen (scratch) + strlen (name) + 2;
+
+  MALLOC (s, char, len);
+  snprintf (s, len, "%s/%s", scratch, name);
+  return s;
+}
+
+static void write_file (const char *name, const char *contents)
+{
+  char *s = scratch_file (name);
+  FILE *fp = fopen (s, "w");
+
+  if (!fp) {
+    fatal_error ("Could not write `%s'", s);
+  }
+  fputs (contents, fp);
+  fclose (fp);
+  FREE (s);
+}
+
+static int strptr_cmp (const void *a, const void *b)
+{
+  return strcmp (*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * The lines of s, sorted: config_dump() walks the hash table, so its
+ * order depends on the order of insertion.
+ */
+static char *sort_lines (char *s)
+{
+  A_DECL (char *, x);
+  char *ret, *t;
+  size_t len;
+  FILE *fp;
+
+  A_INIT (x);
+  for (t = strtok (s, "\n"); t; t = strtok (NULL, "\n")) {
+    A_NEW (x, char *);
+    A_NEXT (x) = t;
+    A_INC (x);
+  }
+  if (A_LEN (x) > 0) {
+    qsort (x, A_LEN (x), sizeof (char *), strptr_cmp);
+  }
+  ret = NULL;
+  fp = open_memstream (&ret, &len);
+  for (int i=0; i < A_LEN (x); i++) {
+    fprintf (fp, "%s\n", x[i]);
+  }
+  fclose (fp);
+  A_FREE (x);
+  return ret;
+}
+
+static char *dump (void)
+{
+  char *s, *ret;
+  size_t len;
+  FILE *fp;
+
+  s = NULL;
+  fp = open_memstream (&s, &len);
+  config_dump (fp);
+  fclose (fp);
+  ret = sort_lines (s);
+  free (s);
+  return ret;
+}
+
+/* names and inodes of the images in the cache directory */
+static char *snapshot (void)
+{
+  A_DECL (char *, x);
+  struct dirent *d;
+  struct stat st;
+  char buf[1024];
+  char *ret;
+  size_t len;
+  FILE *fp;
+  DIR *dir;
+
+  A_INIT (x);
+  dir = opendir (cachedir);
+  if (!dir) {
+    fatal_error ("Could not open `%s'", cachedir);
+  }
+  while ((d = readdir (dir))) {
+    if (d->d_name[0] == '.') {
+      continue;
+    }
+    snprintf (buf, 1024, "%s/%s", cachedir, d->d_name);
+    if (stat (buf, &st) != 0) {
+      continue;
+    }
+    snprintf (buf, 1024, "%s:%lu", d->d_name, (unsigned long)st.st_ino);
+    A_NEW (x, char *);
+    A_NEXT (x) = Strdup (buf);
+    A_INC (x);
+  }
+  closedir (dir);
+  if (A_LEN (x) > 0) {
+    qsort (x, A_LEN (x), sizeof (char *), strptr_cmp);
+  }
+  ret = NULL;
+  fp = open_memstream (&ret, &len);
+  for (int i=0; i < A_LEN (x); i++) {
+    fprintf (fp, "%s\n", x[i]);
+    FREE (x[i]);
+  }
+  fclose (fp);
+  A_FREE (x);
+  return ret;
+}
+
+static int nimages (void)
+{
+  char *s = snapshot ();
+  int n = 0;
+
+  for (char *t = s; *t; t++) {
+    if (*t == '\n') {
+      n++;
+    }
+  }
+  free (s);
+  return n;
+}
+
+/* program values applied before each read */
+static void (*presets) (void);
+
+/*
+ * Read the files with the cache off and then on, starting from an
+ * empty table each time; print whether the image was reused and
+ * whether the two tables match.
+ */
+static void check_read (const char *msg, int nfiles, const char **files,
+			const char *prefix)
+{
+  char *ref, *res, *before, *after;
+
+  config_set_cache (NULL);
+  config_clear ();
+  if (presets) {
+    (*presets) ();
+  }
+  if (prefix) {
+    config_push_prefix (prefix);
+  }
+  for (int i=0; i < nfiles; i++) {
+    config_read (files[i]);
+  }
+  if (prefix) {
+    config_pop_prefix ();
+  }
+  ref = dump ();
+
+  config_set_cache (cachedir);
+  config_clear ();
+  if (presets) {
+    (*presets) ();
+  }
+  if (prefix) {
+    config_push_prefix (prefix);
+  }
+  before = snapshot ();
+  for (int i=0; i < nfiles; i++) {
+    config_read (files[i]);
+  }
+  after = snapshot ();
+  if (prefix) {
+    config_pop_prefix ();
+  }
+  res = dump ();
+
+  printf ("%s: %s, %s\n", msg, strcmp (before, after) == 0 ? "hit" : "miss",
+	  strcmp (ref, res) == 0 ? "same" : "DIFFERENT");
+  if (strcmp (ref, res) != 0) {
+    printf ("--- expected\n%s--- got\n%s", ref, res);
+  }
+  free (ref);
+  free (res);
+  free (before);
+  free (after);
+}
+
+static void show (const char *var)
+{
+  int i, n;
+
+  switch (config_gettype (var)) {
+  case 0:
+    printf ("  %s = %d\n", var, config_get_int (var));
+    break;
+  case 1:
+    printf ("  %s = \"%s\"\n", var, config_get_string (var));
+    break;
+  case 2:
+    printf ("  %s = %g\n", var, config_get_real (var));
+    break;
+  case 3:
+    n = config_get_table_size (var);
+    printf ("  %s =", var);
+    for (i=0; i < n; i++) {
+      printf (" %d", config_get_table_int (var)[i]);
+    }
+    printf ("\n");
+    break;
+  case 4:
+    n = config_get_table_size (var);
+    printf ("  %s =", var);
+    for (i=0; i < n; i++) {
+      printf (" \"%s\"", config_get_table_string (var)[i]);
+    }
+    printf ("\n");
+    break;
+  case 5:
+    n = config_get_table_size (var);
+    printf ("  %s =", var);
+    for (i=0; i < n; i++) {
+      printf (" %g", config_get_table_real (var)[i]);
+    }
+    printf ("\n");
+    break;
+  default:
+    printf ("  %s missing\n", var);
+    break;
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Small files
+ *
+ *------------------------------------------------------------------------
+ */
+static const char top_conf[] =
+  "include \"inc.conf\"\n"
+  "begin sim\n"
+  "  int steps 10\n"
+  "  real scale 2.5\n"
+  "  string name \"run-${CONFIG_TEST_NAME}\"\n"
+  "  int_table widths 1 2 4\n"
+  "  int_tablex extra 7 8\n"
+  "  string_tablex tags \"c\" \"d\"\n"
+  "end\n";
+
+static const char inc_conf[] =
+  "begin sim\n"
+  "  int steps 5\n"
+  "  int_table extra 1 2\n"
+  "  string_table tags \"a\" \"b\"\n"
+  "  real_table delays 0.5 1.5\n"
+  "end\n";
+
+static const char inc2_conf[] =
+  "begin sim\n"
+  "  int steps 5\n"
+  "  int_table extra 1 2\n"
+  "  string_table tags \"a\" \"b\"\n"
+  "  real_table delays 0.5 2.5\n"
+  "end\n";
+
+static void set_values (void)
+{
+  config_set_int ("sim.steps", 42);
+  config_set_string ("sim.name", "fixed");
+  config_set_default_real ("sim.scale", 1.0);
+}
+
+static void test_files (void)
+{
+  const char *top = "top.conf";
+  const char *vars[] = { "sim.steps", "sim.scale", "sim.name", "sim.widths",
+			 "sim.extra", "sim.tags", "sim.delays" };
+  char *s;
+  FILE *fp;
+
+  write_file ("top.conf", top_conf);
+  write_file ("inc.conf", inc_conf);
+  setenv ("CONFIG_TEST_NAME", "one", 1);
+
+  check_read ("cold", 1, &top, NULL);
+  check_read ("warm", 1, &top, NULL);
+  printf ("images: %d\n", nimages ());
+  for (unsigned int i=0; i < sizeof (vars)/sizeof (vars[0]); i++) {
+    show (vars[i]);
+  }
+
+  /* values set by the program are not replaced by the file */
+  presets = set_values;
+  check_read ("set before read", 1, &top, NULL);
+  show ("sim.steps");
+  show ("sim.name");
+  show ("sim.scale");
+  presets = NULL;
+
+  /* a different prefix is a different image */
+  check_read ("prefix cold", 1, &top, "blk");
+  check_read ("prefix warm", 1, &top, "blk");
+  show ("blk.sim.steps");
+  printf ("images: %d\n", nimages ());
+
+  /* environment variables used by string values */
+  setenv ("CONFIG_TEST_NAME", "two", 1);
+  check_read ("env changed", 1, &top, NULL);
+  check_read ("env warm", 1, &top, NULL);
+  show ("sim.name");
+
+  /* same contents with a new time stamp */
+  s = scratch_file ("inc.conf");
+  utime (s, NULL);
+  check_read ("touched", 1, &top, NULL);
+
+  /* same size and inode, new contents; the time stamp may not change */
+  fp = fopen (s, "r+");
+  fputs (inc2_conf, fp);
+  fclose (fp);
+  FREE (s);
+  check_read ("included file edited", 1, &top, NULL);
+  check_read ("edited warm", 1, &top, NULL);
+  show ("sim.delays");
+
+  write_file ("top.conf", "int extra 1\n");
+  check_read ("top file edited", 1, &top, NULL);
+  show ("extra");
+  show ("sim.steps");
+
+  /* damaged images are ignored and written again */
+  s = snapshot ();
+  for (char *t = strtok (s, "\n"); t; t = strtok (NULL, "\n")) {
+    char buf[1024];
+    *strchr (t, ':') = '\0';
+    snprintf (buf, 1024, "%s/%s", cachedir, t);
+    fp = fopen (buf, "r+");
+    fseek (fp, -2, SEEK_END);
+    fputc ('#', fp);
+    fclose (fp);
+  }
+  free (s);
+  check_read ("prefix after damage", 1, &top, "blk");
+  check_read ("unprefixed after damage", 1, &top, NULL);
+  printf ("images: %d\n", nimages ());
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Technology files
+ *
+ *------------------------------------------------------------------------
+ */
+static void test_tech (void)
+{
+  const char *files[] = { "global.conf", "prs2net.conf" };
+  const int n = sizeof (files)/sizeof (files[0]);
+
+  config_stdtech_path ("generic");
+  check_read ("global cold", 1, files, NULL);
+  check_read ("global warm", 1, files, NULL);
+  check_read ("all cold", n, files, NULL);
+  check_read ("all warm", n, files, NULL);
+  printf ("images: %d\n", nimages ());
+}
+
+
+static void cleanup (void)
+{
+  struct dirent *d;
+  char buf[1024];
+  DIR *dir;
+
+  dir = opendir (cachedir);
+  if (dir) {
+    while ((d = readdir (dir))) {
+      if (d->d_name[0] != '.') {
+	snprintf (buf, 1024, "%s/%s", cachedir, d->d_name);
+	unlink (buf);
+      }
+    }
+    closedir (dir);
+  }
+  rmdir (cachedir);
+  dir = opendir (scratch);
+  if (dir) {
+    while ((d = readdir (dir))) {
+      if (d->d_name[0] != '.') {
+	snprintf (buf, 1024, "%s/%s", scratch, d->d_name);
+	unlink (buf);
+      }
+    }
+    closedir (dir);
+  }
+  rmdir (scratch);
+}
+
+int main (int argc, char **argv)
+{
+  char tmpl[] = "/tmp/cfgtestXXXXXX";
+
+  if (argc != 2) {
+    usage (argv[0]);
+  }
+  scratch = mkdtemp (tmpl);
+  if (!scratch) {
+    fatal_error ("Could not create a scratch directory");
+  }
+  cachedir = scratch_file ("cache");
+  mkdir (cachedir, 0755);
+
+  if (strcmp (argv[1], "files") == 0) {
+    config_append_path (scratch);
+    test_files ();
+  }
+  else if (strcmp (argv[1], "tech") == 0) {
+    test_tech ();
+  }
+  else {
+    cleanup ();
+    usage (argv[0]);
+  }
+  cleanup ();
+  FREE (cachedir);
+  return 0;
+}
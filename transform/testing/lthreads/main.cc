@@ -0,0 +1,352 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <common/thread.h>
+#include <common/mutex.h>
+#include <common/count.h>
+#include <common/mytime.h>
+
+/*
+ *  Tests for the lightweight thread library: contexts, the M:N
+ *  scheduler, mutexes, condition variables, counters and timers.
+ *  simulate() does not return, so each run executes one test and
+ *  prints the results from the cleanup function.
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s <test> <workers>\n", name);
+  fprintf (stderr, "  sync  : mutexes, condition variables, counters, pause\n");
+  fprintf (stderr, "  bench : context switch and mutex handoff rates\n");
+  exit (1);
+}
+
+static int new_id (int *next)
+{
+  return __atomic_fetch_add (next, 1, __ATOMIC_RELAXED);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Synchronization
+ *
+ *------------------------------------------------------------------------
+ */
+#define NTHREADS  12
+#define NITER     200
+#define NPROD     4
+#define NCONS     3
+#define NITEMS    300		/* per producer */
+#define BUFSZ     5
+#define NADD      6		/* counter increments */
+#define NWAIT     5		/* counter waiters */
+#define NSLEEP    6		/* threads that pause */
+#define NPAUSE    20		/* pauses per thread */
+
+static mutex_t *m;
+static int counter;
+static int inside;
+static int overlap;
+
+/* threads take turns updating the counter; yielding in the middle
+   gives others a chance to run while the mutex is held */
+static void mutex_body (void)
+{
+  int v;
+
+  for (int i=0; i < NITER; i++) {
+    mutex_lock (m);
+    if (inside) {
+      overlap++;
+    }
+    inside = 1;
+    v = counter;
+    if (i % 3 == 0) {
+      thread_idle ();
+    }
+    counter = v + 1;
+    inside = 0;
+    mutex_unlock (m);
+  }
+}
+
+/* bounded buffer. cond_signal() hands the mutex to the thread it
+   wakes up, or releases it */
+static mutex_t *bm;
+static cond_t *nonempty, *nonfull;
+static int buf[BUFSZ];
+static int nbuf, bhead;
+static long produced, consumed;
+static int nconsumed;
+static int prod_id;
+
+static void producer_body (void)
+{
+  int id = new_id (&prod_id);
+
+  for (int i=1; i <= NITEMS; i++) {
+    int v = id * 1000 + i;
+
+    mutex_lock (bm);
+    while (nbuf == BUFSZ) {
+      cond_wait (nonfull);
+    }
+    buf[(bhead + nbuf) % BUFSZ] = v;
+    nbuf++;
+    produced += v;
+    cond_signal (nonempty);
+  }
+}
+
+static void consumer_body (void)
+{
+  int v;
+
+  for (int i=0; i < NPROD*NITEMS/NCONS; i++) {
+    mutex_lock (bm);
+    while (nbuf == 0) {
+      cond_wait (nonempty);
+    }
+    v = buf[bhead];
+    bhead = (bhead + 1) % BUFSZ;
+    nbuf--;
+    consumed += v;
+    nconsumed++;
+    cond_signal (nonfull);
+  }
+}
+
+/* turns are handed out in reverse order of start, and the threads
+   must go in order of their turn */
+static countw_t *turn;
+static int order[NTHREADS];
+static int norder;
+static int count_id;
+
+static void count_body (void)
+{
+  int id = NTHREADS - 1 - new_id (&count_id);
+
+  count_await (turn, id);
+  order[norder++] = id;
+  count_increment (turn, 1);
+}
+
+/* adders bump the counter by different amounts while waiters block on
+   increasing targets; "added" is updated before each increment, so
+   a waiter that wakes up must see at least its target */
+static countw_t *total;
+static unsigned int added;
+static int nwoken, nearly;
+static int wait_id;
+
+static void add_body (void)
+{
+  for (int i=0; i < NITER; i++) {
+    unsigned int amt = 1 + i % 3;
+    __atomic_add_fetch (&added, amt, __ATOMIC_ACQ_REL);
+    count_increment (total, amt);
+    if (i % 5 == 0) {
+      thread_idle ();
+    }
+  }
+}
+
+static void wait_body (void)
+{
+  int id = new_id (&wait_id);
+  unsigned int target = (id + 1) * (NADD * NITER / NWAIT);
+
+  count_await (total, target);
+  if (__atomic_load_n (&added, __ATOMIC_ACQUIRE) < target) {
+    __atomic_add_fetch (&nearly, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_add_fetch (&nwoken, 1, __ATOMIC_RELAXED);
+}
+
+/* threads pause for different delays. A paused thread only wakes up
+   once some thread has run past its wakeup time, so the clock thread
+   keeps advancing its own time until every sleeper is done */
+static Time_t clock_now;
+static int nsleep_done, nwakeups, npause_early, npause_time;
+static int sleep_id;
+
+static void clock_body (void)
+{
+  while (__atomic_load_n (&nsleep_done, __ATOMIC_ACQUIRE) < NSLEEP) {
+    Delay (7);
+    __atomic_store_n (&clock_now, CurrentTime (), __ATOMIC_RELEASE);
+    thread_idle ();
+  }
+}
+
+static void sleep_body (void)
+{
+  int id = new_id (&sleep_id);
+  Time_t t;
+  int d;
+
+  for (int i=0; i < NPAUSE; i++) {
+    t = CurrentTime ();
+    d = 10 + (id * 13 + i * 29) % 90;
+    thread_pause (d);
+    if (CurrentTime () != t + d) {
+      __atomic_add_fetch (&npause_time, 1, __ATOMIC_RELAXED);
+    }
+    if (__atomic_load_n (&clock_now, __ATOMIC_ACQUIRE) < CurrentTime ()) {
+      __atomic_add_fetch (&npause_early, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch (&nwakeups, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_add_fetch (&nsleep_done, 1, __ATOMIC_RELEASE);
+}
+
+static void sync_done (void)
+{
+  printf ("mutex: counter %d (expected %d), overlaps %d\n", counter,
+	  NTHREADS * NITER, overlap);
+  printf ("cond: %d items, produced %ld, consumed %ld, left %d\n",
+	  nconsumed, produced, consumed, nbuf);
+  printf ("count:");
+  for (int i=0; i < norder; i++) {
+    printf (" %d", order[i]);
+  }
+  printf ("\n");
+  printf ("countw: total %u (expected %u), %d waiters woke up, %d early\n",
+	  total->cnt, added, nwoken, nearly);
+  printf ("pause: %d wakeups (expected %d), %d early, %d wrong times\n",
+	  nwakeups, NSLEEP * NPAUSE, npause_early, npause_time);
+}
+
+static void test_sync (void)
+{
+  m = mutex_new ();
+  for (int i=0; i < NTHREADS; i++) {
+    thread_new (mutex_body, 0);
+  }
+
+  bm = mutex_new ();
+  nonempty = cond_new (bm);
+  nonfull = cond_new (bm);
+  for (int i=0; i < NCONS; i++) {
+    thread_new (consumer_body, 0);
+  }
+  for (int i=0; i < NPROD; i++) {
+    thread_new (producer_body, 0);
+  }
+
+  total = count_new (0);
+  for (int i=0; i < NWAIT; i++) {
+    thread_new (wait_body, 0);
+  }
+  for (int i=0; i < NADD; i++) {
+    thread_new (add_body, 0);
+  }
+
+  for (int i=0; i < NSLEEP; i++) {
+    thread_new (sleep_body, 0);
+  }
+  thread_new (clock_body, 0);
+
+  simulate (sync_done);
+}
+
+static void test_count (void)
+{
+  turn = count_new (0);
+  for (int i=0; i < NTHREADS; i++) {
+    thread_new (count_body, 0);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Microbenchmark
+ *
+ *------------------------------------------------------------------------
+ */
+#define NSWITCH 200000
+#define NHANDOFF 100000
+
+static void idle_body (void)
+{
+  for (int i=0; i < NSWITCH; i++) {
+    thread_idle ();
+  }
+}
+
+static void handoff_body (void)
+{
+  for (int i=0; i < NHANDOFF; i++) {
+    mutex_lock (m);
+    thread_idle ();
+    mutex_unlock (m);
+  }
+}
+
+static void bench_done (void)
+{
+  double t = realtime_msec ()/1000.0;
+
+  printf ("workers %d: %.3f s, %.0f yields/s, %.0f handoffs/s\n",
+	  thread_num_workers (), t, (4.0*NSWITCH + 4.0*NHANDOFF)/t,
+	  4.0*NHANDOFF/t);
+}
+
+static void test_bench (void)
+{
+  m = mutex_new ();
+  for (int i=0; i < 4; i++) {
+    thread_new (idle_body, 0);
+  }
+  for (int i=0; i < 4; i++) {
+    thread_new (handoff_body, 0);
+  }
+  realtime_msec ();
+  simulate (bench_done);
+}
+
+
+int main (int argc, char **argv)
+{
+  if (argc != 3) {
+    usage (argv[0]);
+  }
+  thread_set_workers (atoi (argv[2]));
+  if (strcmp (argv[1], "sync") == 0) {
+    test_count ();
+    test_sync ();
+  }
+  else if (strcmp (argv[1], "bench") == 0) {
+    test_bench ();
+  }
+  else {
+    usage (argv[0]);
+  }
+  return 0;
+}
@@ -0,0 +1,906 @@
+/*************************************************************************
+ *
+ *  This file is part of the ACT library
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <common/simdes.h>
+#include <common/mytime.h>
+
+/*
+ *  Tests for the discrete-event simulation kernel. Each test prints a
+ *  trace that is compared against a saved one.
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s <test>\n", name);
+  fprintf (stderr, "  order  : event ordering across the timing wheel\n");
+  fprintf (stderr, "  cancel : revoking pending events\n");
+  fprintf (stderr, "  ckfork : fork-based snapshots\n");
+  fprintf (stderr, "  ckpt   : checkpoint files, incremental chains, bad restores\n");
+  fprintf (stderr, "  ckbench <objects> : checkpoint size and time\n");
+  fprintf (stderr, "  par <threads> : partitioned simulation\n");
+  fprintf (stderr, "  scale <parts> <nodes> <maxthreads> : time the partitioned simulation\n");
+  exit (1);
+}
+
+/*
+ * An object that wakes up every "period" time units
+ */
+class Ticker : public SimDES {
+public:
+  Ticker (int _period, SimEngine *e = NULL) : SimDES (e) {
+    period = _period;
+    count = 0;
+    new Event (this, 0, period);
+  }
+  int Step (Event *ev) {
+    count++;
+    Pause (period);
+    return 1;
+  }
+  int count;
+private:
+  int period;
+};
+
+
+/*
+ * An object that prints every event it executes
+ */
+class Recorder : public SimDES {
+public:
+  Recorder (const char *_nm, SimEngine *e = NULL) : SimDES (e) {
+    nm = _nm;
+    chain = -1;
+  }
+  int Step (Event *ev) {
+    printf ("  %lu: %s.%d\n", SimDES::CurTimeLo (), nm, ev->getType ());
+    if (chain >= 0) {
+      /* a zero-delay event runs after the ones already queued */
+      new Event (this, chain, 0);
+      chain = -1;
+    }
+    return 1;
+  }
+  int chain;
+private:
+  const char *nm;
+};
+
+/*
+ * An object that revokes another object's event when it runs
+ */
+class Canceller : public SimDES {
+public:
+  Canceller () { victim = NULL; }
+  int Step (Event *ev) {
+    printf ("  %lu: cancel.%d\n", SimDES::CurTimeLo (), ev->getType ());
+    if (victim) {
+      victim->Remove ();
+      victim = NULL;
+    }
+    /* revoking the event being executed has no effect */
+    ev->Remove ();
+    return 1;
+  }
+  Event *victim;
+};
+
+/*
+ * An object that checks that events arrive in time order
+ */
+class Checker : public SimDES {
+public:
+  Checker () {
+    last = 0;
+    n = 0;
+    bad = 0;
+    sum = 0;
+  }
+  int Step (Event *ev) {
+    unsigned long tm = SimDES::CurTimeLo ();
+    if (tm < last) {
+      bad++;
+    }
+    if (tm != (unsigned long)ev->getCause ()) {
+      bad++;
+    }
+    last = tm;
+    n++;
+    sum = sum*31 + tm;
+    return 1;
+  }
+  unsigned long last;
+  int n, bad;
+  unsigned long sum;
+};
+
+static unsigned long _rand_state = 1;
+
+static unsigned long _rand (void)
+{
+  _rand_state = _rand_state * 6364136223846793005UL + 1442695040888963407UL;
+  return _rand_state >> 33;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Event ordering
+ *
+ *------------------------------------------------------------------------
+ */
+static void test_order (void)
+{
+  Recorder *a, *b, *c;
+  Checker *k;
+  int delays[] = { 0, 1, 255, 256, 257, 511, 65535, 65536, 65537,
+		   1000000, 16777216, 1073741824 };
+  int nd = sizeof (delays)/sizeof (delays[0]);
+
+  SimDES::Init ();
+  a = new Recorder ("a");
+  b = new Recorder ("b");
+  c = new Recorder ("c");
+
+  printf ("same time, in creation order:\n");
+  new Event (b, 1, 5);
+  new Event (a, 2, 5);
+  new Event (c, 3, 5);
+  new Event (a, 4, 5);
+  new Event (c, 5, 3);
+  a->chain = 6;
+  SimDES::Run ();
+
+  printf ("across the wheel levels and the far heap:\n");
+  for (int i=nd-1; i >= 0; i--) {
+    new Event (a, i, delays[i]);
+  }
+  SimDES::Run ();
+
+  printf ("after a long gap:\n");
+  new Event (b, 1, 300);
+  new Event (b, 2, 70000);
+  new Event (b, 3, 256);
+  new Event (b, 4, 2);
+  printf ("  pending %d\n", SimEngine::Current()->numPending ());
+  SimDES::AdvanceTime (256);
+  printf ("  stopped at %lu, pending %d\n", SimDES::CurTimeLo (),
+	  SimEngine::Current()->numPending ());
+  SimDES::Run ();
+
+  /* random delays, with a new batch scheduled part way through */
+  k = new Checker ();
+  for (int round=0; round < 4; round++) {
+    unsigned long now = SimDES::CurTimeLo ();
+    for (int i=0; i < 5000; i++) {
+      int d;
+      switch (_rand () % 4) {
+      case 0: d = _rand () % 256; break;
+      case 1: d = _rand () % 65536; break;
+      case 2: d = _rand () % (1 << 24); break;
+      default: d = _rand () % (1 << 30); break;
+      }
+      new Event (k, 0, d, (void *)(long)(now + d));
+    }
+    SimDES::Advance (2000);
+  }
+  SimDES::Run ();
+  printf ("random: %d events, %d out of order, end %lu, sum %lx\n",
+	  k->n, k->bad, SimDES::CurTimeLo (), k->sum);
+  printf ("pending %d, executed %lu\n", SimEngine::Current()->numPending (),
+	  SimEngine::Current()->numEvents ());
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Revoking events
+ *
+ *------------------------------------------------------------------------
+ */
+static void _show_pending (const char *msg)
+{
+  SimEngine *e = SimEngine::Current ();
+  printf ("%s: pending %d, dead %d, revoked %lu\n", msg,
+	  e->numPending (), e->numDead (), e->numRevoked ());
+}
+
+static void _show_find (const char *msg, Event *ev)
+{
+  if (ev) {
+    printf ("  %s: %s.%d\n", msg, ev->getObj ()->Name (), ev->getType ());
+  }
+  else {
+    printf ("  %s: none\n", msg);
+  }
+}
+
+class Named : public Recorder {
+public:
+  Named (const char *nm) : Recorder (nm) { name = nm; }
+  const char *Name () { return name; }
+private:
+  const char *name;
+};
+
+static void test_cancel (void)
+{
+  SimEngine *e;
+  Named *x, *y;
+  Canceller *k;
+  Event *e0, *e1, *e2, *e3;
+
+  SimDES::Init ();
+  e = SimEngine::Current ();
+  e->indexType (3);
+
+  x = new Named ("x");
+  y = new Named ("y");
+  k = new Canceller ();
+
+  /* one event at each level of the queue, and a second far one */
+  e0 = new Event (x, 1, 10);
+  e1 = new Event (x, 2, 1000);
+  e2 = new Event (x, 3, 100000);
+  e3 = new Event (y, 3, 200000);
+  new Event (y, 4, 20);
+  _show_pending ("scheduled");
+
+  _show_find ("x", x->firstPending ());
+  _show_find ("x, type 2", x->firstPending (2));
+  _show_find ("y, type 2", y->firstPending (2));
+  _show_find ("type 3 (indexed)", e->findPending (NULL, 3));
+  _show_find ("type 4", e->findPending (NULL, 4));
+
+  /* wheel events are freed now; far-future ones when they reach the
+     head of the heap */
+  e0->Remove ();
+  e1->Remove ();
+  e2->Remove ();
+  _show_pending ("revoked three");
+  _show_find ("x", x->firstPending ());
+  _show_find ("type 3 (indexed)", e->findPending (NULL, 3));
+
+  e3->Remove ();
+  _show_pending ("revoked all far events");
+  SimDES::Run ();
+  _show_pending ("after run");
+
+  printf ("revoke an event at the same time, from a Step():\n");
+  new Event (k, 1, 5);
+  k->victim = new Event (x, 5, 5);
+  new Event (y, 6, 5);
+  SimDES::Run ();
+  _show_pending ("after run");
+
+  printf ("revoke, then schedule more:\n");
+  e0 = new Event (x, 7, 300000);
+  new Event (y, 8, 300000);
+  e0->Remove ();
+  new Event (x, 9, 300001);
+  SimDES::Run ();
+  _show_pending ("after run");
+
+  /* deleting an object revokes its events; the queue must not refer
+     back to it afterwards */
+  printf ("delete an object with pending events:\n");
+  x = new Named ("z");
+  new Event (x, 10, 10);
+  new Event (x, 11, 1000);
+  new Event (x, 12, 100000);
+  new Event (y, 13, 30);
+  delete x;
+  _show_pending ("deleted");
+  SimDES::Run ();
+  _show_pending ("after run");
+  x = new Named ("w");
+  new Event (x, 14, 10);
+  new Event (x, 15, 100000);
+  delete x;
+  SimDES::Init ();
+  _show_pending ("after init");
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Fork-based snapshots
+ *
+ *------------------------------------------------------------------------
+ */
+static void test_ckfork (void)
+{
+  pid_t a, b, c;
+  int status;
+  Ticker *t;
+
+  /* a hung waitpid() is a failure */
+  alarm (30);
+
+  SimDES::Init ();
+  t = new Ticker (1);
+
+  SimDES::AdvanceTime (10);
+  a = SimEngine::forkCheckpoint ();
+  if (a == 0) {
+    printf ("snapshot a: resumed, should have been dropped\n");
+    exit (1);
+  }
+  SimDES::AdvanceTime (10);
+  b = SimEngine::forkCheckpoint ();
+  if (b == 0) {
+    printf ("snapshot b: resumed, should have been dropped\n");
+    exit (1);
+  }
+  SimDES::AdvanceTime (10);
+  c = SimEngine::forkCheckpoint ();
+  if (c == 0) {
+    /* the snapshot has the state at the time it was taken */
+    printf ("snapshot c: resumed at time %lu, count %d\n",
+	    SimDES::CurTimeLo (), t->count);
+    SimDES::AdvanceTime (5);
+    printf ("snapshot c: time %lu, count %d\n",
+	    SimDES::CurTimeLo (), t->count);
+    exit (0);
+  }
+  if (a < 0 || b < 0 || c < 0) {
+    printf ("fork failed\n");
+    exit (1);
+  }
+  SimDES::AdvanceTime (10);
+  printf ("main: time %lu, count %d\n", SimDES::CurTimeLo (), t->count);
+
+  /* b was forked while a was suspended; dropping the older one must
+     not wait on b */
+  SimEngine::dropCheckpoint (a);
+  printf ("dropped a: %s\n", kill (a, 0) == 0 ? "still running" : "gone");
+
+  fflush (stdout);
+  if (SimEngine::resumeCheckpoint (c) != 0) {
+    printf ("resume c failed\n");
+  }
+  waitpid (c, &status, 0);
+  printf ("c exited: %d\n", WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+
+  SimEngine::dropCheckpoint (b);
+  printf ("dropped b: %s\n", kill (b, 0) == 0 ? "still running" : "gone");
+
+  /* unknown snapshots are ignored */
+  SimEngine::dropCheckpoint (b);
+  printf ("resume b: %d\n", SimEngine::resumeCheckpoint (b));
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoint files
+ *
+ *------------------------------------------------------------------------
+ */
+
+/*
+ * A walker updates its state on every event and picks the type and
+ * delay of its next event from it; delays reach both levels of the
+ * wheel and the far heap. Every event executed is folded into the
+ * trace digest of the model.
+ */
+class Walker : public SimDES {
+public:
+  Walker (SimEngine *e, int _id, unsigned long *_trace) : SimDES (e) {
+    id = _id;
+    trace = _trace;
+    state = 0x9e3779b97f4a7c15UL * (id + 1);
+    n = 0;
+    new Event (this, 0, 1 + id % 7);
+  }
+  int Step (Event *ev) {
+    unsigned long tm = Engine()->CurTimeLo ();
+    unsigned long r;
+
+    *trace = (*trace ^ (tm * 1000 + id * 8 + ev->getType ())) *
+      0x100000001b3UL;
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    n++;
+    r = state >> 33;
+    if (r % 50 == 0) {
+      new Event (this, 3, 70000 + r % 1000);
+    }
+    else if (id % 2) {
+      new Event (this, r % 3, 1 + r % 600);
+    }
+    else {
+      /* mostly idle, so incremental checkpoints can skip it */
+      new Event (this, r % 3, 1 + r % 8000);
+    }
+    return 1;
+  }
+  void SaveState (FILE *fp) {
+    fwrite (&state, sizeof (state), 1, fp);
+    fwrite (&n, sizeof (n), 1, fp);
+  }
+  void RestoreState (FILE *fp) {
+    if (fread (&state, sizeof (state), 1, fp) != 1 ||
+	fread (&n, sizeof (n), 1, fp) != 1) {
+      printf ("walker %d: short state\n", id);
+    }
+  }
+  int id;
+  unsigned long state;
+  unsigned long n;
+private:
+  unsigned long *trace;
+};
+
+struct ck_model {
+  SimEngine *e;
+  Walker **w;
+  int nw;
+  unsigned long trace;
+};
+
+static void ck_build (struct ck_model *m, int nw)
+{
+  m->e = new SimEngine ();
+  m->nw = nw;
+  m->trace = 0;
+  MALLOC (m->w, Walker *, nw);
+  for (int i=0; i < nw; i++) {
+    m->w[i] = new Walker (m->e, i, &m->trace);
+  }
+}
+
+static void ck_free (struct ck_model *m)
+{
+  for (int i=0; i < m->nw; i++) {
+    delete m->w[i];
+  }
+  FREE (m->w);
+  delete m->e;
+}
+
+/* digest of the time, the queue and every walker */
+static unsigned long ck_digest (struct ck_model *m)
+{
+  unsigned long h = m->e->CurTimeLo ();
+
+  h = h * 31 + m->e->numPending ();
+  h = h * 31 + m->e->numEvents ();
+  for (int i=0; i < m->nw; i++) {
+    h = h * 31 + m->w[i]->state;
+    h = h * 31 + m->w[i]->n;
+  }
+  return h;
+}
+
+static char *ck_dir;
+
+static char *ck_file (const char *name)
+{
+  char *s;
+  int len = strlen (ck_dir) + strlen (name) + 2;
+
+  MALLOC (s, char, len);
+  snprintf (s, len, "%s/%s", ck_dir, name);
+  return s;
+}
+
+/* a restore that is expected to fail; its warning is not shown */
+static int ck_quiet_restore (SimEngine *e, const char *file)
+{
+  int fd, err, ret;
+
+  fflush (stderr);
+  fd = dup (2);
+  err = open ("/dev/null", O_WRONLY);
+  dup2 (err, 2);
+  close (err);
+  ret = e->Restore (file);
+  fflush (stderr);
+  dup2 (fd, 2);
+  close (fd);
+  return ret;
+}
+
+static long ck_size (const char *file)
+{
+  struct stat st;
+  return stat (file, &st) == 0 ? (long)st.st_size : -1;
+}
+
+#define CK_WALKERS 40
+
+static void test_ckpt (void)
+{
+  struct ck_model a, b;
+  unsigned long d_after[4], t_after[4], d;
+  char *f[3], *bad;
+  char tmpl[] = "/tmp/simckXXXXXX";
+  FILE *in, *out;
+  long sz;
+  int c;
+
+  ck_dir = mkdtemp (tmpl);
+  if (!ck_dir) {
+    printf ("could not create a scratch directory\n");
+    return;
+  }
+  f[0] = ck_file ("ck.0");
+  f[1] = ck_file ("ck.1");
+  f[2] = ck_file ("ck.2");
+  bad = ck_file ("bad");
+
+  /* reference run: checkpoint at 1000 (full), 2000 and 3000
+     (incremental), and record the trace of each stretch after that */
+  ck_build (&a, CK_WALKERS);
+  a.e->AdvanceTime (1000);
+  for (int k=0; k < 3; k++) {
+    if (a.e->Checkpoint (f[k], k > 0) != 0) {
+      printf ("checkpoint %d failed\n", k);
+    }
+    a.trace = 0;
+    a.e->AdvanceTime (1000);
+    t_after[k] = a.trace;
+    d_after[k] = ck_digest (&a);
+  }
+  printf ("reference: time %lu, events %lu\n", a.e->CurTimeLo (),
+	  a.e->numEvents ());
+  printf ("incremental smaller than full: %s\n",
+	  ck_size (f[1]) < ck_size (f[0]) ? "yes" : "no");
+  ck_free (&a);
+
+  /* restore each prefix of the chain into a new model, and run the
+     next stretch */
+  for (int k=0; k < 3; k++) {
+    ck_build (&b, CK_WALKERS);
+    for (int j=0; j <= k; j++) {
+      if (b.e->Restore (f[j]) != 0) {
+	printf ("restore %d failed\n", j);
+      }
+    }
+    b.e->AdvanceTime (1000);
+    printf ("restore ck.0..ck.%d: time %lu, trace %s, state %s\n", k,
+	    b.e->CurTimeLo (), b.trace == t_after[k] ? "same" : "DIFFERENT",
+	    ck_digest (&b) == d_after[k] ? "same" : "DIFFERENT");
+    ck_free (&b);
+  }
+
+  /* run after a restore for the rest of the reference run */
+  ck_build (&b, CK_WALKERS);
+  b.e->Restore (f[0]);
+  for (int k=0; k < 3; k++) {
+    b.e->AdvanceTime (1000);
+  }
+  printf ("restore ck.0, run to the end: state %s\n",
+	  ck_digest (&b) == d_after[2] ? "same" : "DIFFERENT");
+  ck_free (&b);
+
+  /* bad restores must leave the running simulation alone */
+  ck_build (&b, CK_WALKERS + 1);
+  b.e->AdvanceTime (500);
+  d = ck_digest (&b);
+  printf ("different object set: %d, unchanged %s\n",
+	  ck_quiet_restore (b.e, f[0]), ck_digest (&b) == d ? "yes" : "no");
+  ck_free (&b);
+
+  ck_build (&b, CK_WALKERS);
+  b.e->AdvanceTime (500);
+  d = ck_digest (&b);
+  printf ("incremental out of order: %d, unchanged %s\n",
+	  ck_quiet_restore (b.e, f[1]), ck_digest (&b) == d ? "yes" : "no");
+
+  /* truncated in the object section */
+  sz = ck_size (f[0]);
+  in = fopen (f[0], "rb");
+  out = fopen (bad, "wb");
+  for (long i=0; i < sz - 12 && (c = fgetc (in)) != EOF; i++) {
+    fputc (c, out);
+  }
+  fclose (in);
+  fclose (out);
+  printf ("truncated: %d, unchanged %s\n",
+	  ck_quiet_restore (b.e, bad), ck_digest (&b) == d ? "yes" : "no");
+
+  /* trailing junk */
+  in = fopen (f[0], "rb");
+  out = fopen (bad, "wb");
+  while ((c = fgetc (in)) != EOF) {
+    fputc (c, out);
+  }
+  fputc (0, out);
+  fclose (in);
+  fclose (out);
+  printf ("trailing junk: %d, unchanged %s\n",
+	  ck_quiet_restore (b.e, bad), ck_digest (&b) == d ? "yes" : "no");
+
+  /* the same engine still restores a good checkpoint */
+  b.trace = 0;
+  printf ("then a good one: %d\n", b.e->Restore (f[0]));
+  b.e->AdvanceTime (1000);
+  printf ("  trace %s, state %s\n", b.trace == t_after[0] ? "same" : "DIFFERENT",
+	  ck_digest (&b) == d_after[0] ? "same" : "DIFFERENT");
+  ck_free (&b);
+
+  for (int k=0; k < 3; k++) {
+    unlink (f[k]);
+    FREE (f[k]);
+  }
+  unlink (bad);
+  FREE (bad);
+  rmdir (ck_dir);
+}
+
+/*
+ * Checkpoint size and time for a model with nobj walkers
+ */
+static void test_ckbench (int nobj)
+{
+  struct ck_model a, b;
+  char tmpl[] = "/tmp/simckXXXXXX";
+  char *full, *incr;
+  double tf, ti, tr, tri;
+
+  ck_dir = mkdtemp (tmpl);
+  if (!ck_dir) {
+    printf ("could not create a scratch directory\n");
+    return;
+  }
+  full = ck_file ("full");
+  incr = ck_file ("incr");
+
+  ck_build (&a, nobj);
+  a.e->AdvanceTime (2000);
+  realtime_msec ();
+  a.e->Checkpoint (full, 0);
+  tf = realtime_msec ();
+  /* a short stretch, so that only some objects have run */
+  a.e->AdvanceTime (5);
+  realtime_msec ();
+  a.e->Checkpoint (incr, 1);
+  ti = realtime_msec ();
+
+  ck_build (&b, nobj);
+  realtime_msec ();
+  b.e->Restore (full);
+  tr = realtime_msec ();
+  b.e->Restore (incr);
+  tri = realtime_msec ();
+
+  printf ("%d objects, %d pending events\n", nobj, a.e->numPending ());
+  printf ("%12s %10s %10s\n", "", "size (KB)", "time (ms)");
+  printf ("%12s %10.1f %10.2f\n", "full", ck_size (full)/1024.0, tf);
+  printf ("%12s %10.1f %10.2f\n", "incremental", ck_size (incr)/1024.0, ti);
+  printf ("%12s %10s %10.2f\n", "restore", "", tr);
+  printf ("%12s %10s %10.2f\n", "+ incr", "", tri);
+  printf ("restored state %s\n",
+	  ck_digest (&a) == ck_digest (&b) ? "same" : "DIFFERENT");
+
+  ck_free (&a);
+  ck_free (&b);
+  unlink (full);
+  unlink (incr);
+  FREE (full);
+  FREE (incr);
+  rmdir (ck_dir);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Partitioned simulation
+ *
+ *------------------------------------------------------------------------
+ */
+#define PAR_LOOKAHEAD 4
+
+/*
+ * Nodes pass tokens around. Each token is forwarded to a node picked
+ * from its value, which is often in another partition.
+ */
+class ParNode : public SimDES {
+public:
+  ParNode (SimEngine *e, int _id) : SimDES (e) {
+    id = _id;
+    h = 0;
+    n = 0;
+  }
+  int Step (Event *ev) {
+    unsigned long v = (unsigned long) ev->getCause ();
+    unsigned long tm = SimDES::CurTimeLo ();
+    ParNode *dst;
+    int d;
+
+    h = (h ^ (tm * 0x9e3779b97f4a7c15UL) ^ v) * 0x100000001b3UL;
+    n++;
+    if (tm < limit) {
+      dst = nodes[(id * 7 + v) % nnodes];
+      d = 1 + v % 5;
+      if (dst->Engine () != Engine ()) {
+	d += PAR_LOOKAHEAD;
+      }
+      new Event (dst, 0, d, (void *)((v * 31 + id + tm) & 0xffff));
+    }
+    return 1;
+  }
+  int id;
+  unsigned long h;
+  unsigned long n;
+
+  static ParNode **nodes;
+  static int nnodes;
+  static unsigned long limit;
+};
+
+ParNode **ParNode::nodes;
+int ParNode::nnodes;
+unsigned long ParNode::limit;
+
+struct par_result {
+  unsigned long h;
+  unsigned long n;
+  unsigned long end;
+};
+
+/*
+ * Build nparts partitions with nnodes nodes, run it with nthreads
+ * threads in deterministic mode, and collect a digest of every
+ * node's history.
+ */
+static void _par_run (int nparts, int nnodes, unsigned long limit,
+		      int nthreads, struct par_result *res, int verbose)
+{
+  SimParallel *p;
+  ParNode *x;
+
+  p = new SimParallel (nparts, PAR_LOOKAHEAD, 1);
+  ParNode::nnodes = nnodes;
+  ParNode::limit = limit;
+  MALLOC (ParNode::nodes, ParNode *, nnodes);
+  for (int i=0; i < nnodes; i++) {
+    ParNode::nodes[i] = new ParNode (p->Part (i % nparts), i);
+  }
+  /* a few tokens per node */
+  for (int i=0; i < nnodes; i++) {
+    SimEngine::setCurrent (ParNode::nodes[i]->Engine ());
+    for (int j=0; j < 3; j++) {
+      new Event (ParNode::nodes[i], 0, i % 3 + j, (void *)(long)(i*3 + j));
+    }
+  }
+  SimEngine::setCurrent (NULL);
+
+  if (p->Run (nthreads) != NULL) {
+    printf ("unexpected breakpoint\n");
+  }
+
+  res->h = 0;
+  res->n = 0;
+  res->end = 0;
+  for (int i=0; i < nparts; i++) {
+    unsigned long ph = 0, pn = 0;
+    for (int j=i; j < nnodes; j += nparts) {
+      x = ParNode::nodes[j];
+      ph = ph * 31 + x->h;
+      pn += x->n;
+    }
+    if (verbose) {
+      printf ("  part %d: events %lu, digest %016lx, time %lu\n", i, pn, ph,
+	      p->Part (i)->CurTimeLo ());
+    }
+    res->h = res->h * 31 + ph;
+    res->n += pn;
+    if (p->Part (i)->CurTimeLo () > res->end) {
+      res->end = p->Part (i)->CurTimeLo ();
+    }
+  }
+  if (verbose) {
+    printf ("  windows %lu\n", p->numWindows ());
+  }
+  for (int i=0; i < nnodes; i++) {
+    delete ParNode::nodes[i];
+  }
+  FREE (ParNode::nodes);
+  delete p;
+}
+
+/*
+ * The output must not depend on the number of threads
+ */
+static void test_par (int nthreads)
+{
+  struct par_result r;
+
+  printf ("8 partitions, 64 nodes:\n");
+  _par_run (8, 64, 2000, nthreads, &r, 1);
+  printf ("  total: events %lu, digest %016lx, end %lu\n", r.n, r.h, r.end);
+
+  printf ("5 partitions, 7 nodes:\n");
+  _par_run (5, 7, 5000, nthreads, &r, 1);
+  printf ("  total: events %lu, digest %016lx, end %lu\n", r.n, r.h, r.end);
+}
+
+/*
+ * Scaling: run the same model with 1, 2, 4, ... threads. Every run
+ * must give the same result as the single-threaded one.
+ */
+static void test_scale (int nparts, int nnodes, int maxthreads)
+{
+  struct par_result r1, r;
+  double t, t1 = 0;
+
+  printf ("%d partitions, %d nodes\n", nparts, nnodes);
+  printf ("%8s %6s %10s %12s %8s %6s\n", "threads", "used", "time (s)",
+	  "events/s", "speedup", "same");
+  for (int nt=1; nt <= maxthreads; nt *= 2) {
+    realtime_msec ();
+    _par_run (nparts, nnodes, 20000, nt, &r, 0);
+    t = realtime_msec ()/1000.0;
+    if (nt == 1) {
+      r1 = r;
+      t1 = t;
+    }
+    /* SimParallel uses at most one thread per partition */
+    printf ("%8d %6d %10.3f %12.0f %8.2f %6s\n", nt,
+	    nt < nparts ? nt : nparts, t, r.n/t, t1/t,
+	    (r.h == r1.h && r.n == r1.n && r.end == r1.end) ? "yes" : "NO");
+  }
+}
+
+
+int main (int argc, char **argv)
+{
+  if (argc < 2) {
+    usage (argv[0]);
+  }
+  if (strcmp (argv[1], "order") == 0) {
+    test_order ();
+  }
+  else if (strcmp (argv[1], "cancel") == 0) {
+    test_cancel ();
+  }
+  else if (strcmp (argv[1], "ckfork") == 0) {
+    test_ckfork ();
+  }
+  else if (strcmp (argv[1], "ckpt") == 0) {
+    test_ckpt ();
+  }
+  else if (strcmp (argv[1], "ckbench") == 0 && argc == 3) {
+    test_ckbench (atoi (argv[2]));
+  }
+  else if (strcmp (argv[1], "par") == 0 && argc == 3) {
+    test_par (atoi (argv[2]));
+  }
+  else if (strcmp (argv[1], "scale") == 0 && argc == 5) {
+    test_scale (atoi (argv[2]), atoi (argv[3]), atoi (argv[4]));
+  }
+  else {
+    usage (argv[0]);
+  }
+  return 0;
+}
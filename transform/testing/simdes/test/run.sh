@@ -0,0 +1,105 @@
+#!/bin/sh
+
+echo
+echo "************************************************************************"
+echo "*               Testing simulation kernel                              *"
+echo "************************************************************************"
+echo
+
+
+ARCH=`$VLSI_TOOLS_SRC/scripts/getarch`
+OS=`$VLSI_TOOLS_SRC/scripts/getos`
+EXT=${ARCH}_${OS}
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../test_simdes.$EXT ]; then
+  ACTTOOL=$ACT_HOME/bin/test_simdes
+  echo "testing installation"
+echo
+else
+  ACTTOOL=../test_simdes.$EXT
+fi
+
+check_echo=0
+myecho()
+{
+  if [ $check_echo -eq 0 ]
+  then
+	check_echo=1
+	count=`echo -n "" | wc -c | awk '{print $1}'`
+	if [ $count -gt 0 ]
+	then
+		check_echo=2
+	fi
+  fi
+  if [ $check_echo -eq 1 ]
+  then
+	echo -n "$@"
+  else
+	echo "$@\c"
+  fi
+}
+
+
+fail=0
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+#
+# Each entry is <test>[:<args>]; the output is compared against
+# runs/<test>.stdout, so runs of the same test with different
+# arguments must produce the same output.
+#
+myecho " "
+for t in order cancel ckfork ckpt par:1 par:2 par:3 par:8
+do
+	name=`echo $t | sed 's/:.*//'`
+	args=`echo $t | sed 's/:/ /g'`
+	myecho ".[$t]"
+	ok=1
+	$ACTTOOL $args > runs/$name.t.stdout 2> runs/$name.t.stderr
+	if ! cmp runs/$name.t.stdout runs/$name.stdout >/dev/null 2>/dev/null
+	then
+		echo
+		myecho "** FAILED TEST $t: stdout"
+		fail=`expr $fail + 1`
+		ok=0
+		if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            diff runs/$name.t.stdout runs/$name.stdout
+        fi
+	fi
+	if [ -s runs/$name.t.stderr ]
+	then
+		if [ $ok -eq 1 ]
+		then
+			echo
+			myecho "** FAILED TEST $t:"
+		fi
+		myecho " stderr"
+		fail=`expr $fail + 1`
+		ok=0
+	fi
+	if [ $ok -eq 0 ]
+	then
+		echo " **"
+		myecho " "
+	fi
+done
+echo
+
+
+if [ $fail -ne 0 ]
+then
+	if [ $fail -eq 1 ]
+	then
+		echo "--- Summary: 1 test failed ---"
+	else
+		echo "--- Summary: $fail tests failed ---"
+	fi
+	exit 1
+else
+	echo
+	echo "SUCCESS! All tests passed."
+fi
+echo
@@ -31,16 +31,175 @@
 
 static void usage (char *name)
 {
-  fprintf (stderr, "Usage: %s [act-options] [-v] <actfile> <process>\n", name);
+  fprintf (stderr, "Usage: %s [act-options] [-v|-l] <actfile> <process>\n", name);
+  fprintf (stderr, " -v : verbose\n");
+  fprintf (stderr, " -l : check offset/connection/name round trips\n");
   exit (1);
 }
 
 
+/*------------------------------------------------------------------------
+ *
+ *  Layout checks
+ *
+ *------------------------------------------------------------------------
+ */
+static const char *type_name[] = { "bool", "int", "chan", "chan" };
+static int errors;
+static int nstruct;
+
+static void layout_error (const char *msg, int off, int type, const char *nm)
+{
+  printf ("ERROR: %s: %s offset %d%s%s\n", msg, type_name[type], off,
+	  nm ? ", " : "", nm ? nm : "");
+  errors++;
+}
+
+/*
+ * flat offset -> connection -> name -> id -> flat offset. Returns 1
+ * if the offset maps to state. Fields of dynamic arrays of structures
+ * are named by their array element, so they only go one way.
+ */
+static int check_flat (ActStatePass *sp, int off, int type)
+{
+  char buf[1024];
+  int row, doff, off2, type2;
+  act_connection *c;
+
+  c = sp->layoutConn (off, type, &row, &doff);
+  if (!c) {
+    layout_error ("no connection", off, type, NULL);
+    return 0;
+  }
+  if (!sp->layoutName (off, type, buf, 1024)) {
+    layout_error ("no name", off, type, NULL);
+    return 0;
+  }
+  stateinfo_t *si = (off < 0) ? sp->rootStateInfo () :
+    sp->layoutRow (row)->si;
+  int oi, ob;
+  if (doff >= 0 && sp->getTypeDynamicStructOffset (si, c, &oi, &ob)) {
+    nstruct++;
+    return 1;
+  }
+  ActId *id = ActId::parseId (buf);
+  if (!id) {
+    layout_error ("name does not parse", off, type, buf);
+    return 0;
+  }
+  if (!sp->layoutOffset (id, &off2, &type2)) {
+    layout_error ("name has no offset", off, type, buf);
+  }
+  else if (off2 != off || (type2 >= 2) != (type >= 2) ||
+	   (type < 2 && type2 != type)) {
+    layout_error ("name maps to a different offset", off, type, buf);
+  }
+  delete id;
+  return 1;
+}
+
+/*
+ * port offset -> connection -> port offset, for every port of every
+ * process in the design; the port must also map into the flat layout.
+ */
+static int check_ports (ActStatePass *sp, int row, int type, int n)
+{
+  state_layout_t *r = sp->layoutRow (row);
+  int cnt = 0;
+
+  for (int i=0; i < n; i++) {
+    int off = sp->portOffset (i);
+    int doff, off2, type2, flat, ftype, frow;
+    act_connection *c;
+
+    c = sp->getConnFromOffset (r->si, off, type, &doff);
+    if (!c) {
+      layout_error ("port has no connection", off, type, r->name);
+      continue;
+    }
+    if (!sp->getTypeOffset (r->si, c, &off2, &type2, NULL) ||
+	off2 != off || (type2 >= 2) != (type >= 2)) {
+      layout_error ("port maps to a different offset", off, type, r->name);
+      continue;
+    }
+    if (!sp->layoutOffset (row, c, &flat, &ftype)) {
+      layout_error ("port has no flat offset", off, type, r->name);
+      continue;
+    }
+    act_connection *fc = sp->layoutConn (flat, ftype, &frow, &doff);
+    if (!fc || !sp->layoutOffset (frow, fc, &off2, &type2) || off2 != flat) {
+      layout_error ("port flat offset does not round trip", off, type,
+		    r->name);
+      continue;
+    }
+    cnt++;
+  }
+  return cnt;
+}
+
+static void check_layout (ActStatePass *sp)
+{
+  int rows = sp->buildLayout ();
+  stateinfo_t *si = sp->rootStateInfo ();
+  state_counts g = sp->getGlobals ();
+  int nb, nx, ni, nc;
+  int pb, pi, pc;
+
+  errors = 0;
+  nstruct = 0;
+
+  /* -- every flat offset -- */
+  nb = 0;
+  for (int i=0; i < si->all.numAllBools(); i++) {
+    nb += check_flat (sp, i, 0);
+  }
+  ni = 0;
+  for (int i=0; i < si->all.numInts(); i++) {
+    ni += check_flat (sp, i, 1);
+  }
+  nc = 0;
+  for (int i=0; i < si->all.numChans(); i++) {
+    nc += check_flat (sp, i, 2);
+  }
+  printf ("layout: %d rows; %d bools, %d ints, %d chans\n", rows, nb, ni, nc);
+  if (nstruct > 0) {
+    printf ("  %d in dynamic arrays of structures\n", nstruct);
+  }
+
+  /* -- globals -- */
+  nx = 0;
+  for (int i=0; i < g.numAllBools(); i++) {
+    nx += check_flat (sp, sp->globalOffset (i), 0);
+  }
+  for (int i=0; i < g.numInts(); i++) {
+    nx += check_flat (sp, sp->globalOffset (i), 1);
+  }
+  for (int i=0; i < g.numChans(); i++) {
+    nx += check_flat (sp, sp->globalOffset (i), 2);
+  }
+  printf ("globals: %d\n", nx);
+
+  /* -- ports of every instance -- */
+  pb = 0;
+  pi = 0;
+  pc = 0;
+  for (int i=0; i < rows; i++) {
+    state_layout_t *r = sp->layoutRow (i);
+    pb += check_ports (sp, i, 0, r->si->ports.numAllBools());
+    pi += check_ports (sp, i, 1, r->si->ports.numInts());
+    pc += check_ports (sp, i, 2, r->si->ports.numChans());
+  }
+  printf ("ports: %d bools, %d ints, %d chans\n", pb, pi, pc);
+  printf ("errors: %d\n", errors);
+}
+
+
 int main (int argc, char **argv)
 {
   Act *a;
   char *proc;
   bool verbose = false;
+  bool layout = false;
   int shift = 0;
 
   /* initialize ACT library */
@@ -50,13 +209,17 @@ int main (int argc, char **argv)
   if (argc != 3 && argc != 4) {
     usage (argv[0]);
   }
-  if (argc == 4 && strcmp (argv[1], "-v") != 0) {
-    usage (argv[0]);
-  }
-  else if (argc == 4) {
+  if (argc == 4 && strcmp (argv[1], "-v") == 0) {
     verbose = true;
     shift = 1;
   }
+  else if (argc == 4 && strcmp (argv[1], "-l") == 0) {
+    layout = true;
+    shift = 1;
+  }
+  else if (argc == 4) {
+    usage (argv[0]);
+  }
 
   /* read in the ACT file */
   a = new Act (argv[1+shift]);
@@ -80,7 +243,12 @@ int main (int argc, char **argv)
   sp->run (p);
   sp->setVerbose (verbose);
 
-  sp->Print (stdout, p);
+  if (layout) {
+    check_layout (sp);
+  }
+  else {
+    sp->Print (stdout, p);
+  }
 
 //  ActBooleanizePass *bp = dynamic_cast<ActBooleanizePass *>(a->pass_find ("booleanize"));
 //  bp->Print (stdout, p);
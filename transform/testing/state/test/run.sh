@@ -123,6 +123,20 @@ do
 	fi
         fi
 	if [ $ok -eq 1 ]
+	then
+	$ACTTOOL -cnf=decomp.conf -Wno_local_driver:on -l $i 'foo<>' > runs/$i.t.stdoutl 2>/dev/null
+	if ! cmp runs/$i.t.stdoutl runs/$i.stdoutl >/dev/null 2>/dev/null
+	then
+		echo 
+		myecho "** FAILED TEST $i: stdoutl"
+		fail=`expr $fail + 1`
+		ok=0
+		if [ ! x$ACT_TEST_VERBOSE = x ]; then
+            diff runs/$i.t.stdoutl runs/$i.stdoutl
+        fi
+	fi
+	fi
+	if [ $ok -eq 1 ]
 	then
 		rm runs/$i.c.stderrv
 		if [ $num -eq $lim ]
@@ -31,4 +31,5 @@ do
 	$ACTTOOL -cnf=decomp.conf -Wno_local_driver:on -v $i 'foo<>' > runs/$i.stdoutv 2> runs/$i.tmp.stderrv
 	sort runs/$i.tmp.stderrv > runs/$i.stderrv
 	rm runs/$i.tmp.stderrv
+	$ACTTOOL -cnf=decomp.conf -Wno_local_driver:on -l $i 'foo<>' > runs/$i.stdoutl 2>/dev/null
 done
@@ -751,8 +751,8 @@ void free_typetable (struct Hashtable *H)
   for (i=0; i < H->size; i++) 
     for (b = H->head[i]; b; b = b->next) {
       id = (struct idinfo *)b->v;
+      /* ids themselves live in the VNet blocks */
       A_FREE (id->a);
-      FREE (id);
     }
   hash_free (H);
 }
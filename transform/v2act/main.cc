@@ -32,7 +32,7 @@ char *channame;
 
 static void usage (char *s)
 {
-  fprintf (stderr, "Usage: %s [act-options] [-a] [-n lib_namespace] [-c clkname] [-o outfile] -l <lib> <file.v>\n", s);
+  fprintf (stderr, "Usage: %s [act-options] [-a] [-n lib_namespace] [-c clkname] [-o outfile] [-j threads] -l <lib> <file.v>\n", s);
   fprintf (stderr, "  -a : async output\n");
   fprintf (stderr, "  -g : toggle hazard generation\n");
   fprintf (stderr, "  -v : vectorize all ports in output processes \n");
@@ -41,6 +41,7 @@ static void usage (char *s)
   fprintf (stderr, "  -o <file> : specify output file name [default: stdout]\n");
   fprintf (stderr, "  -l <lib>  : synchronous library (act file) [default: sync.act]\n");
   fprintf (stderr, "  -n <ns>   : look for library components in namespace <ns>\n");
+  fprintf (stderr, "  -j <n>    : use <n> threads for fanout analysis [default: 1]\n");
   exit (1);
 }
 
@@ -58,6 +59,7 @@ int main (int argc, char **argv)
   char *libname;
   int i, j;
   int toggle_haz;
+  int nthreads;
 
   Act::Init (&argc, &argv);
 
@@ -78,6 +80,7 @@ int main (int argc, char **argv)
   config_set_default_string ("s2a.lib_namespace", "sync");
 
   toggle_haz = 0;
+  nthreads = 1;
 
   /*-- Warning: we will be ignoring initial values on the flops --*/
   config_set_default_string ("v2act.posflop.cell", "DFFPOSX1");
@@ -91,7 +94,7 @@ int main (int argc, char **argv)
 
   config_set_default_int ("v2act.vectorize", 0);
 
-  while ((ch = getopt (argc, argv, "gC:c:avo:l:n:t")) != -1) {
+  while ((ch = getopt (argc, argv, "gC:c:avo:l:n:tj:")) != -1) {
     switch (ch) {
     case 't':
       config_set_default_string ("v2act.tie.hi.cell", "TIEHIX1");
@@ -139,6 +142,13 @@ int main (int argc, char **argv)
       config_set_int("v2act.vectorize", 1);
       break;
 
+    case 'j':
+      nthreads = atoi (optarg);
+      if (nthreads < 1) {
+	nthreads = 1;
+      }
+      break;
+
     case 'l':
       if (libname) {
 	FREE (libname);
@@ -184,10 +194,7 @@ int main (int argc, char **argv)
   }
 
   if (mode == V_ASYNC) {
-    module_t *m;
-    for (m = w->hd; m; m = m->next) {
-      compute_fanout (w, m);
-    }
+    compute_fanout_all (w, nthreads);
   }
 
   emit_types (w);
@@ -23,6 +23,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "v2act.h"
 
 
@@ -32,7 +33,6 @@ static void _label_clock_helper (VNet *v, module_t *m, const char *clk)
   int i;
   id_info_t *id;
   conn_info_t *c;
-  hash_bucket_t *b;
 
   m->flags |= M_FLAG_CLKDONE;
 
@@ -58,10 +58,11 @@ static void _label_clock_helper (VNet *v, module_t *m, const char *clk)
 	  c->isclk = 1;
 
 	  Assert (c->prefix->nm, "Prefix without module name?");
-	  b = hash_lookup (v->M, c->prefix->nm);
-	  if (!b) {
+	  /* the instance type was resolved while parsing */
+	  n = c->prefix->m;
+	  if (!n) {
 	    /* library, ignore */
-	    if (verilog_find_lib (v->a, c->prefix->nm) == NULL) {
+	    if (!c->prefix->p) {
 	      fatal_error ("Module `%s' not found in library!", c->prefix->nm);
 	    }
 #if 0 
@@ -70,7 +71,6 @@ static void _label_clock_helper (VNet *v, module_t *m, const char *clk)
 #endif
 	  }
 	  else {
-	    n = (module_t *)b->v;
 	    if ((n->flags & M_FLAG_CLKDONE) == 0) {
 	      _label_clock_helper (v, n, c->id.id->myname);
 	    }
@@ -324,9 +324,14 @@ void compute_fanout (VNet *v, module_t *m)
       /* instance: look at the type */
       Assert (info->isinst, "What?");
       Assert (info->nm, "No module name?");
-      if ((p = verilog_find_lib (v->a, info->nm))) {
+      if ((p = info->p)) {
 	/* port direction */
-	j = p->FindPort (m->conn[i]->id.id->myname);
+	if (m->conn[i]->port >= 0) {
+	  j = m->conn[i]->port + 1;
+	}
+	else {
+	  j = p->FindPort (m->conn[i]->id.id->myname);
+	}
 	if (j == 0) {
 	  fatal_error ("Port name `%s' not found in library process `%s'",
 		       m->conn[i]->id.id->myname, p->getName());
@@ -360,13 +365,12 @@ void compute_fanout (VNet *v, module_t *m)
       }
       else {
 	module_t *n;
-	/* lookup module in the module table */
-	b = hash_lookup (v->M, info->nm);
-	if (!b) {
+	n = info->m;
+	if (!n) {
 	  fatal_error ("Module name `%s' missing?", info->nm);
 	}
-	n = (module_t *)b->v;
-	for (j=0; j < A_LEN (n->port_list); j++) {
+	j = m->conn[i]->port >= 0 ? m->conn[i]->port : 0;
+	for (; j < A_LEN (n->port_list); j++) {
 	  if (strcmp (n->port_list[j]->myname, m->conn[i]->id.id->myname) == 0) {
 	    Assert (n->port_list[j]->isport, "??");
 	    if (n->port_list[j]->isinput) {
@@ -394,13 +398,13 @@ void compute_fanout (VNet *v, module_t *m)
 	    else {
 	      fatal_error ("Undirected port `%s' in module `%s'", 
 			   n->port_list[j]->myname,
-			   b->key);
+			   n->b->key);
 	    }
 	  }
 	}
 	if (j == A_LEN (n->port_list)) {
 	  fatal_error ("Unknown port name `%s' for module `%s'", 
-		       m->conn[i]->id.id->myname, b->key);
+		       m->conn[i]->id.id->myname, n->b->key);
 	}
       }
     }
@@ -557,3 +561,68 @@ void compute_fanout (VNet *v, module_t *m)
   }
 #endif
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  compute_fanout_all --
+ *
+ *   Compute the fanout for every module. A module only updates the
+ *   ids and connections that it owns, so modules are handed out to
+ *   nthreads workers.
+ *
+ *------------------------------------------------------------------------
+ */
+struct fanout_work {
+  VNet *v;
+  module_t *m;			/* next module to process */
+  pthread_mutex_t lock;
+};
+
+static void *_fanout_worker (void *arg)
+{
+  struct fanout_work *w = (struct fanout_work *)arg;
+  module_t *m;
+
+  while (1) {
+    pthread_mutex_lock (&w->lock);
+    m = w->m;
+    if (m) {
+      w->m = m->next;
+    }
+    pthread_mutex_unlock (&w->lock);
+    if (!m) {
+      break;
+    }
+    compute_fanout (w->v, m);
+  }
+  return NULL;
+}
+
+void compute_fanout_all (VNet *v, int nthreads)
+{
+  struct fanout_work w;
+  pthread_t *tids;
+  int i;
+
+  w.v = v;
+  w.m = v->hd;
+  pthread_mutex_init (&w.lock, NULL);
+
+  if (nthreads > 1) {
+    MALLOC (tids, pthread_t, nthreads-1);
+    for (i=0; i < nthreads-1; i++) {
+      if (pthread_create (&tids[i], NULL, _fanout_worker, &w) != 0) {
+	fatal_error ("Could not create fanout thread");
+      }
+    }
+  }
+  _fanout_worker (&w);
+  if (nthreads > 1) {
+    for (i=0; i < nthreads-1; i++) {
+      pthread_join (tids[i], NULL);
+    }
+    FREE (tids);
+  }
+  pthread_mutex_destroy (&w.lock);
+}
@@ -1,5 +1,11 @@
 #!/bin/sh
 
-
-./run_std.sh
-./run_tie.sh
+#
+# run_par.sh runs the standard tests with two fanout threads, and
+# compares against the same saved output as run_std.sh
+#
+fail=0
+./run_std.sh || fail=1
+./run_tie.sh || fail=1
+./run_par.sh || fail=1
+exit $fail
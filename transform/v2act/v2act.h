@@ -49,6 +49,7 @@ void emit_id_deref (FILE *fp, id_deref_t *id);
 void emit_conn_rhs (FILE *fp, conn_rhs_t *r, list_t *l);
 
 void compute_fanout (VNet *v, module_t *m);
+void compute_fanout_all (VNet *v, int nthreads);
 
 extern char *channame;
 
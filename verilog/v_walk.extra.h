@@ -36,12 +36,12 @@
 /* parser */
 id_info_t *verilog_gen_id (VNet *, const char *);
 id_info_t *verilog_find_id (VNet *v, const char *s);
-id_info_t *verilog_alloc_id (char *name);
+id_info_t *verilog_alloc_id (VNet *v, char *name);
 void verilog_delete_id (VNet *v, const char *s);
 id_info_t *verilog_gen_const (VNet *, int);
 
 void _verilog_update_id_info (id_info_t *id);
-void _verilog_update_conn_info (id_info_t *id);
+void _verilog_update_conn_info (VNet *v, id_info_t *id);
 int _verilog_array_length (conn_info_t *c);
 
 
@@ -159,6 +159,9 @@ VNet *verilog_read (const char *netlist, const char *actlib)
   w->port_count = 0;
   w->flop_count = 0;
   w->tie_count = 0;
+  w->names = hash_new (128);
+  A_INIT (w->blk);
+  w->blk_used = 0;
 
   v_walk_X (w, t);
 
@@ -407,66 +410,103 @@ static AGraph *_act_create_graph (VNet *v, Process *p)
   return g;
 }
 
-#define UPDATE_LEN_SZ				\
-  do {						\
-    int tmp = strlen (buf+len);			\
-    len += tmp;					\
-    sz -= tmp;					\
-  } while (0)
+/*
+  A net is a collection of input pins + a driver. Every bit of every
+  signal id in a module gets a dense net index: id->net is the index
+  of its first bit, and bit k of an array is id->net + k.
+*/
+struct netinfo {
+  id_info_t *id;		/* net name is id, or id[off] for arrays */
+  int off;
+
+  int idriver;			/* instance vertex for driver, -1 if none */
+  AGvertex *drive_pin;		/* pin for driver */
+  int offset;			/* for an array pin */
 
+  list_t *targets;		/* list of (instv,pin) pairs; NULL if
+				   the net is not connected to anything */
+};
 
-static void sprint_individual_id (char *buf, int sz, id_deref_t *id)
+static void sprint_net (char *buf, int sz, struct netinfo *ni)
 {
-  int len = 0;
-  buf[0] = '\0';
-  snprintf (buf+len, sz, "%s", id->id->myname);
-  UPDATE_LEN_SZ;
-  if (id->isderef) {
-    snprintf (buf+len, sz, "[%d]", id->deref - id->id->a[0].lo);
-    UPDATE_LEN_SZ;
+  if (A_LEN (ni->id->a) > 0) {
+    snprintf (buf, sz, "%s[%d]", ni->id->myname, ni->off);
+  }
+  else {
+    snprintf (buf, sz, "%s", ni->id->myname);
   }
 }
 
-static void sprint_individual_idx (char *buf, int sz, id_deref_t *id, int k)
+static struct netinfo *_module_alloc_nets (module_t *m, int *nnets)
 {
-  int len = 0;
-  buf[0] = '\0';
-  snprintf (buf+len, sz, "%s", id->id->myname);
-  UPDATE_LEN_SZ;
-  snprintf (buf+len, sz, "[%d]", k - id->id->a[0].lo);
-  UPDATE_LEN_SZ;
-}
+  struct netinfo *N;
+  int n = 0;
 
-struct netinfo {
-  int idriver;			/* instance vertex for driver, -1 if none */
-  AGvertex *drive_pin;		/* pin for driver */
-  int offset;			/* for an array pin */
+  for (int i=0; i < m->H->size; i++) {
+    for (hash_bucket_t *b = m->H->head[i]; b; b = b->next) {
+      id_info_t *id = (id_info_t *)b->v;
+      if (id->isinst || id->ismodname) {
+	id->net = -1;
+	continue;
+      }
+      id->net = n;
+      if (A_LEN (id->a) > 0) {
+	n += id->a[0].hi - id->a[0].lo + 1;
+      }
+      else {
+	n++;
+      }
+    }
+  }
 
-  list_t *targets;		/* list of (instv,pin) pairs */
-};
+  *nnets = n;
+  if (n == 0) {
+    return NULL;
+  }
+  MALLOC (N, struct netinfo, n);
+  for (int i=0; i < m->H->size; i++) {
+    for (hash_bucket_t *b = m->H->head[i]; b; b = b->next) {
+      id_info_t *id = (id_info_t *)b->v;
+      if (id->net == -1) continue;
+      int count = 1;
+      if (A_LEN (id->a) > 0) {
+	count = id->a[0].hi - id->a[0].lo + 1;
+      }
+      for (int k=0; k < count; k++) {
+	N[id->net + k].id = id;
+	N[id->net + k].off = k;
+	N[id->net + k].idriver = -2;
+	N[id->net + k].drive_pin = NULL;
+	N[id->net + k].offset = -1;
+	N[id->net + k].targets = NULL;
+      }
+    }
+  }
+  return N;
+}
 
 
-static void record_connection_idx_both (struct Hashtable *H, char *name,
+static void record_connection_idx_both (struct netinfo *N,
 					AGraph *ag,
 					int inst_v, AGvertex *pin,
 					int idx1,
 					id_info_t *id,
+					int off,
 					int idx2)
 {
-  hash_bucket_t *b;
   struct netinfo *ni;
+  char buf[10240];
 
-  b = hash_lookup (H, name);
-  if (!b) {
-    NEW (ni, struct netinfo);
-    ni->idriver = -2;
-    ni->targets = list_new ();
+  Assert (id->net >= 0, "Connection to an id without a net?");
+  Assert (off >= 0 &&
+	  (off == 0 ||
+	   (A_LEN (id->a) > 0 && off <= id->a[0].hi - id->a[0].lo)),
+	  "Net offset out of range");
 
-    b = hash_add (H, name);
-    b->v = ni;
+  ni = &N[id->net + off];
+  if (!ni->targets) {
+    ni->targets = list_new ();
   }
-  
-  ni = (struct netinfo *) b->v;
 
   /* process <inst_v,pin,indx1> */
   library_vertex_info *li = (library_vertex_info *)pin->info;
@@ -477,7 +517,8 @@ static void record_connection_idx_both (struct Hashtable *H, char *name,
   }
   else {
     if (ni->idriver != -2) {
-      warning ("Multiple driver for `%s'?", name);
+      sprint_net (buf, 10240, ni);
+      warning ("Multiple driver for `%s'?", buf);
     }
     else {
       ni->idriver = inst_v;
@@ -501,8 +542,9 @@ static void record_connection_idx_both (struct Hashtable *H, char *name,
 	  /* ok! */
 	}
 	else {
+	  sprint_net (buf, 10240, ni);
 	  warning ("Already found internal driver; input port `%s'; net: %s",
-		   id->myname, name);
+		   id->myname, buf);
 	}
       }
       else {
@@ -518,36 +560,39 @@ static void record_connection_idx_both (struct Hashtable *H, char *name,
 }
 
 
-static void record_connection (struct Hashtable *H, char *name,
+static void record_connection (struct netinfo *N,
 			       AGraph *ag,
 			       int inst_v, AGvertex *pin,
 			       id_info_t *id)
 {
-  record_connection_idx_both (H, name, ag, inst_v, pin, -1, id, -1);
+  record_connection_idx_both (N, ag, inst_v, pin, -1, id, 0, -1);
 }
 
-static void record_connection_idx (struct Hashtable *H, char *name,
+static void record_connection_idx (struct netinfo *N,
 				   AGraph *ag,
 				   int inst_v, AGvertex *pin,
 				   id_info_t *id, int idx)
 {
-  record_connection_idx_both (H, name, ag, inst_v, pin, idx - id->a[0].lo,
-			      id, idx - id->a[0].lo);
+  record_connection_idx_both (N, ag, inst_v, pin, idx - id->a[0].lo,
+			      id, idx - id->a[0].lo, idx - id->a[0].lo);
 }
 
 
-static void record_connection_idx2 (struct Hashtable *H, char *name,
+static void record_connection_idx2 (struct netinfo *N,
 				    AGraph *ag,
 				    int inst_v, AGvertex *pin, int idx,
-				    id_info_t *id)
+				    id_deref_t *id)
 {
-  record_connection_idx_both (H, name, ag, inst_v, pin, idx, id, -1);
+  record_connection_idx_both (N, ag, inst_v, pin, idx, id->id,
+			      id->isderef ? id->deref - id->id->a[0].lo : 0,
+			      -1);
 }
     
 static
 AGraph *_module_create_graph (VNet *v, module_t *m)
 {
-  struct Hashtable *H;
+  struct netinfo *N;
+  int nnets;
   char buf[10240];
   
   AGraph *g = new AGraph (new AGmoduleinfo(m));
@@ -620,7 +665,7 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
 
 	Process *p;
 	Assert (id->nm, "Hmm...");
-	if ((p = verilog_find_lib (v->a, id->nm))) {
+	if ((p = id->p)) {
 	  /* this is a library module */
 	  hash_bucket_t *tmp;
 	  tmp = hash_lookup (v->missing, id->nm);
@@ -632,13 +677,10 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
 	  subg = (AGraph *)tmp->v;
 	}
 	else {
-	  module_t *n;
-	  hash_bucket_t *tmp;
-	  tmp = hash_lookup (v->M, id->nm);
-	  if (!tmp) {
+	  module_t *n = id->m;
+	  if (!n) {
 	    fatal_error ("Module name `%s': missing?", id->nm);
 	  }
-	  n = (module_t *)tmp->v;
 	  if (!n->space) {
 	    _module_create_graph (v, n);
 	    Assert (n->space, "Hmm");
@@ -661,10 +703,7 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
      Step 1: find all drivers and associate them with the id for the net.
    */
 
-  /* A net is a collection of input pins + a driver. 
-     We need to elaborate arrays.
-   */
-  H = hash_new (16);
+  N = _module_alloc_nets (m, &nnets);
   
   for (int i=0; i < A_LEN (m->conn); i++) {
     conn_info_t *c = m->conn[i];
@@ -746,20 +785,18 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
 	  }
 	  /* lo..hi */
 	  for (int i=lo; i <= hi; i++) {
-	    sprint_individual_idx (buf, 10240, &c->r->id, i);
 	    if (c->r->id.isderef) {
-	      record_connection_idx_both (H, buf, g, inst_v, pin, -1,
-					  c->r->id.id, i);
+	      record_connection_idx_both (N, g, inst_v, pin, -1,
+					  c->r->id.id, i, i);
 	    }
 	    else {
-	      record_connection_idx (H, buf, g, inst_v, pin, c->r->id.id, i);
+	      record_connection_idx (N, g, inst_v, pin, c->r->id.id, i);
 	    }
 	  }
 	}
 	else {
 	  /* simple connection */
-	  sprint_individual_id (buf, 10240, &c->r->id);
-	  record_connection (H, buf, g, inst_v, pin, c->r->id.id);
+	  record_connection (N, g, inst_v, pin, c->r->id.id);
 	}
       }
       else {
@@ -783,15 +820,12 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
 	      hi = rhs->id.id->a[0].hi;
 	    }
 	    for (int i=lo; i <= hi; i++) {
-	      sprint_individual_idx (buf, 10240, &rhs->id, i);
-	      record_connection_idx (H, buf, g, inst_v, pin, rhs->id.id, i);
+	      record_connection_idx (N, g, inst_v, pin, rhs->id.id, i);
 	      pos++;
 	    }
 	  }
 	  else {
-	    sprint_individual_id (buf, 10240, &rhs->id);
-	    record_connection_idx2 (H, buf, g, inst_v, pin, pos,
-				    rhs->id.id);
+	    record_connection_idx2 (N, g, inst_v, pin, pos, &rhs->id);
 	    pos++;
 	  }
 	}
@@ -801,136 +835,138 @@ AGraph *_module_create_graph (VNet *v, module_t *m)
   }
 
   /* build the edges */
-  for (int i=0; i < H->size; i++) {
-    for (hash_bucket_t *b = H->head[i]; b; b = b->next) {
-      struct netinfo *ni = (struct netinfo *)b->v;
-      /* process net! */
+  for (int i=0; i < nnets; i++) {
+    struct netinfo *ni = &N[i];
+    if (!ni->targets) continue;
+    /* process net! */
 #if 0      
-      printf ("[NET %s (%d)]:\n", b->key, ni->idriver);
+    sprint_net (buf, 10240, ni);
+    printf ("[NET %s (%d)]:\n", buf, ni->idriver);
 #endif      
-      if (ni->idriver == -2) {
-	if (Act::no_local_driver) {
-	  if (!config_exists ("s2a.warnings.no_driver") ||
-	      (config_get_int ("s2a.warnings.no_driver") == 1)) {
-	    warning ("Missing driver, net `%s'", b->key);
-	  }
+    if (ni->idriver == -2) {
+      if (Act::no_local_driver) {
+	if (!config_exists ("s2a.warnings.no_driver") ||
+	    (config_get_int ("s2a.warnings.no_driver") == 1)) {
+	  sprint_net (buf, 10240, ni);
+	  warning ("Missing driver, net `%s'", buf);
 	}
       }
-      else {
-	int srcvertex, srcpin;
-
-	if (ni->idriver == -1) {
-	  if (ni->drive_pin == NULL) {
-	    /* must be Vdd or GND */
-	    /* supply; const values, skip! */
-	    srcvertex = -1;
-	    srcpin = -1;
-	  }
-	  else {
-	    inst_vertex_info *v;
-	    library_vertex_info *li = (library_vertex_info *)ni->drive_pin->info;
-	    srcvertex = -1;
-	    srcpin = g->V2idx (ni->drive_pin);
-	    if (ni->offset != -1) {
-	      srcpin += ni->offset;
-	    }
-	  }
+    }
+    else {
+      int srcvertex, srcpin;
+
+      if (ni->idriver == -1) {
+	if (ni->drive_pin == NULL) {
+	  /* must be Vdd or GND */
+	  /* supply; const values, skip! */
+	  srcvertex = -1;
+	  srcpin = -1;
 	}
 	else {
-	  inst_vertex_info *iv = (inst_vertex_info *)(g->getVertex (ni->idriver))->info;
-	  Assert (iv->g, "Hmm");
-	  srcvertex = ni->idriver; // no array instances
-	  srcpin = iv->g->V2idx (ni->drive_pin);
-
+	  inst_vertex_info *v;
+	  library_vertex_info *li = (library_vertex_info *)ni->drive_pin->info;
+	  srcvertex = -1;
+	  srcpin = g->V2idx (ni->drive_pin);
 	  if (ni->offset != -1) {
 	    srcpin += ni->offset;
 	  }
 	}
+      }
+      else {
+	inst_vertex_info *iv = (inst_vertex_info *)(g->getVertex (ni->idriver))->info;
+	Assert (iv->g, "Hmm");
+	srcvertex = ni->idriver; // no array instances
+	srcpin = iv->g->V2idx (ni->drive_pin);
 
-	/* 
-	   srcvertex = -1 if pin, inst_id otherwise
-	   srcpin = pin loc 
-	*/
+	if (ni->offset != -1) {
+	  srcpin += ni->offset;
+	}
+      }
+
+      /* 
+	 srcvertex = -1 if pin, inst_id otherwise
+	 srcpin = pin loc 
+      */
 #if 0
-	{
-	  if (srcvertex == -1) {
-	    if (srcpin != -1) {
-	      AGvertex *v = g->getVertex (srcpin);
-	      library_vertex_info *vi = (library_vertex_info *) v->info;
-	      printf ("%s [pin %d] ", vi->pin, v->isio);
-	    }
-	  }
-	  else {
-	    AGvertex *v = g->getVertex (srcvertex);
-	    inst_vertex_info *vi = (inst_vertex_info *) v->info;
-	    printf ("%s.{%d}", vi->id->myname, srcpin);
-	    AGvertex *v2 = vi->g->getVertex (srcpin);
-	    library_vertex_info *li = (library_vertex_info *) v2->info;
-	    printf ("%s [pin %d] ", li->pin, v2->isio);
-	  }
-	}	
-	printf (" ->{%d} \n", list_length (ni->targets)/3);
-#endif	
-	
-	for (listitem_t *li = list_first (ni->targets); li;
-	     li = list_next (li)) {
-	  int inst_v;
-	  AGvertex *pin;
-	  int idx;
-	  library_edge_info *ei;
-	  int dst_v = -1;
-
-	  inst_v = list_ivalue (li); li = list_next (li);
-	  pin = (AGvertex *)list_value (li); li = list_next (li);
-	  idx = list_ivalue (li);
-
-	  ei = newedge();
-	  if (srcvertex != -1) {
-	    ei->srcpin = srcpin;
-	  }
-	  else {
-	    ei->srcpin = -1;
+      {
+	if (srcvertex == -1) {
+	  if (srcpin != -1) {
+	    AGvertex *v = g->getVertex (srcpin);
+	    library_vertex_info *vi = (library_vertex_info *) v->info;
+	    printf ("%s [pin %d] ", vi->pin, v->isio);
 	  }
+	}
+	else {
+	  AGvertex *v = g->getVertex (srcvertex);
+	  inst_vertex_info *vi = (inst_vertex_info *) v->info;
+	  printf ("%s.{%d}", vi->id->myname, srcpin);
+	  AGvertex *v2 = vi->g->getVertex (srcpin);
+	  library_vertex_info *li = (library_vertex_info *) v2->info;
+	  printf ("%s [pin %d] ", li->pin, v2->isio);
+	}
+      }       
+      printf (" ->{%d} \n", list_length (ni->targets)/3);
+#endif  
 
-	  if (inst_v == -1) {
-	    /* local pin */
-	    if (pin == NULL) {
-	      /* skip */
-	    }
-	    else {
-	      dst_v = g->V2idx (pin);
-	      if (idx != -1) {
-		dst_v += idx;
-	      }
-	      ei->dstpin = -1;
-	    }
+      for (listitem_t *li = list_first (ni->targets); li;
+	   li = list_next (li)) {
+	int inst_v;
+	AGvertex *pin;
+	int idx;
+	library_edge_info *ei;
+	int dst_v = -1;
+
+	inst_v = list_ivalue (li); li = list_next (li);
+	pin = (AGvertex *)list_value (li); li = list_next (li);
+	idx = list_ivalue (li);
+
+	ei = newedge();
+	if (srcvertex != -1) {
+	  ei->srcpin = srcpin;
+	}
+	else {
+	  ei->srcpin = -1;
+	}
+
+	if (inst_v == -1) {
+	  /* local pin */
+	  if (pin == NULL) {
+	    /* skip */
 	  }
 	  else {
-	    Assert (pin->isio != 0, "What?");
-	    inst_vertex_info *iv = (inst_vertex_info *)(g->getVertex (inst_v))->info;
-	    ei->dstpin = iv->g->V2idx (pin);
+	    dst_v = g->V2idx (pin);
 	    if (idx != -1) {
-	      ei->dstpin += idx;
+	      dst_v += idx;
 	    }
-	    dst_v = inst_v;
-	    AGvertex *pin2 = iv->g->getVertex (ei->dstpin);
-	    Assert (pin2->isio != 0, "What?");
+	    ei->dstpin = -1;
 	  }
-	  if (srcvertex != -1) {
-	    g->addEdge (srcvertex, dst_v, ei);
+	}
+	else {
+	  Assert (pin->isio != 0, "What?");
+	  inst_vertex_info *iv = (inst_vertex_info *)(g->getVertex (inst_v))->info;
+	  ei->dstpin = iv->g->V2idx (pin);
+	  if (idx != -1) {
+	    ei->dstpin += idx;
 	  }
-	  else {
-	    if (srcpin != -1) {
-	      g->addEdge (srcpin, dst_v, ei);
-	    }
+	  dst_v = inst_v;
+	  AGvertex *pin2 = iv->g->getVertex (ei->dstpin);
+	  Assert (pin2->isio != 0, "What?");
+	}
+	if (srcvertex != -1) {
+	  g->addEdge (srcvertex, dst_v, ei);
+	}
+	else {
+	  if (srcpin != -1) {
+	    g->addEdge (srcpin, dst_v, ei);
 	  }
 	}
       }
-      list_free (ni->targets);
-      FREE (ni);
     }
+    list_free (ni->targets);
+  }
+  if (N) {
+    FREE (N);
   }
-  hash_free (H);
   m->space = g;
 
   return g;
@@ -975,37 +1011,17 @@ static void _mark_clock_nets (VNet *v, module_t *m)
 {
   if (m->flags != 0) return;
 
-  for (int i=0; i < m->H->size; i++) {
-    for (hash_bucket_t *b = m->H->head[i]; b; b = b->next) {
-      id_info_t *id = (id_info_t *)b->v;
-      if (id->isport) continue;
-      if (strcmp (id->myname, "Vdd") == 0 ||
-	  strcmp (id->myname, "GND") == 0) {
-	continue;
-      }
-      if (id->ismodname) {
-	continue;
-      }
-      if (id->isinst) {
-	Process *p;
-	Assert (id->nm, "Hmm...");
-	if ((p = verilog_find_lib (v->a, id->nm))) {
-	  /* nothing to do */
-	}
-	else {
-	  module_t *n;
-	  hash_bucket_t *tmp;
-	  tmp = hash_lookup (v->M, id->nm);
-	  if (!tmp) {
-	    fatal_error ("Module name `%s': missing?", id->nm);
-	  }
-	  n = (module_t *)tmp->v;
-	  _mark_clock_nets (v, n);
-	}
-      }
-      else {
-	/* signal wire; ignore */
-      }
+  /* m->hd is the instance list; types were resolved while parsing */
+  for (id_info_t *id = m->hd; id; id = id->next) {
+    Assert (id->isinst && id->nm, "Hmm...");
+    if (id->p) {
+      /* nothing to do */
+    }
+    else if (id->m) {
+      _mark_clock_nets (v, id->m);
+    }
+    else {
+      fatal_error ("Module name `%s': missing?", id->nm);
     }
   }
 
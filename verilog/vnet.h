@@ -89,6 +89,9 @@ struct idinfo {
   int conn_start, conn_end;
   struct moduletype  *mod;
 
+  int net;			/* first net index for this id, used
+				   while building the net graph */
+
   /** linear list **/
   struct idinfo *next;
 };
@@ -116,6 +119,9 @@ typedef struct connectinfo {
 
   int isclk;			/* 1 if this is a clock connection */
 
+  int port;			/* port index of id in the instance
+				   type, -1 if not yet known */
+
 
   int dir;			/* direction: 0, 1, 2
 				   0, 2 := lhs <= rhs
@@ -190,10 +196,22 @@ typedef struct {
   int flop_count;
   int tie_count;
   id_deref_t *clk;
-  
+
+  /* names that outlive their type table entry */
+  struct Hashtable *names;
+
+  /* ids, derefs, and connections are never freed individually; they
+     are carved out of large blocks that live as long as the VNet */
+  A_DECL (char *, blk);
+  int blk_used;
   
 } VNet;
 
+#define VNET_BLKSZ 65536
+
+/* allocate one parser object from the VNet blocks */
+#define VNEW(v,x,type)  ((x) = (type *) verilog_arena_alloc ((v), sizeof (type)))
+
 #define CURMOD(vw)  ((vw)->tl)
 
 
@@ -210,6 +228,9 @@ typedef struct {
   } u;
 } VRet;
 
+void *verilog_arena_alloc (VNet *v, int sz);
+char *verilog_intern (VNet *v, const char *s);
+
 Process *verilog_find_lib (Act *a, const char *nm);
 VNet *verilog_read (const char *file, const char *lib);
 AGraph *verilog_create_netgraph (VNet *n);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "v_walk_X.h"
 #include "v_walk.extra.h"
 
@@ -55,6 +56,54 @@ VRet *v_wrap_X_conn_info_t_p (conn_info_t *c)
   return NULL;
 }
 
+/*------------------------------------------------------------------------
+ *
+ *  verilog_arena_alloc --
+ *
+ *   Allocate zeroed storage for a parser object. Objects are packed
+ *   into VNET_BLKSZ blocks owned by the VNet, so a netlist with
+ *   millions of instances does not pay for a malloc per id/connection.
+ *
+ *------------------------------------------------------------------------
+ */
+void *verilog_arena_alloc (VNet *v, int sz)
+{
+  char *ret;
+
+  sz = (sz + sizeof (double) - 1) & ~(int)(sizeof (double) - 1);
+  Assert (sz <= VNET_BLKSZ, "Object too large for VNet block");
+
+  if (A_LEN (v->blk) == 0 || v->blk_used + sz > VNET_BLKSZ) {
+    A_NEW (v->blk, char *);
+    MALLOC (A_NEXT (v->blk), char, VNET_BLKSZ);
+    memset (A_NEXT (v->blk), 0, VNET_BLKSZ);
+    A_INC (v->blk);
+    v->blk_used = 0;
+  }
+  ret = v->blk[A_LEN (v->blk)-1] + v->blk_used;
+  v->blk_used += sz;
+  return ret;
+}
+
+/*------------------------------------------------------------------------
+ *
+ *  verilog_intern --
+ *
+ *   Return a single shared copy of the string s
+ *
+ *------------------------------------------------------------------------
+ */
+char *verilog_intern (VNet *v, const char *s)
+{
+  hash_bucket_t *b;
+
+  b = hash_lookup (v->names, s);
+  if (!b) {
+    b = hash_add (v->names, s);
+  }
+  return b->key;
+}
+
 /*------------------------------------------------------------------------
  *
  *  verilog_gen_id --
@@ -75,11 +124,11 @@ id_info_t *verilog_find_id (VNet *v, const char *s)
   }
 }
 
-id_info_t *verilog_alloc_id (char *name)
+id_info_t *verilog_alloc_id (VNet *v, char *name)
 {
   id_info_t *id;
 
-  NEW (id, id_info_t);
+  VNEW (v, id, id_info_t);
 
   id->myname = name;
   id->isinput = 0;
@@ -99,6 +148,7 @@ id_info_t *verilog_alloc_id (char *name)
   id->conn_start = -1;
   id->conn_end = -1;
   id->mod = NULL;
+  id->net = -1;
 
   A_INIT (id->a);
   id->fa = NULL;
@@ -114,7 +164,7 @@ id_info_t *verilog_gen_id (VNet *v, const char *s)
   b = hash_lookup (CURMOD(v)->H, s);
   if (!b) {
     b = hash_add (CURMOD(v)->H, s);
-    id = verilog_alloc_id (b->key);
+    id = verilog_alloc_id (v, b->key);
     b->v = id;
   }
   return (id_info_t *)b->v;
@@ -185,16 +235,17 @@ id_info_t *verilog_gen_const (VNet *v, int zero_or_one)
 	CURMOD(v)->tielo_cnt = 0;
       }
 
-      NEW (ci, conn_info_t);
+      VNEW (v, ci, conn_info_t);
+      ci->port = -1;
       ci->l = NULL;
       ci->isclk = 0;
-      NEW (ci->r, conn_rhs_t);
+      VNEW (v, ci->r, conn_rhs_t);
       ci->r->id.id = newsig;
       ci->r->id.isderef = 0;
       ci->r->id.cnt = 0;
       ci->r->issubrange = 0;
       ci->prefix = v->prefix;
-      ci->id.id = verilog_alloc_id (config_get_string (pinname));
+      ci->id.id = verilog_alloc_id (v, config_get_string (pinname));
       ci->id.cnt = 0;
       ci->id.isderef = 0;
       A_NEW (CURMOD(v)->conn, conn_info_t *);
@@ -281,7 +332,7 @@ void _verilog_update_id_info (id_info_t *id)
   }
 }
 
-void _verilog_update_conn_info (id_info_t *id)
+void _verilog_update_conn_info (VNet *v, id_info_t *id)
 {
   if (!id->m) return;
   if (id->mod && id->conn_start != -1) {
@@ -293,6 +344,7 @@ void _verilog_update_conn_info (id_info_t *id)
 	  if (strcmp (id->mod->conn[i]->id.id->myname,
 		      id->m->port_list[k]->myname) == 0) {
 	    id->used[k] = 1;
+	    id->mod->conn[i]->port = k;
 	    break;
 	  }
 	}
@@ -306,7 +358,8 @@ void _verilog_update_conn_info (id_info_t *id)
 	  fatal_error ("Not enough ports in definition for `%s'?",
 		       id->m->b->key);
 	id->used[k] = 1;
-	id->mod->conn[i]->id.id = verilog_alloc_id (id->m->port_list[k]->myname);
+	id->mod->conn[i]->port = k;
+	id->mod->conn[i]->id.id = verilog_alloc_id (v, id->m->port_list[k]->myname);
       }
     }
   }